@@ -0,0 +1,47 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace chch {
+
+// Named results of a benchmark run, kept in the order they were set. Every
+// metric is lower is better, times and memory.
+struct BenchMetrics {
+	std::vector<std::pair<std::string, double>> values;
+
+	// Replaces the value if name is already there
+	void set(const std::string& name, double value);
+	// null if name was never set
+	const double* find(const std::string& name) const;
+
+	// A flat object, one metric per line so baselines diff well
+	std::string to_json() const;
+	// Takes what to_json writes, any flat object of numbers really. False and
+	// metrics left alone on anything else.
+	static bool parse_json(const std::string& json, BenchMetrics& metrics);
+
+	// False if the file couldn't be written, read or parsed
+	bool save(const std::filesystem::path& path) const;
+	bool load(const std::filesystem::path& path);
+};
+
+struct BenchRegression {
+	std::string name;
+	double baseline;
+	double current;
+	// (current - baseline) / baseline
+	double change;
+};
+
+// Metrics more than threshold above their baseline, 0.1 for 10%. Metrics the
+// baseline doesn't have are skipped, a zero baseline only fails on growth past
+// threshold in absolute terms.
+std::vector<BenchRegression> find_regressions(
+	const BenchMetrics& current,
+	const BenchMetrics& baseline,
+	double threshold);
+
+}
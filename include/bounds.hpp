@@ -0,0 +1,124 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include <limits>
+
+namespace chch {
+
+struct AABB {
+	glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+	bool is_valid() const
+	{
+		return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+	}
+
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+	glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+	void grow(const glm::vec3& point)
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void grow(const AABB& box)
+	{
+		min = glm::min(min, box.min);
+		max = glm::max(max, box.max);
+	}
+
+	// half the real area, only ever compared against other boxes
+	float surface_area() const
+	{
+		glm::vec3 d = max - min;
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+
+	bool overlaps(const AABB& box) const
+	{
+		return min.x <= box.max.x && max.x >= box.min.x
+			&& min.y <= box.max.y && max.y >= box.min.y
+			&& min.z <= box.max.z && max.z >= box.min.z;
+	}
+
+	bool contains(const AABB& box) const
+	{
+		return min.x <= box.min.x && max.x >= box.max.x
+			&& min.y <= box.min.y && max.y >= box.max.y
+			&& min.z <= box.min.z && max.z >= box.max.z;
+	}
+
+	// Arvo's method, stays tight for rotations without touching all 8 corners
+	AABB transform(const glm::mat4& matrix) const
+	{
+		glm::vec3 c = glm::vec3(matrix * glm::vec4(center(), 1.0f));
+		glm::vec3 e = extent();
+		glm::vec3 r(0.0f);
+		for (int col = 0; col < 3; ++col)
+			r += glm::abs(glm::vec3(matrix[col])) * e[col];
+		return { c - r, c + r };
+	}
+};
+
+struct Sphere {
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+
+	Sphere transform(const glm::mat4& matrix) const
+	{
+		float scale = glm::max(
+			glm::length(glm::vec3(matrix[0])),
+			glm::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+		return { glm::vec3(matrix * glm::vec4(center, 1.0f)), radius * scale };
+	}
+
+	bool overlaps(const AABB& box) const
+	{
+		glm::vec3 d = center - glm::clamp(center, box.min, box.max);
+		return glm::dot(d, d) <= radius * radius;
+	}
+};
+
+// direction doesn't have to be normalized, hit distances are in units of it
+struct Ray {
+	glm::vec3 origin = glm::vec3(0.0f);
+	glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+
+	glm::vec3 at(float t) const { return origin + direction * t; }
+
+	// Through a point on screen, ndc runs -1..1 with y down like the renderer's
+	// clip space. The direction is normalized so hit distances are world units.
+	static Ray from_screen(const glm::mat4& inverse_view_projection, glm::vec2 ndc)
+	{
+		glm::vec4 near_point = inverse_view_projection * glm::vec4(ndc, 0.0f, 1.0f);
+		glm::vec4 far_point = inverse_view_projection * glm::vec4(ndc, 1.0f, 1.0f);
+		glm::vec3 origin = glm::vec3(near_point) / near_point.w;
+		glm::vec3 target = glm::vec3(far_point) / far_point.w;
+		return { origin, glm::normalize(target - origin) };
+	}
+
+	// Slab test, t is where the ray enters the box or 0 when it starts inside
+	bool intersect(const AABB& box, float t_max, float& t) const
+	{
+		glm::vec3 inverse = 1.0f / direction;
+		glm::vec3 t0 = (box.min - origin) * inverse;
+		glm::vec3 t1 = (box.max - origin) * inverse;
+		glm::vec3 low = glm::min(t0, t1);
+		glm::vec3 high = glm::max(t0, t1);
+		float enter = glm::max(glm::max(low.x, low.y), glm::max(low.z, 0.0f));
+		float leave = glm::min(glm::min(high.x, high.y), glm::min(high.z, t_max));
+		t = enter;
+		return enter <= leave;
+	}
+};
+
+struct Bounds {
+	AABB box;
+	Sphere sphere;
+};
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "bounds.hpp"
+#include "frustum.hpp"
+#include "simd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace chch {
+
+// Dynamic bounding volume hierarchy over world space boxes.
+//
+// Proxies live in a binary tree that is edited in place: insert picks the
+// sibling with the lowest surface area cost and rotations on the way back up
+// keep the tree from degrading as objects move. build() throws the structure
+// away and does a binned SAH build instead, which is the better choice after
+// loading a level or when most proxies moved at once.
+//
+// Queries never walk the binary tree. It is collapsed into nodes with one
+// SIMD register worth of children each, stored as structure of arrays so a
+// single test covers every child of a node.
+struct Bvh {
+	static const int32_t NULL_NODE = -1;
+
+	// Children per wide node, never fewer than 4 so scalar builds still branch
+	static constexpr size_t WIDE = simd::WIDTH < 4 ? 4 : simd::WIDTH;
+
+	// Boxes handed to move are grown by this much so small motions don't touch the tree
+	float margin = 0.1f;
+
+	// Returns the proxy id, the box is stored as is
+	int32_t insert(const AABB& box, uint32_t user_data);
+	void remove(int32_t proxy);
+	// Reinserts with a box grown by margin when box escaped the stored one.
+	// Returns true when the tree changed.
+	bool move(int32_t proxy, const AABB& box);
+	// Replaces the stored box without touching the tree, follow up with refit
+	void set_box(int32_t proxy, const AABB& box);
+	// Recomputes every parent box bottom up, rotating where that lowers the cost
+	void refit();
+	// Rebuilds the whole tree top down from the current proxies
+	void build();
+	void clear();
+
+	uint32_t user_data(int32_t proxy) const { return m_nodes[proxy].user_data; }
+	const AABB& box(int32_t proxy) const { return m_nodes[proxy].box; }
+	size_t size() const { return m_proxy_count; }
+	int32_t height() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height; }
+	// Summed surface area of the inner nodes relative to the root, lower is better
+	float cost() const;
+	// Structural checks for tests: parent links, heights and enclosing boxes
+	bool validate() const;
+
+	// Queries append the user data of every proxy whose box passes. They
+	// collapse the tree first if it changed, so they are only safe to run
+	// concurrently after a call to flatten. Results come in tree order, which
+	// changes whenever proxies move, so anything kept per object from frame
+	// to frame has to be looked up by user data rather than by position in
+	// the result. Drawing the result means passing the user data on as
+	// Renderer::draw's object_id.
+	void query(const Frustum& frustum, std::vector<uint32_t>& result) const;
+	void query(const AABB& box, std::vector<uint32_t>& result) const;
+	void query(const Sphere& sphere, std::vector<uint32_t>& result) const;
+
+	// Returns the distance along the ray where the object was hit, or a
+	// negative value for a miss. Lets callers refine a box hit against the
+	// real geometry.
+	using RayCallback = std::function<float(uint32_t user_data, const Ray& ray, float t_max)>;
+
+	// Closest hit, user_data and t are only written when something was hit.
+	// Without a callback the proxy boxes themselves are hit.
+	bool ray_cast(
+		const Ray& ray,
+		float t_max,
+		uint32_t& user_data,
+		float& t,
+		const RayCallback& callback = nullptr) const;
+	// Any hit, stops at the first object the callback reports as hit
+	bool ray_test(const Ray& ray, float t_max, const RayCallback& callback = nullptr) const;
+
+	// Collapses the binary tree into the wide nodes the queries run on
+	void flatten() const;
+
+private:
+	struct Node {
+		AABB box;
+		// next free node while on the free list
+		int32_t parent = NULL_NODE;
+		int32_t child[2] = { NULL_NODE, NULL_NODE };
+		// 0 for leaves, -1 while free
+		int32_t height = -1;
+		uint32_t user_data = 0;
+
+		bool is_leaf() const { return child[0] == NULL_NODE; }
+	};
+
+	// Children are inner wide nodes when >= 0, ~proxy for leaves and EMPTY for
+	// unused slots. Unused slots hold an inverted box that fails every test.
+	struct WideNode {
+		float min_x[WIDE], min_y[WIDE], min_z[WIDE];
+		float max_x[WIDE], max_y[WIDE], max_z[WIDE];
+		int32_t child[WIDE];
+	};
+	static const int32_t EMPTY = INT32_MIN;
+
+	int32_t allocate_node();
+	void free_node(int32_t node);
+	void insert_leaf(int32_t leaf);
+	void remove_leaf(int32_t leaf);
+	void update_parents(int32_t node);
+	void rotate(int32_t node);
+	void set_child(int32_t parent, int slot, int32_t child);
+	int32_t build_range(int32_t* leaves, size_t count);
+	void collect(int32_t wide, std::vector<uint32_t>& result) const;
+	bool traverse(
+		const Ray& ray,
+		float t_max,
+		bool any_hit,
+		uint32_t& user_data,
+		float& t,
+		const RayCallback& callback) const;
+
+	std::vector<Node> m_nodes;
+	int32_t m_root = NULL_NODE;
+	int32_t m_free = NULL_NODE;
+	size_t m_proxy_count = 0;
+
+	mutable std::vector<WideNode> m_wide;
+	mutable bool m_dirty = false;
+};
+
+}
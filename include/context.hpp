@@ -3,9 +3,14 @@
 #include <vulkan/vulkan_core.h>
 #include "vk_mem_alloc.h"
 
+#include "descriptor_allocator.hpp"
+#include "pipeline_registry.hpp"
+
 #define GLFW_INCLUDE_VULKAN
 #include "GLFW/glfw3.h"
 
+#include <atomic>
+#include <filesystem>
 #include <vector> // small vector would be nice here
 #include <functional>
 #include <limits>
@@ -21,6 +26,13 @@ struct ContextCreateInfo {
 	std::vector<const char*> required_extensions;
 	std::vector<const char*> preferred_extensions;
 	VkAllocationCallbacks* allocation_callbacks = nullptr;
+	// loaded at init and written back at deinit, empty keeps the cache in memory
+	std::filesystem::path pipeline_cache_path;
+	// no window, surface or swapchain. The renderer draws into a ring of
+	// headless_image_count offscreen images sized window_size, and software
+	// devices like lavapipe are good enough.
+	bool headless = false;
+	uint32_t headless_image_count = 3;
 };
 
 // TODO: wrap window api
@@ -33,8 +45,8 @@ struct Context {
 	VkPhysicalDevice physical_device;
 	VkDevice device;
 	VmaAllocator allocator;
-	VkSurfaceKHR surface;
-	GLFWwindow* window;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	GLFWwindow* window = nullptr;
 	VkAllocationCallbacks* allocation_callbacks;
 
 	struct QueueFamily {
@@ -52,6 +64,23 @@ struct Context {
 	VkCommandPool graphics_command_pool;
 	VkCommandPool transfer_command_pool;
 
+	// shared by everything holding a const Context*. Sets from the allocator
+	// live until the context goes, anything rebuilt at runtime should keep
+	// its own DescriptorAllocator.
+	mutable DescriptorLayoutCache descriptor_layouts;
+	mutable DescriptorAllocator descriptor_allocator;
+
+	// every pipeline is built through these
+	mutable PipelineRegistry pipelines;
+	VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+	std::filesystem::path pipeline_cache_path;
+	// false when there was no usable cache on disk
+	bool pipeline_cache_warm = false;
+	// added up by PipelineBuilder from every thread, for comparing cold and
+	// warm starts. Time spent compiling, not wall time.
+	mutable std::atomic<uint32_t> pipelines_built { 0 };
+	mutable std::atomic<uint64_t> pipeline_build_us { 0 };
+
 	// supported properties & features
 	VkSurfaceCapabilitiesKHR surface_capabilities;
 	std::vector<VkSurfaceFormatKHR> supported_surface_formats;
@@ -63,11 +92,18 @@ struct Context {
 	VkPhysicalDeviceProperties device_properties;
 	// right now i'm enable all available features, which is probably bad
 	VkPhysicalDeviceFeatures device_features;
+	// VK_KHR_dynamic_rendering, core since 1.3, enabled when the device has it
+	bool dynamic_rendering = false;
 	VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
 
 	bool window_resized = false;
 	VkExtent2D window_size;
 
+	// surface_capabilities, surface_format and present_mode are made up from
+	// the create info when set
+	bool headless = false;
+	uint32_t headless_image_count = 3;
+
 	bool enable_validation_layers;
 	std::vector<const char*> validation_layers;
 	std::vector<const char*> required_extensions;
@@ -80,6 +116,9 @@ struct Context {
 	// helpers
 	uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags property_flags) const;
 	bool window_hidden();
+	// Reads surface_capabilities again after a resize, false while the
+	// window has no area to make a swap chain for
+	bool update_surface_extent();
 	void record_graphics_command(
 			std::function<void(VkCommandBuffer command_buffer)> commands) const;
 	void record_transfer_command(
@@ -88,6 +127,7 @@ struct Context {
 private:
 	bool supports_required_extensions();
 	void populate_surface_info();
+	void populate_headless_info();
 	void populate_queue_family_indices();
 	void set_max_usable_sample_count();
 	void populate_all_info();
@@ -107,6 +147,8 @@ private:
 	void init_queues();
 	void init_allocator();
 	void init_command_pool();
+	void init_pipeline_cache();
+	void save_pipeline_cache();
 };
 
 VkDebugUtilsMessengerCreateInfoEXT make_debugger_create_info();
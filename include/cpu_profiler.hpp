@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace chch {
+
+// A finished zone, times in microseconds from when the profiler started
+struct TraceEvent {
+	std::string name;
+	double start_us;
+	double duration_us;
+	uint32_t thread;
+};
+
+// Scoped CPU zones for the hot path. Every thread records into a ring of its
+// own that nothing else writes, so a zone costs two timestamp reads and a
+// store. The ring keeps the most recent RING_SIZE - 1 zones per thread.
+//
+// The PROFILE_* macros below compile to nothing unless PROFILE is defined,
+// build with make PROFILE=1 to turn them on.
+struct CpuProfiler {
+	static constexpr size_t RING_SIZE = 1 << 15;
+
+	// Raw ticks, the TSC on x86 and steady_clock nanoseconds elsewhere
+	static uint64_t now();
+	// Ticks since the profiler started
+	static double to_us(uint64_t ticks);
+
+	static void record(const char* name, uint64_t begin, uint64_t end);
+	// Shows up as the thread's name in traces, has to outlive the profiler
+	static void set_thread_name(const char* name);
+
+	// Every thread's zones still in its ring. Zones overwritten while this
+	// runs are dropped, not torn.
+	static std::vector<TraceEvent> collect();
+	// Forgets every recorded zone, threads have to be idle
+	static void clear();
+
+	// Chrome trace event JSON, which Perfetto opens as well. extra is put on
+	// a thread of its own called extra_thread, for GPU timings and the like.
+	static std::string chrome_trace(
+		const std::vector<TraceEvent>& extra = {},
+		const char* extra_thread = "GPU");
+	// False if the file couldn't be written
+	static bool write_chrome_trace(
+		const std::filesystem::path& path,
+		const std::vector<TraceEvent>& extra = {},
+		const char* extra_thread = "GPU");
+};
+
+// Records from construction to destruction, name has to outlive the profiler
+struct ProfileZone {
+	explicit ProfileZone(const char* name) : m_name(name), m_begin(CpuProfiler::now()) {}
+	~ProfileZone() { CpuProfiler::record(m_name, m_begin, CpuProfiler::now()); }
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* m_name;
+	uint64_t m_begin;
+};
+
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef PROFILE
+#define PROFILE_ZONE(name) ::chch::ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_THREAD(name) ::chch::CpuProfiler::set_thread_name(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
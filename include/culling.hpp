@@ -0,0 +1,88 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "frustum.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace chch {
+
+struct ThreadPool;
+
+// Structure of arrays so the culler can load a full register of each component
+struct BoundingSpheres {
+	std::vector<float> x, y, z, radius;
+
+	size_t size() const { return radius.size(); }
+
+	void clear()
+	{
+		x.clear();
+		y.clear();
+		z.clear();
+		radius.clear();
+	}
+
+	void resize(size_t count)
+	{
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+		radius.resize(count);
+	}
+
+	void push_back(const Sphere& sphere)
+	{
+		x.push_back(sphere.center.x);
+		y.push_back(sphere.center.y);
+		z.push_back(sphere.center.z);
+		radius.push_back(sphere.radius);
+	}
+
+	void set(size_t index, const Sphere& sphere)
+	{
+		x[index] = sphere.center.x;
+		y[index] = sphere.center.y;
+		z[index] = sphere.center.z;
+		radius[index] = sphere.radius;
+	}
+
+	Sphere get(size_t index) const
+	{
+		return { { x[index], y[index], z[index] }, radius[index] };
+	}
+};
+
+struct FrustumCuller {
+	// spheres smaller than this fraction of the viewport height are rejected
+	float min_screen_size = 0.0f;
+	// optional, without a pool everything runs on the calling thread
+	ThreadPool* thread_pool = nullptr;
+	// spheres handed to a single job
+	size_t batch_size = 64 * 1024;
+
+	bool is_visible(const Frustum& frustum, const Sphere& sphere) const;
+
+	// Writes 1 for every sphere that survives, 0 otherwise. Returns the survivor count.
+	size_t cull(
+		const Frustum& frustum,
+		const BoundingSpheres& spheres,
+		std::vector<uint8_t>& visibility) const;
+
+	// One sphere at a time, kept as the reference the SIMD path is tested against
+	size_t cull_scalar(
+		const Frustum& frustum,
+		const BoundingSpheres& spheres,
+		std::vector<uint8_t>& visibility) const;
+
+private:
+	size_t cull_range(
+		const Frustum& frustum,
+		const BoundingSpheres& spheres,
+		size_t begin,
+		size_t end,
+		uint8_t* visibility) const;
+};
+
+}
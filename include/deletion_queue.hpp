@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace chch {
+
+// Holds on to destruction of things the GPU may still be using until the
+// frames that could use them are done. Frames are counted: an entry pushed
+// with frame n runs once n frames have completed.
+struct DeletionQueue {
+	void push(uint64_t frame, std::function<void()> deleter)
+	{
+		m_entries.push_back({ frame, std::move(deleter) });
+	}
+
+	// Runs everything completed frames are enough for, in the order it was
+	// pushed
+	void flush(uint64_t completed)
+	{
+		// deleters may push, so they run from a copy
+		std::vector<Entry> ready, waiting;
+		for (auto& entry : m_entries)
+			(entry.frame <= completed ? ready : waiting).push_back(std::move(entry));
+		m_entries = std::move(waiting);
+		for (auto& entry : ready)
+			entry.deleter();
+	}
+
+	// Runs everything, once the device is idle
+	void flush_all() { flush(UINT64_MAX); }
+
+	size_t size() const { return m_entries.size(); }
+	bool empty() const { return m_entries.empty(); }
+
+private:
+	struct Entry {
+		uint64_t frame;
+		std::function<void()> deleter;
+	};
+	std::vector<Entry> m_entries;
+};
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "descriptor_layout_key.hpp"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace chch {
+
+struct Context;
+
+// Source data for a descriptor update template, one per descriptor
+union DescriptorInfo {
+	VkDescriptorImageInfo image;
+	VkDescriptorBufferInfo buffer;
+};
+
+// Set layouts shared by everything declaring the same bindings. The cache owns
+// them, callers never destroy a layout they got from here.
+struct DescriptorLayoutCache {
+	struct Layout {
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		// writes a whole set from DescriptorInfos in binding order, one per
+		// descriptor. Null for a layout without bindings.
+		VkDescriptorUpdateTemplate update_template = VK_NULL_HANDLE;
+	};
+
+	void init(const Context* context);
+	void deinit();
+
+	const Layout& get(const VkDescriptorSetLayoutBinding* bindings, uint32_t count);
+	size_t size() const { return m_layouts.size(); }
+
+private:
+	const Context* m_context = nullptr;
+	std::mutex m_mutex;
+	std::unordered_map<DescriptorLayoutKey, Layout, DescriptorLayoutKey::Hash> m_layouts;
+};
+
+// Hands out sets from fixed size pools, opening another whenever the current
+// one runs out. Sets are never freed one by one, reset gives them all back.
+struct DescriptorAllocator {
+	void init(const Context* context, uint32_t sets_per_pool = 64);
+	void deinit();
+
+	VkResult allocate(VkDescriptorSetLayout layout, VkDescriptorSet* set);
+	// Every set allocated so far becomes invalid, the pools are kept for reuse
+	void reset();
+
+	size_t pool_count() const { return m_used.size() + m_free.size(); }
+
+private:
+	VkDescriptorPool grab_pool();
+
+	const Context* m_context = nullptr;
+	uint32_t m_sets_per_pool = 64;
+	VkDescriptorPool m_current = VK_NULL_HANDLE;
+	std::vector<VkDescriptorPool> m_used;
+	std::vector<VkDescriptorPool> m_free;
+};
+
+}
@@ -3,31 +3,47 @@
 #include <vulkan/vulkan_core.h>
 #include <vector>
 #include "context.hpp"
+#include "descriptor_allocator.hpp"
 #include "texture.hpp"
 #include "uniform.hpp"
 #include "frame_data.hpp"
 
 namespace chch {
 
+// The layout comes out of context->descriptor_layouts and belongs to the
+// cache. Sets come from context->descriptor_allocator unless an allocator
+// is given.
 struct DescriptorBuilder {
-	static DescriptorBuilder begin(const Context* context, VkDescriptorPool pool) {
+	static DescriptorBuilder begin(const Context* context) {
+		return begin(context, &context->descriptor_allocator);
+	}
+	static DescriptorBuilder begin(const Context* context, DescriptorAllocator* allocator) {
 		DescriptorBuilder builder;
 		builder.m_context = context;
-		builder.m_pool = pool;
+		builder.m_allocator = allocator;
 		return builder;
 	}
 
 	VkResult build(VkDescriptorSetLayout* layout, VkDescriptorSet* set);
 	DescriptorBuilder bind_uniform(uint32_t binding, UniformBuffer* uniform);
 	DescriptorBuilder bind_texture(uint32_t binding, Texture* texture);
+	DescriptorBuilder bind_buffer(
+			uint32_t binding,
+			VkDescriptorType type,
+			VkDescriptorBufferInfo info,
+			VkShaderStageFlags stages);
+	DescriptorBuilder bind_image(
+			uint32_t binding,
+			VkDescriptorType type,
+			VkDescriptorImageInfo info,
+			VkShaderStageFlags stages);
 
 private:
 	const Context* m_context;
-	VkDescriptorPool m_pool;
+	DescriptorAllocator* m_allocator;
 	std::vector<VkDescriptorSetLayoutBinding> m_bindings;
-	std::vector<VkWriteDescriptorSet> m_writes;
-	std::vector<VkDescriptorImageInfo> m_image_info;
-	std::vector<VkDescriptorBufferInfo> m_buffer_info;
+	// parallel to m_bindings
+	std::vector<DescriptorInfo> m_info;
 };
 
 }
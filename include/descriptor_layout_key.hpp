@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace chch {
+
+// One VkDescriptorSetLayoutBinding, minus the immutable samplers
+struct DescriptorBindingKey {
+	uint32_t binding;
+	uint32_t type;
+	uint32_t count;
+	uint32_t stages;
+
+	bool operator==(const DescriptorBindingKey& other) const
+	{
+		return binding == other.binding
+			&& type == other.type
+			&& count == other.count
+			&& stages == other.stages;
+	}
+};
+
+// What DescriptorLayoutCache looks layouts up by. Bindings are kept sorted by
+// binding number, so the order they were declared in doesn't matter.
+struct DescriptorLayoutKey {
+	std::vector<DescriptorBindingKey> bindings;
+
+	void add(uint32_t binding, uint32_t type, uint32_t count, uint32_t stages)
+	{
+		DescriptorBindingKey key { binding, type, count, stages };
+		auto it = std::upper_bound(
+			bindings.begin(),
+			bindings.end(),
+			key,
+			[](const DescriptorBindingKey& a, const DescriptorBindingKey& b) { return a.binding < b.binding; });
+		bindings.insert(it, key);
+	}
+
+	size_t hash() const
+	{
+		// FNV-1a over every field
+		uint64_t h = 14695981039346656037ull;
+		auto mix = [&h](uint32_t value) {
+			for (int i = 0; i < 4; ++i) {
+				h ^= (value >> (i * 8)) & 0xff;
+				h *= 1099511628211ull;
+			}
+		};
+		mix(static_cast<uint32_t>(bindings.size()));
+		for (auto& b : bindings) {
+			mix(b.binding);
+			mix(b.type);
+			mix(b.count);
+			mix(b.stages);
+		}
+		return static_cast<size_t>(h);
+	}
+
+	bool operator==(const DescriptorLayoutKey& other) const { return bindings == other.bindings; }
+
+	struct Hash {
+		size_t operator()(const DescriptorLayoutKey& key) const { return key.hash(); }
+	};
+};
+
+}
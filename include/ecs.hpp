@@ -0,0 +1,250 @@
+#pragma once
+
+#include "thread_pool.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace chch {
+
+struct Entity {
+	uint32_t index = UINT32_MAX;
+	// bumped every time the index is reused, so stale handles stop resolving
+	uint32_t generation = 0;
+
+	bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+using ComponentMask = uint64_t;
+constexpr size_t MAX_COMPONENTS = 64;
+
+// Hands out ids in registration order, throws past MAX_COMPONENTS
+uint32_t register_component(size_t size, size_t alignment);
+
+// Components are moved between chunks with memcpy, so they have to be
+// trivially copyable. Point at resources instead of owning them.
+template <typename T>
+uint32_t component_id()
+{
+	static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+	static const uint32_t id = register_component(sizeof(T), alignof(T));
+	return id;
+}
+
+template <typename... Ts>
+ComponentMask component_mask()
+{
+	return (ComponentMask(0) | ... | (ComponentMask(1) << component_id<Ts>()));
+}
+
+// Entities grouped by archetype, the exact set of components they carry.
+// Each archetype stores its entities in 16 KB chunks with one tightly packed
+// array per component, so a query walks plain arrays chunk after chunk.
+// Removing an entity moves the archetype's last one into the hole, which
+// keeps every chunk but the last full.
+//
+// Nothing may create, destroy, add or remove while a query is running.
+// Writing to components from inside a query is fine.
+struct World {
+	static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+	// optional, parallel_each_chunk runs on the calling thread without one
+	ThreadPool* thread_pool = nullptr;
+
+	template <typename... Ts>
+	Entity create(const Ts&... components);
+	void destroy(Entity entity);
+	bool alive(Entity entity) const;
+	void clear();
+
+	// Overwrites the component if the entity already has one
+	template <typename T>
+	void add(Entity entity, const T& component);
+	template <typename T>
+	void remove(Entity entity);
+	// nullptr when the entity doesn't have one, only valid until the next structural change
+	template <typename T>
+	T* get(Entity entity);
+	template <typename T>
+	bool has(Entity entity) const;
+
+	// f(size_t count, const Entity* entities, Ts*... components) for every
+	// non-empty chunk holding at least Ts
+	template <typename... Ts, typename F>
+	void each_chunk(F&& f);
+	// Same as each_chunk, chunks are handed out to thread_pool
+	template <typename... Ts, typename F>
+	void parallel_each_chunk(F&& f);
+	// f(Entity entity, Ts&... components) for every entity holding at least Ts
+	template <typename... Ts, typename F>
+	void each(F&& f);
+
+	size_t size() const { return m_alive; }
+	size_t archetype_count() const { return m_archetypes.size(); }
+	size_t chunk_count() const;
+	// rows per chunk for entities carrying exactly Ts
+	template <typename... Ts>
+	size_t chunk_capacity() { return m_archetypes[find_archetype(component_mask<Ts...>())].capacity; }
+
+private:
+	struct alignas(64) ChunkData {
+		uint8_t bytes[CHUNK_SIZE];
+	};
+
+	struct Chunk {
+		std::unique_ptr<ChunkData> data;
+		uint32_t count = 0;
+	};
+
+	struct Archetype {
+		ComponentMask mask = 0;
+		uint32_t capacity = 0;
+		// where each component's array starts in a chunk, the entity array is at 0
+		std::array<uint32_t, MAX_COMPONENTS> offset {};
+		std::vector<Chunk> chunks;
+	};
+
+	struct Record {
+		uint32_t archetype = 0;
+		uint32_t chunk = 0;
+		uint32_t row = 0;
+		uint32_t generation = 0;
+		bool alive = false;
+	};
+
+	Entity allocate_entity(ComponentMask mask);
+	uint32_t find_archetype(ComponentMask mask);
+	void allocate_row(uint32_t archetype, uint32_t& chunk, uint32_t& row);
+	void remove_row(uint32_t archetype, uint32_t chunk, uint32_t row);
+	// moves the entity to the archetype for mask, keeping the components both share
+	void change_archetype(Entity entity, ComponentMask mask);
+	const Record& record(Entity entity) const;
+	void* component(const Record& record, uint32_t id);
+
+	template <typename T>
+	T* array(uint32_t archetype, uint32_t chunk)
+	{
+		const auto& a = m_archetypes[archetype];
+		return reinterpret_cast<T*>(a.chunks[chunk].data->bytes + a.offset[component_id<T>()]);
+	}
+
+	Entity* entities(uint32_t archetype, uint32_t chunk)
+	{
+		return reinterpret_cast<Entity*>(m_archetypes[archetype].chunks[chunk].data->bytes);
+	}
+
+	std::vector<Archetype> m_archetypes;
+	std::unordered_map<ComponentMask, uint32_t> m_archetype_lookup;
+	std::vector<Record> m_records;
+	std::vector<uint32_t> m_free;
+	size_t m_alive = 0;
+};
+
+template <typename... Ts>
+Entity World::create(const Ts&... components)
+{
+	Entity entity = allocate_entity(component_mask<Ts...>());
+	const auto& r = m_records[entity.index];
+	(new (&array<Ts>(r.archetype, r.chunk)[r.row]) Ts(components), ...);
+	return entity;
+}
+
+template <typename T>
+void World::add(Entity entity, const T& component)
+{
+	const auto& r = record(entity);
+	ComponentMask bit = ComponentMask(1) << component_id<T>();
+	if (!(m_archetypes[r.archetype].mask & bit))
+		change_archetype(entity, m_archetypes[r.archetype].mask | bit);
+
+	const auto& moved = m_records[entity.index];
+	new (&array<T>(moved.archetype, moved.chunk)[moved.row]) T(component);
+}
+
+template <typename T>
+void World::remove(Entity entity)
+{
+	const auto& r = record(entity);
+	ComponentMask bit = ComponentMask(1) << component_id<T>();
+	if (m_archetypes[r.archetype].mask & bit)
+		change_archetype(entity, m_archetypes[r.archetype].mask & ~bit);
+}
+
+template <typename T>
+T* World::get(Entity entity)
+{
+	const auto& r = record(entity);
+	if (!(m_archetypes[r.archetype].mask & (ComponentMask(1) << component_id<T>())))
+		return nullptr;
+	return &array<T>(r.archetype, r.chunk)[r.row];
+}
+
+template <typename T>
+bool World::has(Entity entity) const
+{
+	const auto& r = record(entity);
+	return m_archetypes[r.archetype].mask & (ComponentMask(1) << component_id<T>());
+}
+
+template <typename... Ts, typename F>
+void World::each_chunk(F&& f)
+{
+	const ComponentMask mask = component_mask<Ts...>();
+	for (uint32_t a = 0; a < m_archetypes.size(); ++a) {
+		if ((m_archetypes[a].mask & mask) != mask)
+			continue;
+		for (uint32_t c = 0; c < m_archetypes[a].chunks.size(); ++c) {
+			size_t count = m_archetypes[a].chunks[c].count;
+			if (count)
+				f(count, static_cast<const Entity*>(entities(a, c)), array<Ts>(a, c)...);
+		}
+	}
+}
+
+template <typename... Ts, typename F>
+void World::parallel_each_chunk(F&& f)
+{
+	if (!thread_pool) {
+		each_chunk<Ts...>(std::forward<F>(f));
+		return;
+	}
+
+	const ComponentMask mask = component_mask<Ts...>();
+	std::vector<std::pair<uint32_t, uint32_t>> chunks;
+	for (uint32_t a = 0; a < m_archetypes.size(); ++a) {
+		if ((m_archetypes[a].mask & mask) != mask)
+			continue;
+		for (uint32_t c = 0; c < m_archetypes[a].chunks.size(); ++c) {
+			if (m_archetypes[a].chunks[c].count)
+				chunks.push_back({ a, c });
+		}
+	}
+
+	thread_pool->parallel_for(chunks.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			auto [a, c] = chunks[i];
+			f(static_cast<size_t>(m_archetypes[a].chunks[c].count),
+				static_cast<const Entity*>(entities(a, c)),
+				array<Ts>(a, c)...);
+		}
+	});
+}
+
+template <typename... Ts, typename F>
+void World::each(F&& f)
+{
+	each_chunk<Ts...>([&f](size_t count, const Entity* entities, Ts*... components) {
+		for (size_t i = 0; i < count; ++i)
+			f(entities[i], components[i]...);
+	});
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace chch {
+
+// Bytes rgba_to_yuv420 writes, chroma planes are rounded up for odd sizes
+size_t yuv420_size(uint32_t width, uint32_t height);
+// BT.601 studio range, each chroma sample the average of a 2x2 block. The Y,
+// U and V planes go back to back into planes.
+void rgba_to_yuv420(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra, uint8_t* planes);
+
+// Streams frames to disk for encoding offline. Y4M carries its own size and
+// frame rate, so ffmpeg and friends take it as is. Raw is the RGBA pixels back
+// to back, swizzled to RGBA if the frames came in as BGRA.
+struct FrameCapture {
+	enum Format {
+		RAW,
+		Y4M
+	};
+
+	// Y4M for .y4m files, raw for anything else
+	static Format format_for(const std::filesystem::path& path);
+
+	// Throws if the file can't be opened
+	void open(
+		const std::filesystem::path& path,
+		Format format,
+		uint32_t width,
+		uint32_t height,
+		uint32_t fps = 60,
+		bool bgra = false);
+	// width * height tightly packed 8 bit pixels
+	void write(const uint8_t* pixels);
+	void close();
+
+	bool is_open() const { return m_file.is_open(); }
+	uint32_t frames_written() const { return m_frames_written; }
+
+private:
+	std::ofstream m_file;
+	Format m_format = RAW;
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	bool m_bgra = false;
+	uint32_t m_frames_written = 0;
+	std::vector<uint8_t> m_scratch;
+};
+
+}
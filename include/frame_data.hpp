@@ -19,6 +19,9 @@ struct FrameData {
 	VkSemaphore render_finished_semaphore;
 	VkFence in_flight_fence;
 
+	// sets that only live for this frame, reset once the fence has been waited on
+	DescriptorAllocator descriptors;
+
 	void init(const Context* context);
 	void deinit(const Context* context);
 
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "buffer.hpp"
+#include "frame_data.hpp"
+
+#include <cstdint>
+#include <functional>
+
+namespace chch {
+
+struct Context;
+
+// One frame's pixels in host memory, only valid during the callback
+struct ReadbackFrame {
+	uint64_t number;
+	uint32_t width;
+	uint32_t height;
+	// 4 byte texels, rows tightly packed
+	VkFormat color_format;
+	const uint8_t* color;
+	// depth aspect only, null unless depth was read back too
+	VkFormat depth_format;
+	const uint8_t* depth;
+};
+
+// Copies frames into persistently mapped host buffers without stalling. The
+// copy goes into a frame slot's command buffer and its callback runs the next
+// time that slot's fence has been waited on, so results show up
+// MAX_FRAMES_IN_FLIGHT frames late.
+struct FrameReadback {
+	using Callback = std::function<void(const ReadbackFrame&)>;
+
+	// depth_format VK_FORMAT_UNDEFINED leaves depth out
+	void init(
+		const Context* context,
+		VkExtent2D extent,
+		VkFormat color_format,
+		VkFormat depth_format = VK_FORMAT_UNDEFINED);
+	void deinit(const Context* context);
+
+	// With color and depth in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL and their
+	// writes already waited on, the render graph's readback pass takes care
+	// of both. Replaces whatever the slot was still waiting on without
+	// calling it.
+	void record(
+		VkCommandBuffer command_buffer,
+		uint32_t frame,
+		uint64_t number,
+		VkImage color,
+		VkImage depth,
+		Callback callback);
+	// Call once the frame's fence has been waited on
+	void complete(uint32_t frame);
+	// Every slot, the device has to be idle
+	void complete_all();
+
+	bool reads_depth() const { return m_depth_format != VK_FORMAT_UNDEFINED; }
+
+private:
+	struct Slot {
+		Buffer color;
+		Buffer depth;
+		uint8_t* color_data = nullptr;
+		uint8_t* depth_data = nullptr;
+		uint64_t number = 0;
+		Callback callback;
+	};
+	per_frame<Slot> m_slots;
+
+	const Context* m_context = nullptr;
+	VkExtent2D m_extent {};
+	VkFormat m_color_format = VK_FORMAT_UNDEFINED;
+	VkFormat m_depth_format = VK_FORMAT_UNDEFINED;
+	uint32_t m_depth_texel_size = 0;
+};
+
+}
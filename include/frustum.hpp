@@ -0,0 +1,89 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "bounds.hpp"
+
+#include <array>
+
+namespace chch {
+
+struct Frustum {
+	enum {
+		LEFT,
+		RIGHT,
+		BOTTOM,
+		TOP,
+		NEAR,
+		FAR
+	};
+
+	// xyz = normal pointing inside, w = distance, normalized
+	std::array<glm::vec4, 6> planes;
+	// dot(w_row, p) is the clip space w of a point
+	glm::vec4 w_row;
+	// vertical projection scale, radius * scale / w is the screen size of a sphere
+	float projection_scale;
+
+	// Expects the 0..1 depth range that camera.hpp forces on glm
+	static Frustum from_matrix(const glm::mat4& view_projection)
+	{
+		auto row = [&view_projection](int i) {
+			return glm::vec4(
+				view_projection[0][i],
+				view_projection[1][i],
+				view_projection[2][i],
+				view_projection[3][i]);
+		};
+
+		Frustum frustum;
+		frustum.planes[LEFT] = row(3) + row(0);
+		frustum.planes[RIGHT] = row(3) - row(0);
+		frustum.planes[BOTTOM] = row(3) + row(1);
+		frustum.planes[TOP] = row(3) - row(1);
+		frustum.planes[NEAR] = row(2);
+		frustum.planes[FAR] = row(3) - row(2);
+
+		for (auto& plane : frustum.planes)
+			plane /= glm::length(glm::vec3(plane));
+
+		frustum.w_row = row(3);
+		frustum.projection_scale = glm::length(glm::vec3(row(1)));
+		return frustum;
+	}
+
+	bool contains(const Sphere& sphere) const
+	{
+		for (const auto& plane : planes) {
+			if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+				return false;
+		}
+		return true;
+	}
+
+	bool contains(const AABB& box) const
+	{
+		glm::vec3 center = box.center();
+		glm::vec3 extent = box.extent();
+		for (const auto& plane : planes) {
+			glm::vec3 normal(plane);
+			float reach = glm::dot(glm::abs(normal), extent);
+			if (glm::dot(normal, center) + plane.w < -reach)
+				return false;
+		}
+		return true;
+	}
+
+	// Projected diameter as a fraction of the viewport height. Spheres that
+	// straddle the eye are treated as filling the screen.
+	float screen_size(const Sphere& sphere) const
+	{
+		float w = glm::dot(w_row, glm::vec4(sphere.center, 1.0f));
+		if (w <= sphere.radius)
+			return 1.0f;
+		return sphere.radius * projection_scale / w;
+	}
+};
+
+}
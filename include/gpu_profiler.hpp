@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "cpu_profiler.hpp"
+#include "frame_data.hpp"
+#include "profile_stats.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace chch {
+
+struct Context;
+
+// One region's timing in the last frame that was read back
+struct GpuRegionTiming {
+	const char* name;
+	// from the first timestamp of the frame
+	double start_ms;
+	double duration_ms;
+	uint32_t depth;
+};
+
+// Times regions of a frame's command buffer with timestamp queries, one pool
+// per frame in flight. Results are read once the frame's fence has been
+// waited on, so nothing ever blocks on them. Regions also open
+// VK_EXT_debug_utils labels when the instance has the extension, which
+// captures in RenderDoc and friends pick up.
+struct GpuProfiler {
+	static const uint32_t MAX_REGIONS = 64;
+	static const uint32_t NONE = UINT32_MAX;
+
+	// regions kept for trace(), 0 keeps none
+	size_t trace_capacity = 0;
+
+	// Ends its region when it goes out of scope
+	struct Scope {
+		Scope(GpuProfiler* profiler, VkCommandBuffer command_buffer, uint32_t region)
+			: m_profiler(profiler), m_command_buffer(command_buffer), m_region(region) {}
+		Scope(Scope&& other) noexcept;
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+		~Scope();
+
+	private:
+		GpuProfiler* m_profiler;
+		VkCommandBuffer m_command_buffer;
+		uint32_t m_region;
+	};
+
+	// Timestamps are left out when the graphics queue can't write them,
+	// labels still go through
+	void init(const Context* context, size_t window = 120);
+	void deinit(const Context* context);
+
+	// Once the frame's fence has been waited on, before anything is recorded
+	// for it. Picks up the slot's last results and resets its queries.
+	void begin_frame(VkCommandBuffer command_buffer, uint32_t frame);
+
+	// names have to outlive the frame, string literals are the idea
+	uint32_t begin(VkCommandBuffer command_buffer, const char* name);
+	void end(VkCommandBuffer command_buffer, uint32_t region);
+	Scope scope(VkCommandBuffer command_buffer, const char* name) {
+		return Scope(this, command_buffer, begin(command_buffer, name));
+	}
+	// CpuProfiler::now() when the frame went to the queue, which is where
+	// its regions are placed in trace()
+	void submitted(uint64_t cpu_ticks) { m_frames[m_frame].submit_ticks = cpu_ticks; }
+
+	bool timestamps_supported() const { return m_timestamp_period > 0.0; }
+	// rolling per region, regions showing up more than once a frame are summed
+	const ProfileStats& stats() const { return m_stats; }
+	const std::vector<GpuRegionTiming>& last_frame() const { return m_last_frame; }
+	std::string to_json() const { return m_stats.to_json(); }
+	// the most recent regions on the CPU profiler's clock, for
+	// CpuProfiler::write_chrome_trace
+	std::vector<TraceEvent> trace() const { return { m_trace.begin(), m_trace.end() }; }
+
+private:
+	struct Region {
+		const char* name;
+		uint32_t depth;
+	};
+	struct FrameQueries {
+		VkQueryPool pool = VK_NULL_HANDLE;
+		std::vector<Region> regions;
+		uint64_t submit_ticks = 0;
+	};
+
+	void collect(FrameQueries& f);
+
+	per_frame<FrameQueries> m_frames;
+	uint32_t m_frame = 0;
+	uint32_t m_depth = 0;
+
+	const Context* m_context = nullptr;
+	// nanoseconds per tick, 0 without timestamps
+	double m_timestamp_period = 0.0;
+	uint64_t m_timestamp_mask = 0;
+	PFN_vkCmdBeginDebugUtilsLabelEXT m_begin_label = nullptr;
+	PFN_vkCmdEndDebugUtilsLabelEXT m_end_label = nullptr;
+
+	ProfileStats m_stats;
+	std::vector<GpuRegionTiming> m_last_frame;
+	std::deque<TraceEvent> m_trace;
+	std::vector<uint64_t> m_results;
+};
+
+}
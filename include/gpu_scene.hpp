@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "buffer.hpp"
+#include "frame_data.hpp"
+#include "scene_records.hpp"
+
+#include <vector>
+
+namespace chch {
+
+struct Context;
+
+// Persistent storage buffer of per-object records on the GPU. Records are
+// edited on the CPU copy and only the ones that changed are uploaded each
+// frame, so upload bandwidth follows the amount of change rather than the
+// scene size. Small deltas are copied with one region per run of neighbouring
+// records, bigger ones are scattered into place by scene_scatter.comp.
+struct GpuScene {
+	// deltas needing more copy regions than this go through the shader
+	uint32_t max_copy_regions = 64;
+
+	void init(const Context* context, uint32_t capacity);
+	void deinit(const Context* context);
+
+	uint32_t add(const GpuObject& object) { return m_records.add(object); }
+	void remove(uint32_t index) { m_records.remove(index); }
+	void set(uint32_t index, const GpuObject& object) { m_records.set(index, object); }
+	const SceneRecords& records() const { return m_records; }
+
+	// Outside a render pass, once the frame's fence has been waited on. Leaves
+	// the buffer ready for vertex and compute shader reads.
+	void upload(VkCommandBuffer command_buffer, uint32_t frame);
+
+	VkBuffer buffer() const { return m_objects.buffer; }
+	VkDeviceSize size() const { return VkDeviceSize(m_records.capacity()) * sizeof(GpuObject); }
+	// bytes the last upload pushed across, records and indices
+	VkDeviceSize uploaded_bytes() const { return m_uploaded_bytes; }
+
+private:
+	struct FrameBuffers {
+		Buffer records;
+		Buffer indices;
+		GpuObject* record_data;
+		uint32_t* index_data;
+		VkDescriptorSet descriptor_set;
+	};
+
+	void init_buffers(const Context* context);
+	void init_descriptors(const Context* context);
+	void init_pipeline(const Context* context);
+
+	const Context* m_context = nullptr;
+	SceneRecords m_records;
+	Buffer m_objects;
+	per_frame<FrameBuffers> m_frames;
+	std::vector<VkBufferCopy> m_regions;
+	VkDeviceSize m_uploaded_bytes = 0;
+
+	VkDescriptorSetLayout m_set_layout;
+	VkPipelineLayout m_scatter_layout;
+	VkPipeline m_scatter_pipeline = VK_NULL_HANDLE;
+};
+
+}
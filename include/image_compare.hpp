@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace chch {
+
+// 8 bit RGBA pixels, rows tightly packed
+struct Rgba8Image {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+
+	void resize(uint32_t w, uint32_t h) {
+		width = w;
+		height = h;
+		pixels.assign(static_cast<size_t>(w) * h * 4, 0);
+	}
+	size_t pixel_count() const { return static_cast<size_t>(width) * height; }
+};
+
+struct ImageDiff {
+	// pixels with a channel further off than the tolerance
+	uint64_t mismatched = 0;
+	uint8_t max_difference = 0;
+	// mean squared error over the color channels
+	double mse = 0.0;
+
+	// infinite for identical images
+	double psnr() const;
+	bool identical() const { return max_difference == 0; }
+};
+
+// Copies a frame read back from the GPU, swapping red and blue for BGRA formats
+Rgba8Image make_rgba8_image(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra = false);
+
+// Alpha is left out, golden images don't keep it. Throws if the sizes differ.
+// Mismatched pixels are painted red in diff when given, the rest are dimmed
+// copies of a.
+ImageDiff compare_images(const Rgba8Image& a, const Rgba8Image& b, uint8_t tolerance = 0, Rgba8Image* diff = nullptr);
+
+// Golden images are kept as binary PPM. Alpha is dropped on save and comes
+// back as 255. False if the file couldn't be written or read.
+bool save_ppm(const std::filesystem::path& path, const Rgba8Image& image);
+bool load_ppm(const std::filesystem::path& path, Rgba8Image& image);
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace chch {
+
+// Bump allocator over memory it doesn't own. Every slice starts on a multiple
+// of alignment, counted from the start of the memory, and everything is
+// released at once by reset.
+struct LinearAllocator {
+	void init(void* memory, size_t capacity, size_t alignment)
+	{
+		if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+			throw std::runtime_error("alignment has to be a power of two");
+		m_memory = static_cast<uint8_t*>(memory);
+		m_capacity = capacity;
+		m_alignment = alignment;
+		m_offset = 0;
+	}
+
+	void reset() { m_offset = 0; }
+
+	// Returns the slice's offset, throws when it doesn't fit
+	size_t allocate(size_t size)
+	{
+		size_t offset = (m_offset + m_alignment - 1) & ~(m_alignment - 1);
+		if (offset + size > m_capacity)
+			throw std::runtime_error("linear allocator is out of memory");
+		m_offset = offset + size;
+		return offset;
+	}
+
+	size_t push(const void* data, size_t size)
+	{
+		size_t offset = allocate(size);
+		memcpy(m_memory + offset, data, size);
+		return offset;
+	}
+
+	void* data(size_t offset) const { return m_memory + offset; }
+	size_t used() const { return m_offset; }
+	size_t capacity() const { return m_capacity; }
+	size_t alignment() const { return m_alignment; }
+
+private:
+	uint8_t* m_memory = nullptr;
+	size_t m_capacity = 0;
+	size_t m_alignment = 1;
+	size_t m_offset = 0;
+};
+
+}
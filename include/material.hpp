@@ -1,14 +1,23 @@
 #pragma once
 
 #include <vulkan/vulkan_core.h>
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+#include <atomic>
+#include <future>
 #include <string>
 
 #include "buffer.hpp"
+#include "render_target.hpp"
+#include "shader_features.hpp"
 #include "texture.hpp"
+#include "thread_pool.hpp"
 #include "uniform.hpp"
 
 namespace chch {
 
+struct PipelineBuilder;
+
 struct UniformInfo {
 	uint32_t binding;
 	per_frame<UniformBuffer>* uniform_buffer;
@@ -18,25 +27,73 @@ struct TextureInfo {
 	Texture* texture;
 };
 
+// Per-draw params read by material.frag at set 2, std140
+struct MaterialParams {
+	glm::vec4 color = glm::vec4(1.0f);
+	// for SPECULAR
+	glm::vec3 camera_position = glm::vec3(0.0f);
+	// for ALPHA_TEST
+	float alpha_cutoff = 0.5f;
+};
+
+// features are ShaderFeatures bits, applied to both shaders
 struct Material {
-	VkDescriptorPool descriptor_pool;
-	per_frame<VkDescriptorSetLayout> descriptor_set_layout;
+	VkDescriptorSetLayout descriptor_set_layout;
 	per_frame<VkDescriptorSet> descriptor_set;
 
+	// only safe to read once ready() is true
 	VkPipelineLayout pipeline_layout;
 	VkPipeline pipeline;
 
+	// Blocks until the pipeline is built
 	void init(const Context* context,
-			const VkRenderPass& render_pass,
+			const RenderTarget& target,
 			VkDescriptorSetLayout base_layout,
+			VkDescriptorSetLayout draw_layout,
 			std::vector<TextureInfo> texture_info,
 			std::vector<UniformInfo> uniform_info,
 			std::string vertex_shader_name,
 			std::string fragment_shader_name,
+			uint32_t features,
 			VkCullModeFlagBits cull_mode,
 			VkBool32 enable_depth);
 
+	// Descriptors are set up right away, the pipeline is built on the pool.
+	// The renderer draws with its fallback pipeline until ready() is true.
+	std::shared_future<VkResult> init_async(ThreadPool& thread_pool,
+			const Context* context,
+			const RenderTarget& target,
+			VkDescriptorSetLayout base_layout,
+			VkDescriptorSetLayout draw_layout,
+			std::vector<TextureInfo> texture_info,
+			std::vector<UniformInfo> uniform_info,
+			std::string vertex_shader_name,
+			std::string fragment_shader_name,
+			uint32_t features,
+			VkCullModeFlagBits cull_mode,
+			VkBool32 enable_depth);
+
+	bool ready() const { return m_ready.load(std::memory_order_acquire); }
+
+	// Waits for a build still in flight
 	void deinit(const Context* context);
+
+private:
+	// Sets up the descriptors and returns the pipeline still to be built
+	PipelineBuilder setup(const Context* context,
+			const RenderTarget& target,
+			VkDescriptorSetLayout base_layout,
+			VkDescriptorSetLayout draw_layout,
+			std::vector<TextureInfo>& texture_info,
+			std::vector<UniformInfo>& uniform_info,
+			const std::string& vertex_shader_name,
+			const std::string& fragment_shader_name,
+			uint32_t features,
+			VkCullModeFlagBits cull_mode,
+			VkBool32 enable_depth);
+
+	std::shared_future<VkResult> m_build;
+	std::atomic<bool> m_ready { false };
 };
 
 }
@@ -5,7 +5,9 @@
 #include <vulkan/vulkan_core.h>
 #include <string>
 
+#include "bounds.hpp"
 #include "buffer.hpp"
+#include "mesh_bvh.hpp"
 #include "vertex.hpp"
 
 namespace chch {
@@ -19,9 +21,20 @@ struct Mesh {
 	std::vector<uint32_t> indices;
 	Buffer vertex_buffer;
 
+	// object space, filled in by load_model
+	Bounds bounds;
+	// object space triangles for ray casts, also built by load_model
+	MeshBvh bvh;
+
 	void init(const Context* context, std::string filename);
+	// For generated geometry, bounds and bvh are built as for loaded models
+	void init(const Context* context, std::vector<Vertex> mesh_vertices, std::vector<uint32_t> mesh_indices);
 	void deinit(const Context* context);
 
+	// The CPU half of init, reads resources/filename into vertices, indices,
+	// bounds and bvh without touching the GPU
+	void load_model(std::string filename);
+
 private:
 	void copy_buffer(const Context* context,
 		VkBuffer src_buffer,
@@ -29,8 +42,15 @@ private:
 		VkDeviceSize size);
 
 	void init_buffers(const Context* context);
-	void load_model(std::string filename);
+	void compute_bounds();
+	void build_bvh();
 };
 
+// Welds equal corners of a triangle list into one vertex each, appending them
+// to vertices and an index per corner to indices
+void deduplicate_vertices(
+	const std::vector<Vertex>& corners,
+	std::vector<Vertex>& vertices,
+	std::vector<uint32_t>& indices);
 
 }
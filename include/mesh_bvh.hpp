@@ -0,0 +1,117 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "bounds.hpp"
+#include "bvh.hpp"
+#include "simd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace chch {
+
+struct RayHit {
+	float t = 0.0f;
+	// the hit triangle is indices[3 * triangle] onwards
+	uint32_t triangle = 0;
+	// weights of the triangle's second and third vertex
+	glm::vec2 barycentrics = glm::vec2(0.0f);
+	// only filled in by MeshScene
+	uint32_t instance = 0;
+};
+
+// Static bounding volume hierarchy over the triangles of one mesh, in object
+// space. Built top down with binned SAH straight into wide nodes, one SIMD
+// register of children per node. Leaves hold one register of triangles,
+// pre-arranged as structure of arrays so they are tested all at once.
+struct MeshBvh {
+	static constexpr size_t WIDE = Bvh::WIDE;
+
+	// Positions are read with a byte stride so a Vertex array can be handed over as is
+	void build(
+		const void* positions,
+		size_t stride,
+		size_t vertex_count,
+		const uint32_t* indices,
+		size_t index_count);
+	void clear();
+
+	// Closest hit, hit is only written when something was hit
+	bool intersect(const Ray& ray, float t_max, RayHit& hit) const;
+	// Any hit, for line of sight and shadow rays
+	bool occluded(const Ray& ray, float t_max) const;
+
+	const AABB& bounds() const { return m_bounds; }
+	size_t triangle_count() const { return m_triangle_count; }
+	size_t node_count() const { return m_nodes.size(); }
+
+private:
+	// Children are nodes when >= 0, ~leaf for leaves and EMPTY for unused slots
+	struct Node {
+		float min_x[WIDE], min_y[WIDE], min_z[WIDE];
+		float max_x[WIDE], max_y[WIDE], max_z[WIDE];
+		int32_t child[WIDE];
+	};
+	static const int32_t EMPTY = INT32_MIN;
+
+	// First vertex and the two edges leaving it. Unused lanes are all zero,
+	// which no ray can hit.
+	struct Leaf {
+		float v0_x[simd::WIDTH], v0_y[simd::WIDTH], v0_z[simd::WIDTH];
+		float e1_x[simd::WIDTH], e1_y[simd::WIDTH], e1_z[simd::WIDTH];
+		float e2_x[simd::WIDTH], e2_y[simd::WIDTH], e2_z[simd::WIDTH];
+		uint32_t triangle[simd::WIDTH];
+	};
+
+	struct BuildInput {
+		const uint8_t* positions;
+		size_t stride;
+		const uint32_t* indices;
+		std::vector<AABB> boxes;
+		std::vector<glm::vec3> centers;
+	};
+
+	int32_t build_node(BuildInput& input, uint32_t* triangles, size_t count, uint32_t depth);
+	int32_t build_leaf(const BuildInput& input, const uint32_t* triangles, size_t count);
+	bool traverse(const Ray& ray, float t_max, bool any_hit, RayHit& hit) const;
+
+	std::vector<Node> m_nodes;
+	std::vector<Leaf> m_leaves;
+	AABB m_bounds;
+	size_t m_triangle_count = 0;
+};
+
+// Placed MeshBvh instances under a dynamic Bvh. Rays are carried into each
+// instance's object space, so one mesh can be placed any number of times.
+struct MeshScene {
+	// The mesh has to outlive the scene, returns the instance id
+	uint32_t add(const MeshBvh* mesh, const glm::mat4& transform);
+	void set_transform(uint32_t instance, const glm::mat4& transform);
+	void remove(uint32_t instance);
+	void clear();
+
+	bool intersect(const Ray& ray, float t_max, RayHit& hit) const;
+	bool occluded(const Ray& ray, float t_max) const;
+
+	size_t size() const { return m_bvh.size(); }
+	// the top level, for callers that also want to cull or query the instances
+	const Bvh& bvh() const { return m_bvh; }
+
+private:
+	struct Instance {
+		const MeshBvh* mesh = nullptr;
+		glm::mat4 inverse = glm::mat4(1.0f);
+		int32_t proxy = Bvh::NULL_NODE;
+	};
+
+	Ray to_object(const Instance& instance, const Ray& ray) const;
+
+	Bvh m_bvh;
+	std::vector<Instance> m_instances;
+	std::vector<uint32_t> m_free;
+};
+
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "bounds.hpp"
+#include "buffer.hpp"
+#include "deletion_queue.hpp"
+#include "descriptor_allocator.hpp"
+#include "frame_data.hpp"
+#include "texture.hpp"
+
+#include <vector>
+
+namespace chch {
+
+struct Context;
+
+// Matches Object in occlusion_cull.comp
+struct OcclusionObject {
+	glm::vec4 sphere;
+	uint32_t flags;
+	// where the result goes in the visibility buffer
+	uint32_t id;
+	uint32_t pad[2];
+};
+
+// Two phase culling against a depth pyramid. Objects visible last time are
+// drawn straight away, the pyramid is built from that depth, and everything
+// else is tested on the GPU and drawn indirectly if it shows up. Results feed
+// back into the next use of the same frame slot, so visibility lags by
+// MAX_FRAMES_IN_FLIGHT frames. Results are kept by a stable id the caller
+// picks for each object, so they survive draws changing order or dropping
+// out between frames. An id nobody drew since keeps its last result.
+struct OcclusionCuller {
+	enum Flags : uint32_t {
+		// not drawn in phase one, the cull pass fills in its instance count
+		DEFERRED = 1,
+		// rejected on the CPU, reported as hidden
+		CULLED = 2
+	};
+
+	// per frame, ids can go up to the id_count given to init
+	static const uint32_t MAX_OBJECTS = 4096;
+
+	// The depth buffer has to be sampleable at the swap chain's sample count
+	static bool is_supported(const Context* context);
+
+	// depth_image is the render graph's, its view has only the depth aspect
+	void init(const Context* context, const Image& depth_image, uint32_t id_count);
+	void deinit(const Context* context);
+	// After the depth buffer was remade at the swap chain's new size. Only
+	// the pyramid is rebuilt, the old one goes onto retired for frame, and
+	// the visibility results carry over.
+	void resize(const Image& depth_image, DeletionQueue& retired, uint64_t frame);
+
+	// Call once the frame's fence has been waited on
+	void begin_frame(uint32_t frame);
+	bool was_visible(uint32_t frame, uint32_t id) const;
+	// index is the object's place in this frame's list and in indirect_buffer
+	void set_object(
+		uint32_t frame,
+		uint32_t index,
+		uint32_t id,
+		const Sphere& sphere,
+		uint32_t flags,
+		uint32_t index_count);
+
+	// In the render graph's cull pass, which reads depth as
+	// RenderGraph::COMPUTE_READ and writes indirect_buffer as
+	// RenderGraph::COMPUTE_WRITE, so the graph moves both in and out.
+	void record(
+		VkCommandBuffer command_buffer,
+		uint32_t frame,
+		uint32_t object_count,
+		const glm::mat4& view_projection);
+
+	VkBuffer indirect_buffer(uint32_t frame) const { return m_frames[frame].draws.buffer; }
+
+private:
+	struct FrameBuffers {
+		Buffer objects;
+		Buffer draws;
+		Buffer visibility;
+		OcclusionObject* object_data;
+		VkDrawIndexedIndirectCommand* draw_data;
+		uint32_t* visibility_data;
+		VkDescriptorSet descriptor_set;
+	};
+
+	void init_pyramid(const Context* context);
+	void init_buffers(const Context* context);
+	void init_descriptors(const Context* context, const Image& depth_image);
+	void init_pipelines(const Context* context);
+
+	const Context* m_context = nullptr;
+	VkExtent2D m_depth_extent;
+	VkSampleCountFlagBits m_depth_samples;
+	uint32_t m_id_count = 0;
+
+	Image m_pyramid;
+	VkExtent2D m_pyramid_extent;
+	uint32_t m_level_count;
+	std::vector<VkImageView> m_level_views;
+	VkSampler m_sampler;
+	// until the first record after it's made
+	bool m_pyramid_undefined = false;
+
+	per_frame<FrameBuffers> m_frames;
+
+	// rebuilt with the depth buffer, so the sets can't come from the context's allocator
+	DescriptorAllocator m_descriptors;
+	VkDescriptorSetLayout m_pyramid_set_layout;
+	VkDescriptorSetLayout m_cull_set_layout;
+	VkDescriptorSet m_init_set;
+	// m_reduce_sets[i] writes level i + 1
+	std::vector<VkDescriptorSet> m_reduce_sets;
+
+	VkPipelineLayout m_init_layout;
+	VkPipeline m_init_pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout m_reduce_layout;
+	VkPipeline m_reduce_pipeline;
+	VkPipelineLayout m_cull_layout;
+	VkPipeline m_cull_pipeline;
+};
+
+}
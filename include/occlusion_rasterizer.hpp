@@ -0,0 +1,79 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "bounds.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace chch {
+
+struct ThreadPool;
+
+// Non-owning view of an indexed triangle list. Positions are read with a byte
+// stride so a Vertex array can be handed over as is.
+struct OccluderGeometry {
+	const void* positions;
+	size_t stride;
+	size_t vertex_count;
+	const uint32_t* indices;
+	size_t index_count;
+};
+
+// Low resolution software depth buffer for occlusion culling on the CPU.
+// A few big occluders are rasterized up front, then bounding boxes are tested
+// against it before any draw is recorded. Depth follows the renderer: 0 near,
+// 1 far, written at pixel centers.
+struct OcclusionRasterizer {
+	// optional, without a pool everything runs on the calling thread
+	ThreadPool* thread_pool = nullptr;
+	// rows handed to a single job
+	uint32_t band_height = 16;
+
+	// width is rounded up to a multiple of 8 so rows are whole SIMD registers
+	void init(uint32_t width = 256, uint32_t height = 128);
+
+	// Clears depth and starts collecting occluders seen through view_projection
+	void begin(const glm::mat4& view_projection);
+	// geometry must stay alive until rasterize
+	void add_occluder(const OccluderGeometry& geometry, const glm::mat4& model);
+	void rasterize();
+
+	// False only when every pixel the box could touch already holds something nearer
+	bool is_visible(const AABB& box) const;
+
+	uint32_t width() const { return m_width; }
+	uint32_t height() const { return m_height; }
+	const std::vector<float>& depth() const { return m_depth; }
+	size_t triangle_count() const { return m_triangles.size(); }
+
+private:
+	struct Triangle {
+		// edge functions, inside when a * x + b * y + c >= 0 for all three
+		float a[3], b[3], c[3];
+		// depth plane
+		float z_x, z_y, z_c;
+		int32_t x_min, x_max, y_min, y_max;
+	};
+
+	struct Occluder {
+		OccluderGeometry geometry;
+		glm::mat4 model;
+	};
+
+	void setup_triangles();
+	void rasterize_rows(int32_t y_begin, int32_t y_end);
+
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	glm::mat4 m_view_projection = glm::mat4(1.0f);
+	std::vector<float> m_depth;
+	std::vector<Occluder> m_occluders;
+	std::vector<glm::vec4> m_clip;
+	std::vector<Triangle> m_triangles;
+};
+
+}
@@ -1,15 +1,22 @@
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <map>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
 #include "context.hpp"
+#include "pipeline_key.hpp"
+#include "render_target.hpp"
+#include "shader_features.hpp"
 #include "util.hpp"
 
 namespace chch {
 
+// Pipelines come out of context->pipelines, so building the same state twice
+// hands back the first pipeline. Give them back with
+// context->pipelines.release instead of destroying them.
 struct PipelineBuilder {
 	static PipelineBuilder begin(const Context* context)
 	{
@@ -26,10 +33,15 @@ struct PipelineBuilder {
 		return builder;
 	}
 	VkResult build(VkPipelineLayout* pipeline_layout, VkPipeline* pipeline);
+	// Uses the single compute shader, layouts and push constants, ignores the rest
+	VkResult build_compute(VkPipelineLayout* pipeline_layout, VkPipeline* pipeline);
 
 	// Required
-	PipelineBuilder add_shader(const std::string& filename, VkShaderStageFlagBits stage);
+	// features are ShaderFeatures bits, passed in as specialization constants
+	PipelineBuilder add_shader(const std::string& filename, VkShaderStageFlagBits stage, uint32_t features = 0);
 	PipelineBuilder add_layout(uint32_t set_number, VkDescriptorSetLayout layout);
+	PipelineBuilder set_render_target(const RenderTarget& target);
+	// Subpass 0 of render_pass
 	PipelineBuilder set_render_pass(VkRenderPass render_pass);
 
 	// Optional
@@ -47,13 +59,25 @@ struct PipelineBuilder {
 			VkFrontFace front_face);
 
 private:
-	void free_shader_mods();
-	VkResult load_shader(const Context* context, const std::string& filename, VkShaderModule* shader_module);
+	// 'G' for graphics, 'C' for compute, which only looks at shaders and layouts
+	PipelineKey make_key(char kind) const;
+	VkResult create_graphics(VkPipelineLayout* pipeline_layout, VkPipeline* pipeline);
+	VkResult create_compute(VkPipelineLayout* pipeline_layout, VkPipeline* pipeline);
+	void record_build_time(std::chrono::steady_clock::time_point start);
+	VkResult build_layout(VkPipelineLayout* pipeline_layout);
 
 	struct ShaderInfo {
 		std::string filename;
 		VkShaderStageFlagBits stage;
+		uint32_t features;
 	};
+	// one per shader stage, filled in by specialize
+	struct Specialization {
+		std::array<uint32_t, ShaderFeatures::COUNT> constants;
+		std::array<VkSpecializationMapEntry, ShaderFeatures::COUNT> entries;
+		VkSpecializationInfo info;
+	};
+	const VkSpecializationInfo* specialize(size_t shader);
 
 	VkVertexInputBindingDescription vertex_binding_description;
 	std::array<VkVertexInputAttributeDescription, 3> vertex_attribute_description;
@@ -62,9 +86,9 @@ private:
 
 	std::map<uint32_t, VkDescriptorSetLayout> m_layouts;
 	const Context* m_context;
-	VkRenderPass m_render_pass;
-	std::vector<VkShaderModule> m_shader_mods;
+	RenderTarget m_target;
 	std::vector<ShaderInfo> m_shader_info;
+	std::vector<Specialization> m_specializations;
 	std::vector<VkPipelineShaderStageCreateInfo> m_shader_stages;
 	std::vector<VkPushConstantRange> m_push_constants;
 	VkPipelineVertexInputStateCreateInfo m_vertex_input;
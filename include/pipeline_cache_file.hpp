@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace chch {
+
+// What the driver writes at the start of its pipeline cache data,
+// VkPipelineCacheHeaderVersionOne
+struct PipelineCacheHeader {
+	uint32_t header_size;
+	uint32_t header_version;
+	uint32_t vendor_id;
+	uint32_t device_id;
+	uint8_t uuid[16];
+};
+static_assert(sizeof(PipelineCacheHeader) == 32, "PipelineCacheHeader has to match the Vulkan header");
+
+// The device and driver a pipeline cache is valid for, from VkPhysicalDeviceProperties
+struct PipelineCacheDevice {
+	uint32_t vendor_id;
+	uint32_t device_id;
+	std::array<uint8_t, 16> uuid;
+};
+
+// Pipeline cache files are the driver's data behind a small header of our own
+// with a checksum, so a truncated or damaged file is caught before the driver
+// ever sees it.
+struct PipelineCacheFile {
+	static constexpr uint32_t MAGIC = 0x43504843; // "CHPC"
+	static constexpr uint32_t VERSION = 1;
+
+	// Adds the file header to the driver's data
+	static std::vector<char> pack(const std::vector<char>& data);
+	// False, leaving data empty, when the file is damaged or the driver's data
+	// was written by another device or driver version
+	static bool unpack(const std::vector<char>& file, const PipelineCacheDevice& device, std::vector<char>& data);
+
+	// Empty when there is no usable cache at path
+	static std::vector<char> load(const std::filesystem::path& path, const PipelineCacheDevice& device);
+	// Writes next to path, syncs it and renames over it, so a crash or power
+	// loss leaves either the old file or the new one. False if anything failed.
+	static bool save(const std::filesystem::path& path, const std::vector<char>& data);
+};
+
+}
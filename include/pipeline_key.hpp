@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace chch {
+
+// Everything a pipeline is built from, written out field by field. Two keys
+// are only equal if every field matched, the hash just finds the candidates.
+struct PipelineKey {
+	std::vector<uint8_t> bytes;
+
+	// Plain values and handles only, structs can carry padding and pointers
+	template <typename T>
+	PipelineKey& add(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "pipeline keys only take plain values");
+		auto start = bytes.size();
+		bytes.resize(start + sizeof(T));
+		memcpy(bytes.data() + start, &value, sizeof(T));
+		return *this;
+	}
+
+	// Length first, so "ab" then "c" differs from "a" then "bc"
+	PipelineKey& add(const std::string& value)
+	{
+		add(static_cast<uint32_t>(value.size()));
+		bytes.insert(bytes.end(), value.begin(), value.end());
+		return *this;
+	}
+
+	size_t hash() const
+	{
+		// FNV-1a
+		uint64_t h = 14695981039346656037ull;
+		for (auto b : bytes) {
+			h ^= b;
+			h *= 1099511628211ull;
+		}
+		return static_cast<size_t>(h);
+	}
+
+	bool operator==(const PipelineKey& other) const { return bytes == other.bytes; }
+
+	struct Hash {
+		size_t operator()(const PipelineKey& key) const { return key.hash(); }
+	};
+};
+
+}
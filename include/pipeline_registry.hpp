@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "pipeline_key.hpp"
+
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace chch {
+
+struct Context;
+
+// Pipelines shared between everything built with the same state, and the
+// shader modules they were built from. PipelineBuilder goes through this,
+// pipelines it hands out go back with release rather than being destroyed.
+// Safe to use from several threads, builds of different keys run in parallel.
+struct PipelineRegistry {
+	using Build = std::function<VkResult(VkPipelineLayout*, VkPipeline*)>;
+
+	void init(const Context* context);
+	void deinit();
+
+	// Read from shaders/ the first time a file is asked for, kept until deinit
+	VkResult shader_module(const std::string& filename, VkShaderModule* shader_module);
+
+	// The pipeline and layout already built for key, or whatever build makes
+	// of it. Waits when another thread is building the same key. Every
+	// successful acquire needs a release.
+	VkResult acquire(const PipelineKey& key, const Build& build, VkPipelineLayout* layout, VkPipeline* pipeline);
+	// Destroys the pipeline and its layout once nothing uses them anymore
+	void release(VkPipeline pipeline);
+
+	size_t pipeline_count() const { return m_pipelines.size(); }
+	size_t shader_count() const { return m_shaders.size(); }
+
+private:
+	struct Entry {
+		VkPipelineLayout layout;
+		VkPipeline pipeline;
+		uint32_t references;
+		// ready once the thread that inserted the entry is done building
+		std::shared_future<VkResult> built;
+	};
+
+	const Context* m_context = nullptr;
+	std::mutex m_mutex;
+	std::mutex m_shader_mutex;
+	std::unordered_map<std::string, VkShaderModule> m_shaders;
+	std::unordered_map<PipelineKey, Entry, PipelineKey::Hash> m_pipelines;
+	std::unordered_map<VkPipeline, PipelineKey> m_keys;
+};
+
+}
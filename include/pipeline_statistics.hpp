@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "frame_data.hpp"
+#include "render_stats.hpp"
+
+namespace chch {
+
+struct Context;
+
+// One VK_QUERY_TYPE_PIPELINE_STATISTICS query around each frame, a pool per
+// frame in flight. Results are read once the frame's fence has been waited
+// on, so nothing ever blocks on them. Does nothing on devices without
+// pipelineStatisticsQuery.
+struct PipelineStatistics {
+	void init(const Context* context);
+	void deinit(const Context* context);
+
+	bool supported() const { return m_supported; }
+
+	// Outside of any render pass, once the frame's fence has been waited on
+	void begin(VkCommandBuffer command_buffer, uint32_t frame);
+	void end(VkCommandBuffer command_buffer);
+	// Fills in the GPU side of stats from the last frame recorded into the
+	// slot. False, with stats left alone, if there's nothing to read.
+	bool collect(uint32_t frame, RenderStats& stats);
+
+private:
+	struct FrameQuery {
+		VkQueryPool pool = VK_NULL_HANDLE;
+		bool recorded = false;
+	};
+
+	per_frame<FrameQuery> m_frames;
+	uint32_t m_frame = 0;
+	bool m_supported = false;
+	const Context* m_context = nullptr;
+};
+
+}
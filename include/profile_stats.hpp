@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace chch {
+
+// The last window samples of one timing, in milliseconds
+struct RollingStats {
+	explicit RollingStats(size_t window = 120);
+
+	void add(double value);
+
+	size_t count() const { return m_samples.size(); }
+	// 0 for everything while empty
+	double last() const;
+	double average() const;
+	double min() const;
+	double max() const;
+	// p from 0 to 1, nearest rank over the window
+	double percentile(double p) const;
+
+private:
+	std::vector<double> m_samples;
+	size_t m_window;
+	size_t m_next = 0;
+};
+
+// Named timings kept in the order they first showed up
+struct ProfileStats {
+	explicit ProfileStats(size_t window = 120) : m_window(window) {}
+
+	void add(const std::string& name, double ms);
+	// null if name was never added
+	const RollingStats* find(const std::string& name) const;
+	size_t size() const { return m_names.size(); }
+	const std::string& name(size_t i) const { return m_names[i]; }
+	const RollingStats& stats(size_t i) const { return m_stats[i]; }
+	void clear();
+
+	// {"regions":[{"name":...,"count":...,"last_ms":...,"avg_ms":...,
+	// "min_ms":...,"max_ms":...,"p50_ms":...,"p95_ms":...,"p99_ms":...}]}
+	std::string to_json() const;
+
+private:
+	size_t m_window;
+	std::vector<std::string> m_names;
+	std::vector<RollingStats> m_stats;
+};
+
+// Quotes and escapes s for a JSON document
+std::string json_string(const std::string& s);
+
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace chch {
+
+// A frame's passes and what they read and write, compiled into the order,
+// render passes and synchronization to run them with. RenderGraphExecutor
+// turns the result into Vulkan objects and commands, nothing in here touches
+// the device.
+//
+// Passes run in the order they're added. Compiling:
+//  - culls passes whose results nobody reads, a pass survives when it writes
+//    an imported resource, is kept, or feeds a pass that survives
+//  - merges runs of raster passes over same sized attachments into one
+//    render pass with a subpass each, unless merge_subpasses is off
+//  - folds layout transitions of attachments into the render passes' initial
+//    and final layouts, and batches everything else into one barrier per
+//    group. Reading something the way the last pass did needs no barrier.
+//  - works out load and store ops, an attachment is only stored when a later
+//    pass reads it
+//  - finds the lifetimes of the graph's own images so they can share memory,
+//    and the ones that never leave their render pass and need none at all
+struct RenderGraph {
+	using Handle = uint32_t;
+	static constexpr Handle NONE = UINT32_MAX;
+	// src or dst of a dependency on work outside the group
+	static constexpr uint32_t EXTERNAL = UINT32_MAX;
+
+	// How a pass touches a resource. Each has one image layout, and the
+	// executor maps them to pipeline stages and access masks.
+	enum Use : uint8_t {
+		// before anything, the contents don't matter
+		UNDEFINED,
+		COLOR_ATTACHMENT,
+		DEPTH_ATTACHMENT,
+		// depth tested but not written
+		DEPTH_READ,
+		// sampled in vertex or fragment shaders
+		SHADER_READ,
+		COMPUTE_READ,
+		COMPUTE_WRITE,
+		INDIRECT_READ,
+		TRANSFER_READ,
+		TRANSFER_WRITE,
+		PRESENT,
+		USE_COUNT
+	};
+
+	enum Type : uint8_t {
+		RASTER,
+		COMPUTE,
+		TRANSFER
+	};
+
+	// Mirrors VkClearValue
+	union ClearValue {
+		float color[4];
+		struct {
+			float depth;
+			uint32_t stencil;
+		} depth_stencil;
+	};
+
+	struct ImageInfo {
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// a VkFormat, only compared here
+		uint32_t format = 0;
+		// a VkSampleCountFlagBits
+		uint32_t samples = 1;
+		// what clearing attachments of this image writes
+		ClearValue clear {};
+	};
+
+	// Layouts come from before and after, the wait mask from the uses whose
+	// work has to finish first
+	struct Barrier {
+		Handle resource;
+		// UNDEFINED when the contents can be dropped
+		Use before;
+		Use after;
+		uint32_t wait;
+	};
+
+	struct Dependency {
+		uint32_t src_subpass;
+		uint32_t dst_subpass;
+		uint32_t src_uses;
+		uint32_t dst_uses;
+	};
+
+	enum Load : uint8_t {
+		LOAD,
+		CLEAR,
+		DONT_CARE
+	};
+
+	struct Attachment {
+		Handle resource;
+		Load load;
+		bool store;
+		// the layouts it comes in with and leaves with
+		Use initial;
+		Use final;
+	};
+
+	struct Subpass {
+		Handle pass;
+		// indices into the group's attachments
+		std::vector<uint32_t> colors;
+		// one per color, EXTERNAL for colors that aren't resolved
+		std::vector<uint32_t> resolves;
+		uint32_t depth = EXTERNAL;
+		Use depth_use = UNDEFINED;
+	};
+
+	// One render pass, or a single compute or transfer pass
+	struct Group {
+		Type type;
+		std::vector<Handle> passes;
+		// before the group starts, in one batch
+		std::vector<Barrier> barriers;
+		// raster groups only
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<Attachment> attachments;
+		std::vector<Subpass> subpasses;
+		std::vector<Dependency> dependencies;
+	};
+
+	// An image the graph owns, alive from its first group to its last
+	struct Transient {
+		Handle resource;
+		uint32_t first_group;
+		uint32_t last_group;
+		// every use it's put to, for the image's usage flags
+		uint32_t uses;
+		// only ever an attachment of one render pass, never loaded or
+		// stored, so it can live in lazily allocated memory
+		bool memoryless;
+		// into the shared memory, set by alias
+		uint64_t offset = 0;
+	};
+
+	struct MemoryRequirement {
+		uint64_t size;
+		uint64_t alignment;
+	};
+
+	static constexpr uint32_t bit(Use use) { return 1u << use; }
+	static bool is_write(Use use);
+
+	// Comes in as initial, after the frame it's left as final. UNDEFINED for
+	// final leaves it as the last pass had it.
+	Handle import_image(const std::string& name, const ImageInfo& info, Use initial, Use final);
+	Handle import_buffer(const std::string& name, Use initial = UNDEFINED, Use final = UNDEFINED);
+	// Owned by the graph, its contents only last the frame
+	Handle create_image(const std::string& name, const ImageInfo& info);
+
+	Handle add_pass(const std::string& name, Type type);
+	// Written as a color attachment and resolved into resolve when that's
+	// given. Loaded unless cleared.
+	void color(Handle pass, Handle image, Handle resolve = NONE, bool clear = false);
+	// Tested against and written unless read_only. Loaded unless cleared.
+	void depth(Handle pass, Handle image, bool read_only = false, bool clear = false);
+	void read(Handle pass, Handle resource, Use use);
+	void write(Handle pass, Handle resource, Use use);
+	// Never culled, for passes whose results leave the GPU some other way
+	void keep(Handle pass);
+
+	// Forgets every pass and resource
+	void clear();
+
+	// Off leaves every raster pass in a render pass of its own, for
+	// executors without subpasses
+	bool merge_subpasses = true;
+
+	// Throws if a pass's attachments don't match in size
+	void compile();
+	// Places the transients that aren't memoryless in one block of memory,
+	// the ones alive at the same time apart, and returns its size.
+	// requirements line up with transients(). Whatever takes over memory has
+	// to wait on what used it before, which goes into the first barrier or
+	// dependency of each.
+	// Memoryless transients are left out unless include_memoryless is set,
+	// for devices without lazily allocated memory.
+	uint64_t alias(const std::vector<MemoryRequirement>& requirements, bool include_memoryless = false);
+
+	const std::vector<Group>& groups() const { return m_groups; }
+	// Imported resources into their final use, after the last group
+	const std::vector<Barrier>& final_barriers() const { return m_final_barriers; }
+	const std::vector<Transient>& transients() const { return m_transients; }
+
+	// NONE for culled passes
+	uint32_t group_of(Handle pass) const { return m_passes[pass].group; }
+	uint32_t subpass_of(Handle pass) const { return m_passes[pass].subpass; }
+	bool culled(Handle pass) const { return m_passes[pass].group == NONE; }
+
+	size_t pass_count() const { return m_passes.size(); }
+	size_t resource_count() const { return m_resources.size(); }
+	const std::string& pass_name(Handle pass) const { return m_passes[pass].name; }
+	const std::string& resource_name(Handle resource) const { return m_resources[resource].name; }
+	bool is_image(Handle resource) const { return m_resources[resource].image; }
+	bool is_imported(Handle resource) const { return m_resources[resource].imported; }
+	const ImageInfo& image_info(Handle resource) const { return m_resources[resource].info; }
+
+private:
+	enum Role : uint8_t {
+		OTHER,
+		COLOR,
+		RESOLVE,
+		DEPTH
+	};
+
+	struct Access {
+		Handle resource;
+		Use use;
+		Role role;
+		bool clear;
+	};
+
+	struct Pass {
+		std::string name;
+		Type type;
+		bool keep = false;
+		std::vector<Access> accesses;
+		uint32_t group = NONE;
+		uint32_t subpass = 0;
+	};
+
+	struct Resource {
+		std::string name;
+		bool image;
+		bool imported;
+		ImageInfo info;
+		Use initial;
+		Use final;
+	};
+
+	// Where a transient's first use waits, so alias can add to it
+	struct FirstSync {
+		uint32_t group;
+		uint32_t index;
+		bool barrier;
+	};
+
+	static bool reads(const Access& access);
+	Handle add_resource(Resource resource);
+	// False for passes without attachments
+	bool extent(const Pass& pass, uint32_t& width, uint32_t& height) const;
+	void cull(std::vector<Handle>& alive) const;
+	bool can_merge(const Group& group, const Pass& pass) const;
+	void form_groups(const std::vector<Handle>& alive);
+	void synchronize();
+
+	std::vector<Pass> m_passes;
+	std::vector<Resource> m_resources;
+
+	std::vector<Group> m_groups;
+	std::vector<Barrier> m_final_barriers;
+	std::vector<Transient> m_transients;
+	std::vector<FirstSync> m_first_syncs;
+	std::vector<Use> m_last_uses;
+};
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "deletion_queue.hpp"
+#include "render_graph.hpp"
+#include "render_target.hpp"
+#include "texture.hpp"
+
+#include <vector>
+
+namespace chch {
+
+struct Context;
+
+// Runs a compiled RenderGraph. build makes its transient images and render
+// passes, then every frame the imported resources are handed over and each
+// pass's commands go between begin_pass and end_pass:
+//
+//     executor.set_image(swap, images[i], views[i]);
+//     if (executor.begin_pass(cmd, main)) {
+//         ...draws...
+//         executor.end_pass(cmd, main);
+//     }
+//     executor.finish(cmd);
+//
+// Transients that share memory get one allocation between them, and the
+// memoryless ones are lazily allocated where the device has memory for it.
+//
+// With dynamic_rendering, raster passes begin with vkCmdBeginRendering and
+// no render passes or framebuffers are made. The layout changes render
+// passes would have made go into barriers around each pass instead.
+struct RenderGraphExecutor {
+	void init(const Context* context);
+	void deinit();
+
+	// Set before build, needs Context::dynamic_rendering. Turns off the
+	// graph's merge_subpasses.
+	bool dynamic_rendering = false;
+
+	// Compiles the graph and replaces whatever an earlier build made. That
+	// goes onto retired for frame when it's given, otherwise it's destroyed
+	// right away and the device has to be idle. The graph has to outlive the
+	// executor.
+	void build(RenderGraph& graph, DeletionQueue* retired = nullptr, uint64_t frame = 0);
+
+	// Imported resources, before the first pass that uses them each frame
+	void set_image(RenderGraph::Handle image, VkImage vk_image, VkImageView view);
+	void set_buffer(RenderGraph::Handle buffer, VkBuffer vk_buffer);
+
+	// Transients and imported images both
+	const Image& image(RenderGraph::Handle image) const { return m_images[image]; }
+	// The render pass and subpass pipelines for a raster pass are built against
+	VkRenderPass render_pass(RenderGraph::Handle pass) const;
+	uint32_t subpass(RenderGraph::Handle pass) const { return m_graph->subpass_of(pass); }
+	// Both of those and the pass's attachment formats, for PipelineBuilder
+	RenderTarget render_target(RenderGraph::Handle pass) const;
+
+	// Records the barriers ahead of the pass and begins its render pass or
+	// subpass. False for culled passes, whose commands should be skipped.
+	bool begin_pass(VkCommandBuffer command_buffer, RenderGraph::Handle pass);
+	void end_pass(VkCommandBuffer command_buffer, RenderGraph::Handle pass);
+	// After the last pass, leaves imported resources the way they were asked for
+	void finish(VkCommandBuffer command_buffer);
+
+	// memory behind the aliased transients, 0 when there are none
+	VkDeviceSize aliased_size() const { return m_aliased_size; }
+
+private:
+	struct Framebuffer {
+		uint32_t group;
+		std::vector<VkImageView> views;
+		VkFramebuffer framebuffer;
+	};
+
+	// everything but the render passes
+	void release(DeletionQueue* retired, uint64_t frame);
+	void init_transients();
+	void init_render_passes(DeletionQueue* retired, uint64_t frame);
+	void init_rendering_barriers();
+	VkFramebuffer framebuffer(uint32_t group);
+	void begin_rendering(VkCommandBuffer command_buffer, uint32_t group);
+	void record_barriers(VkCommandBuffer command_buffer, const std::vector<RenderGraph::Barrier>& barriers);
+
+	const Context* m_context = nullptr;
+	RenderGraph* m_graph = nullptr;
+
+	// indexed by handle, imported entries are filled in by set_image
+	std::vector<Image> m_images;
+	std::vector<VkImageAspectFlags> m_aspects;
+	std::vector<VkBuffer> m_buffers;
+	// the images build made, their allocation is null when they're aliased
+	std::vector<RenderGraph::Handle> m_transients;
+	VmaAllocation m_aliased = VK_NULL_HANDLE;
+	VkDeviceSize m_aliased_size = 0;
+
+	// one per group, null for compute and transfer
+	std::vector<VkRenderPass> m_render_passes;
+	// Kept through builds and handed out again to groups that come out the
+	// same, so pipelines made against them outlive a swap chain resize
+	struct CachedRenderPass {
+		std::vector<uint32_t> key;
+		VkRenderPass render_pass;
+	};
+	std::vector<CachedRenderPass> m_render_pass_cache;
+	std::vector<std::vector<VkClearValue>> m_clear_values;
+	// views change with the swap chain image, so a few per group
+	std::vector<Framebuffer> m_framebuffers;
+
+	// per group with dynamic rendering, the group's barriers along with its
+	// attachments' way in, and their way out to their final layouts
+	std::vector<std::vector<RenderGraph::Barrier>> m_begin_barriers;
+	std::vector<std::vector<RenderGraph::Barrier>> m_end_barriers;
+};
+
+}
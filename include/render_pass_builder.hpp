@@ -40,13 +40,18 @@ struct RenderPassBuilder {
 	VkResult build(VkRenderPass* render_pass);
 
 	RenderPassBuilder add_color_attachment(uint32_t attachment_index, VkFormat format);
-	RenderPassBuilder add_color_resolve_attachment(uint32_t attachment_index, VkFormat format);
+	RenderPassBuilder add_color_resolve_attachment(
+		uint32_t attachment_index,
+		VkFormat format,
+		VkImageLayout final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 	RenderPassBuilder add_depth_attachment(
 		uint32_t attachment_index,
 		VkSampleCountFlagBits samples,
 		VkAttachmentStoreOp store_op,
 		VkImageLayout final_layout);
 	RenderPassBuilder add_input_attachment(uint32_t attachment_index);
+	// Keep what an earlier pass left in the attachment instead of clearing it
+	RenderPassBuilder load_attachment(uint32_t attachment_index, VkImageLayout initial_layout);
 	SubpassBuilder begin_subpass(uint32_t subpass_index);
 	RenderPassBuilder add_dependency(
 		uint32_t src_subpass_index,
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <string>
+
+namespace chch {
+
+// What one frame cost to draw. The counters are gathered on the CPU while the
+// frame is recorded. The GPU side comes from pipeline statistics queries and
+// is only there when gpu_valid is set.
+struct RenderStats {
+	// the frame_number these were counted for
+	uint64_t frame = 0;
+
+	// recorded draws, deferred ones included
+	uint32_t draws = 0;
+	uint32_t instances = 0;
+	uint64_t triangles = 0;
+	uint32_t pipeline_binds = 0;
+	uint32_t descriptor_binds = 0;
+	uint32_t vertex_buffer_binds = 0;
+	// dropped before recording
+	uint32_t frustum_culled = 0;
+	uint32_t occlusion_culled = 0;
+	// left for the GPU occlusion test to decide
+	uint32_t deferred = 0;
+
+	bool gpu_valid = false;
+	uint64_t input_vertices = 0;
+	uint64_t input_primitives = 0;
+	uint64_t vertex_invocations = 0;
+	uint64_t clipping_invocations = 0;
+	uint64_t clipping_primitives = 0;
+	uint64_t fragment_invocations = 0;
+
+	// fragment shader invocations per pixel, 0 without the GPU side
+	double overdraw(uint32_t width, uint32_t height) const;
+};
+
+// frame,draws,...,fragment_invocations, the GPU columns are left empty for
+// frames without them
+std::string render_stats_csv_header();
+std::string render_stats_csv_row(const RenderStats& stats);
+
+// The most recent frames' stats, oldest first
+struct RenderStatsLog {
+	// frames kept, 0 keeps none
+	size_t capacity = 0;
+
+	void add(const RenderStats& stats);
+	size_t size() const { return m_frames.size(); }
+	const RenderStats& operator[](size_t i) const { return m_frames[i]; }
+	void clear() { m_frames.clear(); }
+
+	std::string to_csv() const;
+	// False if the file couldn't be written
+	bool write_csv(const std::filesystem::path& path) const;
+
+private:
+	std::deque<RenderStats> m_frames;
+};
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <vector>
+
+namespace chch {
+
+// What a graphics pipeline draws into. With a render pass the pipeline is
+// made for that subpass, without one it's made for dynamic rendering with
+// these formats, and works in any pass that has them.
+struct RenderTarget {
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+	std::vector<VkFormat> color_formats;
+	VkFormat depth_format = VK_FORMAT_UNDEFINED;
+};
+
+}
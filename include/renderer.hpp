@@ -5,8 +5,24 @@
 #include <GLFW/glfw3.h>
 
 #include <context.hpp>
+#include "bvh.hpp"
 #include "camera.hpp"
+#include "culling.hpp"
+#include "deletion_queue.hpp"
+#include "ecs.hpp"
 #include "frame_data.hpp"
+#include "frame_readback.hpp"
+#include "gpu_profiler.hpp"
+#include "gpu_scene.hpp"
+#include "occlusion_culler.hpp"
+#include "occlusion_rasterizer.hpp"
+#include "pipeline_statistics.hpp"
+#include "render_graph.hpp"
+#include "render_graph_executor.hpp"
+#include "render_stats.hpp"
+#include "thread_pool.hpp"
+#include "transform_hierarchy.hpp"
+#include "uniform_allocator.hpp"
 #include "uniform.hpp"
 
 #include <vector>
@@ -27,24 +43,106 @@ struct Window;
 struct Device;
 struct Mesh;
 
+// Entities carrying a SceneNode and one of these are drawn by Renderer::draw(World&, ...)
+struct Renderable {
+	const Mesh* mesh = nullptr;
+	const Material* material = nullptr;
+	// copied into draw_uniforms every draw, read by the shaders at set 2
+	const void* params = nullptr;
+	uint32_t params_size = 0;
+};
+
+// Where an entity sits in a TransformHierarchy
+struct SceneNode {
+	TransformHierarchy::Handle handle = TransformHierarchy::NONE;
+};
+
+// An entity's record in Renderer::gpu_scene, filled in by update_scene. Hand
+// it to Renderer::remove_from_scene before destroying the entity.
+struct SceneRecord {
+	static constexpr uint32_t NONE = UINT32_MAX;
+	uint32_t index = NONE;
+	uint32_t material = 0;
+};
+
 struct Renderer {
-	uint32_t image_index;
+	uint32_t image_index = 0;
+	// stays null in headless mode
 	VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
 
-	VkRenderPass render_pass = VK_NULL_HANDLE;
-	VkRenderPass shadow_mapping_render_pass = VK_NULL_HANDLE;
-	Image depth_image;
-	Image msaa_image;
-	Image shadow_map_image;
+	// set before init, ignored when the device doesn't support it. Passes
+	// begin with vkCmdBeginRendering instead of render pass objects, so there
+	// are no framebuffers to remake on resize.
+	bool dynamic_rendering = false;
 
-	VkDescriptorPool descriptor_pool;
-	per_frame<VkDescriptorSetLayout> descriptor_set_layout;
+	// the main pass's, what materials build their pipelines against. It
+	// stays the same through swap chain resizes.
+	RenderTarget render_target;
+
+	// the frame's passes, rebuilt with the swap chain. The executor owns the
+	// multisampled color and depth images.
+	RenderGraph render_graph;
+	RenderGraphExecutor graph_executor;
+
+	VkDescriptorSetLayout descriptor_set_layout;
 	per_frame<VkDescriptorSet> descriptor_set;
 	Uniform<SceneGlobals> scene_uniform;
 
 	Frames frames;
 	Camera* camera;
 	Context* context;
+	ThreadPool thread_pool;
+
+	// draws whose bounds fall outside the camera frustum are dropped
+	bool frustum_culling = true;
+	FrustumCuller culler;
+	Frustum frustum;
+
+	// set before init, ignored if the depth buffer can't be sampled
+	bool occlusion_culling = false;
+	OcclusionCuller occlusion_culler;
+
+	// draws hidden behind the registered occluders are dropped before recording
+	bool software_occlusion = false;
+	OcclusionRasterizer occlusion_rasterizer;
+
+	// per-draw uniform data, bound at set 2 with a dynamic offset. Materials
+	// have to be built with draw_uniforms.layout().
+	VkDeviceSize draw_uniform_capacity = 1024 * 1024;
+	UniformAllocator draw_uniforms;
+
+	// per-object records on the GPU, changes go up in setup_draw
+	uint32_t max_scene_objects = 16 * 1024;
+	GpuScene gpu_scene;
+	// world space boxes of the gpu_scene records, user data is the record
+	// index. Kept up to date by update_scene.
+	Bvh scene_bvh;
+
+	// set before init, for read_back. Depth is only copied when the depth
+	// buffer isn't multisampled.
+	bool readback = false;
+	bool readback_depth = false;
+	FrameReadback frame_readback;
+	// set before init, times the passes of every frame. With validation on
+	// the regions are labelled in frame captures too.
+	bool gpu_profiling = false;
+	GpuProfiler gpu_profiler;
+	// set before init, counts shader invocations and the like as well when
+	// the device supports pipeline statistics queries
+	bool pipeline_statistics = false;
+	PipelineStatistics pipeline_stats;
+
+	// counters for the frame being recorded, reset by setup_draw
+	RenderStats stats;
+	// every frame's stats once its GPU side is back, nothing is kept until
+	// the capacity is set
+	RenderStatsLog stats_log;
+
+	// counts submitted frames, read back frames are numbered by it
+	uint64_t frame_number = 0;
+
+	// correction_matrix * camera->matrix(), refreshed once per frame by setup_draw
+	glm::mat4 view_projection = glm::mat4(1.0f);
 
 	const glm::mat4 correction_matrix = {
 		{ 1.0f, 0.0f, 0.0f, 0.0f },
@@ -53,33 +151,127 @@ struct Renderer {
 		{ 0.0f, 0.0f, 0.0f, 1.0f }
 	};
 
-	// These are all associated
+	// These are all associated. In headless mode the images are an offscreen
+	// ring, each left in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL once drawn.
 	std::vector<VkImage> swap_chain_images;
 	std::vector<VkImageView> swap_chain_image_views;
-	std::vector<VkFramebuffer> framebuffers;
 
 	void init(Context* p_context, SceneGlobals scene_globals, Camera* p_camera);
 	void deinit();
 
+	// While the window has no area there's no swap chain image to draw into,
+	// and the frame's draws and present_draw do nothing
 	void setup_draw();
+	bool frame_skipped() const { return m_frame_skipped; }
 	void draw(const Transform& transform, const Mesh& mesh, const Material& material);
+	// params, when given, are copied into draw_uniforms for the material's shaders.
+	// object_id keys the object's occlusion results from frame to frame, it
+	// has to be below max_scene_objects and the same every frame, like a
+	// SceneRecord index. Draws without one skip GPU occlusion culling.
+	void draw(
+		const glm::mat4& model_matrix,
+		const Mesh& mesh,
+		const Material& material,
+		const void* params = nullptr,
+		uint32_t params_size = 0,
+		uint32_t object_id = SceneRecord::NONE);
+	// Every entity with a SceneNode and a Renderable. The hierarchy has to be
+	// updated first, and update_scene run for entities with a SceneRecord.
+	// With frustum culling those come out of a scene_bvh query, so the cost
+	// follows what's in view rather than the scene size. The rest are
+	// walked chunk by chunk.
+	void draw(World& world, const TransformHierarchy& transforms);
+	// Records entities with a SceneNode, Renderable and SceneRecord in
+	// gpu_scene and scene_bvh, rewriting the ones whose world matrix changed
+	// in the last hierarchy update. Call before setup_draw.
+	void update_scene(World& world, const TransformHierarchy& transforms);
+	// Takes the record out of gpu_scene and scene_bvh, resetting its index
+	void remove_from_scene(SceneRecord& record);
+	// Between setup_draw and the first draw, the mesh has to outlive the frame
+	void add_occluder(const Transform& transform, const Mesh& mesh);
+	void add_occluder(const glm::mat4& model_matrix, const Mesh& mesh);
 	void present_draw();
+	// Between setup_draw and present_draw. The callback gets this frame's
+	// pixels MAX_FRAMES_IN_FLIGHT frames later, or at deinit.
+	void read_back(FrameReadback::Callback callback);
+
+	// Batch visibility test against this frame's frustum, for callers that
+	// keep their bounds in SoA form instead of going through draw
+	size_t cull(const BoundingSpheres& spheres, std::vector<uint8_t>& visibility) const;
+
+	// World space ray through a window position in pixels, for picking
+	Ray pick_ray(glm::vec2 cursor) const;
+
+	// The newest frame's stats with their GPU side, MAX_FRAMES_IN_FLIGHT
+	// frames behind stats
+	const RenderStats& completed_stats() const { return m_completed_stats; }
 
 private:
 	void init_swap_chain();
+	void init_offscreen_images();
 	void init_image_views();
-	void init_render_pass();
-	void init_framebuffers();
-	void init_images();
+	void init_render_graph();
 	void init_base_descriptor();
+	void init_fallback_pipeline();
 	void init_camera();
 
+	// draws indirectly when given a buffer
 	void record_command_buffer(
 		VkCommandBuffer& command_buffer,
-		const Transform& transform,
+		const glm::mat4& model_matrix,
 		const Mesh& mesh,
-		const Material& material);
-	void recreate_swap_chain();
+		const Material& material,
+		uint32_t params_offset,
+		VkBuffer indirect_buffer = VK_NULL_HANDLE,
+		VkDeviceSize indirect_offset = 0);
+	// Hands the old swap chain to the new one and retires it along with the
+	// rest of what was sized to it, without waiting on the device. False
+	// while the window has no area, the swap chain is kept until it does.
+	bool recreate_swap_chain();
+
+	// waiting on the occlusion test before they can be drawn
+	struct DeferredDraw {
+		glm::mat4 model_matrix;
+		const Mesh* mesh;
+		const Material* material;
+		uint32_t params_offset;
+		uint32_t object_index;
+	};
+	std::vector<DeferredDraw> m_deferred_draws;
+	RenderGraph::Handle m_swap_image;
+	RenderGraph::Handle m_msaa_image;
+	RenderGraph::Handle m_depth_image;
+	RenderGraph::Handle m_indirect_buffer = RenderGraph::NONE;
+	RenderGraph::Handle m_main_pass;
+	RenderGraph::Handle m_cull_pass = RenderGraph::NONE;
+	RenderGraph::Handle m_deferred_pass = RenderGraph::NONE;
+	RenderGraph::Handle m_readback_pass = RenderGraph::NONE;
+	FrameReadback::Callback m_readback_callback;
+	uint32_t m_frame_region = GpuProfiler::NONE;
+	uint32_t m_main_pass_region = GpuProfiler::NONE;
+	// stats of submitted frames, waiting on their GPU side
+	per_frame<RenderStats> m_submitted_stats;
+	per_frame<bool> m_stats_pending {};
+	RenderStats m_completed_stats;
+	// backs swap_chain_images when the context is headless
+	std::vector<Image> m_offscreen_images;
+	uint32_t m_draw_count = 0;
+	bool m_occluders_pending = false;
+	// by gpu_scene record index
+	std::vector<Entity> m_scene_entities;
+	std::vector<int32_t> m_scene_proxies;
+	std::vector<uint32_t> m_visible_records;
+	// stands in for materials whose pipeline is still being built, only uses set 0
+	VkPipelineLayout m_fallback_layout;
+	VkPipeline m_fallback_pipeline = VK_NULL_HANDLE;
+	// zeroed slice for draws that don't bring their own params
+	uint32_t m_blank_params = 0;
+	VkFormat m_depth_format;
+	// what swap chain recreation replaced, freed once the frames that were
+	// in flight at the time are done
+	DeletionQueue m_retired;
+	bool m_swap_chain_stale = false;
+	bool m_frame_skipped = false;
 };
 
 }
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "transform.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace chch {
+
+// A resource the frame loaded, draws refer to it by its place in the log's
+// sequence of loads
+struct ReplayLoad {
+	enum Kind : uint8_t {
+		MESH,
+		TEXTURE,
+		MATERIAL
+	};
+
+	Kind kind;
+	std::string name;
+
+	bool operator==(const ReplayLoad& other) const { return kind == other.kind && name == other.name; }
+	bool operator!=(const ReplayLoad& other) const { return !(*this == other); }
+};
+
+struct ReplayTransform {
+	uint32_t object;
+	Transform local;
+};
+
+struct ReplayDraw {
+	// for draws that aren't one of the scene's objects, like the skybox
+	static constexpr uint32_t NO_OBJECT = UINT32_MAX;
+
+	uint32_t object;
+	uint32_t mesh;
+	uint32_t material;
+
+	bool operator==(const ReplayDraw& other) const
+	{
+		return object == other.object && mesh == other.mesh && material == other.material;
+	}
+	bool operator!=(const ReplayDraw& other) const { return !(*this == other); }
+};
+
+// Everything a frame took from outside the engine
+struct ReplayFrame {
+	float time = 0.0f;
+	float delta = 0.0f;
+	Transform camera;
+	bool pick = false;
+	std::vector<ReplayLoad> loads;
+	// object transforms set this frame
+	std::vector<ReplayTransform> transforms;
+	// every draw issued this frame, in order
+	std::vector<ReplayDraw> draws;
+
+	void clear();
+};
+
+struct ReplayHeader {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// seconds per frame, 0 when frames were timed by the clock
+	float timestep = 0.0f;
+};
+
+// Binary log of frame inputs, written a frame at a time as it runs. A
+// transform that's the same as the one last written for its object is left
+// out, as is a draw list that's the same as the frame before's, so scenes
+// that mostly sit still make small logs.
+struct ReplayWriter {
+	static constexpr uint32_t MAGIC = 0x50524843; // "CHRP"
+	static constexpr uint32_t VERSION = 1;
+
+	// Throws if the file can't be opened
+	void open(const std::filesystem::path& path, const ReplayHeader& header);
+	// Throws if the frame couldn't be written
+	void write(const ReplayFrame& frame);
+	void close();
+
+	bool is_open() const { return m_file.is_open(); }
+	uint32_t frames_written() const { return m_frames_written; }
+
+private:
+	std::ofstream m_file;
+	uint32_t m_frames_written = 0;
+	std::vector<Transform> m_transforms;
+	std::vector<bool> m_written;
+	std::vector<ReplayDraw> m_draws;
+	std::vector<uint8_t> m_chunk;
+};
+
+// Reads back what ReplayWriter wrote. Frames come back with only the
+// transforms that changed and with the full draw list.
+struct ReplayReader {
+	// Throws if the file can't be opened or isn't a replay log
+	void open(const std::filesystem::path& path);
+	// False at the end of the log, throws if the log is damaged
+	bool next(ReplayFrame& frame);
+	void close();
+
+	bool is_open() const { return m_file.is_open(); }
+	const ReplayHeader& header() const { return m_header; }
+	uint32_t frames_read() const { return m_frames_read; }
+
+private:
+	std::ifstream m_file;
+	ReplayHeader m_header;
+	uint64_t m_remaining = 0;
+	uint32_t m_frames_read = 0;
+	std::vector<ReplayDraw> m_draws;
+	std::vector<uint8_t> m_chunk;
+};
+
+}
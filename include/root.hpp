@@ -0,0 +1,12 @@
+#pragma once
+
+#include <filesystem>
+
+namespace chch {
+
+// Where shaders/ and resources/ are found, defined by whatever links the engine
+struct Root {
+	static const std::filesystem::path& path;
+};
+
+}
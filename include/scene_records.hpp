@@ -0,0 +1,70 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "bounds.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace chch {
+
+// Matches Object in scene_scatter.comp, std430
+struct GpuObject {
+	glm::mat4 model;
+	// world space, center and radius
+	glm::vec4 sphere;
+	// world space box, w unused
+	glm::vec4 box_min;
+	glm::vec4 box_max;
+	uint32_t material;
+	// where the mesh sits in the index and vertex buffers
+	uint32_t first_index;
+	uint32_t index_count;
+	int32_t vertex_offset;
+
+	static GpuObject make(
+		const glm::mat4& model,
+		const Bounds& object_bounds,
+		uint32_t material,
+		uint32_t index_count,
+		uint32_t first_index = 0,
+		int32_t vertex_offset = 0);
+};
+static_assert(sizeof(GpuObject) == 128, "GpuObject has to match the shader's std430 layout");
+
+// CPU side copy of the GPU scene buffer that remembers which records changed
+// since they were last collected, so only those have to be uploaded.
+struct SceneRecords {
+	void init(uint32_t capacity);
+	void clear();
+
+	// Throws once capacity records are in use
+	uint32_t add(const GpuObject& object);
+	// The slot is cleared to an empty record that draws nothing, and reused by the next add
+	void remove(uint32_t index);
+	void set(uint32_t index, const GpuObject& object);
+	const GpuObject& get(uint32_t index) const { return m_objects[index]; }
+
+	// Changed records in index order, indices and records need room for
+	// dirty_count() entries. Everything counts as uploaded afterwards.
+	size_t collect(uint32_t* indices, GpuObject* records);
+	size_t dirty_count() const { return m_dirty_list.size(); }
+
+	uint32_t capacity() const { return static_cast<uint32_t>(m_objects.size()); }
+	// highest index in use plus one
+	uint32_t extent() const { return m_extent; }
+	size_t size() const { return m_extent - m_free.size(); }
+
+private:
+	void mark(uint32_t index);
+
+	std::vector<GpuObject> m_objects;
+	std::vector<uint8_t> m_dirty;
+	std::vector<uint32_t> m_dirty_list;
+	std::vector<uint32_t> m_free;
+	uint32_t m_extent = 0;
+};
+
+}
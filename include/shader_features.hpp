@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace chch {
+
+// Feature bits shaders are specialized on. Bit i is specialization constant
+// i, declared in the shader as
+//     layout(constant_id = i) const bool NAME = false;
+// so the driver compiles out the paths a material doesn't use.
+struct ShaderFeatures {
+	enum Bits : uint32_t {
+		// multiplies the base color by the material's texture at set 1 binding 1
+		TEXTURED = 1 << 0,
+		// ambient and sun light, the base color is drawn flat without it
+		LIT = 1 << 1,
+		// sun highlight, needs LIT
+		SPECULAR = 1 << 2,
+		// reserved for sampling the shadow map, needs LIT
+		SHADOWS = 1 << 3,
+		// discards fragments below the material's alpha cutoff
+		ALPHA_TEST = 1 << 4,
+	};
+	static constexpr uint32_t COUNT = 5;
+
+	// Drops bits that do nothing without another, so materials asking for
+	// the same result share one pipeline
+	static uint32_t normalize(uint32_t bits)
+	{
+		bits &= (1u << COUNT) - 1;
+		if (!(bits & LIT))
+			bits &= ~(SPECULAR | SHADOWS);
+		return bits;
+	}
+
+	// One VkBool32 per feature, in constant_id order
+	static std::array<uint32_t, COUNT> constants(uint32_t bits)
+	{
+		std::array<uint32_t, COUNT> values {};
+		for (uint32_t i = 0; i < COUNT; ++i)
+			values[i] = (bits >> i) & 1;
+		return values;
+	}
+};
+
+}
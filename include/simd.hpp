@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Thin wrapper over whatever float vector the target supports.
+// Everything is inline so the wrappers vanish at -O1 and above.
+namespace chch::simd {
+
+#if defined(__AVX__)
+
+constexpr size_t WIDTH = 8;
+struct Float { __m256 v; };
+struct Mask { __m256 v; };
+
+inline Float load(const float* p) { return { _mm256_loadu_ps(p) }; }
+inline void store(float* p, Float a) { _mm256_storeu_ps(p, a.v); }
+inline Float splat(float f) { return { _mm256_set1_ps(f) }; }
+inline Float add(Float a, Float b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Float sub(Float a, Float b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Float mul(Float a, Float b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Float div(Float a, Float b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline Float min(Float a, Float b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline Float max(Float a, Float b) { return { _mm256_max_ps(a.v, b.v) }; }
+#if defined(__FMA__)
+inline Float mul_add(Float a, Float b, Float c) { return { _mm256_fmadd_ps(a.v, b.v, c.v) }; }
+#else
+inline Float mul_add(Float a, Float b, Float c) { return add(mul(a, b), c); }
+#endif
+inline Mask greater_equal(Float a, Float b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline Mask less_equal(Float a, Float b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline Mask mask_and(Mask a, Mask b) { return { _mm256_and_ps(a.v, b.v) }; }
+inline Mask mask_or(Mask a, Mask b) { return { _mm256_or_ps(a.v, b.v) }; }
+inline uint32_t bits(Mask m) { return static_cast<uint32_t>(_mm256_movemask_ps(m.v)); }
+inline Float select(Mask m, Float a, Float b) { return { _mm256_blendv_ps(b.v, a.v, m.v) }; }
+
+#elif defined(__SSE2__)
+
+constexpr size_t WIDTH = 4;
+struct Float { __m128 v; };
+struct Mask { __m128 v; };
+
+inline Float load(const float* p) { return { _mm_loadu_ps(p) }; }
+inline void store(float* p, Float a) { _mm_storeu_ps(p, a.v); }
+inline Float splat(float f) { return { _mm_set1_ps(f) }; }
+inline Float add(Float a, Float b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Float sub(Float a, Float b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Float mul(Float a, Float b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Float div(Float a, Float b) { return { _mm_div_ps(a.v, b.v) }; }
+inline Float min(Float a, Float b) { return { _mm_min_ps(a.v, b.v) }; }
+inline Float max(Float a, Float b) { return { _mm_max_ps(a.v, b.v) }; }
+inline Float mul_add(Float a, Float b, Float c) { return add(mul(a, b), c); }
+inline Mask greater_equal(Float a, Float b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline Mask less_equal(Float a, Float b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline Mask mask_and(Mask a, Mask b) { return { _mm_and_ps(a.v, b.v) }; }
+inline Mask mask_or(Mask a, Mask b) { return { _mm_or_ps(a.v, b.v) }; }
+inline uint32_t bits(Mask m) { return static_cast<uint32_t>(_mm_movemask_ps(m.v)); }
+inline Float select(Mask m, Float a, Float b) { return { _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) }; }
+
+#elif defined(__ARM_NEON)
+
+constexpr size_t WIDTH = 4;
+struct Float { float32x4_t v; };
+struct Mask { uint32x4_t v; };
+
+inline Float load(const float* p) { return { vld1q_f32(p) }; }
+inline void store(float* p, Float a) { vst1q_f32(p, a.v); }
+inline Float splat(float f) { return { vdupq_n_f32(f) }; }
+inline Float add(Float a, Float b) { return { vaddq_f32(a.v, b.v) }; }
+inline Float sub(Float a, Float b) { return { vsubq_f32(a.v, b.v) }; }
+inline Float mul(Float a, Float b) { return { vmulq_f32(a.v, b.v) }; }
+inline Float div(Float a, Float b) { return { vdivq_f32(a.v, b.v) }; }
+inline Float min(Float a, Float b) { return { vminq_f32(a.v, b.v) }; }
+inline Float max(Float a, Float b) { return { vmaxq_f32(a.v, b.v) }; }
+inline Float mul_add(Float a, Float b, Float c) { return { vmlaq_f32(c.v, a.v, b.v) }; }
+inline Mask greater_equal(Float a, Float b) { return { vcgeq_f32(a.v, b.v) }; }
+inline Mask less_equal(Float a, Float b) { return { vcleq_f32(a.v, b.v) }; }
+inline Mask mask_and(Mask a, Mask b) { return { vandq_u32(a.v, b.v) }; }
+inline Mask mask_or(Mask a, Mask b) { return { vorrq_u32(a.v, b.v) }; }
+inline uint32_t bits(Mask m)
+{
+	const uint32x4_t shift = { 1, 2, 4, 8 };
+	return vaddvq_u32(vandq_u32(m.v, shift));
+}
+inline Float select(Mask m, Float a, Float b) { return { vbslq_f32(m.v, a.v, b.v) }; }
+
+#else
+
+constexpr size_t WIDTH = 1;
+struct Float { float v; };
+struct Mask { bool v; };
+
+inline Float load(const float* p) { return { *p }; }
+inline void store(float* p, Float a) { *p = a.v; }
+inline Float splat(float f) { return { f }; }
+inline Float add(Float a, Float b) { return { a.v + b.v }; }
+inline Float sub(Float a, Float b) { return { a.v - b.v }; }
+inline Float mul(Float a, Float b) { return { a.v * b.v }; }
+inline Float div(Float a, Float b) { return { a.v / b.v }; }
+inline Float min(Float a, Float b) { return { a.v < b.v ? a.v : b.v }; }
+inline Float max(Float a, Float b) { return { a.v > b.v ? a.v : b.v }; }
+inline Float mul_add(Float a, Float b, Float c) { return { a.v * b.v + c.v }; }
+inline Mask greater_equal(Float a, Float b) { return { a.v >= b.v }; }
+inline Mask less_equal(Float a, Float b) { return { a.v <= b.v }; }
+inline Mask mask_and(Mask a, Mask b) { return { a.v && b.v }; }
+inline Mask mask_or(Mask a, Mask b) { return { a.v || b.v }; }
+inline uint32_t bits(Mask m) { return m.v ? 1u : 0u; }
+inline Float select(Mask m, Float a, Float b) { return m.v ? a : b; }
+
+#endif
+
+constexpr uint32_t ALL_LANES = (1u << WIDTH) - 1;
+
+}
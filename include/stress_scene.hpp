@@ -0,0 +1,58 @@
+#pragma once
+
+#include "transform.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace chch {
+
+struct StressSceneInfo {
+	uint32_t objects = 2000;
+	uint32_t meshes = 8;
+	uint32_t materials = 8;
+	// share of the objects that move every frame, the rest stay put
+	float dynamic_fraction = 0.25f;
+	// objects are scattered through a cube this wide around the origin
+	float extent = 100.0f;
+	uint32_t seed = 1;
+};
+
+// An indexed triangle list
+struct StressMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> uvs;
+	std::vector<uint32_t> indices;
+};
+
+struct StressObject {
+	Transform transform;
+	uint32_t mesh = 0;
+	uint32_t material = 0;
+	bool dynamic = false;
+	// dynamic objects spin about this, in radians per second
+	glm::vec3 spin_axis = glm::vec3(0.0f, 1.0f, 0.0f);
+	float spin_speed = 0.0f;
+};
+
+struct StressScene {
+	std::vector<StressMesh> meshes;
+	std::vector<StressObject> objects;
+};
+
+// The same info always gives the same scene. Mesh i is a sphere finer than
+// mesh i - 1, so the meshes differ in vertex load as well.
+StressScene generate_stress_scene(const StressSceneInfo& info);
+
+// Unit radius, rings and segments are clamped to at least 2 and 3
+StressMesh make_sphere_mesh(uint32_t rings, uint32_t segments);
+
+// Where a dynamic object is seconds into the run, static ones never move
+Transform animate(const StressObject& object, float seconds);
+
+// The scripted camera, one orbit around the origin over frame_count frames,
+// bobbing up and down and always looking at the middle of the scene
+Transform camera_path(uint32_t frame, uint32_t frame_count, float radius);
+
+}
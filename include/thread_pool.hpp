@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chch {
+
+struct ThreadPool {
+	// 0 threads means everything runs on the calling thread
+	void init(uint32_t thread_count = std::thread::hardware_concurrency());
+	void deinit();
+
+	uint32_t size() const { return static_cast<uint32_t>(m_threads.size()); }
+
+	template <typename F>
+	auto submit(F&& job) -> std::future<decltype(job())>
+	{
+		using Result = decltype(job());
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+		auto future = task->get_future();
+		if (m_threads.empty()) {
+			(*task)();
+			return future;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.emplace_back([task]() { (*task)(); });
+		}
+		m_condition.notify_one();
+		return future;
+	}
+
+	// Splits [0, count) into chunks of at least grain items. The calling thread
+	// works through any chunks the workers haven't claimed, so this is safe to
+	// call from a job, and it never runs other submitted jobs while it waits.
+	void parallel_for(
+			size_t count,
+			size_t grain,
+			const std::function<void(size_t begin, size_t end)>& body);
+
+private:
+	void worker();
+
+	std::vector<std::thread> m_threads;
+	std::deque<std::function<void()>> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stop = false;
+};
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "transform.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace chch {
+
+// Parent/child transforms with the local parts kept as structure of arrays.
+// Nodes are stored sorted by depth, so update() can walk one level at a time
+// and build a full register of world matrices at once, every parent already
+// being final. Only nodes whose local transform changed, or whose parent's
+// world matrix changed, are recomputed.
+//
+// World matrices compose the same way as Transform::matrix(), a root's world
+// matrix is exactly its local Transform's.
+struct TransformHierarchy {
+	using Handle = uint32_t;
+	static constexpr Handle NONE = UINT32_MAX;
+
+	Handle add(const Transform& local, Handle parent = NONE);
+	// Children are left behind as roots, keeping their local transform.
+	// Linear in the node count.
+	void remove(Handle node);
+	// Throws when the node would end up its own ancestor
+	void set_parent(Handle node, Handle parent);
+	void clear();
+
+	void set_local(Handle node, const Transform& local);
+	Transform local(Handle node) const;
+	Handle parent(Handle node) const { return m_parent[node]; }
+	bool alive(Handle node) const { return node < m_slot.size() && m_slot[node] != NONE; }
+
+	// Recomputes what changed since the last call
+	void update();
+	// As of the last update
+	const glm::mat4& world(Handle node) const { return m_world[node]; }
+	// Nodes whose world matrix changed in the last update
+	const std::vector<Handle>& updated() const { return m_updated; }
+	bool changed(Handle node) const { return m_changed[node]; }
+
+	size_t size() const { return m_count; }
+
+private:
+	// one slot per node in depth order, padded by a register so the last
+	// block can be loaded whole
+	struct Locals {
+		std::vector<float> position_x, position_y, position_z;
+		std::vector<float> rotation_x, rotation_y, rotation_z, rotation_w;
+		std::vector<float> scale_x, scale_y, scale_z;
+
+		void resize(size_t count);
+	};
+
+	uint32_t push_slot(Handle node, const Transform& local);
+	void set_slot(uint32_t slot, const Transform& local);
+	// sorts the slots by depth after nodes were added, removed or reparented
+	void rebuild();
+	void update_block(uint32_t begin, uint32_t count, bool root);
+
+	Locals m_locals;
+	std::vector<Handle> m_slot_node;
+	std::vector<Handle> m_slot_parent;
+	std::vector<uint8_t> m_dirty;
+	// where each level's slots start, with the end as the last entry
+	std::vector<uint32_t> m_levels;
+
+	std::vector<uint32_t> m_slot;
+	std::vector<Handle> m_parent;
+	std::vector<glm::mat4> m_world;
+	std::vector<uint8_t> m_changed;
+	std::vector<Handle> m_free;
+	std::vector<Handle> m_updated;
+	size_t m_count = 0;
+	bool m_topology_dirty = false;
+};
+
+}
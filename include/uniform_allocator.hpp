@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include "buffer.hpp"
+#include "frame_data.hpp"
+#include "linear_allocator.hpp"
+
+namespace chch {
+
+struct Context;
+
+// Per-draw uniform data. Each frame in flight owns one persistently mapped
+// buffer that is handed out front to back, aligned for dynamic offsets, and
+// rewound at the start of the frame. All draws share one UNIFORM_BUFFER_DYNAMIC
+// descriptor set per frame and only differ in the offset they bind it with.
+struct UniformAllocator {
+	// capacity per frame, max_range is the largest struct a shader may read
+	void init(const Context* context, VkDeviceSize capacity, uint32_t max_range = 256);
+	void deinit(const Context* context);
+
+	// Once the frame's fence has been waited on, everything pushed for it before is gone
+	void begin_frame(uint32_t frame);
+
+	// Copies the data in and returns the dynamic offset to bind it with, throws when the frame is full
+	uint32_t push(const void* data, size_t size);
+	template <typename T>
+	uint32_t push(const T& value) { return push(&value, sizeof(T)); }
+
+	// The same for every frame
+	VkDescriptorSetLayout layout() const { return m_set_layout; }
+	VkDescriptorSet descriptor_set() const { return m_frames[m_frame].descriptor_set; }
+	size_t used() const { return m_allocator.used(); }
+
+private:
+	struct FrameBuffer {
+		Buffer buffer;
+		void* data;
+		VkDescriptorSet descriptor_set;
+	};
+
+	per_frame<FrameBuffer> m_frames;
+	LinearAllocator m_allocator;
+	VkDeviceSize m_capacity = 0;
+	VkDeviceSize m_alignment = 1;
+	uint32_t m_max_range = 0;
+	uint32_t m_frame = 0;
+
+	VkDescriptorSetLayout m_set_layout = VK_NULL_HANDLE;
+};
+
+}
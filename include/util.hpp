@@ -10,13 +10,10 @@
 
 #include "context.hpp"
 #include "frame_data.hpp"
+#include "root.hpp"
 
 namespace chch {
 
-struct Root {
-	static const std::filesystem::path& path;
-};
-
 inline std::vector<char> read_file(const char* filename) {
 	std::ifstream file((Root::path / filename).string(), std::ios::ate | std::ios::binary);
 	if (!file.is_open())
@@ -157,6 +154,22 @@ inline VkFormat find_supported_format(
 	throw std::runtime_error("failed to find supported format");
 }
 
+// features are needed on top of being a depth attachment, like
+// VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT when a pass reads the depth buffer
+inline VkFormat find_depth_format(const Context* context, VkFormatFeatureFlags features = 0)
+{
+	return find_supported_format(
+		context,
+		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | features);
+}
+
+inline bool has_stencil_component(VkFormat format)
+{
+	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
 inline void generate_mipmaps(
 	const Context* context,
 	VkImage image,
@@ -253,29 +266,4 @@ inline void generate_mipmaps(
 	});
 }
 
-inline VkDescriptorPool make_descriptor_pool(const VkDevice& device, uint32_t image_count, uint32_t uniform_count)
-{
-	image_count = std::max((uint32_t)1, image_count);
-	uniform_count = std::max((uint32_t)1, uniform_count);
-
-	VkDescriptorPool descriptor_pool;
-
-	std::array<VkDescriptorPoolSize, 2> pool_sizes {};
-	pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	pool_sizes[0].descriptorCount = static_cast<uint32_t>(image_count * MAX_FRAMES_IN_FLIGHT);
-	pool_sizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	pool_sizes[1].descriptorCount = static_cast<uint32_t>(uniform_count * MAX_FRAMES_IN_FLIGHT);
-
-	VkDescriptorPoolCreateInfo pool_info {};
-	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
-	pool_info.pPoolSizes = pool_sizes.data();
-	pool_info.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-
-	if (vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS)
-		throw std::runtime_error("failed to create descriptor pool");
-
-	return descriptor_pool;
-}
-
 }
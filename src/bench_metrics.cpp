@@ -0,0 +1,161 @@
+#include "bench_metrics.hpp"
+#include "profile_stats.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace chch {
+
+void BenchMetrics::set(const std::string& name, double value)
+{
+	for (auto& [n, v] : values) {
+		if (n == name) {
+			v = value;
+			return;
+		}
+	}
+	values.emplace_back(name, value);
+}
+
+const double* BenchMetrics::find(const std::string& name) const
+{
+	for (const auto& [n, v] : values) {
+		if (n == name)
+			return &v;
+	}
+	return nullptr;
+}
+
+std::string BenchMetrics::to_json() const
+{
+	std::ostringstream out;
+	out << std::setprecision(std::numeric_limits<double>::max_digits10);
+	out << "{";
+	for (size_t i = 0; i < values.size(); ++i)
+		out << (i ? ",\n\t" : "\n\t") << json_string(values[i].first) << ": " << values[i].second;
+	out << "\n}\n";
+	return out.str();
+}
+
+bool BenchMetrics::parse_json(const std::string& json, BenchMetrics& metrics)
+{
+	const char* p = json.c_str();
+	auto skip_space = [&p]() {
+		while (std::isspace(static_cast<unsigned char>(*p)))
+			++p;
+	};
+	auto parse_string = [&p](std::string& out) {
+		if (*p != '"')
+			return false;
+		for (++p; *p != '"'; ++p) {
+			if (*p == '\0')
+				return false;
+			if (*p == '\\') {
+				++p;
+				switch (*p) {
+				case 'n':
+					out += '\n';
+					break;
+				case 't':
+					out += '\t';
+					break;
+				case '"':
+				case '\\':
+				case '/':
+					out += *p;
+					break;
+				default:
+					// \uXXXX and friends never show up in metric names
+					return false;
+				}
+			} else {
+				out += *p;
+			}
+		}
+		++p;
+		return true;
+	};
+
+	BenchMetrics parsed;
+	skip_space();
+	if (*p++ != '{')
+		return false;
+	skip_space();
+	if (*p == '}') {
+		++p;
+	} else {
+		while (true) {
+			std::string name;
+			skip_space();
+			if (!parse_string(name))
+				return false;
+			skip_space();
+			if (*p++ != ':')
+				return false;
+			skip_space();
+			char* end = nullptr;
+			double value = std::strtod(p, &end);
+			if (end == p)
+				return false;
+			p = end;
+			parsed.set(name, value);
+
+			skip_space();
+			if (*p == ',') {
+				++p;
+				continue;
+			}
+			if (*p++ != '}')
+				return false;
+			break;
+		}
+	}
+	skip_space();
+	if (*p != '\0')
+		return false;
+
+	metrics = std::move(parsed);
+	return true;
+}
+
+bool BenchMetrics::save(const std::filesystem::path& path) const
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file)
+		return false;
+	file << to_json();
+	return static_cast<bool>(file);
+}
+
+bool BenchMetrics::load(const std::filesystem::path& path)
+{
+	std::ifstream file(path);
+	if (!file)
+		return false;
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return parse_json(contents.str(), *this);
+}
+
+std::vector<BenchRegression> find_regressions(
+	const BenchMetrics& current,
+	const BenchMetrics& baseline,
+	double threshold)
+{
+	std::vector<BenchRegression> regressions;
+	for (const auto& [name, value] : current.values) {
+		const double* base = baseline.find(name);
+		if (!base)
+			continue;
+		double change = *base != 0.0 ? (value - *base) / *base : value;
+		if (change > threshold)
+			regressions.push_back({ name, *base, value, change });
+	}
+	return regressions;
+}
+
+}
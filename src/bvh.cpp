@@ -0,0 +1,734 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace chch {
+
+// bins per axis for the top down build
+static const int SAH_BINS = 16;
+
+int32_t Bvh::insert(const AABB& box, uint32_t user_data)
+{
+	int32_t proxy = allocate_node();
+	auto& node = m_nodes[proxy];
+	node.box = box;
+	node.user_data = user_data;
+	node.height = 0;
+	insert_leaf(proxy);
+	++m_proxy_count;
+	m_dirty = true;
+	return proxy;
+}
+
+void Bvh::remove(int32_t proxy)
+{
+	remove_leaf(proxy);
+	free_node(proxy);
+	--m_proxy_count;
+	m_dirty = true;
+}
+
+bool Bvh::move(int32_t proxy, const AABB& box)
+{
+	const AABB& stored = m_nodes[proxy].box;
+	AABB loose = box;
+	loose.min -= glm::vec3(4.0f * margin);
+	loose.max += glm::vec3(4.0f * margin);
+	// also reinsert boxes that shrank a lot, a huge stale box would be hit by everything
+	if (stored.contains(box) && loose.contains(stored))
+		return false;
+
+	remove_leaf(proxy);
+	m_nodes[proxy].box = { box.min - glm::vec3(margin), box.max + glm::vec3(margin) };
+	insert_leaf(proxy);
+	m_dirty = true;
+	return true;
+}
+
+void Bvh::set_box(int32_t proxy, const AABB& box)
+{
+	m_nodes[proxy].box = box;
+	m_dirty = true;
+}
+
+void Bvh::refit()
+{
+	if (m_root == NULL_NODE)
+		return;
+
+	// reversed pre-order visits every child before its parent
+	std::vector<int32_t> order, stack = { m_root };
+	while (!stack.empty()) {
+		int32_t index = stack.back();
+		stack.pop_back();
+		const auto& node = m_nodes[index];
+		if (node.is_leaf())
+			continue;
+		order.push_back(index);
+		stack.push_back(node.child[0]);
+		stack.push_back(node.child[1]);
+	}
+
+	for (auto it = order.rbegin(); it != order.rend(); ++it) {
+		auto& node = m_nodes[*it];
+		const auto& a = m_nodes[node.child[0]];
+		const auto& b = m_nodes[node.child[1]];
+		node.box = a.box;
+		node.box.grow(b.box);
+		node.height = 1 + std::max(a.height, b.height);
+		rotate(*it);
+	}
+	m_dirty = true;
+}
+
+void Bvh::build()
+{
+	std::vector<int32_t> leaves;
+	leaves.reserve(m_proxy_count);
+	for (int32_t i = 0; i < static_cast<int32_t>(m_nodes.size()); ++i) {
+		if (m_nodes[i].height == 0)
+			leaves.push_back(i);
+		else if (m_nodes[i].height > 0)
+			free_node(i);
+	}
+
+	m_root = leaves.empty() ? NULL_NODE : build_range(leaves.data(), leaves.size());
+	if (m_root != NULL_NODE)
+		m_nodes[m_root].parent = NULL_NODE;
+	m_dirty = true;
+}
+
+void Bvh::clear()
+{
+	m_nodes.clear();
+	m_root = NULL_NODE;
+	m_free = NULL_NODE;
+	m_proxy_count = 0;
+	m_dirty = true;
+}
+
+float Bvh::cost() const
+{
+	if (m_root == NULL_NODE)
+		return 0.0f;
+
+	float total = 0.0f;
+	for (const auto& node : m_nodes) {
+		if (node.height > 0)
+			total += node.box.surface_area();
+	}
+	float root = m_nodes[m_root].box.surface_area();
+	return root > 0.0f ? total / root : 0.0f;
+}
+
+bool Bvh::validate() const
+{
+	if (m_root == NULL_NODE)
+		return m_proxy_count == 0;
+	if (m_nodes[m_root].parent != NULL_NODE)
+		return false;
+
+	size_t leaves = 0, reachable = 0;
+	std::vector<int32_t> stack = { m_root };
+	while (!stack.empty()) {
+		int32_t index = stack.back();
+		stack.pop_back();
+		const auto& node = m_nodes[index];
+		++reachable;
+		if (node.is_leaf()) {
+			leaves += node.height == 0;
+			continue;
+		}
+
+		int32_t height = 0;
+		for (int32_t child : node.child) {
+			const auto& c = m_nodes[child];
+			if (c.parent != index || !node.box.contains(c.box))
+				return false;
+			height = std::max(height, c.height + 1);
+			stack.push_back(child);
+		}
+		if (height != node.height)
+			return false;
+	}
+
+	size_t free = 0;
+	for (int32_t index = m_free; index != NULL_NODE; index = m_nodes[index].parent)
+		++free;
+
+	return leaves == m_proxy_count && reachable + free == m_nodes.size();
+}
+
+int32_t Bvh::allocate_node()
+{
+	if (m_free == NULL_NODE) {
+		m_nodes.emplace_back();
+		return static_cast<int32_t>(m_nodes.size() - 1);
+	}
+
+	int32_t index = m_free;
+	m_free = m_nodes[index].parent;
+	m_nodes[index] = Node();
+	return index;
+}
+
+void Bvh::free_node(int32_t node)
+{
+	m_nodes[node].parent = m_free;
+	m_nodes[node].height = -1;
+	m_free = node;
+}
+
+void Bvh::insert_leaf(int32_t leaf)
+{
+	if (m_root == NULL_NODE) {
+		m_root = leaf;
+		m_nodes[leaf].parent = NULL_NODE;
+		return;
+	}
+
+	// Walk down to the cheapest sibling. Every node on the way grows to hold
+	// the leaf, that growth is paid for no matter where the leaf ends up.
+	const AABB box = m_nodes[leaf].box;
+	int32_t index = m_root;
+	while (!m_nodes[index].is_leaf()) {
+		const auto& node = m_nodes[index];
+		AABB combined = node.box;
+		combined.grow(box);
+		float area = node.box.surface_area();
+		float combined_area = combined.surface_area();
+
+		float here = 2.0f * combined_area;
+		float inherited = 2.0f * (combined_area - area);
+
+		float descend[2];
+		for (int i = 0; i < 2; ++i) {
+			const auto& child = m_nodes[node.child[i]];
+			AABB grown = child.box;
+			grown.grow(box);
+			descend[i] = grown.surface_area() + inherited;
+			if (!child.is_leaf())
+				descend[i] -= child.box.surface_area();
+		}
+
+		if (here < descend[0] && here < descend[1])
+			break;
+		index = node.child[descend[0] < descend[1] ? 0 : 1];
+	}
+
+	int32_t sibling = index;
+	int32_t old_parent = m_nodes[sibling].parent;
+	int32_t parent = allocate_node();
+	m_nodes[parent].box = m_nodes[sibling].box;
+	m_nodes[parent].box.grow(box);
+	m_nodes[parent].height = m_nodes[sibling].height + 1;
+
+	if (old_parent == NULL_NODE) {
+		m_root = parent;
+		m_nodes[parent].parent = NULL_NODE;
+	} else {
+		auto& p = m_nodes[old_parent];
+		set_child(old_parent, p.child[0] == sibling ? 0 : 1, parent);
+	}
+	set_child(parent, 0, sibling);
+	set_child(parent, 1, leaf);
+
+	update_parents(old_parent);
+}
+
+void Bvh::remove_leaf(int32_t leaf)
+{
+	if (leaf == m_root) {
+		m_root = NULL_NODE;
+		return;
+	}
+
+	int32_t parent = m_nodes[leaf].parent;
+	int32_t grand_parent = m_nodes[parent].parent;
+	const auto& p = m_nodes[parent];
+	int32_t sibling = p.child[0] == leaf ? p.child[1] : p.child[0];
+
+	if (grand_parent == NULL_NODE) {
+		m_root = sibling;
+		m_nodes[sibling].parent = NULL_NODE;
+	} else {
+		const auto& g = m_nodes[grand_parent];
+		set_child(grand_parent, g.child[0] == parent ? 0 : 1, sibling);
+	}
+	free_node(parent);
+	update_parents(grand_parent);
+}
+
+void Bvh::update_parents(int32_t index)
+{
+	while (index != NULL_NODE) {
+		auto& node = m_nodes[index];
+		const auto& a = m_nodes[node.child[0]];
+		const auto& b = m_nodes[node.child[1]];
+		node.box = a.box;
+		node.box.grow(b.box);
+		node.height = 1 + std::max(a.height, b.height);
+		rotate(index);
+		index = m_nodes[index].parent;
+	}
+}
+
+// Swaps a child with one of its nephews when that shrinks the box in between.
+// The node's own box stays the same, so nothing above has to be refit.
+void Bvh::rotate(int32_t index)
+{
+	const auto& node = m_nodes[index];
+	float best_gain = 0.0f;
+	int best_side = -1, best_slot = -1;
+
+	for (int side = 0; side < 2; ++side) {
+		const auto& outer = m_nodes[node.child[side]];
+		const auto& inner = m_nodes[node.child[1 - side]];
+		if (inner.is_leaf())
+			continue;
+
+		float area = inner.box.surface_area();
+		for (int slot = 0; slot < 2; ++slot) {
+			AABB swapped = outer.box;
+			swapped.grow(m_nodes[inner.child[1 - slot]].box);
+			float gain = area - swapped.surface_area();
+			if (gain > best_gain) {
+				best_gain = gain;
+				best_side = side;
+				best_slot = slot;
+			}
+		}
+	}
+
+	if (best_side < 0)
+		return;
+
+	int32_t outer = node.child[best_side];
+	int32_t inner = node.child[1 - best_side];
+	int32_t nephew = m_nodes[inner].child[best_slot];
+	set_child(index, best_side, nephew);
+	set_child(inner, best_slot, outer);
+
+	auto& in = m_nodes[inner];
+	in.box = m_nodes[in.child[0]].box;
+	in.box.grow(m_nodes[in.child[1]].box);
+	in.height = 1 + std::max(m_nodes[in.child[0]].height, m_nodes[in.child[1]].height);
+
+	auto& n = m_nodes[index];
+	n.height = 1 + std::max(m_nodes[n.child[0]].height, m_nodes[n.child[1]].height);
+}
+
+void Bvh::set_child(int32_t parent, int slot, int32_t child)
+{
+	m_nodes[parent].child[slot] = child;
+	m_nodes[child].parent = parent;
+}
+
+int32_t Bvh::build_range(int32_t* leaves, size_t count)
+{
+	if (count == 1)
+		return leaves[0];
+
+	AABB bounds, centers;
+	for (size_t i = 0; i < count; ++i) {
+		const auto& box = m_nodes[leaves[i]].box;
+		bounds.grow(box);
+		centers.grow(box.center());
+	}
+
+	glm::vec3 size = centers.max - centers.min;
+	int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+	size_t split = count / 2;
+
+	if (size[axis] > 0.0f) {
+		float scale = SAH_BINS / size[axis];
+		auto bin_of = [&](int32_t leaf) {
+			float c = m_nodes[leaf].box.center()[axis];
+			return std::min(SAH_BINS - 1, static_cast<int>((c - centers.min[axis]) * scale));
+		};
+
+		AABB bin_box[SAH_BINS];
+		size_t bin_count[SAH_BINS] = {};
+		for (size_t i = 0; i < count; ++i) {
+			int bin = bin_of(leaves[i]);
+			bin_box[bin].grow(m_nodes[leaves[i]].box);
+			++bin_count[bin];
+		}
+
+		// sweep from the right, then from the left, to cost every plane between bins
+		float right_cost[SAH_BINS];
+		AABB right;
+		size_t right_count = 0;
+		for (int i = SAH_BINS - 1; i > 0; --i) {
+			right.grow(bin_box[i]);
+			right_count += bin_count[i];
+			right_cost[i] = right_count ? right.surface_area() * right_count : 0.0f;
+		}
+
+		float best = std::numeric_limits<float>::max();
+		int best_bin = -1;
+		AABB left;
+		size_t left_count = 0;
+		for (int i = 1; i < SAH_BINS; ++i) {
+			left.grow(bin_box[i - 1]);
+			left_count += bin_count[i - 1];
+			if (left_count == 0 || left_count == count)
+				continue;
+			float cost = left.surface_area() * left_count + right_cost[i];
+			if (cost < best) {
+				best = cost;
+				best_bin = i;
+			}
+		}
+
+		if (best_bin > 0) {
+			auto middle = std::partition(leaves, leaves + count, [&](int32_t leaf) {
+				return bin_of(leaf) < best_bin;
+			});
+			split = static_cast<size_t>(middle - leaves);
+		}
+	}
+
+	// every center in one spot, any split is as good as another
+	if (split == 0 || split == count)
+		split = count / 2;
+
+	int32_t left_child = build_range(leaves, split);
+	int32_t right_child = build_range(leaves + split, count - split);
+
+	int32_t index = allocate_node();
+	set_child(index, 0, left_child);
+	set_child(index, 1, right_child);
+	auto& node = m_nodes[index];
+	node.box = bounds;
+	node.height = 1 + std::max(m_nodes[left_child].height, m_nodes[right_child].height);
+	return index;
+}
+
+void Bvh::flatten() const
+{
+	if (!m_dirty)
+		return;
+	m_dirty = false;
+	m_wide.clear();
+	if (m_root == NULL_NODE)
+		return;
+
+	std::vector<std::pair<int32_t, size_t>> stack = { { m_root, 0 } };
+	m_wide.emplace_back();
+
+	while (!stack.empty()) {
+		auto [index, wide] = stack.back();
+		stack.pop_back();
+
+		// open up the largest inner child until the node is full
+		int32_t slots[WIDE];
+		size_t count = 0;
+		if (m_nodes[index].is_leaf()) {
+			slots[count++] = index;
+		} else {
+			slots[count++] = m_nodes[index].child[0];
+			slots[count++] = m_nodes[index].child[1];
+		}
+		while (count < WIDE) {
+			int largest = -1;
+			float largest_area = -1.0f;
+			for (size_t i = 0; i < count; ++i) {
+				const auto& node = m_nodes[slots[i]];
+				if (!node.is_leaf() && node.box.surface_area() > largest_area) {
+					largest_area = node.box.surface_area();
+					largest = static_cast<int>(i);
+				}
+			}
+			if (largest < 0)
+				break;
+			const auto& node = m_nodes[slots[largest]];
+			slots[largest] = node.child[0];
+			slots[count++] = node.child[1];
+		}
+
+		for (size_t i = 0; i < WIDE; ++i) {
+			int32_t child = EMPTY;
+			AABB box;
+			if (i < count) {
+				const auto& node = m_nodes[slots[i]];
+				box = node.box;
+				if (node.is_leaf()) {
+					child = ~slots[i];
+				} else {
+					child = static_cast<int32_t>(m_wide.size());
+					m_wide.emplace_back();
+					stack.push_back({ slots[i], m_wide.size() - 1 });
+				}
+			}
+
+			auto& w = m_wide[wide];
+			w.min_x[i] = box.min.x;
+			w.min_y[i] = box.min.y;
+			w.min_z[i] = box.min.z;
+			w.max_x[i] = box.max.x;
+			w.max_y[i] = box.max.y;
+			w.max_z[i] = box.max.z;
+			w.child[i] = child;
+		}
+	}
+}
+
+void Bvh::collect(int32_t wide, std::vector<uint32_t>& result) const
+{
+	std::vector<int32_t> stack = { wide };
+	while (!stack.empty()) {
+		const auto& w = m_wide[stack.back()];
+		stack.pop_back();
+		for (size_t i = 0; i < WIDE; ++i) {
+			int32_t child = w.child[i];
+			if (child == EMPTY)
+				continue;
+			if (child >= 0)
+				stack.push_back(child);
+			else
+				result.push_back(m_nodes[~child].user_data);
+		}
+	}
+}
+
+void Bvh::query(const Frustum& frustum, std::vector<uint32_t>& result) const
+{
+	using namespace simd;
+
+	flatten();
+	if (m_wide.empty())
+		return;
+
+	const Float half = splat(0.5f);
+	const Float zero = splat(0.0f);
+
+	std::vector<int32_t> stack = { 0 };
+	while (!stack.empty()) {
+		const auto& w = m_wide[stack.back()];
+		stack.pop_back();
+
+		for (size_t base = 0; base < WIDE; base += WIDTH) {
+			Float min_x = load(w.min_x + base), max_x = load(w.max_x + base);
+			Float min_y = load(w.min_y + base), max_y = load(w.max_y + base);
+			Float min_z = load(w.min_z + base), max_z = load(w.max_z + base);
+			Float cx = mul(add(min_x, max_x), half), ex = mul(sub(max_x, min_x), half);
+			Float cy = mul(add(min_y, max_y), half), ey = mul(sub(max_y, min_y), half);
+			Float cz = mul(add(min_z, max_z), half), ez = mul(sub(max_z, min_z), half);
+
+			Mask visible = greater_equal(zero, zero);
+			Mask inside = visible;
+			for (const auto& plane : frustum.planes) {
+				Float d = mul_add(splat(plane.x), cx,
+					mul_add(splat(plane.y), cy,
+						mul_add(splat(plane.z), cz, splat(plane.w))));
+				Float reach = mul_add(splat(std::abs(plane.x)), ex,
+					mul_add(splat(std::abs(plane.y)), ey,
+						mul(splat(std::abs(plane.z)), ez)));
+				visible = mask_and(visible, greater_equal(add(d, reach), zero));
+				inside = mask_and(inside, greater_equal(sub(d, reach), zero));
+			}
+
+			uint32_t visible_bits = bits(visible);
+			uint32_t inside_bits = bits(inside);
+			for (size_t lane = 0; lane < WIDTH; ++lane) {
+				int32_t child = w.child[base + lane];
+				if (child == EMPTY || !(visible_bits & (1u << lane)))
+					continue;
+				if (child < 0)
+					result.push_back(m_nodes[~child].user_data);
+				else if (inside_bits & (1u << lane))
+					collect(child, result);
+				else
+					stack.push_back(child);
+			}
+		}
+	}
+}
+
+void Bvh::query(const AABB& box, std::vector<uint32_t>& result) const
+{
+	using namespace simd;
+
+	flatten();
+	if (m_wide.empty())
+		return;
+
+	const Float q_min_x = splat(box.min.x), q_max_x = splat(box.max.x);
+	const Float q_min_y = splat(box.min.y), q_max_y = splat(box.max.y);
+	const Float q_min_z = splat(box.min.z), q_max_z = splat(box.max.z);
+
+	std::vector<int32_t> stack = { 0 };
+	while (!stack.empty()) {
+		const auto& w = m_wide[stack.back()];
+		stack.pop_back();
+
+		for (size_t base = 0; base < WIDE; base += WIDTH) {
+			Mask overlap = mask_and(
+				mask_and(
+					less_equal(load(w.min_x + base), q_max_x),
+					greater_equal(load(w.max_x + base), q_min_x)),
+				mask_and(
+					mask_and(
+						less_equal(load(w.min_y + base), q_max_y),
+						greater_equal(load(w.max_y + base), q_min_y)),
+					mask_and(
+						less_equal(load(w.min_z + base), q_max_z),
+						greater_equal(load(w.max_z + base), q_min_z))));
+
+			uint32_t overlap_bits = bits(overlap);
+			for (size_t lane = 0; lane < WIDTH; ++lane) {
+				int32_t child = w.child[base + lane];
+				if (child == EMPTY || !(overlap_bits & (1u << lane)))
+					continue;
+				if (child < 0)
+					result.push_back(m_nodes[~child].user_data);
+				else
+					stack.push_back(child);
+			}
+		}
+	}
+}
+
+void Bvh::query(const Sphere& sphere, std::vector<uint32_t>& result) const
+{
+	using namespace simd;
+
+	flatten();
+	if (m_wide.empty())
+		return;
+
+	const Float cx = splat(sphere.center.x);
+	const Float cy = splat(sphere.center.y);
+	const Float cz = splat(sphere.center.z);
+	const Float radius_squared = splat(sphere.radius * sphere.radius);
+
+	std::vector<int32_t> stack = { 0 };
+	while (!stack.empty()) {
+		const auto& w = m_wide[stack.back()];
+		stack.pop_back();
+
+		for (size_t base = 0; base < WIDE; base += WIDTH) {
+			// offset from the center to the closest point of each box
+			Float dx = sub(cx, max(load(w.min_x + base), min(cx, load(w.max_x + base))));
+			Float dy = sub(cy, max(load(w.min_y + base), min(cy, load(w.max_y + base))));
+			Float dz = sub(cz, max(load(w.min_z + base), min(cz, load(w.max_z + base))));
+			Float distance_squared = mul_add(dx, dx, mul_add(dy, dy, mul(dz, dz)));
+
+			uint32_t overlap_bits = bits(less_equal(distance_squared, radius_squared));
+			for (size_t lane = 0; lane < WIDTH; ++lane) {
+				int32_t child = w.child[base + lane];
+				if (child == EMPTY || !(overlap_bits & (1u << lane)))
+					continue;
+				if (child < 0)
+					result.push_back(m_nodes[~child].user_data);
+				else
+					stack.push_back(child);
+			}
+		}
+	}
+}
+
+bool Bvh::ray_cast(
+	const Ray& ray,
+	float t_max,
+	uint32_t& user_data,
+	float& t,
+	const RayCallback& callback) const
+{
+	return traverse(ray, t_max, false, user_data, t, callback);
+}
+
+bool Bvh::ray_test(const Ray& ray, float t_max, const RayCallback& callback) const
+{
+	uint32_t user_data;
+	float t;
+	return traverse(ray, t_max, true, user_data, t, callback);
+}
+
+bool Bvh::traverse(
+	const Ray& ray,
+	float t_max,
+	bool any_hit,
+	uint32_t& user_data,
+	float& t,
+	const RayCallback& callback) const
+{
+	using namespace simd;
+
+	flatten();
+	if (m_wide.empty())
+		return false;
+
+	const glm::vec3 inverse = 1.0f / ray.direction;
+	const Float ox = splat(ray.origin.x), ix = splat(inverse.x);
+	const Float oy = splat(ray.origin.y), iy = splat(inverse.y);
+	const Float oz = splat(ray.origin.z), iz = splat(inverse.z);
+	const Float zero = splat(0.0f);
+
+	float closest = t_max;
+	bool hit = false;
+
+	struct Entry {
+		int32_t node;
+		float t;
+	};
+	std::vector<Entry> stack = { { 0, 0.0f } };
+	float enter[WIDE];
+
+	while (!stack.empty()) {
+		Entry entry = stack.back();
+		stack.pop_back();
+		// something nearer was hit since this node was pushed
+		if (entry.t > closest)
+			continue;
+		const auto& w = m_wide[entry.node];
+
+		Entry inner[WIDE];
+		size_t inner_count = 0;
+		const Float limit = splat(closest);
+		for (size_t base = 0; base < WIDE; base += WIDTH) {
+			Float x0 = mul(sub(load(w.min_x + base), ox), ix), x1 = mul(sub(load(w.max_x + base), ox), ix);
+			Float y0 = mul(sub(load(w.min_y + base), oy), iy), y1 = mul(sub(load(w.max_y + base), oy), iy);
+			Float z0 = mul(sub(load(w.min_z + base), oz), iz), z1 = mul(sub(load(w.max_z + base), oz), iz);
+			Float t_enter = max(max(min(x0, x1), min(y0, y1)), max(min(z0, z1), zero));
+			Float t_leave = min(min(max(x0, x1), max(y0, y1)), min(max(z0, z1), limit));
+			store(enter + base, t_enter);
+
+			uint32_t hit_bits = bits(less_equal(t_enter, t_leave));
+			for (size_t lane = 0; lane < WIDTH; ++lane) {
+				int32_t child = w.child[base + lane];
+				if (child == EMPTY || !(hit_bits & (1u << lane)))
+					continue;
+				if (child >= 0) {
+					inner[inner_count++] = { child, enter[base + lane] };
+					continue;
+				}
+
+				uint32_t data = m_nodes[~child].user_data;
+				float distance = callback ? callback(data, ray, closest) : enter[base + lane];
+				if (distance >= 0.0f && distance <= closest) {
+					closest = distance;
+					user_data = data;
+					hit = true;
+					if (any_hit) {
+						t = closest;
+						return true;
+					}
+				}
+			}
+		}
+
+		// farthest first so the nearest child is popped next
+		std::sort(inner, inner + inner_count, [](const Entry& a, const Entry& b) { return a.t > b.t; });
+		stack.insert(stack.end(), inner, inner + inner_count);
+	}
+
+	if (hit)
+		t = closest;
+	return hit;
+}
+
+}
@@ -1,10 +1,11 @@
 #include "context.hpp"
+#include "cpu_profiler.hpp"
+#include "pipeline_cache_file.hpp"
 
 #include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <limits>
-#include <map>
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -59,6 +60,7 @@ void DestroyDebugUtilsMessengerEXT(
 static void framebuffer_resize_callback(GLFWwindow* window, int width, int height)
 {
 	auto context = reinterpret_cast<Context*>(glfwGetWindowUserPointer(window));
+	context->window_resized = true;
 	// gonna have to reset capabilities
 	auto& capabilities = context->surface_capabilities;
 
@@ -74,8 +76,6 @@ static void framebuffer_resize_callback(GLFWwindow* window, int width, int heigh
 		static_cast<uint32_t>(height),
 		capabilities.minImageExtent.height,
 		capabilities.maxImageExtent.height);
-
-	context->window_resized = true;
 }
 
 VkDebugUtilsMessengerCreateInfoEXT make_debugger_create_info()
@@ -95,36 +95,64 @@ VkDebugUtilsMessengerCreateInfoEXT make_debugger_create_info()
 
 void Context::init(const ContextCreateInfo& create_info)
 {
+	PROFILE_ZONE("Context::init");
 	enable_validation_layers = create_info.enable_validation_layers;
 	validation_layers = create_info.validation_layers;
 	required_extensions = create_info.required_extensions;
 	preferred_extensions = create_info.preferred_extensions;
 	found_extensions.resize(required_extensions.size() + preferred_extensions.size());
 	allocation_callbacks = create_info.allocation_callbacks;
+	window_size = create_info.window_size;
+	headless = create_info.headless;
+	headless_image_count = std::max(1u, create_info.headless_image_count);
+
+	// nothing gets presented, so don't hold out for a device that can
+	if (headless) {
+		required_extensions.erase(
+			std::remove_if(required_extensions.begin(), required_extensions.end(), [](const char* ext) {
+				return strcmp(ext, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+			}),
+			required_extensions.end());
+	}
 
-	init_glfw(create_info);
+	if (!headless)
+		init_glfw(create_info);
 	init_instance(create_info);
 	init_debugger();
-	init_surface();
+	if (!headless)
+		init_surface();
 	init_physical_device();
 	init_logical_device();
 	init_queues();
 	init_allocator();
 	init_command_pool();
+	pipeline_cache_path = create_info.pipeline_cache_path;
+	init_pipeline_cache();
+	pipelines.init(this);
+	descriptor_layouts.init(this);
+	descriptor_allocator.init(this);
 }
 
 void Context::deinit()
 {
+	pipelines.deinit();
+	descriptor_allocator.deinit();
+	descriptor_layouts.deinit();
+	save_pipeline_cache();
+	vkDestroyPipelineCache(device, pipeline_cache, allocation_callbacks);
 	vkDestroyCommandPool(device, graphics_command_pool, allocation_callbacks);
 	vkDestroyCommandPool(device, transfer_command_pool, allocation_callbacks);
 	vmaDestroyAllocator(allocator);
 	vkDestroyDevice(device, allocation_callbacks);
-	vkDestroySurfaceKHR(instance, surface, allocation_callbacks);
+	if (surface != VK_NULL_HANDLE)
+		vkDestroySurfaceKHR(instance, surface, allocation_callbacks);
 	if (enable_validation_layers)
 		DestroyDebugUtilsMessengerEXT(instance, debug_messenger, allocation_callbacks);
 	vkDestroyInstance(instance, allocation_callbacks);
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	if (!headless) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 }
 
 uint32_t Context::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags property_flags) const
@@ -139,8 +167,34 @@ uint32_t Context::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags p
 	throw std::runtime_error("failed to find suitable memory type");
 }
 
+bool Context::update_surface_extent()
+{
+	if (headless)
+		return true;
+
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &surface_capabilities);
+	// some platforms leave the size up to the swap chain
+	auto& extent = surface_capabilities.currentExtent;
+	if (extent.width == std::numeric_limits<uint32_t>::max()) {
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(window, &width, &height);
+		extent.width = std::clamp(
+			static_cast<uint32_t>(width),
+			surface_capabilities.minImageExtent.width,
+			surface_capabilities.maxImageExtent.width);
+		extent.height = std::clamp(
+			static_cast<uint32_t>(height),
+			surface_capabilities.minImageExtent.height,
+			surface_capabilities.maxImageExtent.height);
+	}
+	return extent.width > 0 && extent.height > 0;
+}
+
 bool Context::window_hidden()
 {
+	if (headless)
+		return false;
+
 	int width = 0, height = 0;
 	glfwGetFramebufferSize(window, &width, &height);
 	return width == 0 || height == 0;
@@ -215,6 +269,28 @@ bool Context::supports_required_extensions()
 	return true;
 }
 
+void Context::populate_headless_info()
+{
+	if (!supports_required_extensions())
+		return;
+
+	// stands in for the surface so the renderer can size and format its
+	// images the same way either way
+	surface_capabilities = {};
+	surface_capabilities.minImageCount = headless_image_count;
+	surface_capabilities.maxImageCount = headless_image_count;
+	surface_capabilities.currentExtent = window_size;
+	surface_capabilities.minImageExtent = window_size;
+	surface_capabilities.maxImageExtent = window_size;
+	surface_capabilities.maxImageArrayLayers = 1;
+	surface_capabilities.currentTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+
+	surface_format = { VK_FORMAT_R8G8B8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+	supported_surface_formats = { surface_format };
+	present_mode = VK_PRESENT_MODE_FIFO_KHR;
+	supported_present_modes = { present_mode };
+}
+
 void Context::populate_surface_info()
 {
 	if (!supports_required_extensions())
@@ -279,6 +355,8 @@ void Context::populate_queue_family_indices()
 			&& !(queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
 			transfer_queue.index = i;
 
+		if (headless)
+			continue;
 		VkBool32 present_support = false;
 		vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &present_support);
 		if (present_support)
@@ -288,6 +366,12 @@ void Context::populate_queue_family_indices()
 	if (!transfer_queue.is_available())
 		transfer_queue.index = graphics_queue.index;
 
+	// frames stay on the graphics queue
+	if (headless) {
+		present_queue.index = graphics_queue.index;
+		return;
+	}
+
 	// prefer graphics and present queue being the same queue
 	VkBool32 present_support = false;
 	vkGetPhysicalDeviceSurfaceSupportKHR(
@@ -326,11 +410,25 @@ void Context::set_max_usable_sample_count()
 
 void Context::populate_all_info()
 {
-	populate_surface_info();
+	if (headless)
+		populate_headless_info();
+	else
+		populate_surface_info();
 	populate_queue_family_indices();
 	set_max_usable_sample_count();
 	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
 	vkGetPhysicalDeviceFeatures(physical_device, &device_features);
+
+	dynamic_rendering = false;
+	if (device_properties.apiVersion >= VK_API_VERSION_1_3) {
+		VkPhysicalDeviceVulkan13Features features_13 {};
+		features_13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+		VkPhysicalDeviceFeatures2 features {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &features_13;
+		vkGetPhysicalDeviceFeatures2(physical_device, &features);
+		dynamic_rendering = features_13.dynamicRendering == VK_TRUE;
+	}
 	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
 }
 
@@ -375,6 +473,7 @@ int Context::score_device()
 
 void Context::init_glfw(const ContextCreateInfo& create_info)
 {
+	PROFILE_ZONE("Context::init_glfw");
 	glfwInit();
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	window = glfwCreateWindow(
@@ -389,6 +488,7 @@ void Context::init_glfw(const ContextCreateInfo& create_info)
 
 void Context::init_instance(const ContextCreateInfo& create_info)
 {
+	PROFILE_ZONE("Context::init_instance");
 	// Validation layer support
 	if (enable_validation_layers) {
 		std::cout << "Requested Layers:\n";
@@ -416,15 +516,18 @@ void Context::init_instance(const ContextCreateInfo& create_info)
 	} // Validation Layer Support - End
 
 	// Extension support
-	uint32_t glfw_extension_count = 0;
-	const char** glfw_extensions;
-	glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+	std::vector<const char*> instance_extensions;
+	if (!headless) {
+		uint32_t glfw_extension_count = 0;
+		const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+		instance_extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
+	}
 	if (enable_validation_layers)
-		glfw_extensions[glfw_extension_count++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+		instance_extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
-	std::cout << "Requested GLFW Extensions:\n";
-	for (uint32_t i = 0; i < glfw_extension_count; ++i) {
-		std::cout << '\t' << glfw_extensions[i] << '\n';
+	std::cout << "Requested Instance Extensions:\n";
+	for (auto ext : instance_extensions) {
+		std::cout << '\t' << ext << '\n';
 	}
 	std::cout << '\n';
 
@@ -433,14 +536,14 @@ void Context::init_instance(const ContextCreateInfo& create_info)
 	std::vector<VkExtensionProperties> available_extensions(extension_count);
 	vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, available_extensions.data());
 
-	for (uint32_t i = 0; i < glfw_extension_count; ++i) {
+	for (auto ext : instance_extensions) {
 		bool extension_found = false;
 		for (const auto& e : available_extensions) {
-			extension_found = extension_found || (strcmp(e.extensionName, glfw_extensions[i]) == 0);
+			extension_found = extension_found || (strcmp(e.extensionName, ext) == 0);
 		}
 		if (!extension_found) {
-			std::string msg = "required glfw extension ";
-			msg += glfw_extensions[i];
+			std::string msg = "required instance extension ";
+			msg += ext;
 			msg += " not found";
 			throw std::runtime_error(msg);
 		}
@@ -459,8 +562,8 @@ void Context::init_instance(const ContextCreateInfo& create_info)
 	VkInstanceCreateInfo instance_create_info {};
 	instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instance_create_info.pApplicationInfo = &app_info;
-	instance_create_info.enabledExtensionCount = glfw_extension_count;
-	instance_create_info.ppEnabledExtensionNames = glfw_extensions;
+	instance_create_info.enabledExtensionCount = static_cast<uint32_t>(instance_extensions.size());
+	instance_create_info.ppEnabledExtensionNames = instance_extensions.data();
 
 	VkDebugUtilsMessengerCreateInfoEXT debugger_create_info {};
 	if (enable_validation_layers) {
@@ -480,6 +583,7 @@ void Context::init_instance(const ContextCreateInfo& create_info)
 
 void Context::init_debugger()
 {
+	PROFILE_ZONE("Context::init_debugger");
 	if (!enable_validation_layers) {
 		VkDebugUtilsMessengerCreateInfoEXT debugger_create_info = make_debugger_create_info();
 		if (CreateDebugUtilsMessengerEXT(
@@ -494,12 +598,14 @@ void Context::init_debugger()
 
 void Context::init_surface()
 {
+	PROFILE_ZONE("Context::init_surface");
 	if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
 		throw std::runtime_error("failed to create window surface");
 }
 
 void Context::init_physical_device()
 {
+	PROFILE_ZONE("Context::init_physical_device");
 	uint32_t device_count = 0;
 	vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
 	if (device_count == 0)
@@ -507,33 +613,44 @@ void Context::init_physical_device()
 
 	std::vector<VkPhysicalDevice> physical_devices(device_count);
 	vkEnumeratePhysicalDevices(instance, &device_count, physical_devices.data());
-	std::map<int, Context> candidates;
 
+	// Context can't be copied, only the winner's details are kept
+	int best_score = 0;
+	VkPhysicalDevice best_device = VK_NULL_HANDLE;
+	std::vector<const char*> best_extensions;
 	for (size_t i = 0; i < device_count; ++i) {
 		Context dev;
 		dev.physical_device = physical_devices[i];
 		dev.surface = surface;
+		dev.headless = headless;
+		dev.headless_image_count = headless_image_count;
+		dev.window_size = window_size;
 		dev.preferred_extensions = preferred_extensions;
 		dev.required_extensions = required_extensions;
 		dev.populate_all_info();
-		candidates[dev.score_device()] = dev;
+		int score = dev.score_device();
+		if (score >= best_score && score > 0) {
+			best_score = score;
+			best_device = dev.physical_device;
+			best_extensions = dev.found_extensions;
+		}
 	}
 
-	auto [best_score, best_device] = *candidates.rbegin();
 	if (best_score == 0)
 		throw std::runtime_error("failed to find suitable GPU");
 
-	physical_device = best_device.physical_device;
+	physical_device = best_device;
 	populate_all_info();
-	found_extensions = best_device.found_extensions;
+	found_extensions = best_extensions;
 	std::cout << "Requested Device Extensions:\n";
-	for (auto& ext : best_device.found_extensions)
+	for (auto& ext : found_extensions)
 		std::cout << '\t' << ext << '\n';
 	std::cout << '\n';
 }
 
 void Context::init_logical_device()
 {
+	PROFILE_ZONE("Context::init_logical_device");
 	std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
 	std::set<uint32_t> unique_queue_families = {
 		graphics_queue.index,
@@ -573,6 +690,12 @@ void Context::init_logical_device()
 	create_info.enabledExtensionCount = static_cast<uint32_t>(found_extensions.size());
 	create_info.ppEnabledExtensionNames = found_extensions.data();
 
+	VkPhysicalDeviceVulkan13Features features_13 {};
+	features_13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	features_13.dynamicRendering = VK_TRUE;
+	if (dynamic_rendering)
+		create_info.pNext = &features_13;
+
 	if (enable_validation_layers) {
 		create_info.enabledLayerCount = static_cast<uint32_t>(validation_layers.size());
 		create_info.ppEnabledLayerNames = validation_layers.data();
@@ -586,6 +709,7 @@ void Context::init_logical_device()
 
 void Context::init_queues()
 {
+	PROFILE_ZONE("Context::init_queues");
 	vkGetDeviceQueue(device, graphics_queue.index, 0, &graphics_queue.queue);
 	vkGetDeviceQueue(device, present_queue.index, 0, &present_queue.queue);
 	vkGetDeviceQueue(device, transfer_queue.index, 0, &transfer_queue.queue);
@@ -593,6 +717,7 @@ void Context::init_queues()
 
 void Context::init_allocator()
 {
+	PROFILE_ZONE("Context::init_allocator");
 	VmaAllocatorCreateInfo create_info {};
 	create_info.instance = instance;
 	create_info.device = device;
@@ -605,6 +730,7 @@ void Context::init_allocator()
 
 void Context::init_command_pool()
 {
+	PROFILE_ZONE("Context::init_command_pool");
 	VkCommandPoolCreateInfo pool_info {};
 	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
@@ -617,4 +743,49 @@ void Context::init_command_pool()
 		throw std::runtime_error("failed to create command pool");
 }
 
+void Context::init_pipeline_cache()
+{
+	PROFILE_ZONE("Context::init_pipeline_cache");
+	std::vector<char> data;
+	if (!pipeline_cache_path.empty()) {
+		PipelineCacheDevice cache_device { device_properties.vendorID, device_properties.deviceID, {} };
+		memcpy(cache_device.uuid.data(), device_properties.pipelineCacheUUID, VK_UUID_SIZE);
+		data = PipelineCacheFile::load(pipeline_cache_path, cache_device);
+	}
+	pipeline_cache_warm = !data.empty();
+
+	VkPipelineCacheCreateInfo cache_info {};
+	cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cache_info.initialDataSize = data.size();
+	cache_info.pInitialData = data.empty() ? nullptr : data.data();
+
+	auto result = vkCreatePipelineCache(device, &cache_info, allocation_callbacks, &pipeline_cache);
+	if (result != VK_SUCCESS && pipeline_cache_warm) {
+		// the driver turned the data down after all, start over empty
+		cache_info.initialDataSize = 0;
+		cache_info.pInitialData = nullptr;
+		pipeline_cache_warm = false;
+		result = vkCreatePipelineCache(device, &cache_info, allocation_callbacks, &pipeline_cache);
+	}
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("failed to create pipeline cache");
+}
+
+void Context::save_pipeline_cache()
+{
+	if (pipeline_cache_path.empty())
+		return;
+
+	size_t size = 0;
+	if (vkGetPipelineCacheData(device, pipeline_cache, &size, nullptr) != VK_SUCCESS)
+		return;
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(device, pipeline_cache, &size, data.data()) != VK_SUCCESS)
+		return;
+	data.resize(size);
+
+	if (!PipelineCacheFile::save(pipeline_cache_path, data))
+		std::cerr << "failed to save pipeline cache to " << pipeline_cache_path << std::endl;
+}
+
 }
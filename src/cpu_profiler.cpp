@@ -0,0 +1,222 @@
+#include "cpu_profiler.hpp"
+#include "profile_stats.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace chch {
+
+namespace {
+
+struct Zone {
+	const char* name;
+	uint64_t begin;
+	uint64_t end;
+};
+
+// written by its thread only, head is published after the zone is in place
+struct ThreadRing {
+	Zone zones[CpuProfiler::RING_SIZE];
+	std::atomic<uint64_t> head { 0 };
+	std::atomic<const char*> name { nullptr };
+	uint32_t id = 0;
+};
+
+// only taken when a thread records its first zone, and to read the rings
+struct Registry {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadRing>> rings;
+};
+
+struct Clock {
+	uint64_t ticks;
+	std::chrono::steady_clock::time_point time;
+};
+
+Registry& registry()
+{
+	static Registry r;
+	return r;
+}
+
+thread_local ThreadRing* t_ring = nullptr;
+thread_local const char* t_name = nullptr;
+
+ThreadRing* register_thread()
+{
+	auto ring = std::make_unique<ThreadRing>();
+	ring->name = t_name;
+
+	auto& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	ring->id = static_cast<uint32_t>(r.rings.size());
+	r.rings.push_back(std::move(ring));
+	return r.rings.back().get();
+}
+
+Clock sample()
+{
+	return { CpuProfiler::now(), std::chrono::steady_clock::now() };
+}
+
+const Clock s_origin = sample();
+
+double ticks_per_us()
+{
+	// too short a span and the TSC rate comes out rough
+	auto elapsed = [](const Clock& c) {
+		return std::chrono::duration<double, std::micro>(c.time - s_origin.time).count();
+	};
+	Clock c = sample();
+	while (elapsed(c) < 10000.0) {
+		std::this_thread::yield();
+		c = sample();
+	}
+	return static_cast<double>(c.ticks - s_origin.ticks) / elapsed(c);
+}
+
+double since_origin(uint64_t ticks, double per_us)
+{
+	// zones from static constructors can start before the origin
+	return static_cast<double>(static_cast<int64_t>(ticks - s_origin.ticks)) / per_us;
+}
+
+}
+
+uint64_t CpuProfiler::now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+#endif
+}
+
+double CpuProfiler::to_us(uint64_t ticks)
+{
+	return since_origin(ticks, ticks_per_us());
+}
+
+void CpuProfiler::record(const char* name, uint64_t begin, uint64_t end)
+{
+	ThreadRing* ring = t_ring;
+	if (!ring)
+		ring = t_ring = register_thread();
+
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+	ring->zones[head & (RING_SIZE - 1)] = { name, begin, end };
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::set_thread_name(const char* name)
+{
+	t_name = name;
+	if (t_ring)
+		t_ring->name.store(name, std::memory_order_relaxed);
+}
+
+std::vector<TraceEvent> CpuProfiler::collect()
+{
+	std::vector<TraceEvent> events;
+	std::vector<Zone> zones;
+	double per_us = ticks_per_us();
+
+	auto& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	for (auto& ring : r.rings) {
+		uint64_t head = ring->head.load(std::memory_order_acquire);
+		uint64_t first = head > RING_SIZE ? head - RING_SIZE : 0;
+		zones.clear();
+		for (uint64_t i = first; i < head; ++i)
+			zones.push_back(ring->zones[i & (RING_SIZE - 1)]);
+
+		// anything the thread has wrapped around onto since might be torn
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t after = ring->head.load(std::memory_order_relaxed);
+		for (uint64_t i = first; i < head; ++i) {
+			if (i + RING_SIZE <= after)
+				continue;
+			const Zone& z = zones[i - first];
+			events.push_back({
+				z.name,
+				since_origin(z.begin, per_us),
+				static_cast<double>(z.end - z.begin) / per_us,
+				ring->id });
+		}
+	}
+	return events;
+}
+
+void CpuProfiler::clear()
+{
+	auto& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	for (auto& ring : r.rings)
+		ring->head.store(0, std::memory_order_relaxed);
+}
+
+std::string CpuProfiler::chrome_trace(const std::vector<TraceEvent>& extra, const char* extra_thread)
+{
+	auto events = collect();
+
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	auto thread_name = [&](uint32_t tid, const std::string& name) {
+		out << (first ? "" : ",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+			<< ",\"args\":{\"name\":" << json_string(name) << "}}";
+		first = false;
+	};
+	auto zone = [&](const TraceEvent& e, uint32_t tid) {
+		out << (first ? "" : ",") << "{\"name\":" << json_string(e.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+			<< ",\"ts\":" << e.start_us << ",\"dur\":" << e.duration_us << "}";
+		first = false;
+	};
+
+	uint32_t extra_tid = 0;
+	{
+		auto& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		for (auto& ring : r.rings) {
+			const char* name = ring->name.load(std::memory_order_relaxed);
+			thread_name(ring->id, name ? name : "thread " + std::to_string(ring->id));
+		}
+		extra_tid = static_cast<uint32_t>(r.rings.size());
+	}
+	if (!extra.empty())
+		thread_name(extra_tid, extra_thread);
+
+	for (const auto& e : events)
+		zone(e, e.thread);
+	for (const auto& e : extra)
+		zone(e, extra_tid);
+	out << "]}";
+	return out.str();
+}
+
+bool CpuProfiler::write_chrome_trace(
+	const std::filesystem::path& path,
+	const std::vector<TraceEvent>& extra,
+	const char* extra_thread)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file)
+		return false;
+	file << chrome_trace(extra, extra_thread) << '\n';
+	return static_cast<bool>(file);
+}
+
+}
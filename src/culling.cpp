@@ -0,0 +1,152 @@
+#include "culling.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace chch {
+
+// four lane bits spread out to four 0/1 bytes, little endian
+static const uint32_t LANE_BYTES[16] = {
+	0x00000000, 0x00000001, 0x00000100, 0x00000101,
+	0x00010000, 0x00010001, 0x00010100, 0x00010101,
+	0x01000000, 0x01000001, 0x01000100, 0x01000101,
+	0x01010000, 0x01010001, 0x01010100, 0x01010101
+};
+
+bool FrustumCuller::is_visible(const Frustum& frustum, const Sphere& sphere) const
+{
+	const auto& c = sphere.center;
+	for (const auto& p : frustum.planes) {
+		if (p.x * c.x + (p.y * c.y + (p.z * c.z + p.w)) < -sphere.radius)
+			return false;
+	}
+
+	if (min_screen_size <= 0.0f)
+		return true;
+
+	const auto& w_row = frustum.w_row;
+	float w = w_row.x * c.x + (w_row.y * c.y + (w_row.z * c.z + w_row.w));
+	return sphere.radius * frustum.projection_scale >= min_screen_size * w
+		|| w <= sphere.radius;
+}
+
+size_t FrustumCuller::cull_scalar(
+	const Frustum& frustum,
+	const BoundingSpheres& spheres,
+	std::vector<uint8_t>& visibility) const
+{
+	visibility.resize(spheres.size());
+
+	size_t visible = 0;
+	for (size_t i = 0; i < spheres.size(); ++i) {
+		visibility[i] = is_visible(frustum, spheres.get(i));
+		visible += visibility[i];
+	}
+	return visible;
+}
+
+size_t FrustumCuller::cull(
+	const Frustum& frustum,
+	const BoundingSpheres& spheres,
+	std::vector<uint8_t>& visibility) const
+{
+	visibility.resize(spheres.size());
+
+	if (!thread_pool || spheres.size() <= batch_size)
+		return cull_range(frustum, spheres, 0, spheres.size(), visibility.data());
+
+	std::atomic<size_t> visible(0);
+	thread_pool->parallel_for(spheres.size(), batch_size,
+		[&](size_t begin, size_t end) {
+			visible += cull_range(frustum, spheres, begin, end, visibility.data());
+		});
+	return visible;
+}
+
+size_t FrustumCuller::cull_range(
+	const Frustum& frustum,
+	const BoundingSpheres& spheres,
+	size_t begin,
+	size_t end,
+	uint8_t* visibility) const
+{
+	using namespace simd;
+
+	Float plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+	for (size_t p = 0; p < 6; ++p) {
+		plane_x[p] = splat(frustum.planes[p].x);
+		plane_y[p] = splat(frustum.planes[p].y);
+		plane_z[p] = splat(frustum.planes[p].z);
+		plane_w[p] = splat(frustum.planes[p].w);
+	}
+
+	const bool test_size = min_screen_size > 0.0f;
+	const Float w_x = splat(frustum.w_row.x);
+	const Float w_y = splat(frustum.w_row.y);
+	const Float w_z = splat(frustum.w_row.z);
+	const Float w_w = splat(frustum.w_row.w);
+	const Float scale = splat(frustum.projection_scale);
+	const Float threshold = splat(min_screen_size);
+	const Float zero = splat(0.0f);
+
+	auto test_lanes = [&](size_t i) {
+		Float cx = load(&spheres.x[i]);
+		Float cy = load(&spheres.y[i]);
+		Float cz = load(&spheres.z[i]);
+		Float r = load(&spheres.radius[i]);
+		Float neg_r = sub(zero, r);
+
+		Mask inside = greater_equal(
+			mul_add(plane_x[0], cx, mul_add(plane_y[0], cy, mul_add(plane_z[0], cz, plane_w[0]))),
+			neg_r);
+		for (size_t p = 1; p < 6; ++p) {
+			Float distance = mul_add(plane_x[p], cx,
+				mul_add(plane_y[p], cy, mul_add(plane_z[p], cz, plane_w[p])));
+			inside = mask_and(inside, greater_equal(distance, neg_r));
+		}
+
+		if (test_size) {
+			Float w = mul_add(w_x, cx, mul_add(w_y, cy, mul_add(w_z, cz, w_w)));
+			Mask big_enough = mask_or(
+				greater_equal(mul(r, scale), mul(threshold, w)),
+				less_equal(w, r));
+			inside = mask_and(inside, big_enough);
+		}
+		return bits(inside);
+	};
+
+	auto write_lanes = [visibility](size_t i, uint32_t lanes) {
+		if constexpr (WIDTH >= 4) {
+			for (size_t lane = 0; lane < WIDTH; lane += 4)
+				memcpy(&visibility[i + lane], &LANE_BYTES[(lanes >> lane) & 0xfu], 4);
+		} else {
+			for (size_t lane = 0; lane < WIDTH; ++lane)
+				visibility[i + lane] = static_cast<uint8_t>((lanes >> lane) & 1u);
+		}
+		return static_cast<size_t>(__builtin_popcount(lanes));
+	};
+
+	size_t visible = 0;
+	size_t i = begin;
+
+	// two registers per iteration keeps both compare chains in flight
+	for (; i + 2 * WIDTH <= end; i += 2 * WIDTH) {
+		uint32_t a = test_lanes(i);
+		uint32_t b = test_lanes(i + WIDTH);
+		visible += write_lanes(i, a);
+		visible += write_lanes(i + WIDTH, b);
+	}
+	for (; i + WIDTH <= end; i += WIDTH)
+		visible += write_lanes(i, test_lanes(i));
+
+	for (; i < end; ++i) {
+		visibility[i] = is_visible(frustum, spheres.get(i));
+		visible += visibility[i];
+	}
+	return visible;
+}
+
+}
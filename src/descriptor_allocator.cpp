@@ -0,0 +1,177 @@
+#include "descriptor_allocator.hpp"
+#include "context.hpp"
+#include "util.hpp"
+
+#include <array>
+#include <vulkan/vulkan_core.h>
+
+namespace chch {
+
+void DescriptorLayoutCache::init(const Context* context)
+{
+	m_context = context;
+}
+
+void DescriptorLayoutCache::deinit()
+{
+	for (auto& [key, l] : m_layouts) {
+		if (l.update_template != VK_NULL_HANDLE)
+			vkDestroyDescriptorUpdateTemplate(m_context->device, l.update_template, m_context->allocation_callbacks);
+		vkDestroyDescriptorSetLayout(m_context->device, l.layout, m_context->allocation_callbacks);
+	}
+	m_layouts.clear();
+}
+
+const DescriptorLayoutCache::Layout& DescriptorLayoutCache::get(
+	const VkDescriptorSetLayoutBinding* bindings,
+	uint32_t count)
+{
+	DescriptorLayoutKey key;
+	for (uint32_t i = 0; i < count; ++i)
+		key.add(bindings[i].binding, bindings[i].descriptorType, bindings[i].descriptorCount, bindings[i].stageFlags);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_layouts.find(key);
+	if (it != m_layouts.end())
+		return it->second;
+
+	Layout l;
+	VkDescriptorSetLayoutCreateInfo layout_info {};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.bindingCount = count;
+	layout_info.pBindings = bindings;
+
+	auto result = vkCreateDescriptorSetLayout(
+		m_context->device,
+		&layout_info,
+		m_context->allocation_callbacks,
+		&l.layout);
+	vk_check(result, "Failed to create descriptor set layout");
+
+	// a template needs at least one entry, empty sets have nothing to update
+	if (count == 0)
+		return m_layouts.emplace(std::move(key), l).first->second;
+
+	// the key is sorted, so the template reads descriptors in binding order
+	std::vector<VkDescriptorUpdateTemplateEntry> entries;
+	size_t offset = 0;
+	for (auto& b : key.bindings) {
+		VkDescriptorUpdateTemplateEntry entry {};
+		entry.dstBinding = b.binding;
+		entry.dstArrayElement = 0;
+		entry.descriptorCount = b.count;
+		entry.descriptorType = static_cast<VkDescriptorType>(b.type);
+		entry.offset = offset;
+		entry.stride = sizeof(DescriptorInfo);
+		entries.push_back(entry);
+		offset += b.count * sizeof(DescriptorInfo);
+	}
+
+	VkDescriptorUpdateTemplateCreateInfo template_info {};
+	template_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+	template_info.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+	template_info.pDescriptorUpdateEntries = entries.data();
+	template_info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+	template_info.descriptorSetLayout = l.layout;
+
+	result = vkCreateDescriptorUpdateTemplate(
+		m_context->device,
+		&template_info,
+		m_context->allocation_callbacks,
+		&l.update_template);
+	vk_check(result, "Failed to create descriptor update template");
+
+	return m_layouts.emplace(std::move(key), l).first->second;
+}
+
+void DescriptorAllocator::init(const Context* context, uint32_t sets_per_pool)
+{
+	m_context = context;
+	m_sets_per_pool = sets_per_pool;
+}
+
+void DescriptorAllocator::deinit()
+{
+	for (auto pool : m_used)
+		vkDestroyDescriptorPool(m_context->device, pool, m_context->allocation_callbacks);
+	for (auto pool : m_free)
+		vkDestroyDescriptorPool(m_context->device, pool, m_context->allocation_callbacks);
+	m_used.clear();
+	m_free.clear();
+	m_current = VK_NULL_HANDLE;
+}
+
+VkResult DescriptorAllocator::allocate(VkDescriptorSetLayout layout, VkDescriptorSet* set)
+{
+	if (m_current == VK_NULL_HANDLE)
+		m_current = grab_pool();
+
+	VkDescriptorSetAllocateInfo alloc_info {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = m_current;
+	alloc_info.descriptorSetCount = 1;
+	alloc_info.pSetLayouts = &layout;
+
+	auto result = vkAllocateDescriptorSets(m_context->device, &alloc_info, set);
+	if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+		return result;
+
+	// the set didn't fit, a fresh pool always has room for one
+	m_current = grab_pool();
+	alloc_info.descriptorPool = m_current;
+	return vkAllocateDescriptorSets(m_context->device, &alloc_info, set);
+}
+
+void DescriptorAllocator::reset()
+{
+	for (auto pool : m_used) {
+		vkResetDescriptorPool(m_context->device, pool, 0);
+		m_free.push_back(pool);
+	}
+	m_used.clear();
+	m_current = VK_NULL_HANDLE;
+}
+
+VkDescriptorPool DescriptorAllocator::grab_pool()
+{
+	if (!m_free.empty()) {
+		auto pool = m_free.back();
+		m_free.pop_back();
+		m_used.push_back(pool);
+		return pool;
+	}
+
+	// descriptors of each type per set, roughly what the engine's sets declare
+	const std::array<std::pair<VkDescriptorType, float>, 5> ratios { {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+	} };
+
+	std::array<VkDescriptorPoolSize, ratios.size()> pool_sizes {};
+	for (size_t i = 0; i < ratios.size(); ++i) {
+		pool_sizes[i].type = ratios[i].first;
+		pool_sizes[i].descriptorCount = static_cast<uint32_t>(ratios[i].second * m_sets_per_pool);
+	}
+
+	VkDescriptorPoolCreateInfo pool_info {};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+	pool_info.pPoolSizes = pool_sizes.data();
+	pool_info.maxSets = m_sets_per_pool;
+
+	VkDescriptorPool pool;
+	auto result = vkCreateDescriptorPool(
+		m_context->device,
+		&pool_info,
+		m_context->allocation_callbacks,
+		&pool);
+	vk_check(result, "Failed to create descriptor pool");
+
+	m_used.push_back(pool);
+	return pool;
+}
+
+}
@@ -2,47 +2,35 @@
 #include "texture.hpp"
 #include "uniform.hpp"
 
+#include <algorithm>
+#include <numeric>
+
 namespace chch {
 
 VkResult DescriptorBuilder::build(VkDescriptorSetLayout* layout, VkDescriptorSet* set)
 {
-	VkDescriptorSetLayoutCreateInfo layout_info {};
-	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layout_info.bindingCount = static_cast<uint32_t>(m_bindings.size());
-	layout_info.pBindings = m_bindings.data();
-
-	auto result = vkCreateDescriptorSetLayout(
-		m_context->device,
-		&layout_info,
-		m_context->allocation_callbacks,
-		layout);
-
-	if (result != VK_SUCCESS)
-		return result;
-
-	VkDescriptorSetAllocateInfo alloc_info;
-	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	alloc_info.descriptorPool = m_pool;
-	alloc_info.descriptorSetCount = 1;
-	alloc_info.pSetLayouts = layout;
-	alloc_info.pNext = nullptr;
+	auto& cached = m_context->descriptor_layouts.get(
+		m_bindings.data(),
+		static_cast<uint32_t>(m_bindings.size()));
+	*layout = cached.layout;
 
-	result = vkAllocateDescriptorSets(m_context->device, &alloc_info, set);
-	if (result != VK_SUCCESS)
+	auto result = m_allocator->allocate(cached.layout, set);
+	if (result != VK_SUCCESS || m_bindings.empty())
 		return result;
 
-	for (auto& w : m_writes) {
-		w.dstSet = *set;
-		w.pNext = nullptr;
-	}
+	// the update template reads the descriptors in binding order
+	std::vector<uint32_t> order(m_bindings.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+		return m_bindings[a].binding < m_bindings[b].binding;
+	});
 
-	vkUpdateDescriptorSets(
-		m_context->device,
-		static_cast<uint32_t>(m_writes.size()),
-		m_writes.data(),
-		0,
-		nullptr);
+	std::vector<DescriptorInfo> data;
+	data.reserve(m_info.size());
+	for (auto i : order)
+		data.push_back(m_info[i]);
 
+	vkUpdateDescriptorSetWithTemplate(m_context->device, *set, cached.update_template, data.data());
 	return result;
 }
 
@@ -50,59 +38,72 @@ DescriptorBuilder DescriptorBuilder::bind_uniform(
 		uint32_t binding,
 		UniformBuffer* uniform)
 {
-	VkDescriptorSetLayoutBinding layout_binding {};
-	layout_binding.binding = binding;
-	layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	layout_binding.descriptorCount = 1;
-	layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-	layout_binding.pImmutableSamplers = nullptr;
-	m_bindings.push_back(layout_binding);
-
 	VkDescriptorBufferInfo info {};
-	info.buffer = uniform->buffer.buffer,
+	info.buffer = uniform->buffer.buffer;
 	info.offset = 0;
 	info.range = uniform->ubo_size;
-	m_buffer_info.push_back(info);
 
-	VkWriteDescriptorSet layout_write;
-	layout_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	layout_write.dstBinding = binding;
-	layout_write.dstArrayElement = 0;
-	layout_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	layout_write.descriptorCount = 1;
-	layout_write.pBufferInfo = &m_buffer_info.back();
-	m_writes.push_back(layout_write);
-
-	return *this;
+	return bind_buffer(
+		binding,
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		info,
+		VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
 }
 
 DescriptorBuilder DescriptorBuilder::bind_texture(
 		uint32_t binding,
 		Texture* texture)
+{
+	VkDescriptorImageInfo info {};
+	info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	info.imageView = texture->image.image_view;
+	info.sampler = texture->sampler;
+
+	return bind_image(
+		binding,
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		info,
+		VK_SHADER_STAGE_FRAGMENT_BIT);
+}
+
+DescriptorBuilder DescriptorBuilder::bind_buffer(
+		uint32_t binding,
+		VkDescriptorType type,
+		VkDescriptorBufferInfo info,
+		VkShaderStageFlags stages)
 {
 	VkDescriptorSetLayoutBinding layout_binding {};
 	layout_binding.binding = binding;
-	layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	layout_binding.descriptorType = type;
 	layout_binding.descriptorCount = 1;
-	layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	layout_binding.stageFlags = stages;
 	layout_binding.pImmutableSamplers = nullptr;
 	m_bindings.push_back(layout_binding);
 
-	VkDescriptorImageInfo info {};
-	info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	info.imageView = texture->image.image_view;
-	info.sampler = texture->sampler;
-	m_image_info.push_back(info);
+	DescriptorInfo descriptor {};
+	descriptor.buffer = info;
+	m_info.push_back(descriptor);
 
-	VkWriteDescriptorSet layout_write;
-	layout_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	layout_write.dstBinding = binding;
-	layout_write.dstArrayElement = 0;
-	layout_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	layout_write.descriptorCount = 1;
-	layout_write.pImageInfo = &m_image_info.back();
+	return *this;
+}
+
+DescriptorBuilder DescriptorBuilder::bind_image(
+		uint32_t binding,
+		VkDescriptorType type,
+		VkDescriptorImageInfo info,
+		VkShaderStageFlags stages)
+{
+	VkDescriptorSetLayoutBinding layout_binding {};
+	layout_binding.binding = binding;
+	layout_binding.descriptorType = type;
+	layout_binding.descriptorCount = 1;
+	layout_binding.stageFlags = stages;
+	layout_binding.pImmutableSamplers = nullptr;
+	m_bindings.push_back(layout_binding);
 
-	m_writes.push_back(layout_write);
+	DescriptorInfo descriptor {};
+	descriptor.image = info;
+	m_info.push_back(descriptor);
 
 	return *this;
 }
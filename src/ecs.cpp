@@ -0,0 +1,206 @@
+#include "ecs.hpp"
+
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+namespace chch {
+
+struct ComponentInfo {
+	size_t size;
+	size_t alignment;
+};
+
+static std::mutex component_mutex;
+static std::vector<ComponentInfo> components;
+
+static ComponentInfo component_info(uint32_t id)
+{
+	std::lock_guard<std::mutex> lock(component_mutex);
+	return components[id];
+}
+
+uint32_t register_component(size_t size, size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(component_mutex);
+	if (components.size() == MAX_COMPONENTS)
+		throw std::runtime_error("too many component types");
+	components.push_back({ size, alignment });
+	return static_cast<uint32_t>(components.size() - 1);
+}
+
+template <typename F>
+static void for_each_bit(ComponentMask mask, F&& f)
+{
+	for (; mask; mask &= mask - 1)
+		f(static_cast<uint32_t>(__builtin_ctzll(mask)));
+}
+
+void World::destroy(Entity entity)
+{
+	const Record& r = record(entity);
+	remove_row(r.archetype, r.chunk, r.row);
+
+	auto& dead = m_records[entity.index];
+	dead.alive = false;
+	++dead.generation;
+	m_free.push_back(entity.index);
+	--m_alive;
+}
+
+bool World::alive(Entity entity) const
+{
+	return entity.index < m_records.size()
+		&& m_records[entity.index].alive
+		&& m_records[entity.index].generation == entity.generation;
+}
+
+void World::clear()
+{
+	m_archetypes.clear();
+	m_archetype_lookup.clear();
+	m_records.clear();
+	m_free.clear();
+	m_alive = 0;
+}
+
+size_t World::chunk_count() const
+{
+	size_t count = 0;
+	for (const auto& archetype : m_archetypes)
+		count += archetype.chunks.size();
+	return count;
+}
+
+Entity World::allocate_entity(ComponentMask mask)
+{
+	uint32_t index;
+	if (m_free.empty()) {
+		index = static_cast<uint32_t>(m_records.size());
+		m_records.emplace_back();
+	} else {
+		index = m_free.back();
+		m_free.pop_back();
+	}
+
+	Entity entity { index, m_records[index].generation };
+	uint32_t archetype = find_archetype(mask);
+	uint32_t chunk, row;
+	allocate_row(archetype, chunk, row);
+	entities(archetype, chunk)[row] = entity;
+
+	auto& r = m_records[index];
+	r.archetype = archetype;
+	r.chunk = chunk;
+	r.row = row;
+	r.alive = true;
+	++m_alive;
+	return entity;
+}
+
+uint32_t World::find_archetype(ComponentMask mask)
+{
+	auto it = m_archetype_lookup.find(mask);
+	if (it != m_archetype_lookup.end())
+		return it->second;
+
+	size_t row_size = sizeof(Entity);
+	for_each_bit(mask, [&row_size](uint32_t id) { row_size += component_info(id).size; });
+
+	// the first guess ignores alignment padding, back off until everything fits
+	Archetype archetype;
+	archetype.mask = mask;
+	for (size_t capacity = CHUNK_SIZE / row_size; capacity > 0; --capacity) {
+		size_t end = sizeof(Entity) * capacity;
+		for_each_bit(mask, [&](uint32_t id) {
+			auto info = component_info(id);
+			end = (end + info.alignment - 1) / info.alignment * info.alignment;
+			archetype.offset[id] = static_cast<uint32_t>(end);
+			end += info.size * capacity;
+		});
+		if (end <= CHUNK_SIZE) {
+			archetype.capacity = static_cast<uint32_t>(capacity);
+			break;
+		}
+	}
+	if (archetype.capacity == 0)
+		throw std::runtime_error("components don't fit in a single chunk");
+
+	m_archetypes.push_back(std::move(archetype));
+	uint32_t index = static_cast<uint32_t>(m_archetypes.size() - 1);
+	m_archetype_lookup[mask] = index;
+	return index;
+}
+
+void World::allocate_row(uint32_t archetype, uint32_t& chunk, uint32_t& row)
+{
+	auto& a = m_archetypes[archetype];
+	if (a.chunks.empty() || a.chunks.back().count == a.capacity) {
+		Chunk fresh;
+		fresh.data = std::make_unique<ChunkData>();
+		a.chunks.push_back(std::move(fresh));
+	}
+
+	chunk = static_cast<uint32_t>(a.chunks.size() - 1);
+	row = a.chunks.back().count++;
+}
+
+void World::remove_row(uint32_t archetype, uint32_t chunk, uint32_t row)
+{
+	auto& a = m_archetypes[archetype];
+	uint32_t last_chunk = static_cast<uint32_t>(a.chunks.size() - 1);
+	uint32_t last_row = a.chunks[last_chunk].count - 1;
+
+	if (chunk != last_chunk || row != last_row) {
+		Entity moved = entities(archetype, last_chunk)[last_row];
+		entities(archetype, chunk)[row] = moved;
+		uint8_t* to = a.chunks[chunk].data->bytes;
+		const uint8_t* from = a.chunks[last_chunk].data->bytes;
+		for_each_bit(a.mask, [&](uint32_t id) {
+			size_t size = component_info(id).size;
+			memcpy(to + a.offset[id] + row * size, from + a.offset[id] + last_row * size, size);
+		});
+
+		auto& r = m_records[moved.index];
+		r.chunk = chunk;
+		r.row = row;
+	}
+
+	if (--a.chunks[last_chunk].count == 0)
+		a.chunks.pop_back();
+}
+
+void World::change_archetype(Entity entity, ComponentMask mask)
+{
+	Record old = record(entity);
+	uint32_t archetype = find_archetype(mask);
+	uint32_t chunk, row;
+	allocate_row(archetype, chunk, row);
+	entities(archetype, chunk)[row] = entity;
+
+	Record fresh = old;
+	fresh.archetype = archetype;
+	fresh.chunk = chunk;
+	fresh.row = row;
+	for_each_bit(m_archetypes[old.archetype].mask & mask, [&](uint32_t id) {
+		memcpy(component(fresh, id), component(old, id), component_info(id).size);
+	});
+
+	remove_row(old.archetype, old.chunk, old.row);
+	m_records[entity.index] = fresh;
+}
+
+const World::Record& World::record(Entity entity) const
+{
+	if (!alive(entity))
+		throw std::runtime_error("entity is no longer alive");
+	return m_records[entity.index];
+}
+
+void* World::component(const Record& record, uint32_t id)
+{
+	const auto& a = m_archetypes[record.archetype];
+	return a.chunks[record.chunk].data->bytes + a.offset[id] + record.row * component_info(id).size;
+}
+
+}
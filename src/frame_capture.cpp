@@ -0,0 +1,118 @@
+#include "frame_capture.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace chch {
+
+size_t yuv420_size(uint32_t width, uint32_t height)
+{
+	size_t chroma = static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+	return static_cast<size_t>(width) * height + 2 * chroma;
+}
+
+void rgba_to_yuv420(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra, uint8_t* planes)
+{
+	const int r_at = bgra ? 2 : 0;
+	const int b_at = bgra ? 0 : 2;
+	const uint32_t chroma_width = (width + 1) / 2;
+	const uint32_t chroma_height = (height + 1) / 2;
+	uint8_t* y_plane = planes;
+	uint8_t* u_plane = y_plane + static_cast<size_t>(width) * height;
+	uint8_t* v_plane = u_plane + static_cast<size_t>(chroma_width) * chroma_height;
+
+	for (uint32_t y = 0; y < height; ++y) {
+		const uint8_t* row = pixels + static_cast<size_t>(y) * width * 4;
+		uint8_t* out = y_plane + static_cast<size_t>(y) * width;
+		for (uint32_t x = 0; x < width; ++x) {
+			int r = row[x * 4 + r_at], g = row[x * 4 + 1], b = row[x * 4 + b_at];
+			out[x] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		}
+	}
+
+	// edge blocks of odd sized frames reuse their last row or column
+	for (uint32_t cy = 0; cy < chroma_height; ++cy) {
+		const uint8_t* row0 = pixels + static_cast<size_t>(cy * 2) * width * 4;
+		const uint8_t* row1 = pixels + static_cast<size_t>(std::min(cy * 2 + 1, height - 1)) * width * 4;
+		for (uint32_t cx = 0; cx < chroma_width; ++cx) {
+			uint32_t x0 = cx * 2 * 4;
+			uint32_t x1 = std::min(cx * 2 + 1, width - 1) * 4;
+			int r = row0[x0 + r_at] + row0[x1 + r_at] + row1[x0 + r_at] + row1[x1 + r_at];
+			int g = row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1];
+			int b = row0[x0 + b_at] + row0[x1 + b_at] + row1[x0 + b_at] + row1[x1 + b_at];
+
+			// the sums are four times the average, folded into the shift
+			size_t i = static_cast<size_t>(cy) * chroma_width + cx;
+			u_plane[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+			v_plane[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+		}
+	}
+}
+
+FrameCapture::Format FrameCapture::format_for(const std::filesystem::path& path)
+{
+	return path.extension() == ".y4m" ? Y4M : RAW;
+}
+
+void FrameCapture::open(
+	const std::filesystem::path& path,
+	Format format,
+	uint32_t width,
+	uint32_t height,
+	uint32_t fps,
+	bool bgra)
+{
+	close();
+	m_file.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_file.is_open())
+		throw std::runtime_error("failed to open capture file " + path.string());
+
+	m_format = format;
+	m_width = width;
+	m_height = height;
+	m_bgra = bgra;
+	m_frames_written = 0;
+
+	if (m_format == Y4M) {
+		m_file << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C420jpeg\n";
+		m_scratch.resize(yuv420_size(width, height));
+	} else if (m_bgra) {
+		m_scratch.resize(static_cast<size_t>(width) * height * 4);
+	}
+}
+
+void FrameCapture::write(const uint8_t* pixels)
+{
+	if (!m_file.is_open())
+		throw std::runtime_error("capture file isn't open");
+
+	size_t size = static_cast<size_t>(m_width) * m_height * 4;
+	if (m_format == Y4M) {
+		rgba_to_yuv420(pixels, m_width, m_height, m_bgra, m_scratch.data());
+		m_file << "FRAME\n";
+		m_file.write(reinterpret_cast<const char*>(m_scratch.data()), m_scratch.size());
+	} else if (m_bgra) {
+		for (size_t i = 0; i < size; i += 4) {
+			m_scratch[i + 0] = pixels[i + 2];
+			m_scratch[i + 1] = pixels[i + 1];
+			m_scratch[i + 2] = pixels[i + 0];
+			m_scratch[i + 3] = pixels[i + 3];
+		}
+		m_file.write(reinterpret_cast<const char*>(m_scratch.data()), size);
+	} else {
+		m_file.write(reinterpret_cast<const char*>(pixels), size);
+	}
+
+	if (!m_file)
+		throw std::runtime_error("failed to write capture frame");
+	++m_frames_written;
+}
+
+void FrameCapture::close()
+{
+	if (m_file.is_open())
+		m_file.close();
+}
+
+}
@@ -9,6 +9,7 @@ namespace chch {
 void FrameData::init(const Context* context)
 {
 	init_command_buffer(context);
+	init_descriptors(context);
 	init_sync_objects(context);
 }
 
@@ -18,6 +19,7 @@ void FrameData::deinit(const Context* context)
 	vkDestroySemaphore(context->device, render_finished_semaphore, context->allocation_callbacks);
 	vkDestroyFence(context->device, in_flight_fence, context->allocation_callbacks);
 	vkDestroyCommandPool(context->device, command_pool, context->allocation_callbacks);
+	descriptors.deinit();
 }
 
 void FrameData::init_command_buffer(const Context* context)
@@ -38,6 +40,11 @@ void FrameData::init_command_buffer(const Context* context)
 	vk_check(vkAllocateCommandBuffers(context->device, &alloc_info, &command_buffer));
 }
 
+void FrameData::init_descriptors(const Context* context)
+{
+	descriptors.init(context);
+}
+
 void FrameData::init_sync_objects(const Context* context)
 {
 	VkSemaphoreCreateInfo semaphore_info {};
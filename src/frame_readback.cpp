@@ -0,0 +1,165 @@
+#include "frame_readback.hpp"
+#include "context.hpp"
+#include "util.hpp"
+
+#include <utility>
+#include <vulkan/vulkan_core.h>
+
+namespace chch {
+
+static uint32_t depth_texel_size(VkFormat format)
+{
+	// packed D24 comes out in 32 bits
+	switch (format) {
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+void FrameReadback::init(
+	const Context* context,
+	VkExtent2D extent,
+	VkFormat color_format,
+	VkFormat depth_format)
+{
+	m_context = context;
+	m_extent = extent;
+	m_color_format = color_format;
+	m_depth_format = depth_format;
+	m_depth_texel_size = depth_texel_size(depth_format);
+
+	VkDeviceSize texels = static_cast<VkDeviceSize>(extent.width) * extent.height;
+	for (auto& slot : m_slots) {
+		void* data;
+		slot.color.init(
+			context,
+			texels * 4,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			VMA_MEMORY_USAGE_GPU_TO_CPU);
+		vmaMapMemory(context->allocator, slot.color.allocation, &data);
+		slot.color_data = static_cast<uint8_t*>(data);
+
+		if (!reads_depth())
+			continue;
+		slot.depth.init(
+			context,
+			texels * m_depth_texel_size,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			VMA_MEMORY_USAGE_GPU_TO_CPU);
+		vmaMapMemory(context->allocator, slot.depth.allocation, &data);
+		slot.depth_data = static_cast<uint8_t*>(data);
+	}
+}
+
+void FrameReadback::deinit(const Context* context)
+{
+	if (m_context == nullptr)
+		return;
+	m_context = nullptr;
+
+	for (auto& slot : m_slots) {
+		slot.callback = nullptr;
+		vmaUnmapMemory(context->allocator, slot.color.allocation);
+		slot.color.deinit(context);
+		if (slot.depth_data) {
+			vmaUnmapMemory(context->allocator, slot.depth.allocation);
+			slot.depth.deinit(context);
+			slot.depth_data = nullptr;
+		}
+	}
+}
+
+void FrameReadback::record(
+	VkCommandBuffer command_buffer,
+	uint32_t frame,
+	uint64_t number,
+	VkImage color,
+	VkImage depth,
+	Callback callback)
+{
+	auto& slot = m_slots[frame];
+	slot.number = number;
+	slot.callback = std::move(callback);
+	bool with_depth = reads_depth() && depth != VK_NULL_HANDLE;
+
+	VkBufferImageCopy region {};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = { m_extent.width, m_extent.height, 1 };
+	vkCmdCopyImageToBuffer(
+		command_buffer,
+		color,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		slot.color.buffer,
+		1,
+		&region);
+
+	if (with_depth) {
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		vkCmdCopyImageToBuffer(
+			command_buffer,
+			depth,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			slot.depth.buffer,
+			1,
+			&region);
+	}
+
+	VkMemoryBarrier host_barrier {};
+	host_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT,
+		0,
+		1, &host_barrier,
+		0, nullptr,
+		0, nullptr);
+}
+
+void FrameReadback::complete(uint32_t frame)
+{
+	auto& slot = m_slots[frame];
+	if (!slot.callback)
+		return;
+
+	// GPU_TO_CPU memory isn't always coherent
+	vmaInvalidateAllocation(m_context->allocator, slot.color.allocation, 0, VK_WHOLE_SIZE);
+	if (slot.depth_data)
+		vmaInvalidateAllocation(m_context->allocator, slot.depth.allocation, 0, VK_WHOLE_SIZE);
+
+	ReadbackFrame result {
+		slot.number,
+		m_extent.width,
+		m_extent.height,
+		m_color_format,
+		slot.color_data,
+		m_depth_format,
+		slot.depth_data
+	};
+	// taken out first, the callback may well ask for another frame
+	auto callback = std::move(slot.callback);
+	slot.callback = nullptr;
+	callback(result);
+}
+
+void FrameReadback::complete_all()
+{
+	// oldest first, frame slots are used in turn
+	uint32_t first = 0;
+	for (uint32_t i = 1; i < m_slots.size(); ++i) {
+		if (m_slots[i].callback && (!m_slots[first].callback || m_slots[i].number < m_slots[first].number))
+			first = i;
+	}
+	for (uint32_t i = 0; i < m_slots.size(); ++i)
+		complete((first + i) % m_slots.size());
+}
+
+}
@@ -0,0 +1,180 @@
+#include "gpu_profiler.hpp"
+#include "context.hpp"
+#include "util.hpp"
+
+#include <utility>
+#include <vulkan/vulkan_core.h>
+
+namespace chch {
+
+GpuProfiler::Scope::Scope(Scope&& other) noexcept
+	: m_profiler(other.m_profiler), m_command_buffer(other.m_command_buffer), m_region(other.m_region)
+{
+	other.m_profiler = nullptr;
+}
+
+GpuProfiler::Scope::~Scope()
+{
+	if (m_profiler)
+		m_profiler->end(m_command_buffer, m_region);
+}
+
+void GpuProfiler::init(const Context* context, size_t window)
+{
+	m_context = context;
+	m_stats = ProfileStats(window);
+	m_results.resize(MAX_REGIONS * 2);
+
+	// the debug utils extension is only turned on along with validation
+	if (context->enable_validation_layers) {
+		m_begin_label = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(
+			context->instance,
+			"vkCmdBeginDebugUtilsLabelEXT");
+		m_end_label = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(
+			context->instance,
+			"vkCmdEndDebugUtilsLabelEXT");
+		if (!m_begin_label || !m_end_label) {
+			m_begin_label = nullptr;
+			m_end_label = nullptr;
+		}
+	}
+
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(context->physical_device, &family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(context->physical_device, &family_count, families.data());
+
+	uint32_t valid_bits = families[context->graphics_queue.index].timestampValidBits;
+	if (valid_bits == 0 || context->device_properties.limits.timestampPeriod <= 0.0f)
+		return;
+	m_timestamp_period = context->device_properties.limits.timestampPeriod;
+	m_timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+	VkQueryPoolCreateInfo create_info {};
+	create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	create_info.queryCount = MAX_REGIONS * 2;
+	for (auto& f : m_frames) {
+		auto result = vkCreateQueryPool(context->device, &create_info, context->allocation_callbacks, &f.pool);
+		vk_check(result, "Failed to create timestamp query pool");
+	}
+}
+
+void GpuProfiler::deinit(const Context* context)
+{
+	for (auto& f : m_frames) {
+		if (f.pool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(context->device, f.pool, context->allocation_callbacks);
+		f.pool = VK_NULL_HANDLE;
+		f.regions.clear();
+	}
+	m_timestamp_period = 0.0;
+	m_begin_label = nullptr;
+	m_end_label = nullptr;
+	m_context = nullptr;
+}
+
+void GpuProfiler::begin_frame(VkCommandBuffer command_buffer, uint32_t frame)
+{
+	m_frame = frame;
+	m_depth = 0;
+
+	auto& f = m_frames[frame];
+	if (f.pool == VK_NULL_HANDLE)
+		return;
+	collect(f);
+	f.regions.clear();
+	f.submit_ticks = 0;
+	vkCmdResetQueryPool(command_buffer, f.pool, 0, MAX_REGIONS * 2);
+}
+
+void GpuProfiler::collect(FrameQueries& f)
+{
+	if (f.regions.empty())
+		return;
+
+	// not ready only if the frame never made it to the queue
+	uint32_t count = static_cast<uint32_t>(f.regions.size()) * 2;
+	auto result = vkGetQueryPoolResults(
+		m_context->device,
+		f.pool,
+		0,
+		count,
+		count * sizeof(uint64_t),
+		m_results.data(),
+		sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+		return;
+
+	auto to_ms = [this](uint64_t from, uint64_t to) {
+		return ((to - from) & m_timestamp_mask) * m_timestamp_period / 1e6;
+	};
+
+	m_last_frame.clear();
+	uint64_t origin = m_results[0];
+	for (size_t i = 0; i < f.regions.size(); ++i) {
+		m_last_frame.push_back({
+			f.regions[i].name,
+			to_ms(origin, m_results[i * 2]),
+			to_ms(m_results[i * 2], m_results[i * 2 + 1]),
+			f.regions[i].depth });
+	}
+
+	// one sample per name and frame
+	for (size_t i = 0; i < m_last_frame.size(); ++i) {
+		bool seen = false;
+		for (size_t j = 0; j < i && !seen; ++j)
+			seen = m_last_frame[j].name == m_last_frame[i].name;
+		if (seen)
+			continue;
+
+		double total = m_last_frame[i].duration_ms;
+		for (size_t j = i + 1; j < m_last_frame.size(); ++j) {
+			if (m_last_frame[j].name == m_last_frame[i].name)
+				total += m_last_frame[j].duration_ms;
+		}
+		m_stats.add(m_last_frame[i].name, total);
+	}
+
+	// the GPU clock can't be read from here, so the frame starts when it
+	// was submitted, which is as early as it could have
+	if (trace_capacity == 0 || f.submit_ticks == 0)
+		return;
+	double submit_us = CpuProfiler::to_us(f.submit_ticks);
+	for (const auto& t : m_last_frame)
+		m_trace.push_back({ t.name, submit_us + t.start_ms * 1000.0, t.duration_ms * 1000.0, 0 });
+	while (m_trace.size() > trace_capacity)
+		m_trace.pop_front();
+}
+
+uint32_t GpuProfiler::begin(VkCommandBuffer command_buffer, const char* name)
+{
+	if (m_begin_label) {
+		VkDebugUtilsLabelEXT label {};
+		label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+		label.pLabelName = name;
+		m_begin_label(command_buffer, &label);
+	}
+
+	auto& f = m_frames[m_frame];
+	if (f.pool == VK_NULL_HANDLE || f.regions.size() >= MAX_REGIONS)
+		return NONE;
+
+	uint32_t region = static_cast<uint32_t>(f.regions.size());
+	f.regions.push_back({ name, m_depth++ });
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, f.pool, region * 2);
+	return region;
+}
+
+void GpuProfiler::end(VkCommandBuffer command_buffer, uint32_t region)
+{
+	if (region != NONE) {
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_frames[m_frame].pool, region * 2 + 1);
+		--m_depth;
+	}
+	if (m_end_label)
+		m_end_label(command_buffer);
+}
+
+}
@@ -0,0 +1,174 @@
+#include "gpu_scene.hpp"
+#include "context.hpp"
+#include "util.hpp"
+
+#include "descriptor_builder.hpp"
+#include "pipeline_builder.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+namespace chch {
+
+struct ScatterParams {
+	uint32_t count;
+};
+
+void GpuScene::init(const Context* context, uint32_t capacity)
+{
+	m_context = context;
+	m_records.init(capacity);
+
+	init_buffers(context);
+	init_descriptors(context);
+	init_pipeline(context);
+}
+
+void GpuScene::deinit(const Context* context)
+{
+	if (m_scatter_pipeline == VK_NULL_HANDLE)
+		return;
+
+	context->pipelines.release(m_scatter_pipeline);
+	m_scatter_pipeline = VK_NULL_HANDLE;
+
+	for (auto& f : m_frames) {
+		vmaUnmapMemory(context->allocator, f.records.allocation);
+		vmaUnmapMemory(context->allocator, f.indices.allocation);
+		f.records.deinit(context);
+		f.indices.deinit(context);
+	}
+	m_objects.deinit(context);
+}
+
+void GpuScene::init_buffers(const Context* context)
+{
+	m_objects.init(
+		context,
+		size(),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY);
+
+	// a frame can at most change every record once
+	for (auto& f : m_frames) {
+		f.records.init(
+			context,
+			size(),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU);
+		f.indices.init(
+			context,
+			m_records.capacity() * sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+		void* data;
+		vmaMapMemory(context->allocator, f.records.allocation, &data);
+		f.record_data = static_cast<GpuObject*>(data);
+		vmaMapMemory(context->allocator, f.indices.allocation, &data);
+		f.index_data = static_cast<uint32_t*>(data);
+	}
+}
+
+void GpuScene::init_descriptors(const Context* context)
+{
+	for (auto& f : m_frames) {
+		auto result = DescriptorBuilder::begin(context)
+					 .bind_buffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { f.records.buffer, 0, VK_WHOLE_SIZE }, VK_SHADER_STAGE_COMPUTE_BIT)
+					 .bind_buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { f.indices.buffer, 0, VK_WHOLE_SIZE }, VK_SHADER_STAGE_COMPUTE_BIT)
+					 .bind_buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { m_objects.buffer, 0, VK_WHOLE_SIZE }, VK_SHADER_STAGE_COMPUTE_BIT)
+					 .build(&m_set_layout, &f.descriptor_set);
+		vk_check(result, "Failed to create scene buffer descriptor");
+	}
+}
+
+void GpuScene::init_pipeline(const Context* context)
+{
+	auto result = PipelineBuilder::begin(context)
+					  .add_shader("scene_scatter_comp.spv", VK_SHADER_STAGE_COMPUTE_BIT)
+					  .add_layout(0, m_set_layout)
+					  .add_push_constant(0, sizeof(ScatterParams), VK_SHADER_STAGE_COMPUTE_BIT)
+					  .build_compute(&m_scatter_layout, &m_scatter_pipeline);
+	vk_check(result, "Failed to create scene scatter pipeline");
+}
+
+void GpuScene::upload(VkCommandBuffer command_buffer, uint32_t frame)
+{
+	m_uploaded_bytes = 0;
+	if (m_records.dirty_count() == 0)
+		return;
+
+	auto& f = m_frames[frame];
+	auto count = static_cast<uint32_t>(m_records.collect(f.index_data, f.record_data));
+	vmaFlushAllocation(m_context->allocator, f.records.allocation, 0, count * sizeof(GpuObject));
+
+	// one region per run of neighbouring records, collect hands them out sorted
+	m_regions.clear();
+	for (uint32_t i = 0; i < count && m_regions.size() <= max_copy_regions; ++i) {
+		VkDeviceSize destination = f.index_data[i] * sizeof(GpuObject);
+		if (!m_regions.empty() && m_regions.back().dstOffset + m_regions.back().size == destination) {
+			m_regions.back().size += sizeof(GpuObject);
+			continue;
+		}
+		m_regions.push_back({ i * sizeof(GpuObject), destination, sizeof(GpuObject) });
+	}
+	bool scatter = m_regions.size() > max_copy_regions;
+
+	// last frame's shaders may still be reading the records being replaced
+	vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		scatter ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		0, nullptr);
+
+	if (scatter) {
+		vmaFlushAllocation(m_context->allocator, f.indices.allocation, 0, count * sizeof(uint32_t));
+		m_uploaded_bytes = count * (sizeof(GpuObject) + sizeof(uint32_t));
+
+		ScatterParams params { count };
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_scatter_pipeline);
+		vkCmdBindDescriptorSets(
+			command_buffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			m_scatter_layout,
+			0, 1, &f.descriptor_set,
+			0, nullptr);
+		vkCmdPushConstants(
+			command_buffer,
+			m_scatter_layout,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			0,
+			sizeof(ScatterParams),
+			&params);
+		vkCmdDispatch(command_buffer, (count + 63) / 64, 1, 1);
+	} else {
+		m_uploaded_bytes = count * sizeof(GpuObject);
+		vkCmdCopyBuffer(
+			command_buffer,
+			f.records.buffer,
+			m_objects.buffer,
+			static_cast<uint32_t>(m_regions.size()),
+			m_regions.data());
+	}
+
+	VkMemoryBarrier barrier {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = scatter ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(
+		command_buffer,
+		scatter ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+}
+
+}
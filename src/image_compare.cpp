@@ -0,0 +1,155 @@
+#include "image_compare.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace chch {
+
+double ImageDiff::psnr() const
+{
+	if (mse == 0.0)
+		return std::numeric_limits<double>::infinity();
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+Rgba8Image make_rgba8_image(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra)
+{
+	Rgba8Image image;
+	image.resize(width, height);
+	std::copy(pixels, pixels + image.pixels.size(), image.pixels.begin());
+	if (bgra) {
+		for (size_t i = 0; i < image.pixels.size(); i += 4)
+			std::swap(image.pixels[i], image.pixels[i + 2]);
+	}
+	return image;
+}
+
+ImageDiff compare_images(const Rgba8Image& a, const Rgba8Image& b, uint8_t tolerance, Rgba8Image* diff)
+{
+	if (a.width != b.width || a.height != b.height)
+		throw std::runtime_error("compared images have to be the same size");
+
+	if (diff)
+		diff->resize(a.width, a.height);
+
+	ImageDiff result;
+	uint64_t squared_error = 0;
+	for (size_t p = 0; p < a.pixel_count(); ++p) {
+		const uint8_t* pa = &a.pixels[p * 4];
+		const uint8_t* pb = &b.pixels[p * 4];
+
+		int worst = 0;
+		for (int c = 0; c < 3; ++c) {
+			int d = std::abs(pa[c] - pb[c]);
+			worst = std::max(worst, d);
+			squared_error += d * d;
+		}
+		result.max_difference = std::max(result.max_difference, static_cast<uint8_t>(worst));
+		bool mismatch = worst > tolerance;
+		result.mismatched += mismatch;
+
+		if (diff) {
+			uint8_t* pd = &diff->pixels[p * 4];
+			if (mismatch) {
+				pd[0] = 255;
+				pd[1] = 0;
+				pd[2] = 0;
+			} else {
+				for (int c = 0; c < 3; ++c)
+					pd[c] = pa[c] / 4;
+			}
+			pd[3] = 255;
+		}
+	}
+
+	if (a.pixel_count() > 0)
+		result.mse = static_cast<double>(squared_error) / (a.pixel_count() * 3);
+	return result;
+}
+
+bool save_ppm(const std::filesystem::path& path, const Rgba8Image& image)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	file << "P6\n" << image.width << ' ' << image.height << "\n255\n";
+	std::vector<char> row(static_cast<size_t>(image.width) * 3);
+	for (uint32_t y = 0; y < image.height; ++y) {
+		const uint8_t* src = &image.pixels[static_cast<size_t>(y) * image.width * 4];
+		for (uint32_t x = 0; x < image.width; ++x) {
+			row[x * 3 + 0] = static_cast<char>(src[x * 4 + 0]);
+			row[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+			row[x * 3 + 2] = static_cast<char>(src[x * 4 + 2]);
+		}
+		file.write(row.data(), row.size());
+	}
+	return static_cast<bool>(file);
+}
+
+// anything bigger is a broken header, not a frame
+static constexpr uint32_t max_ppm_size = 16384;
+
+// the next header number, skipping whitespace and comments
+static bool read_ppm_number(std::istream& file, uint32_t& value)
+{
+	int c = file.get();
+	while (c == '#' || std::isspace(c)) {
+		if (c == '#')
+			while (c != '\n' && c != EOF)
+				c = file.get();
+		c = file.get();
+	}
+	if (!std::isdigit(c))
+		return false;
+
+	uint64_t v = 0;
+	while (std::isdigit(c) && v <= UINT32_MAX) {
+		v = v * 10 + (c - '0');
+		c = file.get();
+	}
+	value = static_cast<uint32_t>(v);
+	// exactly one whitespace character separates the header from the pixels
+	return v <= UINT32_MAX && std::isspace(c);
+}
+
+bool load_ppm(const std::filesystem::path& path, Rgba8Image& image)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	char magic[2];
+	uint32_t width, height, max_value;
+	if (!file.read(magic, 2) || magic[0] != 'P' || magic[1] != '6'
+		|| !read_ppm_number(file, width)
+		|| !read_ppm_number(file, height)
+		|| !read_ppm_number(file, max_value)
+		|| max_value != 255
+		|| width > max_ppm_size
+		|| height > max_ppm_size)
+		return false;
+
+	image.resize(width, height);
+	std::vector<char> row(static_cast<size_t>(width) * 3);
+	for (uint32_t y = 0; y < height; ++y) {
+		if (!file.read(row.data(), row.size()))
+			return false;
+		uint8_t* dst = &image.pixels[static_cast<size_t>(y) * width * 4];
+		for (uint32_t x = 0; x < width; ++x) {
+			dst[x * 4 + 0] = static_cast<uint8_t>(row[x * 3 + 0]);
+			dst[x * 4 + 1] = static_cast<uint8_t>(row[x * 3 + 1]);
+			dst[x * 4 + 2] = static_cast<uint8_t>(row[x * 3 + 2]);
+			dst[x * 4 + 3] = 255;
+		}
+	}
+	return true;
+}
+
+}
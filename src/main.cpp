@@ -2,12 +2,22 @@
 #include "util.hpp"
 #include "renderer.hpp"
 #include "camera.hpp"
+#include "cpu_profiler.hpp"
+#include "frame_capture.hpp"
 #include "material.hpp"
 #include "mesh.hpp"
+#include "replay_log.hpp"
 #include "transform.hpp"
+#include "transform_hierarchy.hpp"
 
+#include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <string>
+#include <unordered_map>
 #include <vulkan/vulkan_core.h>
 
 static std::filesystem::path root_path;
@@ -38,6 +48,16 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 		left = action != GLFW_RELEASE ? true : false;
 }
 
+bool pick = false;
+static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+	(void)window;
+	(void)mods;
+
+	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+		pick = true;
+}
+
 float lastX = 1920 / 2.0f, lastY = 1080 / 2.0f;
 static void cursor_position_callback(GLFWwindow* window, double xpos, double ypos)
 {
@@ -60,25 +80,68 @@ static void cursor_position_callback(GLFWwindow* window, double xpos, double ypo
 	lastY = ypos;
 }
 
-struct RenderObject {
-	Transform transform;
-	Mesh mesh;
-	Material material;
+struct Spin {
+	glm::vec3 axis;
+	float degrees_per_second;
 };
 
-struct FloorColor {
-	glm::vec3 color;
+struct Orbit {
+	float radius;
 };
 
-struct SpecularData {
-	glm::vec3 camera_direction;
-	float width = 5.0f;
+// links an entity to its instance in the picking scene
+struct Pickable {
+	uint32_t instance;
+	const char* name;
 };
 
 int main(int argc, char** argv)
 {
-	(void)argc;
 	root_path = std::filesystem::absolute(argv[0]).parent_path();
+	PROFILE_THREAD("main");
+
+	// --headless [--frames n] renders n frames offscreen and exits,
+	// --capture file streams every frame to a .y4m or raw RGBA file,
+	// --gpu-profile file.json writes GPU pass timings on exit,
+	// --trace file.json writes a Chrome trace of the GPU passes on exit, with
+	// the CPU zones alongside them in make PROFILE=1 builds,
+	// --stats file.csv writes every frame's draw counts and pipeline statistics,
+	// --record file logs every frame's camera, object transforms, loads and draws,
+	// --replay file plays a log back frame by frame in place of the clock and input,
+	// --timestep seconds advances time by a fixed step each frame,
+	// --dynamic-rendering draws without render pass and framebuffer objects
+	bool headless = false;
+	bool dynamic_rendering = false;
+	uint32_t headless_frames = 300;
+	std::filesystem::path capture_path;
+	std::filesystem::path gpu_profile_path;
+	std::filesystem::path trace_path;
+	std::filesystem::path stats_path;
+	std::filesystem::path record_path;
+	std::filesystem::path replay_path;
+	float timestep = 0.0f;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--headless") == 0)
+			headless = true;
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			headless_frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+			capture_path = argv[++i];
+		else if (strcmp(argv[i], "--gpu-profile") == 0 && i + 1 < argc)
+			gpu_profile_path = argv[++i];
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			trace_path = argv[++i];
+		else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+			stats_path = argv[++i];
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			record_path = argv[++i];
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			replay_path = argv[++i];
+		else if (strcmp(argv[i], "--timestep") == 0 && i + 1 < argc)
+			timestep = std::stof(argv[++i]);
+		else if (strcmp(argv[i], "--dynamic-rendering") == 0)
+			dynamic_rendering = true;
+	}
 
 	ContextCreateInfo cc_info {};
 	cc_info.app_name = "test";
@@ -99,16 +162,25 @@ int main(int argc, char** argv)
 		VK_KHR_SHADER_NON_SEMANTIC_INFO_EXTENSION_NAME
 	};
 	cc_info.allocation_callbacks = nullptr;
+	cc_info.pipeline_cache_path = root_path / "pipeline_cache.bin";
+	cc_info.headless = headless;
 
 	Context context;
 	Renderer renderer;
+	FrameCapture capture;
+	ReplayWriter recording;
+	ReplayReader replay;
 
 	Texture skyline, viking_room, statue;
-	Uniform<FloorColor> floor_uniform;
-	Uniform<SpecularData> spec_uniform;
+	// per-draw params, pushed into renderer.draw_uniforms every frame
+	MaterialParams lit_params;
+	MaterialParams floor_params { glm::vec4(0.3f, 0.3f, 0.3f, 1.0f) };
 
-	RenderObject sphere, cube, floor;
-	RenderObject skybox;
+	Mesh sphere_mesh, cube_mesh, floor_mesh, skybox_mesh;
+	Material sphere_material, cube_material, floor_material, skybox_material;
+	Transform skybox_transform;
+	World world;
+	TransformHierarchy transforms;
 
 	SceneGlobals globs;
 	globs.sun_color = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -118,11 +190,37 @@ int main(int argc, char** argv)
 
 	try {
 		context.init(cc_info);
+		renderer.occlusion_culling = true;
+		renderer.software_occlusion = true;
+		renderer.readback = !capture_path.empty();
+		renderer.dynamic_rendering = dynamic_rendering;
+		renderer.gpu_profiling = !gpu_profile_path.empty() || !trace_path.empty();
+		if (!trace_path.empty())
+			renderer.gpu_profiler.trace_capacity = 64 * 1024;
+		renderer.pipeline_statistics = !stats_path.empty();
+		if (!stats_path.empty())
+			renderer.stats_log.capacity = 64 * 1024;
 		renderer.init(&context, globs, &camera);
 
-		glfwSetInputMode(context.window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-		glfwSetKeyCallback(context.window, key_callback);
-		glfwSetCursorPosCallback(context.window, cursor_position_callback);
+		VkExtent2D capture_extent = context.surface_capabilities.currentExtent;
+		if (renderer.readback) {
+			auto format = context.surface_format.format;
+			bool bgra = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+			capture.open(
+				capture_path,
+				FrameCapture::format_for(capture_path),
+				capture_extent.width,
+				capture_extent.height,
+				60,
+				bgra);
+		}
+
+		if (!headless) {
+			glfwSetInputMode(context.window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+			glfwSetKeyCallback(context.window, key_callback);
+			glfwSetCursorPosCallback(context.window, cursor_position_callback);
+			glfwSetMouseButtonCallback(context.window, mouse_button_callback);
+		}
 
 		camera.width = context.surface_capabilities.currentExtent.width;
 		camera.height = context.surface_capabilities.currentExtent.height;
@@ -132,122 +230,311 @@ int main(int argc, char** argv)
 		camera.type = Camera::PERSPECTIVE;
 		camera.transform.position = glm::vec3(0.0f, 0.0f, -10.0f);
 
+		// pipelines compile on the renderer's pool while the meshes load and the first frames draw
+		auto build_start = std::chrono::steady_clock::now();
+		std::vector<std::shared_future<VkResult>> builds;
+
 		skyline.init(&context, "skybox.png");
 		viking_room.init(&context, "viking_room.png");
 		statue.init(&context, "texture.jpg");
 
-		floor_uniform.init(&context, { glm::vec3(0.3f) });
-		spec_uniform.init(&context, { camera.transform.position, 0.5f });
-
-		sphere.transform = Transform {
-			glm::vec3(3.0f, 3.0f, 0.0f),
-			glm::quat(0.0f, 0.0f, 0.0f, 1.0f),
-			glm::vec3(1.0f)
-		};
-		sphere.mesh.init(&context, "sphere.obj");
-		sphere.material.init(&context,
-				renderer.render_pass, renderer.descriptor_set_layout[0],
+		sphere_mesh.init(&context, "sphere.obj");
+		builds.push_back(sphere_material.init_async(renderer.thread_pool, &context,
+				renderer.render_target, renderer.descriptor_set_layout, renderer.draw_uniforms.layout(),
 				{{ 1, &viking_room }},
-				{{ 0, &spec_uniform.buffer }},
-				"shader_vert.spv", "shader_frag.spv",
-				VK_CULL_MODE_BACK_BIT, VK_TRUE);
+				{ },
+				"shader_vert.spv", "material_frag.spv",
+				ShaderFeatures::TEXTURED | ShaderFeatures::LIT | ShaderFeatures::SPECULAR,
+				VK_CULL_MODE_BACK_BIT, VK_TRUE));
 
-		cube.mesh.init(&context, "cube.obj");
-		cube.material.init(&context,
-				renderer.render_pass, renderer.descriptor_set_layout[0],
+		cube_mesh.init(&context, "cube.obj");
+		builds.push_back(cube_material.init_async(renderer.thread_pool, &context,
+				renderer.render_target, renderer.descriptor_set_layout, renderer.draw_uniforms.layout(),
 				{{ 1, &statue }},
-				{{ 0, &spec_uniform.buffer }},
-				"shader_vert.spv", "shader_frag.spv",
-				VK_CULL_MODE_BACK_BIT, VK_TRUE);
-
-		floor.transform = Transform {
-			glm::vec3(0.0f, -3.0f, 0.0f),
-			glm::quat(0.0f, 0.0f, 0.0f, 1.0f),
-			glm::vec3(20.0f, 1.0f, 20.0f)
-		};
-		floor.mesh.init(&context, "quad.obj");
-		floor.material.init(&context,
-				renderer.render_pass, renderer.descriptor_set_layout[0],
 				{ },
-				{{ 0, &floor_uniform.buffer }},
-				"shader_vert.spv", "white_out_frag.spv",
-				VK_CULL_MODE_NONE, VK_TRUE);
+				"shader_vert.spv", "material_frag.spv",
+				ShaderFeatures::TEXTURED | ShaderFeatures::LIT | ShaderFeatures::SPECULAR,
+				VK_CULL_MODE_BACK_BIT, VK_TRUE));
 
-		skybox.mesh.init(&context, "skybox.obj");
-		skybox.material.init(&context,
-				renderer.render_pass, renderer.descriptor_set_layout[0],
+		floor_mesh.init(&context, "quad.obj");
+		builds.push_back(floor_material.init_async(renderer.thread_pool, &context,
+				renderer.render_target, renderer.descriptor_set_layout, renderer.draw_uniforms.layout(),
+				{ },
+				{ },
+				"shader_vert.spv", "material_frag.spv", 0,
+				VK_CULL_MODE_NONE, VK_TRUE));
+
+		skybox_mesh.init(&context, "skybox.obj");
+		builds.push_back(skybox_material.init_async(renderer.thread_pool, &context,
+				renderer.render_target, renderer.descriptor_set_layout, renderer.draw_uniforms.layout(),
 				{{ 0, &skyline }},
 				{ },
-				"shader_vert.spv", "skybox_frag.spv",
-				VK_CULL_MODE_FRONT_BIT, VK_FALSE);
+				"shader_vert.spv", "skybox_frag.spv", 0,
+				VK_CULL_MODE_FRONT_BIT, VK_FALSE));
+
+		// the loop starts straight away and draws with the fallback pipeline
+		// until these land, checking for failures once a frame
+		auto poll_builds = [&]() {
+			if (builds.empty())
+				return;
+			for (auto it = builds.begin(); it != builds.end();) {
+				if (it->wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+					++it;
+					continue;
+				}
+				vk_check(it->get(), "Failed to create material pipeline");
+				it = builds.erase(it);
+			}
+			if (!builds.empty())
+				return;
+			std::chrono::duration<double, std::milli> build_time = std::chrono::steady_clock::now() - build_start;
+			std::cout << context.pipelines_built << " pipelines built in " << context.pipeline_build_us / 1000.0
+					  << " ms of compile time, materials ready after " << build_time.count() << " ms, "
+					  << (context.pipeline_cache_warm ? "warm" : "cold") << " pipeline cache" << std::endl;
+		};
+
+		// everything but the skybox, which has to be drawn before the rest
+		MeshScene scene;
+		auto add_object = [&](const char* name, const Transform& transform, Renderable renderable) {
+			const Mesh& mesh = *renderable.mesh;
+			uint32_t instance = scene.add(&mesh.bvh, transform.matrix());
+			SceneNode node { transforms.add(transform) };
+			// one material each, the instance id doubles as the material index
+			SceneRecord record { SceneRecord::NONE, instance };
+			return world.create(node, renderable, Pickable { instance, name }, record);
+		};
+		Entity sphere = add_object("sphere",
+			Transform { glm::vec3(3.0f, 3.0f, 0.0f), glm::quat(0.0f, 0.0f, 0.0f, 1.0f), glm::vec3(1.0f) },
+			Renderable { &sphere_mesh, &sphere_material, &lit_params, sizeof(lit_params) });
+		world.add(sphere, Orbit { 10.0f });
+		Entity cube = add_object("cube", Transform {},
+			Renderable { &cube_mesh, &cube_material, &lit_params, sizeof(lit_params) });
+		world.add(cube, Spin { glm::normalize(glm::vec3(1.0f, 1.3f, 0.4f)), 90.0f });
+		Entity floor = add_object("floor",
+			Transform { glm::vec3(0.0f, -3.0f, 0.0f), glm::quat(0.0f, 0.0f, 0.0f, 1.0f), glm::vec3(20.0f, 1.0f, 20.0f) },
+			Renderable { &floor_mesh, &floor_material, &floor_params, sizeof(floor_params) });
+		std::vector<const char*> picked_names(scene.size());
+		world.each<Pickable>([&](Entity, Pickable& pickable) { picked_names[pickable.instance] = pickable.name; });
+
+		// replay logs name objects by their picking instance, and meshes and
+		// materials by where they sit in the loads
+		std::vector<TransformHierarchy::Handle> object_nodes(scene.size());
+		world.each<SceneNode, Pickable>([&](Entity, SceneNode& node, Pickable& pickable) {
+			object_nodes[pickable.instance] = node.handle;
+		});
+		std::vector<ReplayLoad> loads;
+		std::unordered_map<const void*, uint32_t> load_ids;
+		auto loaded = [&](ReplayLoad::Kind kind, const char* name, const void* resource) {
+			load_ids[resource] = static_cast<uint32_t>(loads.size());
+			loads.push_back({ kind, name });
+		};
+		loaded(ReplayLoad::TEXTURE, "skybox.png", &skyline);
+		loaded(ReplayLoad::TEXTURE, "viking_room.png", &viking_room);
+		loaded(ReplayLoad::TEXTURE, "texture.jpg", &statue);
+		loaded(ReplayLoad::MESH, "sphere.obj", &sphere_mesh);
+		loaded(ReplayLoad::MATERIAL, "sphere", &sphere_material);
+		loaded(ReplayLoad::MESH, "cube.obj", &cube_mesh);
+		loaded(ReplayLoad::MATERIAL, "cube", &cube_material);
+		loaded(ReplayLoad::MESH, "quad.obj", &floor_mesh);
+		loaded(ReplayLoad::MATERIAL, "floor", &floor_material);
+		loaded(ReplayLoad::MESH, "skybox.obj", &skybox_mesh);
+		loaded(ReplayLoad::MATERIAL, "skybox", &skybox_material);
+
+		// in the order they're issued below
+		auto frame_draws = [&](std::vector<ReplayDraw>& draws) {
+			draws.clear();
+			draws.push_back({ ReplayDraw::NO_OBJECT, load_ids.at(&skybox_mesh), load_ids.at(&skybox_material) });
+			world.each<Renderable, Pickable>([&](Entity, Renderable& renderable, Pickable& pickable) {
+				draws.push_back({ pickable.instance, load_ids.at(renderable.mesh), load_ids.at(renderable.material) });
+			});
+		};
+
+		if (!record_path.empty())
+			recording.open(record_path, { static_cast<uint32_t>(camera.width), static_cast<uint32_t>(camera.height), timestep });
+		if (!replay_path.empty()) {
+			replay.open(replay_path);
+			if (replay.header().width != camera.width || replay.header().height != camera.height)
+				std::cerr << "replaying a " << replay.header().width << "x" << replay.header().height
+						  << " recording at " << camera.width << "x" << camera.height << std::endl;
+		}
+		ReplayFrame replay_frame, record_frame;
+		std::vector<ReplayDraw> draws;
+		bool draws_diverged = false;
 
 		static auto start_time = std::chrono::high_resolution_clock::now();
 		float last_time = 0.0f;
 
-		while (!should_exit && !glfwWindowShouldClose(context.window)) {
-			glfwPollEvents();
-
-			auto current_time = std::chrono::high_resolution_clock::now();
-			float time = std::chrono::duration<float, std::chrono::seconds::period>(
-				current_time - start_time)
-							 .count();
-			float delta = last_time - time;
-
-			auto v = glm::vec4(0.0f);
-			if (forward)
-				v.z -= 1.0f;
-			if (backward)
-				v.z += 1.0f;
-			if (right)
-				v.x += 1.0f;
-			if (left)
-				v.x -= 1.0f;
-			glm::vec3 v2(camera.transform.matrix() * v * 50.0f * delta);
-			camera.transform.position += v2;
-			skybox.transform.position = camera.transform.position;
-
-			spec_uniform.ubo().camera_direction = -camera.transform.position;
-			spec_uniform.update(renderer.frames.index);
-
-			cube.transform.rotation = glm::rotate(
-				cube.transform.rotation,
-				glm::radians(90.0f * delta),
-				glm::normalize(glm::vec3(1.0f, 1.3f, 0.4f)));
-
-			sphere.transform.position = glm::vec3(
-					10 * (glm::sin(time)),
-					0.0f,
-					10 * (glm::cos(time)));
-
+		uint32_t frame_count = 0;
+		uint32_t frame_index = 0;
+		while (!should_exit) {
+			if (headless) {
+				// replays run until the log does
+				if (!replay.is_open() && frame_count++ == headless_frames)
+					break;
+			} else {
+				if (glfwWindowShouldClose(context.window))
+					break;
+				glfwPollEvents();
+				// nothing gets drawn while minimized, so sleep until that changes
+				if (context.window_hidden()) {
+					glfwWaitEvents();
+					continue;
+				}
+			}
+
+			float time, delta;
+			if (replay.is_open()) {
+				if (!replay.next(replay_frame))
+					break;
+				if (replay.frames_read() == 1 && replay_frame.loads != loads)
+					throw std::runtime_error(replay_path.string() + " was recorded with other resources loaded");
+
+				time = replay_frame.time;
+				delta = replay_frame.delta;
+				camera.transform = replay_frame.camera;
+				pick = replay_frame.pick;
+				for (const auto& transform : replay_frame.transforms)
+					transforms.set_local(object_nodes.at(transform.object), transform.local);
+			} else {
+				if (timestep > 0.0f) {
+					time = frame_index * timestep;
+				} else {
+					auto current_time = std::chrono::high_resolution_clock::now();
+					time = std::chrono::duration<float, std::chrono::seconds::period>(
+						current_time - start_time)
+							   .count();
+				}
+				delta = last_time - time;
+
+				auto v = glm::vec4(0.0f);
+				if (forward)
+					v.z -= 1.0f;
+				if (backward)
+					v.z += 1.0f;
+				if (right)
+					v.x += 1.0f;
+				if (left)
+					v.x -= 1.0f;
+				glm::vec3 v2(camera.transform.matrix() * v * 50.0f * delta);
+				camera.transform.position += v2;
+
+				world.each<SceneNode, Spin>([&transforms, delta](Entity, SceneNode& node, Spin& spin) {
+					Transform local = transforms.local(node.handle);
+					local.rotation = glm::rotate(
+						local.rotation,
+						glm::radians(spin.degrees_per_second * delta),
+						spin.axis);
+					transforms.set_local(node.handle, local);
+				});
+				world.each<SceneNode, Orbit>([&transforms, time](Entity, SceneNode& node, Orbit& orbit) {
+					Transform local = transforms.local(node.handle);
+					local.position = glm::vec3(
+							orbit.radius * glm::sin(time),
+							0.0f,
+							orbit.radius * glm::cos(time));
+					transforms.set_local(node.handle, local);
+				});
+			}
+			skybox_transform.position = camera.transform.position;
+			lit_params.camera_position = -camera.transform.position;
+			bool frame_pick = pick;
+
+			transforms.update();
+			renderer.update_scene(world, transforms);
+
+			// the fat margin in the scene bvh makes this cheap for things that stay put
+			world.each<SceneNode, Pickable>([&](Entity, SceneNode& node, Pickable& pickable) {
+				scene.set_transform(pickable.instance, transforms.world(node.handle));
+			});
+
+			// the cursor is captured, so pick through the crosshair
+			if (pick) {
+				pick = false;
+				RayHit hit;
+				Ray ray = renderer.pick_ray({ camera.width * 0.5f, camera.height * 0.5f });
+				if (scene.intersect(ray, camera.depth_max, hit))
+					std::cout << "picked " << picked_names[hit.instance] << " triangle " << hit.triangle
+							  << " at distance " << hit.t << std::endl;
+			}
+
+			if (recording.is_open() || replay.is_open())
+				frame_draws(draws);
+			if (replay.is_open() && !draws_diverged && draws != replay_frame.draws) {
+				std::cerr << "draws differ from the recording from frame " << frame_index << " on" << std::endl;
+				draws_diverged = true;
+			}
+			if (recording.is_open()) {
+				record_frame.clear();
+				record_frame.time = time;
+				record_frame.delta = delta;
+				record_frame.camera = camera.transform;
+				record_frame.pick = frame_pick;
+				if (frame_index == 0)
+					record_frame.loads = loads;
+				// the writer drops the ones that haven't changed
+				world.each<SceneNode, Pickable>([&](Entity, SceneNode& node, Pickable& pickable) {
+					record_frame.transforms.push_back({ pickable.instance, transforms.local(node.handle) });
+				});
+				record_frame.draws = draws;
+				recording.write(record_frame);
+			}
+
+			poll_builds();
 			renderer.setup_draw();
-			renderer.draw(skybox.transform, skybox.mesh, skybox.material);
-
-			renderer.draw(sphere.transform, sphere.mesh, sphere.material);
-			renderer.draw(cube.transform, cube.mesh, cube.material);
-			renderer.draw(floor.transform, floor.mesh, floor.material);
+			// frames from after a resize don't fit the stream
+			if (capture.is_open())
+				renderer.read_back([&capture, capture_extent](const ReadbackFrame& frame) {
+					if (frame.width == capture_extent.width && frame.height == capture_extent.height)
+						capture.write(frame.color);
+				});
+			renderer.add_occluder(transforms.world(world.get<SceneNode>(floor)->handle), floor_mesh);
+			renderer.draw(skybox_transform, skybox_mesh, skybox_material);
+			renderer.draw(world, transforms);
 
 			renderer.present_draw();
 			last_time = time;
+			++frame_index;
 		}
 		vkDeviceWaitIdle(context.device);
+		if (!stats_path.empty() && !renderer.stats_log.write_csv(stats_path))
+			std::cerr << "failed to write stats to " << stats_path << std::endl;
+		if (!trace_path.empty() && !CpuProfiler::write_chrome_trace(trace_path, renderer.gpu_profiler.trace()))
+			std::cerr << "failed to write trace to " << trace_path << std::endl;
+		if (!gpu_profile_path.empty()) {
+			std::ofstream(gpu_profile_path) << renderer.gpu_profiler.to_json() << '\n';
+			if (auto frame = renderer.gpu_profiler.stats().find("frame"))
+				std::cout << "gpu frame time " << frame->average() << " ms average, "
+						  << frame->percentile(0.95) << " ms p95" << std::endl;
+		}
 
-		sphere.material.deinit(&context);
-		sphere.mesh.deinit(&context);
-		cube.material.deinit(&context);
-		cube.mesh.deinit(&context);
-		floor.material.deinit(&context);
-		floor.mesh.deinit(&context);
-		skybox.material.deinit(&context);
-		skybox.mesh.deinit(&context);
+		world.clear();
+		sphere_material.deinit(&context);
+		sphere_mesh.deinit(&context);
+		cube_material.deinit(&context);
+		cube_mesh.deinit(&context);
+		floor_material.deinit(&context);
+		floor_mesh.deinit(&context);
+		skybox_material.deinit(&context);
+		skybox_mesh.deinit(&context);
 
 		skyline.deinit(&context);
 		viking_room.deinit(&context);
 		statue.deinit(&context);
 
-		floor_uniform.deinit(&context);
-		spec_uniform.deinit(&context);
 
 		renderer.deinit();
+		if (capture.is_open()) {
+			std::cout << capture.frames_written() << " frames captured to " << capture_path << std::endl;
+			capture.close();
+		}
+		if (recording.is_open()) {
+			std::cout << recording.frames_written() << " frames recorded to " << record_path << std::endl;
+			recording.close();
+		}
+		if (replay.is_open()) {
+			std::cout << replay.frames_read() << " frames replayed from " << replay_path << std::endl;
+			replay.close();
+		}
 		context.deinit();
 
 	} catch (const std::exception& e) {
@@ -2,6 +2,7 @@
 #include "util.hpp"
 #include "vertex.hpp"
 #include "context.hpp"
+#include "cpu_profiler.hpp"
 
 #include "descriptor_builder.hpp"
 #include "pipeline_builder.hpp"
@@ -14,46 +15,99 @@
 namespace chch {
 
 void Material::init(const Context* context,
-		const VkRenderPass& render_pass,
+		const RenderTarget& target,
 		VkDescriptorSetLayout base_layout,
-			std::vector<TextureInfo> texture_info,
-			std::vector<UniformInfo> uniform_info,
+		VkDescriptorSetLayout draw_layout,
+		std::vector<TextureInfo> texture_info,
+		std::vector<UniformInfo> uniform_info,
 		std::string vertex_shader_name,
 		std::string fragment_shader_name,
+		uint32_t features,
 		VkCullModeFlagBits cull_mode,
 		VkBool32 enable_depth)
 {
-	descriptor_pool = make_descriptor_pool(context->device, texture_info.size(), uniform_info.size());
+	PROFILE_ZONE("Material::init");
+	auto builder = setup(context,
+		target, base_layout, draw_layout,
+		texture_info, uniform_info,
+		vertex_shader_name, fragment_shader_name, features,
+		cull_mode, enable_depth);
+	vk_check(builder.build(&pipeline_layout, &pipeline), "Failed to create material pipeline");
+	m_ready.store(true, std::memory_order_release);
+}
+
+std::shared_future<VkResult> Material::init_async(ThreadPool& thread_pool,
+		const Context* context,
+		const RenderTarget& target,
+		VkDescriptorSetLayout base_layout,
+		VkDescriptorSetLayout draw_layout,
+		std::vector<TextureInfo> texture_info,
+		std::vector<UniformInfo> uniform_info,
+		std::string vertex_shader_name,
+		std::string fragment_shader_name,
+		uint32_t features,
+		VkCullModeFlagBits cull_mode,
+		VkBool32 enable_depth)
+{
+	auto builder = setup(context,
+		target, base_layout, draw_layout,
+		texture_info, uniform_info,
+		vertex_shader_name, fragment_shader_name, features,
+		cull_mode, enable_depth);
+
+	m_build = thread_pool.submit([this, builder]() mutable {
+		PROFILE_ZONE("Material pipeline build");
+		auto result = builder.build(&pipeline_layout, &pipeline);
+		m_ready.store(result == VK_SUCCESS, std::memory_order_release);
+		return result;
+	}).share();
+	return m_build;
+}
 
+PipelineBuilder Material::setup(const Context* context,
+		const RenderTarget& target,
+		VkDescriptorSetLayout base_layout,
+		VkDescriptorSetLayout draw_layout,
+		std::vector<TextureInfo>& texture_info,
+		std::vector<UniformInfo>& uniform_info,
+		const std::string& vertex_shader_name,
+		const std::string& fragment_shader_name,
+		uint32_t features,
+		VkCullModeFlagBits cull_mode,
+		VkBool32 enable_depth)
+{
+	// descriptors stay on the calling thread, the allocator isn't shared safely
 	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-		auto builder = DescriptorBuilder::begin(context, descriptor_pool);
+		auto builder = DescriptorBuilder::begin(context);
 		for (auto& t : texture_info)
 			builder.bind_texture(t.binding, t.texture);
 		for (auto& u : uniform_info)
 			builder.bind_uniform(u.binding, &u.uniform_buffer->at(i));
-		builder.build(&descriptor_set_layout[i], &descriptor_set[i]);
+		builder.build(&descriptor_set_layout, &descriptor_set[i]);
 	}
 
-	PipelineBuilder::begin(context)
-		.add_shader(vertex_shader_name, VK_SHADER_STAGE_VERTEX_BIT)
-		.add_shader(fragment_shader_name, VK_SHADER_STAGE_FRAGMENT_BIT)
-		.set_render_pass(render_pass)
+	return PipelineBuilder::begin(context)
+		.add_shader(vertex_shader_name, VK_SHADER_STAGE_VERTEX_BIT, features)
+		.add_shader(fragment_shader_name, VK_SHADER_STAGE_FRAGMENT_BIT, features)
+		.set_render_target(target)
 		.add_layout(0, base_layout)
-		.add_layout(1, descriptor_set_layout[0])
+		.add_layout(1, descriptor_set_layout)
+		.add_layout(2, draw_layout)
 		.add_push_constant(0, sizeof(glm::mat4), VK_SHADER_STAGE_VERTEX_BIT)
 		.set_depth_stencil(enable_depth, enable_depth)
-		.set_rasterizer(VK_POLYGON_MODE_FILL, cull_mode, VK_FRONT_FACE_COUNTER_CLOCKWISE)
-		.build(&pipeline_layout, &pipeline);
+		.set_rasterizer(VK_POLYGON_MODE_FILL, cull_mode, VK_FRONT_FACE_COUNTER_CLOCKWISE);
 }
 
 
 void Material::deinit(const Context* context)
 {
-	vkDestroyPipeline(context->device, pipeline, context->allocation_callbacks);
-	vkDestroyPipelineLayout(context->device, pipeline_layout, context->allocation_callbacks);
-	vkDestroyDescriptorPool(context->device, descriptor_pool, context->allocation_callbacks);
-	for (auto& layout : descriptor_set_layout)
-		vkDestroyDescriptorSetLayout(context->device, layout, context->allocation_callbacks);
+	if (m_build.valid())
+		m_build.wait();
+	// materials with the same state share the pipeline and its layout
+	if (ready())
+		context->pipelines.release(pipeline);
+	m_ready.store(false, std::memory_order_release);
+	// the sets stay in context->descriptor_allocator until the context goes
 }
 
 
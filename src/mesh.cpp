@@ -2,24 +2,40 @@
 #include "context.hpp"
 #include "vertex.hpp"
 #include "util.hpp"
+#include "cpu_profiler.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <utility>
 
 namespace chch {
 
 void Mesh::init(const Context* context, std::string filename)
 {
+	PROFILE_ZONE("Mesh::init");
 	load_model(filename);
 	init_buffers(context);
 }
 
+void Mesh::init(const Context* context, std::vector<Vertex> mesh_vertices, std::vector<uint32_t> mesh_indices)
+{
+	PROFILE_ZONE("Mesh::init");
+	vertices = std::move(mesh_vertices);
+	indices = std::move(mesh_indices);
+	compute_bounds();
+	build_bvh();
+	init_buffers(context);
+}
+
 void Mesh::init_buffers(const Context* context)
 {
 	// Create Vertex Buffer
@@ -83,7 +99,11 @@ void Mesh::load_model(std::string filename)
 		throw std::runtime_error(err);
 	}
 
-	std::unordered_map<Vertex, uint32_t> unique_vertices {};
+	size_t corner_count = 0;
+	for (const auto& shape : shapes)
+		corner_count += shape.mesh.indices.size();
+	std::vector<Vertex> corners;
+	corners.reserve(corner_count);
 
 	for (const auto& shape : shapes) {
 		for (const auto& index : shape.mesh.indices) {
@@ -103,14 +123,38 @@ void Mesh::load_model(std::string filename)
 				1.0f - attribute.texcoords[2 * index.texcoord_index + 1]
 			};
 
-			if (unique_vertices.count(vertex) == 0) {
-				unique_vertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
-			}
-
-			indices.push_back(unique_vertices[vertex]);
+			corners.push_back(vertex);
 		}
 	}
+	deduplicate_vertices(corners, vertices, indices);
+
+	compute_bounds();
+	build_bvh();
+}
+
+void Mesh::build_bvh()
+{
+	bvh.build(
+		reinterpret_cast<const uint8_t*>(vertices.data()) + offsetof(Vertex, position),
+		sizeof(Vertex),
+		vertices.size(),
+		indices.data(),
+		indices.size());
+}
+
+void Mesh::compute_bounds()
+{
+	bounds = Bounds {};
+	for (const auto& v : vertices)
+		bounds.box.grow(v.position);
+
+	bounds.sphere.center = bounds.box.center();
+	float radius_squared = 0.0f;
+	for (const auto& v : vertices) {
+		glm::vec3 d = v.position - bounds.sphere.center;
+		radius_squared = std::max(radius_squared, glm::dot(d, d));
+	}
+	bounds.sphere.radius = std::sqrt(radius_squared);
 }
 
 void Mesh::deinit(const Context* context)
@@ -133,4 +177,22 @@ void Mesh::copy_buffer(const Context* context,
 	});
 }
 
+void deduplicate_vertices(
+	const std::vector<Vertex>& corners,
+	std::vector<Vertex>& vertices,
+	std::vector<uint32_t>& indices)
+{
+	// one lookup per corner, and no rehashing on the way
+	std::unordered_map<Vertex, uint32_t> unique_vertices;
+	unique_vertices.reserve(corners.size());
+	indices.reserve(indices.size() + corners.size());
+
+	for (const auto& corner : corners) {
+		auto [it, inserted] = unique_vertices.try_emplace(corner, static_cast<uint32_t>(vertices.size()));
+		if (inserted)
+			vertices.push_back(corner);
+		indices.push_back(it->second);
+	}
+}
+
 }
@@ -0,0 +1,451 @@
+#include "mesh_bvh.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace chch {
+
+// bins per axis for the top down build
+static const int SAH_BINS = 16;
+
+// past this depth the build falls back to median splits, which bounds the
+// traversal stack no matter how the triangles are laid out
+static const uint32_t MAX_SAH_DEPTH = 48;
+
+// determinants closer to zero than this belong to rays parallel to the triangle
+static const float MIN_DETERMINANT = 1e-30f;
+
+static glm::vec3 load_position(const uint8_t* positions, size_t stride, uint32_t index)
+{
+	glm::vec3 position;
+	memcpy(&position, positions + index * stride, sizeof(position));
+	return position;
+}
+
+// Halves items around the median center on the widest axis
+static size_t median_split(uint32_t* items, size_t count, const std::vector<glm::vec3>& centers)
+{
+	AABB bounds;
+	for (size_t i = 0; i < count; ++i)
+		bounds.grow(centers[items[i]]);
+	glm::vec3 size = bounds.max - bounds.min;
+	int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+	std::nth_element(items, items + count / 2, items + count, [&](uint32_t a, uint32_t b) {
+		return centers[a][axis] < centers[b][axis];
+	});
+	return count / 2;
+}
+
+// Partitions items along the cheapest of the bin planes on the widest centroid
+// axis and returns where the right half starts
+static size_t sah_split(
+	uint32_t* items,
+	size_t count,
+	const std::vector<AABB>& boxes,
+	const std::vector<glm::vec3>& centers)
+{
+	AABB bounds;
+	for (size_t i = 0; i < count; ++i)
+		bounds.grow(centers[items[i]]);
+
+	glm::vec3 size = bounds.max - bounds.min;
+	int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+	// every center in one spot, any split is as good as another
+	if (!(size[axis] > 0.0f))
+		return count / 2;
+
+	float scale = SAH_BINS / size[axis];
+	auto bin_of = [&](uint32_t item) {
+		return std::min(SAH_BINS - 1, static_cast<int>((centers[item][axis] - bounds.min[axis]) * scale));
+	};
+
+	AABB bin_box[SAH_BINS];
+	size_t bin_count[SAH_BINS] = {};
+	for (size_t i = 0; i < count; ++i) {
+		int bin = bin_of(items[i]);
+		bin_box[bin].grow(boxes[items[i]]);
+		++bin_count[bin];
+	}
+
+	float right_cost[SAH_BINS];
+	AABB right;
+	size_t right_count = 0;
+	for (int i = SAH_BINS - 1; i > 0; --i) {
+		right.grow(bin_box[i]);
+		right_count += bin_count[i];
+		right_cost[i] = right_count ? right.surface_area() * right_count : 0.0f;
+	}
+
+	float best = std::numeric_limits<float>::max();
+	int best_bin = -1;
+	AABB left;
+	size_t left_count = 0;
+	for (int i = 1; i < SAH_BINS; ++i) {
+		left.grow(bin_box[i - 1]);
+		left_count += bin_count[i - 1];
+		if (left_count == 0 || left_count == count)
+			continue;
+		float cost = left.surface_area() * left_count + right_cost[i];
+		if (cost < best) {
+			best = cost;
+			best_bin = i;
+		}
+	}
+	if (best_bin < 0)
+		return count / 2;
+
+	auto middle = std::partition(items, items + count, [&](uint32_t item) {
+		return bin_of(item) < best_bin;
+	});
+	return static_cast<size_t>(middle - items);
+}
+
+void MeshBvh::build(
+	const void* positions,
+	size_t stride,
+	size_t vertex_count,
+	const uint32_t* indices,
+	size_t index_count)
+{
+	clear();
+
+	BuildInput input { static_cast<const uint8_t*>(positions), stride, indices, {}, {} };
+	m_triangle_count = index_count / 3;
+	input.boxes.resize(m_triangle_count);
+	input.centers.resize(m_triangle_count);
+
+	for (size_t i = 0; i < m_triangle_count; ++i) {
+		AABB box;
+		for (size_t k = 0; k < 3; ++k) {
+			uint32_t index = indices[3 * i + k];
+			if (index >= vertex_count)
+				throw std::runtime_error("triangle index out of range while building a mesh BVH");
+			box.grow(load_position(input.positions, stride, index));
+		}
+		input.boxes[i] = box;
+		input.centers[i] = box.center();
+		m_bounds.grow(box);
+	}
+
+	if (m_triangle_count == 0)
+		return;
+
+	std::vector<uint32_t> triangles(m_triangle_count);
+	std::iota(triangles.begin(), triangles.end(), 0u);
+	m_nodes.reserve(2 * m_triangle_count / (simd::WIDTH * (WIDE - 1)) + 1);
+	m_leaves.reserve(2 * m_triangle_count / simd::WIDTH + 1);
+	build_node(input, triangles.data(), triangles.size(), 0);
+}
+
+void MeshBvh::clear()
+{
+	m_nodes.clear();
+	m_leaves.clear();
+	m_bounds = AABB();
+	m_triangle_count = 0;
+}
+
+// Splits the largest part until the node is full, so a node is the top few
+// levels of the binary SAH tree squashed together
+int32_t MeshBvh::build_node(BuildInput& input, uint32_t* triangles, size_t count, uint32_t depth)
+{
+	struct Part {
+		uint32_t* triangles;
+		size_t count;
+		AABB box;
+	};
+	auto make_part = [&input](uint32_t* items, size_t size) {
+		Part part { items, size, AABB() };
+		for (size_t i = 0; i < size; ++i)
+			part.box.grow(input.boxes[items[i]]);
+		return part;
+	};
+
+	Part parts[WIDE];
+	size_t part_count = 0;
+	parts[part_count++] = make_part(triangles, count);
+
+	while (part_count < WIDE) {
+		int largest = -1;
+		float largest_area = -1.0f;
+		for (size_t i = 0; i < part_count; ++i) {
+			if (parts[i].count > simd::WIDTH && parts[i].box.surface_area() > largest_area) {
+				largest_area = parts[i].box.surface_area();
+				largest = static_cast<int>(i);
+			}
+		}
+		if (largest < 0)
+			break;
+
+		Part part = parts[largest];
+		size_t split = depth < MAX_SAH_DEPTH
+			? sah_split(part.triangles, part.count, input.boxes, input.centers)
+			: median_split(part.triangles, part.count, input.centers);
+		parts[largest] = make_part(part.triangles, split);
+		parts[part_count++] = make_part(part.triangles + split, part.count - split);
+	}
+
+	int32_t index = static_cast<int32_t>(m_nodes.size());
+	m_nodes.emplace_back();
+
+	for (size_t i = 0; i < WIDE; ++i) {
+		int32_t child = EMPTY;
+		AABB box;
+		if (i < part_count) {
+			box = parts[i].box;
+			if (parts[i].count <= simd::WIDTH)
+				child = ~build_leaf(input, parts[i].triangles, parts[i].count);
+			else
+				child = build_node(input, parts[i].triangles, parts[i].count, depth + 1);
+		}
+
+		// children may have grown m_nodes
+		auto& node = m_nodes[index];
+		node.min_x[i] = box.min.x;
+		node.min_y[i] = box.min.y;
+		node.min_z[i] = box.min.z;
+		node.max_x[i] = box.max.x;
+		node.max_y[i] = box.max.y;
+		node.max_z[i] = box.max.z;
+		node.child[i] = child;
+	}
+	return index;
+}
+
+int32_t MeshBvh::build_leaf(const BuildInput& input, const uint32_t* triangles, size_t count)
+{
+	Leaf leaf {};
+	for (size_t lane = 0; lane < count; ++lane) {
+		uint32_t triangle = triangles[lane];
+		const uint32_t* corners = input.indices + 3 * triangle;
+		glm::vec3 v0 = load_position(input.positions, input.stride, corners[0]);
+		glm::vec3 e1 = load_position(input.positions, input.stride, corners[1]) - v0;
+		glm::vec3 e2 = load_position(input.positions, input.stride, corners[2]) - v0;
+
+		leaf.v0_x[lane] = v0.x;
+		leaf.v0_y[lane] = v0.y;
+		leaf.v0_z[lane] = v0.z;
+		leaf.e1_x[lane] = e1.x;
+		leaf.e1_y[lane] = e1.y;
+		leaf.e1_z[lane] = e1.z;
+		leaf.e2_x[lane] = e2.x;
+		leaf.e2_y[lane] = e2.y;
+		leaf.e2_z[lane] = e2.z;
+		leaf.triangle[lane] = triangle;
+	}
+	m_leaves.push_back(leaf);
+	return static_cast<int32_t>(m_leaves.size() - 1);
+}
+
+bool MeshBvh::intersect(const Ray& ray, float t_max, RayHit& hit) const
+{
+	return traverse(ray, t_max, false, hit);
+}
+
+bool MeshBvh::occluded(const Ray& ray, float t_max) const
+{
+	RayHit hit;
+	return traverse(ray, t_max, true, hit);
+}
+
+// Slab tests a whole node at once, then Moller-Trumbore on a whole leaf at
+// once. Triangles are hit from both sides.
+bool MeshBvh::traverse(const Ray& ray, float t_max, bool any_hit, RayHit& hit) const
+{
+	using namespace simd;
+
+	if (m_nodes.empty())
+		return false;
+
+	const glm::vec3 inverse = 1.0f / ray.direction;
+	const Float ox = splat(ray.origin.x), ix = splat(inverse.x), dx = splat(ray.direction.x);
+	const Float oy = splat(ray.origin.y), iy = splat(inverse.y), dy = splat(ray.direction.y);
+	const Float oz = splat(ray.origin.z), iz = splat(inverse.z), dz = splat(ray.direction.z);
+	const Float zero = splat(0.0f);
+	const Float one = splat(1.0f);
+	const Float min_determinant = splat(MIN_DETERMINANT);
+
+	float closest = t_max;
+	bool found = false;
+
+	struct Entry {
+		int32_t node;
+		float t;
+	};
+	// the build keeps the tree shallow enough that this can't overflow
+	Entry stack[64 * WIDE];
+	size_t stack_size = 0;
+	stack[stack_size++] = { 0, 0.0f };
+
+	float enter[WIDE];
+	float lane_t[WIDTH], lane_u[WIDTH], lane_v[WIDTH];
+
+	while (stack_size) {
+		Entry entry = stack[--stack_size];
+		if (entry.t > closest)
+			continue;
+		const auto& node = m_nodes[entry.node];
+
+		Entry inner[WIDE];
+		size_t inner_count = 0;
+		for (size_t base = 0; base < WIDE; base += WIDTH) {
+			const Float limit = splat(closest);
+			Float x0 = mul(sub(load(node.min_x + base), ox), ix), x1 = mul(sub(load(node.max_x + base), ox), ix);
+			Float y0 = mul(sub(load(node.min_y + base), oy), iy), y1 = mul(sub(load(node.max_y + base), oy), iy);
+			Float z0 = mul(sub(load(node.min_z + base), oz), iz), z1 = mul(sub(load(node.max_z + base), oz), iz);
+			Float t_enter = max(max(min(x0, x1), min(y0, y1)), max(min(z0, z1), zero));
+			Float t_leave = min(min(max(x0, x1), max(y0, y1)), min(max(z0, z1), limit));
+			store(enter + base, t_enter);
+
+			uint32_t box_bits = bits(less_equal(t_enter, t_leave));
+			for (size_t lane = 0; lane < WIDTH; ++lane) {
+				int32_t child = node.child[base + lane];
+				if (child == EMPTY || !(box_bits & (1u << lane)))
+					continue;
+				if (child >= 0) {
+					inner[inner_count++] = { child, enter[base + lane] };
+					continue;
+				}
+
+				const Leaf& leaf = m_leaves[~child];
+				Float e1x = load(leaf.e1_x), e1y = load(leaf.e1_y), e1z = load(leaf.e1_z);
+				Float e2x = load(leaf.e2_x), e2y = load(leaf.e2_y), e2z = load(leaf.e2_z);
+				Float px = sub(mul(dy, e2z), mul(dz, e2y));
+				Float py = sub(mul(dz, e2x), mul(dx, e2z));
+				Float pz = sub(mul(dx, e2y), mul(dy, e2x));
+				Float det = mul_add(e1x, px, mul_add(e1y, py, mul(e1z, pz)));
+				Float inverse_det = div(one, det);
+
+				Float sx = sub(ox, load(leaf.v0_x));
+				Float sy = sub(oy, load(leaf.v0_y));
+				Float sz = sub(oz, load(leaf.v0_z));
+				Float u = mul(mul_add(sx, px, mul_add(sy, py, mul(sz, pz))), inverse_det);
+				Float qx = sub(mul(sy, e1z), mul(sz, e1y));
+				Float qy = sub(mul(sz, e1x), mul(sx, e1z));
+				Float qz = sub(mul(sx, e1y), mul(sy, e1x));
+				Float v = mul(mul_add(dx, qx, mul_add(dy, qy, mul(dz, qz))), inverse_det);
+				Float t = mul(mul_add(e2x, qx, mul_add(e2y, qy, mul(e2z, qz))), inverse_det);
+
+				Mask triangle_hit = mask_and(
+					mask_and(
+						greater_equal(max(det, sub(zero, det)), min_determinant),
+						mask_and(greater_equal(u, zero), greater_equal(v, zero))),
+					mask_and(
+						less_equal(add(u, v), one),
+						mask_and(greater_equal(t, zero), less_equal(t, splat(closest)))));
+
+				uint32_t triangle_bits = bits(triangle_hit);
+				if (!triangle_bits)
+					continue;
+
+				store(lane_t, t);
+				store(lane_u, u);
+				store(lane_v, v);
+				for (size_t k = 0; k < WIDTH; ++k) {
+					if (!(triangle_bits & (1u << k)) || lane_t[k] > closest)
+						continue;
+					closest = lane_t[k];
+					hit.t = lane_t[k];
+					hit.triangle = leaf.triangle[k];
+					hit.barycentrics = { lane_u[k], lane_v[k] };
+					found = true;
+				}
+				if (any_hit)
+					return true;
+			}
+		}
+
+		// farthest first so the nearest child is popped next, order doesn't matter for any hit
+		if (!any_hit)
+			std::sort(inner, inner + inner_count, [](const Entry& a, const Entry& b) { return a.t > b.t; });
+		for (size_t i = 0; i < inner_count; ++i)
+			stack[stack_size++] = inner[i];
+	}
+
+	return found;
+}
+
+uint32_t MeshScene::add(const MeshBvh* mesh, const glm::mat4& transform)
+{
+	uint32_t index;
+	if (m_free.empty()) {
+		index = static_cast<uint32_t>(m_instances.size());
+		m_instances.emplace_back();
+	} else {
+		index = m_free.back();
+		m_free.pop_back();
+	}
+
+	auto& instance = m_instances[index];
+	instance.mesh = mesh;
+	instance.inverse = glm::inverse(transform);
+	instance.proxy = m_bvh.insert(mesh->bounds().transform(transform), index);
+	return index;
+}
+
+void MeshScene::set_transform(uint32_t index, const glm::mat4& transform)
+{
+	auto& instance = m_instances[index];
+	instance.inverse = glm::inverse(transform);
+	m_bvh.move(instance.proxy, instance.mesh->bounds().transform(transform));
+}
+
+void MeshScene::remove(uint32_t index)
+{
+	auto& instance = m_instances[index];
+	m_bvh.remove(instance.proxy);
+	instance = Instance();
+	m_free.push_back(index);
+}
+
+void MeshScene::clear()
+{
+	m_bvh.clear();
+	m_instances.clear();
+	m_free.clear();
+}
+
+// The direction isn't renormalized, so t means the same thing in both spaces
+Ray MeshScene::to_object(const Instance& instance, const Ray& ray) const
+{
+	return {
+		glm::vec3(instance.inverse * glm::vec4(ray.origin, 1.0f)),
+		glm::vec3(instance.inverse * glm::vec4(ray.direction, 0.0f))
+	};
+}
+
+bool MeshScene::intersect(const Ray& ray, float t_max, RayHit& hit) const
+{
+	RayHit closest;
+	uint32_t index;
+	float t;
+	auto refine = [&](uint32_t instance_index, const Ray& world, float limit) {
+		const auto& instance = m_instances[instance_index];
+		RayHit local;
+		if (!instance.mesh->intersect(to_object(instance, world), limit, local))
+			return -1.0f;
+		// the top level only accepts hits nearer than limit, so the last one wins
+		local.instance = instance_index;
+		closest = local;
+		return local.t;
+	};
+
+	if (!m_bvh.ray_cast(ray, t_max, index, t, refine))
+		return false;
+	hit = closest;
+	return true;
+}
+
+bool MeshScene::occluded(const Ray& ray, float t_max) const
+{
+	return m_bvh.ray_test(ray, t_max, [this](uint32_t instance_index, const Ray& world, float limit) {
+		const auto& instance = m_instances[instance_index];
+		return instance.mesh->occluded(to_object(instance, world), limit) ? 0.0f : -1.0f;
+	});
+}
+
+}
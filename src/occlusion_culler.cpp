@@ -0,0 +1,461 @@
+#include "occlusion_culler.hpp"
+#include "context.hpp"
+#include "util.hpp"
+
+#include "descriptor_builder.hpp"
+#include "pipeline_builder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vulkan/vulkan_core.h>
+
+namespace chch {
+
+struct InitParams {
+	glm::ivec2 depth_size;
+	glm::ivec2 pyramid_size;
+	int32_t samples;
+};
+
+struct ReduceParams {
+	glm::ivec2 source_size;
+	glm::ivec2 destination_size;
+};
+
+struct CullParams {
+	glm::mat4 view_projection;
+	uint32_t object_count;
+	uint32_t level_count;
+};
+
+static uint32_t previous_power_of_two(uint32_t value)
+{
+	uint32_t result = 1;
+	while (result <= value / 2)
+		result *= 2;
+	return result;
+}
+
+static uint32_t group_count(uint32_t size, uint32_t group_size)
+{
+	return (size + group_size - 1) / group_size;
+}
+
+static void compute_barrier(VkCommandBuffer command_buffer)
+{
+	VkMemoryBarrier barrier {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr);
+}
+
+bool OcclusionCuller::is_supported(const Context* context)
+{
+	return context->device_properties.limits.sampledImageDepthSampleCounts & context->msaa_samples;
+}
+
+void OcclusionCuller::init(const Context* context, const Image& depth_image, uint32_t id_count)
+{
+	m_context = context;
+	m_id_count = id_count;
+	m_depth_extent = context->surface_capabilities.currentExtent;
+	m_depth_samples = context->msaa_samples;
+
+	init_pyramid(context);
+	init_buffers(context);
+	init_descriptors(context, depth_image);
+	init_pipelines(context);
+}
+
+void OcclusionCuller::deinit(const Context* context)
+{
+	if (m_init_pipeline == VK_NULL_HANDLE)
+		return;
+
+	context->pipelines.release(m_init_pipeline);
+	context->pipelines.release(m_reduce_pipeline);
+	context->pipelines.release(m_cull_pipeline);
+	m_init_pipeline = VK_NULL_HANDLE;
+
+	m_descriptors.deinit();
+	m_reduce_sets.clear();
+
+	for (auto& f : m_frames) {
+		vmaUnmapMemory(context->allocator, f.objects.allocation);
+		vmaUnmapMemory(context->allocator, f.draws.allocation);
+		vmaUnmapMemory(context->allocator, f.visibility.allocation);
+		f.objects.deinit(context);
+		f.draws.deinit(context);
+		f.visibility.deinit(context);
+	}
+
+	vkDestroySampler(context->device, m_sampler, context->allocation_callbacks);
+	for (auto view : m_level_views)
+		vkDestroyImageView(context->device, view, context->allocation_callbacks);
+	m_level_views.clear();
+	m_pyramid.deinit(context);
+}
+
+void OcclusionCuller::resize(const Image& depth_image, DeletionQueue& retired, uint64_t frame)
+{
+	retired.push(frame, [context = m_context, pyramid = m_pyramid, views = m_level_views, sampler = m_sampler, descriptors = m_descriptors]() mutable {
+		descriptors.deinit();
+		vkDestroySampler(context->device, sampler, context->allocation_callbacks);
+		for (auto view : views)
+			vkDestroyImageView(context->device, view, context->allocation_callbacks);
+		pyramid.deinit(context);
+	});
+	m_descriptors = DescriptorAllocator {};
+	m_reduce_sets.clear();
+
+	m_depth_extent = m_context->surface_capabilities.currentExtent;
+	init_pyramid(m_context);
+	init_descriptors(m_context, depth_image);
+}
+
+void OcclusionCuller::init_pyramid(const Context* context)
+{
+	// power of two keeps every reduction an exact 2x2 footprint
+	m_pyramid_extent = {
+		previous_power_of_two(m_depth_extent.width),
+		previous_power_of_two(m_depth_extent.height)
+	};
+	m_level_count = 1;
+	while ((std::max(m_pyramid_extent.width, m_pyramid_extent.height) >> m_level_count) > 0)
+		++m_level_count;
+
+	m_pyramid.init(
+		context,
+		m_pyramid_extent.width,
+		m_pyramid_extent.height,
+		m_level_count,
+		VK_SAMPLE_COUNT_1_BIT,
+		VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY);
+
+	// stays in GENERAL, it is only ever touched by compute. The first record
+	// moves it there, so remaking it doesn't wait on the queue.
+	m_pyramid_undefined = true;
+
+	m_level_views.resize(m_level_count);
+	for (uint32_t i = 0; i < m_level_count; ++i) {
+		VkImageViewCreateInfo view_info {};
+		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_info.image = m_pyramid.image;
+		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_info.format = VK_FORMAT_R32_SFLOAT;
+		view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		view_info.subresourceRange.baseMipLevel = i;
+		view_info.subresourceRange.levelCount = 1;
+		view_info.subresourceRange.baseArrayLayer = 0;
+		view_info.subresourceRange.layerCount = 1;
+
+		auto result = vkCreateImageView(
+			context->device,
+			&view_info,
+			context->allocation_callbacks,
+			&m_level_views[i]);
+		vk_check(result, "Failed to create depth pyramid view");
+	}
+
+	VkSamplerCreateInfo sampler_info {};
+	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_info.magFilter = VK_FILTER_NEAREST;
+	sampler_info.minFilter = VK_FILTER_NEAREST;
+	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.minLod = 0.0f;
+	sampler_info.maxLod = static_cast<float>(m_level_count);
+	sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+
+	auto result = vkCreateSampler(context->device, &sampler_info, context->allocation_callbacks, &m_sampler);
+	vk_check(result, "Failed to create depth pyramid sampler");
+}
+
+void OcclusionCuller::init_buffers(const Context* context)
+{
+	for (auto& f : m_frames) {
+		f.objects.init(
+			context,
+			MAX_OBJECTS * sizeof(OcclusionObject),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU);
+		f.draws.init(
+			context,
+			MAX_OBJECTS * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU);
+		f.visibility.init(
+			context,
+			m_id_count * sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			VMA_MEMORY_USAGE_GPU_TO_CPU);
+
+		void* data;
+		vmaMapMemory(context->allocator, f.objects.allocation, &data);
+		f.object_data = static_cast<OcclusionObject*>(data);
+		vmaMapMemory(context->allocator, f.draws.allocation, &data);
+		f.draw_data = static_cast<VkDrawIndexedIndirectCommand*>(data);
+		vmaMapMemory(context->allocator, f.visibility.allocation, &data);
+		f.visibility_data = static_cast<uint32_t*>(data);
+
+		// nothing has been seen yet, the first frame tests everything
+		memset(f.visibility_data, 0, m_id_count * sizeof(uint32_t));
+		vmaFlushAllocation(context->allocator, f.visibility.allocation, 0, VK_WHOLE_SIZE);
+	}
+}
+
+void OcclusionCuller::init_descriptors(const Context* context, const Image& depth_image)
+{
+	m_descriptors.init(context, m_level_count + MAX_FRAMES_IN_FLIGHT);
+
+	VkDescriptorImageInfo source {};
+	source.sampler = m_sampler;
+	source.imageView = depth_image.image_view;
+	source.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	VkDescriptorImageInfo destination {};
+	destination.imageView = m_level_views[0];
+	destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	auto result = DescriptorBuilder::begin(context, &m_descriptors)
+					  .bind_image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, source, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .bind_image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, destination, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .build(&m_pyramid_set_layout, &m_init_set);
+	vk_check(result, "Failed to create depth pyramid descriptor");
+
+	m_reduce_sets.resize(m_level_count - 1);
+	for (uint32_t i = 1; i < m_level_count; ++i) {
+		source.imageView = m_level_views[i - 1];
+		source.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		destination.imageView = m_level_views[i];
+
+		result = DescriptorBuilder::begin(context, &m_descriptors)
+					 .bind_image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, source, VK_SHADER_STAGE_COMPUTE_BIT)
+					 .bind_image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, destination, VK_SHADER_STAGE_COMPUTE_BIT)
+					 .build(&m_pyramid_set_layout, &m_reduce_sets[i - 1]);
+		vk_check(result, "Failed to create depth pyramid descriptor");
+	}
+
+	VkDescriptorImageInfo pyramid {};
+	pyramid.sampler = m_sampler;
+	pyramid.imageView = m_pyramid.image_view;
+	pyramid.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	for (auto& f : m_frames) {
+		result = DescriptorBuilder::begin(context, &m_descriptors)
+					 .bind_image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pyramid, VK_SHADER_STAGE_COMPUTE_BIT)
+					 .bind_buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { f.objects.buffer, 0, VK_WHOLE_SIZE }, VK_SHADER_STAGE_COMPUTE_BIT)
+					 .bind_buffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { f.draws.buffer, 0, VK_WHOLE_SIZE }, VK_SHADER_STAGE_COMPUTE_BIT)
+					 .bind_buffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { f.visibility.buffer, 0, VK_WHOLE_SIZE }, VK_SHADER_STAGE_COMPUTE_BIT)
+					 .build(&m_cull_set_layout, &f.descriptor_set);
+		vk_check(result, "Failed to create occlusion culling descriptor");
+	}
+}
+
+void OcclusionCuller::init_pipelines(const Context* context)
+{
+	auto result = PipelineBuilder::begin(context)
+					  .add_shader(
+						  m_depth_samples == VK_SAMPLE_COUNT_1_BIT
+							  ? "depth_pyramid_init_comp.spv"
+							  : "depth_pyramid_init_ms_comp.spv",
+						  VK_SHADER_STAGE_COMPUTE_BIT)
+					  .add_layout(0, m_pyramid_set_layout)
+					  .add_push_constant(0, sizeof(InitParams), VK_SHADER_STAGE_COMPUTE_BIT)
+					  .build_compute(&m_init_layout, &m_init_pipeline);
+	vk_check(result, "Failed to create depth pyramid init pipeline");
+
+	// init and reduce sets declare the same bindings, so they share one layout
+	result = PipelineBuilder::begin(context)
+				 .add_shader("depth_pyramid_reduce_comp.spv", VK_SHADER_STAGE_COMPUTE_BIT)
+				 .add_layout(0, m_pyramid_set_layout)
+				 .add_push_constant(0, sizeof(ReduceParams), VK_SHADER_STAGE_COMPUTE_BIT)
+				 .build_compute(&m_reduce_layout, &m_reduce_pipeline);
+	vk_check(result, "Failed to create depth pyramid reduce pipeline");
+
+	result = PipelineBuilder::begin(context)
+				 .add_shader("occlusion_cull_comp.spv", VK_SHADER_STAGE_COMPUTE_BIT)
+				 .add_layout(0, m_cull_set_layout)
+				 .add_push_constant(0, sizeof(CullParams), VK_SHADER_STAGE_COMPUTE_BIT)
+				 .build_compute(&m_cull_layout, &m_cull_pipeline);
+	vk_check(result, "Failed to create occlusion culling pipeline");
+}
+
+void OcclusionCuller::begin_frame(uint32_t frame)
+{
+	vmaInvalidateAllocation(m_context->allocator, m_frames[frame].visibility.allocation, 0, VK_WHOLE_SIZE);
+}
+
+bool OcclusionCuller::was_visible(uint32_t frame, uint32_t id) const
+{
+	return id < m_id_count && m_frames[frame].visibility_data[id] != 0;
+}
+
+void OcclusionCuller::set_object(
+	uint32_t frame,
+	uint32_t index,
+	uint32_t id,
+	const Sphere& sphere,
+	uint32_t flags,
+	uint32_t index_count)
+{
+	auto& f = m_frames[frame];
+	f.object_data[index].sphere = glm::vec4(sphere.center, sphere.radius);
+	f.object_data[index].flags = flags;
+	f.object_data[index].id = id;
+
+	// instance count is left for the cull pass to decide
+	f.draw_data[index] = { index_count, 0, 0, 0, 0 };
+}
+
+void OcclusionCuller::record(
+	VkCommandBuffer command_buffer,
+	uint32_t frame,
+	uint32_t object_count,
+	const glm::mat4& view_projection)
+{
+	auto& f = m_frames[frame];
+	vmaFlushAllocation(m_context->allocator, f.objects.allocation, 0, VK_WHOLE_SIZE);
+	vmaFlushAllocation(m_context->allocator, f.draws.allocation, 0, VK_WHOLE_SIZE);
+
+	if (m_pyramid_undefined) {
+		VkImageMemoryBarrier barrier {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = m_pyramid.image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = m_level_count;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+		m_pyramid_undefined = false;
+	}
+
+	// the pyramid is shared between frames in flight, so this frame's
+	// writes wait on the previous frame's reads
+	compute_barrier(command_buffer);
+
+	InitParams init_params {
+		glm::ivec2(m_depth_extent.width, m_depth_extent.height),
+		glm::ivec2(m_pyramid_extent.width, m_pyramid_extent.height),
+		static_cast<int32_t>(m_depth_samples)
+	};
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_init_pipeline);
+	vkCmdBindDescriptorSets(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		m_init_layout,
+		0, 1, &m_init_set,
+		0, nullptr);
+	vkCmdPushConstants(
+		command_buffer,
+		m_init_layout,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		0,
+		sizeof(InitParams),
+		&init_params);
+	vkCmdDispatch(
+		command_buffer,
+		group_count(m_pyramid_extent.width, 8),
+		group_count(m_pyramid_extent.height, 8),
+		1);
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reduce_pipeline);
+	for (uint32_t level = 1; level < m_level_count; ++level) {
+		compute_barrier(command_buffer);
+
+		ReduceParams reduce_params {
+			glm::ivec2(
+				std::max(m_pyramid_extent.width >> (level - 1), 1u),
+				std::max(m_pyramid_extent.height >> (level - 1), 1u)),
+			glm::ivec2(
+				std::max(m_pyramid_extent.width >> level, 1u),
+				std::max(m_pyramid_extent.height >> level, 1u))
+		};
+		vkCmdBindDescriptorSets(
+			command_buffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			m_reduce_layout,
+			0, 1, &m_reduce_sets[level - 1],
+			0, nullptr);
+		vkCmdPushConstants(
+			command_buffer,
+			m_reduce_layout,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			0,
+			sizeof(ReduceParams),
+			&reduce_params);
+		vkCmdDispatch(
+			command_buffer,
+			group_count(reduce_params.destination_size.x, 8),
+			group_count(reduce_params.destination_size.y, 8),
+			1);
+	}
+	compute_barrier(command_buffer);
+
+	CullParams cull_params { view_projection, object_count, m_level_count };
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_pipeline);
+	vkCmdBindDescriptorSets(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		m_cull_layout,
+		0, 1, &f.descriptor_set,
+		0, nullptr);
+	vkCmdPushConstants(
+		command_buffer,
+		m_cull_layout,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		0,
+		sizeof(CullParams),
+		&cull_params);
+	vkCmdDispatch(command_buffer, group_count(object_count, 64), 1, 1);
+
+	// the render graph gets the draws to the deferred pass, visibility goes
+	// back to the host
+	VkMemoryBarrier results_barrier {};
+	results_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	results_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	results_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT,
+		0,
+		1, &results_barrier,
+		0, nullptr,
+		0, nullptr);
+}
+
+}
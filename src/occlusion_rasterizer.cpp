@@ -0,0 +1,239 @@
+#include "occlusion_rasterizer.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace chch {
+
+// anything closer to the eye than this can't be projected
+static const float MIN_W = 1e-5f;
+
+static const float LANE_INDEX[8] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+
+// clamped as a float first, vertices near the eye project far outside int range
+static int32_t to_pixel(float v, int32_t low, int32_t high)
+{
+	return static_cast<int32_t>(std::max(static_cast<float>(low), std::min(static_cast<float>(high), v)));
+}
+
+void OcclusionRasterizer::init(uint32_t width, uint32_t height)
+{
+	m_width = (width + 7) & ~7u;
+	m_height = height;
+	m_depth.assign(m_width * m_height, 1.0f);
+}
+
+void OcclusionRasterizer::begin(const glm::mat4& view_projection)
+{
+	m_view_projection = view_projection;
+	m_occluders.clear();
+	m_triangles.clear();
+	std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+}
+
+void OcclusionRasterizer::add_occluder(const OccluderGeometry& geometry, const glm::mat4& model)
+{
+	m_occluders.push_back({ geometry, model });
+}
+
+void OcclusionRasterizer::rasterize()
+{
+	setup_triangles();
+
+	uint32_t band_count = (m_height + band_height - 1) / band_height;
+	auto body = [this](size_t begin, size_t end) {
+		rasterize_rows(
+			static_cast<int32_t>(begin * band_height),
+			static_cast<int32_t>(std::min<size_t>(end * band_height, m_height)));
+	};
+
+	if (thread_pool)
+		thread_pool->parallel_for(band_count, 1, body);
+	else
+		body(0, band_count);
+}
+
+void OcclusionRasterizer::setup_triangles()
+{
+	m_triangles.clear();
+
+	const float width = static_cast<float>(m_width);
+	const float height = static_cast<float>(m_height);
+
+	for (const auto& occluder : m_occluders) {
+		const auto& geometry = occluder.geometry;
+		glm::mat4 mvp = m_view_projection * occluder.model;
+
+		m_clip.resize(geometry.vertex_count);
+		auto bytes = static_cast<const uint8_t*>(geometry.positions);
+		for (size_t i = 0; i < geometry.vertex_count; ++i) {
+			glm::vec3 position;
+			memcpy(&position, bytes + i * geometry.stride, sizeof(position));
+			m_clip[i] = mvp * glm::vec4(position, 1.0f);
+		}
+
+		for (size_t i = 0; i + 2 < geometry.index_count; i += 3) {
+			glm::vec3 v[3];
+			bool behind = false;
+			for (int k = 0; k < 3; ++k) {
+				const auto& clip = m_clip[geometry.indices[i + k]];
+				// dropping near clipped triangles only ever loses occlusion
+				if (clip.w < MIN_W) {
+					behind = true;
+					break;
+				}
+				v[k] = glm::vec3(
+					(clip.x / clip.w * 0.5f + 0.5f) * width,
+					(clip.y / clip.w * 0.5f + 0.5f) * height,
+					clip.z / clip.w);
+			}
+			if (behind)
+				continue;
+
+			float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+			if (std::abs(area) < 1e-8f)
+				continue;
+			// occluders are rasterized from both sides, make every triangle counter clockwise
+			if (area < 0.0f) {
+				std::swap(v[1], v[2]);
+				area = -area;
+			}
+
+			Triangle t;
+			// pixels whose centers fall inside the bounds
+			const int32_t w = static_cast<int32_t>(m_width);
+			const int32_t h = static_cast<int32_t>(m_height);
+			t.x_min = to_pixel(std::ceil(std::min({ v[0].x, v[1].x, v[2].x }) - 0.5f), 0, w);
+			t.x_max = to_pixel(std::floor(std::max({ v[0].x, v[1].x, v[2].x }) - 0.5f), -1, w - 1);
+			t.y_min = to_pixel(std::ceil(std::min({ v[0].y, v[1].y, v[2].y }) - 0.5f), 0, h);
+			t.y_max = to_pixel(std::floor(std::max({ v[0].y, v[1].y, v[2].y }) - 0.5f), -1, h - 1);
+			if (t.x_min > t.x_max || t.y_min > t.y_max)
+				continue;
+
+			for (int k = 0; k < 3; ++k) {
+				const auto& from = v[k];
+				const auto& to = v[(k + 1) % 3];
+				t.a[k] = from.y - to.y;
+				t.b[k] = to.x - from.x;
+				t.c[k] = -(t.a[k] * from.x + t.b[k] * from.y);
+			}
+
+			float dx1 = v[1].x - v[0].x, dy1 = v[1].y - v[0].y, dz1 = v[1].z - v[0].z;
+			float dx2 = v[2].x - v[0].x, dy2 = v[2].y - v[0].y, dz2 = v[2].z - v[0].z;
+			t.z_x = (dz1 * dy2 - dz2 * dy1) / area;
+			t.z_y = (dx1 * dz2 - dx2 * dz1) / area;
+			t.z_c = v[0].z - t.z_x * v[0].x - t.z_y * v[0].y;
+
+			m_triangles.push_back(t);
+		}
+	}
+}
+
+void OcclusionRasterizer::rasterize_rows(int32_t y_begin, int32_t y_end)
+{
+	using namespace simd;
+
+	const Float zero = splat(0.0f);
+	const Float centers = add(load(LANE_INDEX), splat(0.5f));
+
+	for (const auto& t : m_triangles) {
+		int32_t y_first = std::max(t.y_min, y_begin);
+		int32_t y_last = std::min(t.y_max, y_end - 1);
+		if (y_first > y_last)
+			continue;
+
+		const Float a0 = splat(t.a[0]), a1 = splat(t.a[1]), a2 = splat(t.a[2]);
+		const Float z_x = splat(t.z_x);
+		const int32_t x_first = t.x_min - t.x_min % static_cast<int32_t>(WIDTH);
+
+		for (int32_t y = y_first; y <= y_last; ++y) {
+			// rows and blocks are evaluated from scratch, never stepped, so the
+			// result doesn't depend on how the rows were split between jobs
+			float py = static_cast<float>(y) + 0.5f;
+			const Float row0 = splat(t.b[0] * py + t.c[0]);
+			const Float row1 = splat(t.b[1] * py + t.c[1]);
+			const Float row2 = splat(t.b[2] * py + t.c[2]);
+			const Float z_row = splat(t.z_y * py + t.z_c);
+			float* row = &m_depth[static_cast<size_t>(y) * m_width];
+
+			for (int32_t x = x_first; x <= t.x_max; x += WIDTH) {
+				Float px = add(splat(static_cast<float>(x)), centers);
+				Mask inside = mask_and(
+					greater_equal(mul_add(a0, px, row0), zero),
+					mask_and(
+						greater_equal(mul_add(a1, px, row1), zero),
+						greater_equal(mul_add(a2, px, row2), zero)));
+				if (!bits(inside))
+					continue;
+
+				Float z = mul_add(z_x, px, z_row);
+				Float depth = load(row + x);
+				store(row + x, select(inside, min(z, depth), depth));
+			}
+		}
+	}
+}
+
+bool OcclusionRasterizer::is_visible(const AABB& box) const
+{
+	using namespace simd;
+
+	float x_min = std::numeric_limits<float>::max();
+	float x_max = std::numeric_limits<float>::lowest();
+	float y_min = x_min, y_max = x_max;
+	float nearest = 1.0f;
+
+	for (int c = 0; c < 8; ++c) {
+		glm::vec3 corner(
+			(c & 1) ? box.max.x : box.min.x,
+			(c & 2) ? box.max.y : box.min.y,
+			(c & 4) ? box.max.z : box.min.z);
+		glm::vec4 clip = m_view_projection * glm::vec4(corner, 1.0f);
+		if (clip.w < MIN_W)
+			return true;
+
+		float x = (clip.x / clip.w * 0.5f + 0.5f) * m_width;
+		float y = (clip.y / clip.w * 0.5f + 0.5f) * m_height;
+		x_min = std::min(x_min, x);
+		x_max = std::max(x_max, x);
+		y_min = std::min(y_min, y);
+		y_max = std::max(y_max, y);
+		nearest = std::min(nearest, clip.z / clip.w);
+	}
+
+	// every pixel the rect touches, not just the ones whose centers it covers
+	const int32_t w = static_cast<int32_t>(m_width);
+	const int32_t h = static_cast<int32_t>(m_height);
+	int32_t px_min = to_pixel(std::floor(x_min), 0, w);
+	int32_t px_max = to_pixel(std::floor(x_max), -1, w - 1);
+	int32_t py_min = to_pixel(std::floor(y_min), 0, h);
+	int32_t py_max = to_pixel(std::floor(y_max), -1, h - 1);
+	if (px_min > px_max || py_min > py_max)
+		return false;
+
+	const Float lanes = load(LANE_INDEX);
+	const Float first = splat(static_cast<float>(px_min));
+	const Float last = splat(static_cast<float>(px_max));
+	const Float near_depth = splat(nearest);
+	const int32_t x_first = px_min - px_min % static_cast<int32_t>(WIDTH);
+
+	for (int32_t y = py_min; y <= py_max; ++y) {
+		const float* row = &m_depth[static_cast<size_t>(y) * m_width];
+		for (int32_t x = x_first; x <= px_max; x += WIDTH) {
+			Float px = add(splat(static_cast<float>(x)), lanes);
+			Mask hit = mask_and(
+				mask_and(greater_equal(px, first), less_equal(px, last)),
+				greater_equal(load(row + x), near_depth));
+			if (bits(hit))
+				return true;
+		}
+	}
+	return false;
+}
+
+}
@@ -10,26 +10,10 @@
 
 namespace chch {
 
-VkResult PipelineBuilder::load_shader(const Context* context, const std::string& filename, VkShaderModule* shader_module)
-{
-	auto shader_file = chch::read_file(("shaders/" + filename).c_str());
-
-	VkShaderModuleCreateInfo create_info {};
-	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	create_info.codeSize = shader_file.size();
-	create_info.pCode = reinterpret_cast<const uint32_t*>(shader_file.data());
-
-	return vkCreateShaderModule(
-		context->device,
-		&create_info,
-		context->allocation_callbacks,
-		shader_module);
-}
-
 // Required
-PipelineBuilder PipelineBuilder::add_shader(const std::string& filename, VkShaderStageFlagBits stage)
+PipelineBuilder PipelineBuilder::add_shader(const std::string& filename, VkShaderStageFlagBits stage, uint32_t features)
 {
-	m_shader_info.push_back({ filename, stage });
+	m_shader_info.push_back({ filename, stage, ShaderFeatures::normalize(features) });
 	return *this;
 }
 
@@ -39,9 +23,16 @@ PipelineBuilder PipelineBuilder::add_layout(uint32_t set_number, VkDescriptorSet
 	return *this;
 }
 
+PipelineBuilder PipelineBuilder::set_render_target(const RenderTarget& target)
+{
+	m_target = target;
+	return *this;
+}
+
 PipelineBuilder PipelineBuilder::set_render_pass(VkRenderPass render_pass)
 {
-	m_render_pass = render_pass;
+	m_target = RenderTarget {};
+	m_target.render_pass = render_pass;
 	return *this;
 }
 
@@ -195,32 +186,15 @@ PipelineBuilder PipelineBuilder::set_dynamic_state()
 	return *this;
 }
 
-void PipelineBuilder::free_shader_mods()
+void PipelineBuilder::record_build_time(std::chrono::steady_clock::time_point start)
 {
-	for (auto& mod : m_shader_mods)
-		vkDestroyShaderModule(m_context->device, mod, m_context->allocation_callbacks);
+	auto time = std::chrono::steady_clock::now() - start;
+	m_context->pipelines_built += 1;
+	m_context->pipeline_build_us += std::chrono::duration_cast<std::chrono::microseconds>(time).count();
 }
 
-VkResult PipelineBuilder::build(VkPipelineLayout* pipeline_layout, VkPipeline* pipeline)
+VkResult PipelineBuilder::build_layout(VkPipelineLayout* pipeline_layout)
 {
-	m_shader_mods.reserve(m_shader_info.size());
-	m_shader_stages.reserve(m_shader_info.size());
-	for (auto& shader : m_shader_info) {
-		VkShaderModule mod;
-		auto result = load_shader(m_context, shader.filename, &mod);
-		if (result != VK_SUCCESS)
-			free_shader_mods();
-
-		VkPipelineShaderStageCreateInfo shader_stage_info {};
-		shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		shader_stage_info.stage = shader.stage;
-		shader_stage_info.module = mod;
-		shader_stage_info.pName = "main";
-
-		m_shader_mods.push_back(mod);
-		m_shader_stages.push_back(shader_stage_info);
-	}
-
 	std::vector<VkDescriptorSetLayout> layouts;
 	for (auto [key, value] : m_layouts)
 		layouts.push_back(value);
@@ -232,16 +206,157 @@ VkResult PipelineBuilder::build(VkPipelineLayout* pipeline_layout, VkPipeline* p
 	pipeline_layout_info.pushConstantRangeCount = m_push_constants.size();
 	pipeline_layout_info.pPushConstantRanges = m_push_constants.data();
 
-	auto result = vkCreatePipelineLayout(
+	return vkCreatePipelineLayout(
 		m_context->device,
 		&pipeline_layout_info,
 		m_context->allocation_callbacks,
 		pipeline_layout);
+}
 
-	if (result != VK_SUCCESS) {
-		free_shader_mods();
-		return result;
+PipelineKey PipelineBuilder::make_key(char kind) const
+{
+	PipelineKey key;
+	key.add(kind);
+	for (auto& shader : m_shader_info)
+		key.add(shader.filename).add(shader.stage).add(shader.features);
+	for (auto [set, layout] : m_layouts)
+		key.add(set).add(layout);
+	for (auto& range : m_push_constants)
+		key.add(range.offset).add(range.size).add(range.stageFlags);
+	if (kind == 'C')
+		return key;
+
+	key.add(vertex_binding_description.binding)
+		.add(vertex_binding_description.stride)
+		.add(vertex_binding_description.inputRate);
+	for (auto& attribute : vertex_attribute_description)
+		key.add(attribute.location).add(attribute.binding).add(attribute.format).add(attribute.offset);
+
+	key.add(m_input_assembly.topology).add(m_input_assembly.primitiveRestartEnable);
+
+	key.add(m_rasterizer.depthClampEnable)
+		.add(m_rasterizer.rasterizerDiscardEnable)
+		.add(m_rasterizer.polygonMode)
+		.add(m_rasterizer.cullMode)
+		.add(m_rasterizer.frontFace)
+		.add(m_rasterizer.depthBiasEnable)
+		.add(m_rasterizer.depthBiasConstantFactor)
+		.add(m_rasterizer.depthBiasClamp)
+		.add(m_rasterizer.depthBiasSlopeFactor)
+		.add(m_rasterizer.lineWidth);
+
+	key.add(m_multisampling.rasterizationSamples)
+		.add(m_multisampling.sampleShadingEnable)
+		.add(m_multisampling.minSampleShading)
+		.add(m_multisampling.alphaToCoverageEnable)
+		.add(m_multisampling.alphaToOneEnable);
+
+	key.add(m_depth_stencil.depthTestEnable)
+		.add(m_depth_stencil.depthWriteEnable)
+		.add(m_depth_stencil.depthCompareOp)
+		.add(m_depth_stencil.depthBoundsTestEnable)
+		.add(m_depth_stencil.stencilTestEnable)
+		.add(m_depth_stencil.minDepthBounds)
+		.add(m_depth_stencil.maxDepthBounds);
+
+	key.add(color_blend_attachment.blendEnable)
+		.add(color_blend_attachment.srcColorBlendFactor)
+		.add(color_blend_attachment.dstColorBlendFactor)
+		.add(color_blend_attachment.colorBlendOp)
+		.add(color_blend_attachment.srcAlphaBlendFactor)
+		.add(color_blend_attachment.dstAlphaBlendFactor)
+		.add(color_blend_attachment.alphaBlendOp)
+		.add(color_blend_attachment.colorWriteMask)
+		.add(m_color_blending.logicOpEnable)
+		.add(m_color_blending.logicOp);
+	for (auto constant : m_color_blending.blendConstants)
+		key.add(constant);
+
+	for (auto state : dynamic_states)
+		key.add(state);
+
+	// pipelines for dynamic rendering only care about formats, so passes
+	// that agree on them share one
+	key.add(m_target.render_pass).add(m_target.subpass);
+	if (m_target.render_pass == VK_NULL_HANDLE) {
+		key.add(m_target.color_formats.size());
+		for (auto format : m_target.color_formats)
+			key.add(format);
+		key.add(m_target.depth_format);
 	}
+	return key;
+}
+
+VkResult PipelineBuilder::build(VkPipelineLayout* pipeline_layout, VkPipeline* pipeline)
+{
+	return m_context->pipelines.acquire(
+		make_key('G'),
+		[this](VkPipelineLayout* layout, VkPipeline* built) { return create_graphics(layout, built); },
+		pipeline_layout,
+		pipeline);
+}
+
+VkResult PipelineBuilder::build_compute(VkPipelineLayout* pipeline_layout, VkPipeline* pipeline)
+{
+	if (m_shader_info.size() != 1 || m_shader_info[0].stage != VK_SHADER_STAGE_COMPUTE_BIT)
+		return VK_ERROR_INITIALIZATION_FAILED;
+
+	return m_context->pipelines.acquire(
+		make_key('C'),
+		[this](VkPipelineLayout* layout, VkPipeline* built) { return create_compute(layout, built); },
+		pipeline_layout,
+		pipeline);
+}
+
+const VkSpecializationInfo* PipelineBuilder::specialize(size_t shader)
+{
+	auto features = m_shader_info[shader].features;
+	if (features == 0)
+		return nullptr;
+
+	auto& s = m_specializations.emplace_back();
+	s.constants = ShaderFeatures::constants(features);
+	for (uint32_t i = 0; i < ShaderFeatures::COUNT; ++i)
+		s.entries[i] = { i, static_cast<uint32_t>(i * sizeof(uint32_t)), sizeof(uint32_t) };
+
+	s.info.mapEntryCount = static_cast<uint32_t>(s.entries.size());
+	s.info.pMapEntries = s.entries.data();
+	s.info.dataSize = sizeof(s.constants);
+	s.info.pData = s.constants.data();
+	return &s.info;
+}
+
+VkResult PipelineBuilder::create_graphics(VkPipelineLayout* pipeline_layout, VkPipeline* pipeline)
+{
+	m_shader_stages.clear();
+	// reserved so the specialization infos stay where the stages point
+	m_specializations.clear();
+	m_specializations.reserve(m_shader_info.size());
+	for (size_t i = 0; i < m_shader_info.size(); ++i) {
+		auto& shader = m_shader_info[i];
+		VkShaderModule mod;
+		auto result = m_context->pipelines.shader_module(shader.filename, &mod);
+		if (result != VK_SUCCESS)
+			return result;
+
+		VkPipelineShaderStageCreateInfo shader_stage_info {};
+		shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shader_stage_info.stage = shader.stage;
+		shader_stage_info.module = mod;
+		shader_stage_info.pName = "main";
+		shader_stage_info.pSpecializationInfo = specialize(i);
+		m_shader_stages.push_back(shader_stage_info);
+	}
+
+	auto result = build_layout(pipeline_layout);
+	if (result != VK_SUCCESS)
+		return result;
+
+	// the builder is passed around by value, so these may point into an old copy
+	m_vertex_input.pVertexBindingDescriptions = &vertex_binding_description;
+	m_vertex_input.pVertexAttributeDescriptions = vertex_attribute_description.data();
+	m_color_blending.pAttachments = &color_blend_attachment;
+	m_dynamic_state.pDynamicStates = dynamic_states.data();
 
 	VkGraphicsPipelineCreateInfo pipeline_info {};
 	pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -256,19 +371,68 @@ VkResult PipelineBuilder::build(VkPipelineLayout* pipeline_layout, VkPipeline* p
 	pipeline_info.pColorBlendState = &m_color_blending;
 	pipeline_info.pDynamicState = &m_dynamic_state;
 	pipeline_info.layout = *pipeline_layout;
-	pipeline_info.renderPass = m_render_pass;
-	pipeline_info.subpass = 0;
+	pipeline_info.renderPass = m_target.render_pass;
+	pipeline_info.subpass = m_target.subpass;
+
+	VkPipelineRenderingCreateInfo rendering_info {};
+	rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	rendering_info.colorAttachmentCount = static_cast<uint32_t>(m_target.color_formats.size());
+	rendering_info.pColorAttachmentFormats = m_target.color_formats.data();
+	rendering_info.depthAttachmentFormat = m_target.depth_format;
+	if (m_target.render_pass == VK_NULL_HANDLE)
+		pipeline_info.pNext = &rendering_info;
 	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
 
+	auto start = std::chrono::steady_clock::now();
 	result = vkCreateGraphicsPipelines(
 		m_context->device,
-		VK_NULL_HANDLE,
+		m_context->pipeline_cache,
+		1,
+		&pipeline_info,
+		m_context->allocation_callbacks,
+		pipeline);
+	record_build_time(start);
+
+	if (result != VK_SUCCESS)
+		vkDestroyPipelineLayout(m_context->device, *pipeline_layout, m_context->allocation_callbacks);
+	return result;
+}
+
+VkResult PipelineBuilder::create_compute(VkPipelineLayout* pipeline_layout, VkPipeline* pipeline)
+{
+	VkShaderModule mod;
+	auto result = m_context->pipelines.shader_module(m_shader_info[0].filename, &mod);
+	if (result != VK_SUCCESS)
+		return result;
+
+	result = build_layout(pipeline_layout);
+	if (result != VK_SUCCESS)
+		return result;
+
+	VkComputePipelineCreateInfo pipeline_info {};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_info.stage.module = mod;
+	pipeline_info.stage.pName = "main";
+	m_specializations.clear();
+	m_specializations.reserve(1);
+	pipeline_info.stage.pSpecializationInfo = specialize(0);
+	pipeline_info.layout = *pipeline_layout;
+	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+
+	auto start = std::chrono::steady_clock::now();
+	result = vkCreateComputePipelines(
+		m_context->device,
+		m_context->pipeline_cache,
 		1,
 		&pipeline_info,
 		m_context->allocation_callbacks,
 		pipeline);
+	record_build_time(start);
 
-	free_shader_mods();
+	if (result != VK_SUCCESS)
+		vkDestroyPipelineLayout(m_context->device, *pipeline_layout, m_context->allocation_callbacks);
 	return result;
 }
 
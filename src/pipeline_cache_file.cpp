@@ -0,0 +1,151 @@
+#include "pipeline_cache_file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace chch {
+
+struct FileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size;
+	uint64_t checksum;
+};
+
+static uint64_t checksum(const char* data, size_t size)
+{
+	// FNV-1a, a word at a time since caches run to megabytes
+	uint64_t h = 14695981039346656037ull;
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		h ^= word;
+		h *= 1099511628211ull;
+	}
+	for (; i < size; ++i) {
+		h ^= static_cast<uint8_t>(data[i]);
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+// Waits for what was written to path to reach the disk. Directories too, on
+// POSIX that's what makes a rename inside them stick.
+static bool sync_to_disk(const std::filesystem::path& path)
+{
+#if defined(__unix__) || defined(__APPLE__)
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	bool synced = fsync(fd) == 0;
+	close(fd);
+	return synced;
+#else
+	(void)path;
+	return true;
+#endif
+}
+
+std::vector<char> PipelineCacheFile::pack(const std::vector<char>& data)
+{
+	FileHeader header { MAGIC, VERSION, data.size(), checksum(data.data(), data.size()) };
+
+	std::vector<char> file(sizeof(FileHeader) + data.size());
+	memcpy(file.data(), &header, sizeof(FileHeader));
+	if (!data.empty())
+		memcpy(file.data() + sizeof(FileHeader), data.data(), data.size());
+	return file;
+}
+
+bool PipelineCacheFile::unpack(
+	const std::vector<char>& file,
+	const PipelineCacheDevice& device,
+	std::vector<char>& data)
+{
+	data.clear();
+	if (file.size() < sizeof(FileHeader) + sizeof(PipelineCacheHeader))
+		return false;
+
+	FileHeader header;
+	memcpy(&header, file.data(), sizeof(FileHeader));
+	const char* payload = file.data() + sizeof(FileHeader);
+	if (header.magic != MAGIC
+		|| header.version != VERSION
+		|| header.size != file.size() - sizeof(FileHeader)
+		|| header.checksum != checksum(payload, header.size))
+		return false;
+
+	// a new driver can't use what an old one compiled
+	PipelineCacheHeader cache;
+	memcpy(&cache, payload, sizeof(PipelineCacheHeader));
+	if (cache.header_size < sizeof(PipelineCacheHeader)
+		|| cache.header_size > header.size
+		|| cache.header_version != 1
+		|| cache.vendor_id != device.vendor_id
+		|| cache.device_id != device.device_id
+		|| memcmp(cache.uuid, device.uuid.data(), device.uuid.size()) != 0)
+		return false;
+
+	data.assign(payload, payload + header.size);
+	return true;
+}
+
+std::vector<char> PipelineCacheFile::load(const std::filesystem::path& path, const PipelineCacheDevice& device)
+{
+	std::vector<char> data;
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+		return data;
+
+	std::vector<char> contents(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(contents.data(), contents.size());
+	if (!file)
+		return data;
+
+	unpack(contents, device, data);
+	return data;
+}
+
+bool PipelineCacheFile::save(const std::filesystem::path& path, const std::vector<char>& data)
+{
+	auto contents = pack(data);
+	auto temporary = path;
+	temporary += ".tmp";
+
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+		file.write(contents.data(), contents.size());
+		file.flush();
+		if (!file)
+			return false;
+	}
+
+	// without this the rename can reach the disk before the data does, and
+	// a crash leaves an empty file where the old cache was
+	std::error_code error;
+	if (!sync_to_disk(temporary)) {
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+
+	std::filesystem::rename(temporary, path, error);
+	if (error) {
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+
+	auto directory = path.parent_path();
+	return sync_to_disk(directory.empty() ? std::filesystem::path(".") : directory);
+}
+
+}
@@ -0,0 +1,127 @@
+#include "pipeline_registry.hpp"
+#include "context.hpp"
+#include "util.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+namespace chch {
+
+void PipelineRegistry::init(const Context* context)
+{
+	m_context = context;
+}
+
+void PipelineRegistry::deinit()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& [key, entry] : m_pipelines) {
+		vkDestroyPipeline(m_context->device, entry.pipeline, m_context->allocation_callbacks);
+		vkDestroyPipelineLayout(m_context->device, entry.layout, m_context->allocation_callbacks);
+	}
+	m_pipelines.clear();
+	m_keys.clear();
+
+	std::lock_guard<std::mutex> shader_lock(m_shader_mutex);
+	for (auto& [filename, mod] : m_shaders)
+		vkDestroyShaderModule(m_context->device, mod, m_context->allocation_callbacks);
+	m_shaders.clear();
+}
+
+VkResult PipelineRegistry::shader_module(const std::string& filename, VkShaderModule* shader_module)
+{
+	std::lock_guard<std::mutex> lock(m_shader_mutex);
+	auto it = m_shaders.find(filename);
+	if (it != m_shaders.end()) {
+		*shader_module = it->second;
+		return VK_SUCCESS;
+	}
+
+	auto shader_file = read_file(("shaders/" + filename).c_str());
+
+	VkShaderModuleCreateInfo create_info {};
+	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	create_info.codeSize = shader_file.size();
+	create_info.pCode = reinterpret_cast<const uint32_t*>(shader_file.data());
+
+	auto result = vkCreateShaderModule(
+		m_context->device,
+		&create_info,
+		m_context->allocation_callbacks,
+		shader_module);
+	if (result == VK_SUCCESS)
+		m_shaders.emplace(filename, *shader_module);
+	return result;
+}
+
+VkResult PipelineRegistry::acquire(
+	const PipelineKey& key,
+	const Build& build,
+	VkPipelineLayout* layout,
+	VkPipeline* pipeline)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	auto it = m_pipelines.find(key);
+	if (it != m_pipelines.end()) {
+		// entries aren't erased while they have references, so this stays valid
+		Entry* entry = &it->second;
+		entry->references += 1;
+		auto built = entry->built;
+		lock.unlock();
+
+		// a failed build takes its entry, and the references, with it
+		auto result = built.get();
+		if (result != VK_SUCCESS)
+			return result;
+		*layout = entry->layout;
+		*pipeline = entry->pipeline;
+		return result;
+	}
+
+	std::promise<VkResult> promise;
+	Entry* entry = &m_pipelines[key];
+	*entry = { VK_NULL_HANDLE, VK_NULL_HANDLE, 1, promise.get_future().share() };
+	lock.unlock();
+
+	VkResult result;
+	try {
+		result = build(layout, pipeline);
+	} catch (...) {
+		lock.lock();
+		m_pipelines.erase(key);
+		lock.unlock();
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+
+	lock.lock();
+	if (result == VK_SUCCESS) {
+		entry->layout = *layout;
+		entry->pipeline = *pipeline;
+		m_keys.emplace(*pipeline, key);
+	} else {
+		m_pipelines.erase(key);
+	}
+	lock.unlock();
+
+	promise.set_value(result);
+	return result;
+}
+
+void PipelineRegistry::release(VkPipeline pipeline)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto key = m_keys.find(pipeline);
+	if (key == m_keys.end())
+		return;
+
+	auto it = m_pipelines.find(key->second);
+	if (--it->second.references > 0)
+		return;
+
+	vkDestroyPipeline(m_context->device, it->second.pipeline, m_context->allocation_callbacks);
+	vkDestroyPipelineLayout(m_context->device, it->second.layout, m_context->allocation_callbacks);
+	m_pipelines.erase(it);
+	m_keys.erase(key);
+}
+
+}
@@ -0,0 +1,104 @@
+#include "pipeline_statistics.hpp"
+#include "context.hpp"
+#include "util.hpp"
+
+#include <cstdint>
+#include <vulkan/vulkan_core.h>
+
+namespace chch {
+
+namespace {
+
+// results come back in bit order, so keep these sorted
+const VkQueryPipelineStatisticFlags STATISTICS =
+	VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+const uint32_t STATISTIC_COUNT = 6;
+
+}
+
+void PipelineStatistics::init(const Context* context)
+{
+	m_context = context;
+	m_supported = context->device_features.pipelineStatisticsQuery == VK_TRUE;
+	if (!m_supported)
+		return;
+
+	VkQueryPoolCreateInfo create_info {};
+	create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	create_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	create_info.queryCount = 1;
+	create_info.pipelineStatistics = STATISTICS;
+	for (auto& f : m_frames) {
+		auto result = vkCreateQueryPool(context->device, &create_info, context->allocation_callbacks, &f.pool);
+		vk_check(result, "Failed to create pipeline statistics query pool");
+	}
+}
+
+void PipelineStatistics::deinit(const Context* context)
+{
+	for (auto& f : m_frames) {
+		if (f.pool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(context->device, f.pool, context->allocation_callbacks);
+		f.pool = VK_NULL_HANDLE;
+		f.recorded = false;
+	}
+	m_supported = false;
+	m_context = nullptr;
+}
+
+void PipelineStatistics::begin(VkCommandBuffer command_buffer, uint32_t frame)
+{
+	m_frame = frame;
+	auto& f = m_frames[frame];
+	if (f.pool == VK_NULL_HANDLE)
+		return;
+	vkCmdResetQueryPool(command_buffer, f.pool, 0, 1);
+	vkCmdBeginQuery(command_buffer, f.pool, 0, 0);
+}
+
+void PipelineStatistics::end(VkCommandBuffer command_buffer)
+{
+	auto& f = m_frames[m_frame];
+	if (f.pool == VK_NULL_HANDLE)
+		return;
+	vkCmdEndQuery(command_buffer, f.pool, 0);
+	f.recorded = true;
+}
+
+bool PipelineStatistics::collect(uint32_t frame, RenderStats& stats)
+{
+	auto& f = m_frames[frame];
+	if (!f.recorded)
+		return false;
+	f.recorded = false;
+
+	// not ready only if the frame never made it to the queue
+	uint64_t results[STATISTIC_COUNT] {};
+	auto result = vkGetQueryPoolResults(
+		m_context->device,
+		f.pool,
+		0,
+		1,
+		sizeof(results),
+		results,
+		sizeof(results),
+		VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+		return false;
+
+	stats.gpu_valid = true;
+	stats.input_vertices = results[0];
+	stats.input_primitives = results[1];
+	stats.vertex_invocations = results[2];
+	stats.clipping_invocations = results[3];
+	stats.clipping_primitives = results[4];
+	stats.fragment_invocations = results[5];
+	return true;
+}
+
+}
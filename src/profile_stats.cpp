@@ -0,0 +1,147 @@
+#include "profile_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+namespace chch {
+
+RollingStats::RollingStats(size_t window) : m_window(std::max<size_t>(window, 1))
+{
+	m_samples.reserve(m_window);
+}
+
+void RollingStats::add(double value)
+{
+	if (m_samples.size() < m_window)
+		m_samples.push_back(value);
+	else
+		m_samples[m_next] = value;
+	m_next = (m_next + 1) % m_window;
+}
+
+double RollingStats::last() const
+{
+	if (m_samples.empty())
+		return 0.0;
+	return m_samples[(m_next + m_window - 1) % m_window];
+}
+
+double RollingStats::average() const
+{
+	if (m_samples.empty())
+		return 0.0;
+	double sum = 0.0;
+	for (double s : m_samples)
+		sum += s;
+	return sum / m_samples.size();
+}
+
+double RollingStats::min() const
+{
+	if (m_samples.empty())
+		return 0.0;
+	return *std::min_element(m_samples.begin(), m_samples.end());
+}
+
+double RollingStats::max() const
+{
+	if (m_samples.empty())
+		return 0.0;
+	return *std::max_element(m_samples.begin(), m_samples.end());
+}
+
+double RollingStats::percentile(double p) const
+{
+	if (m_samples.empty())
+		return 0.0;
+	p = std::clamp(p, 0.0, 1.0);
+	size_t rank = static_cast<size_t>(std::ceil(p * m_samples.size()));
+	rank = std::max<size_t>(rank, 1) - 1;
+
+	std::vector<double> sorted = m_samples;
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+	return sorted[rank];
+}
+
+void ProfileStats::add(const std::string& name, double ms)
+{
+	// a handful of regions, a scan beats hashing
+	for (size_t i = 0; i < m_names.size(); ++i) {
+		if (m_names[i] == name) {
+			m_stats[i].add(ms);
+			return;
+		}
+	}
+	m_names.push_back(name);
+	m_stats.emplace_back(m_window);
+	m_stats.back().add(ms);
+}
+
+const RollingStats* ProfileStats::find(const std::string& name) const
+{
+	for (size_t i = 0; i < m_names.size(); ++i) {
+		if (m_names[i] == name)
+			return &m_stats[i];
+	}
+	return nullptr;
+}
+
+void ProfileStats::clear()
+{
+	m_names.clear();
+	m_stats.clear();
+}
+
+std::string ProfileStats::to_json() const
+{
+	std::ostringstream out;
+	out << "{\"regions\":[";
+	for (size_t i = 0; i < m_names.size(); ++i) {
+		const auto& s = m_stats[i];
+		out << (i ? "," : "") << "{\"name\":" << json_string(m_names[i])
+			<< ",\"count\":" << s.count()
+			<< ",\"last_ms\":" << s.last()
+			<< ",\"avg_ms\":" << s.average()
+			<< ",\"min_ms\":" << s.min()
+			<< ",\"max_ms\":" << s.max()
+			<< ",\"p50_ms\":" << s.percentile(0.5)
+			<< ",\"p95_ms\":" << s.percentile(0.95)
+			<< ",\"p99_ms\":" << s.percentile(0.99) << "}";
+	}
+	out << "]}";
+	return out.str();
+}
+
+std::string json_string(const std::string& s)
+{
+	std::string out = "\"";
+	for (char c : s) {
+		switch (c) {
+		case '"':
+			out += "\\\"";
+			break;
+		case '\\':
+			out += "\\\\";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		case '\t':
+			out += "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				out += escaped;
+			} else {
+				out += c;
+			}
+		}
+	}
+	return out + "\"";
+}
+
+}
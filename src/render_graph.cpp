@@ -0,0 +1,444 @@
+#include "render_graph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace chch {
+
+bool RenderGraph::is_write(Use use)
+{
+	return use == COLOR_ATTACHMENT || use == DEPTH_ATTACHMENT || use == COMPUTE_WRITE || use == TRANSFER_WRITE;
+}
+
+// Whether the access depends on what was there before. Attachments that aren't
+// cleared are loaded, resolves overwrite all of it, and writes from shaders or
+// transfers may only cover part of it.
+bool RenderGraph::reads(const Access& access)
+{
+	if (access.role == RESOLVE)
+		return false;
+	if (access.role != OTHER)
+		return !access.clear;
+	return true;
+}
+
+RenderGraph::Handle RenderGraph::add_resource(Resource resource)
+{
+	m_resources.push_back(std::move(resource));
+	return static_cast<Handle>(m_resources.size() - 1);
+}
+
+RenderGraph::Handle RenderGraph::import_image(const std::string& name, const ImageInfo& info, Use initial, Use final)
+{
+	return add_resource({ name, true, true, info, initial, final });
+}
+
+RenderGraph::Handle RenderGraph::import_buffer(const std::string& name, Use initial, Use final)
+{
+	return add_resource({ name, false, true, {}, initial, final });
+}
+
+RenderGraph::Handle RenderGraph::create_image(const std::string& name, const ImageInfo& info)
+{
+	return add_resource({ name, true, false, info, UNDEFINED, UNDEFINED });
+}
+
+RenderGraph::Handle RenderGraph::add_pass(const std::string& name, Type type)
+{
+	Pass pass;
+	pass.name = name;
+	pass.type = type;
+	m_passes.push_back(std::move(pass));
+	return static_cast<Handle>(m_passes.size() - 1);
+}
+
+void RenderGraph::color(Handle pass, Handle image, Handle resolve, bool clear)
+{
+	if (m_passes[pass].type != RASTER)
+		throw std::runtime_error("render graph pass " + m_passes[pass].name + " has attachments but doesn't raster");
+	m_passes[pass].accesses.push_back({ image, COLOR_ATTACHMENT, COLOR, clear });
+	if (resolve != NONE)
+		m_passes[pass].accesses.push_back({ resolve, COLOR_ATTACHMENT, RESOLVE, false });
+}
+
+void RenderGraph::depth(Handle pass, Handle image, bool read_only, bool clear)
+{
+	if (m_passes[pass].type != RASTER)
+		throw std::runtime_error("render graph pass " + m_passes[pass].name + " has attachments but doesn't raster");
+	m_passes[pass].accesses.push_back({ image, read_only ? DEPTH_READ : DEPTH_ATTACHMENT, DEPTH, clear });
+}
+
+void RenderGraph::read(Handle pass, Handle resource, Use use)
+{
+	m_passes[pass].accesses.push_back({ resource, use, OTHER, false });
+}
+
+void RenderGraph::write(Handle pass, Handle resource, Use use)
+{
+	m_passes[pass].accesses.push_back({ resource, use, OTHER, false });
+}
+
+void RenderGraph::keep(Handle pass)
+{
+	m_passes[pass].keep = true;
+}
+
+void RenderGraph::clear()
+{
+	m_passes.clear();
+	m_resources.clear();
+	m_groups.clear();
+	m_final_barriers.clear();
+	m_transients.clear();
+	m_first_syncs.clear();
+	m_last_uses.clear();
+}
+
+bool RenderGraph::extent(const Pass& pass, uint32_t& width, uint32_t& height) const
+{
+	bool found = false;
+	for (const Access& access : pass.accesses) {
+		if (access.role == OTHER)
+			continue;
+		const ImageInfo& info = m_resources[access.resource].info;
+		if (!found) {
+			width = info.width;
+			height = info.height;
+			found = true;
+		} else if (info.width != width || info.height != height) {
+			throw std::runtime_error("render graph pass " + pass.name + " has attachments of different sizes");
+		}
+	}
+	return found;
+}
+
+void RenderGraph::cull(std::vector<Handle>& alive) const
+{
+	// each pass depends on the last pass to write what it reads
+	std::vector<std::vector<Handle>> producers(m_passes.size());
+	std::vector<Handle> last_writer(m_resources.size(), NONE);
+	std::vector<uint8_t> needed(m_passes.size(), 0);
+	for (Handle p = 0; p < m_passes.size(); ++p) {
+		const Pass& pass = m_passes[p];
+		for (const Access& access : pass.accesses)
+			if (reads(access) && last_writer[access.resource] != NONE)
+				producers[p].push_back(last_writer[access.resource]);
+		for (const Access& access : pass.accesses) {
+			if (!is_write(access.use))
+				continue;
+			last_writer[access.resource] = p;
+			if (m_resources[access.resource].imported)
+				needed[p] = 1;
+		}
+		if (pass.keep)
+			needed[p] = 1;
+	}
+
+	// producers always come first, so one walk backwards finds them all
+	for (Handle p = static_cast<Handle>(m_passes.size()); p-- > 0;)
+		if (needed[p])
+			for (Handle producer : producers[p])
+				needed[producer] = 1;
+
+	alive.clear();
+	for (Handle p = 0; p < m_passes.size(); ++p)
+		if (needed[p])
+			alive.push_back(p);
+}
+
+bool RenderGraph::can_merge(const Group& group, const Pass& pass) const
+{
+	if (!merge_subpasses || group.type != RASTER || pass.type != RASTER)
+		return false;
+	uint32_t width, height;
+	if (!extent(pass, width, height) || width != group.width || height != group.height)
+		return false;
+
+	// A resource has to be an attachment everywhere in the render pass or
+	// nowhere, and anything else has to be read the same way throughout, so
+	// the group's one batch of barriers covers it
+	for (const Access& access : pass.accesses) {
+		for (Handle other : group.passes) {
+			for (const Access& before : m_passes[other].accesses) {
+				if (before.resource != access.resource)
+					continue;
+				if ((before.role == OTHER) != (access.role == OTHER))
+					return false;
+				if (access.role == OTHER && (before.use != access.use || is_write(access.use)))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+void RenderGraph::form_groups(const std::vector<Handle>& alive)
+{
+	for (Handle p : alive) {
+		Pass& pass = m_passes[p];
+		if (m_groups.empty() || !can_merge(m_groups.back(), pass)) {
+			Group group;
+			group.type = pass.type;
+			if (pass.type == RASTER)
+				extent(pass, group.width, group.height);
+			m_groups.push_back(std::move(group));
+		}
+		Group& group = m_groups.back();
+		pass.group = static_cast<uint32_t>(m_groups.size() - 1);
+		pass.subpass = static_cast<uint32_t>(group.passes.size());
+		group.passes.push_back(p);
+	}
+}
+
+// Dependencies between the same pair of subpasses share one entry
+static uint32_t add_dependency(RenderGraph::Group& group, uint32_t src, uint32_t dst, uint32_t src_uses, uint32_t dst_uses)
+{
+	for (uint32_t i = 0; i < group.dependencies.size(); ++i) {
+		RenderGraph::Dependency& dependency = group.dependencies[i];
+		if (dependency.src_subpass == src && dependency.dst_subpass == dst) {
+			dependency.src_uses |= src_uses;
+			dependency.dst_uses |= dst_uses;
+			return i;
+		}
+	}
+	group.dependencies.push_back({ src, dst, src_uses, dst_uses });
+	return static_cast<uint32_t>(group.dependencies.size() - 1);
+}
+
+void RenderGraph::synchronize()
+{
+	// Every group's accesses to each resource, in order, to look ahead from
+	struct Touch {
+		uint32_t group;
+		const Access* access;
+	};
+	std::vector<std::vector<Touch>> touches(m_resources.size());
+	std::vector<uint32_t> transient_of(m_resources.size(), NONE);
+	m_last_uses.assign(m_resources.size(), UNDEFINED);
+	for (uint32_t g = 0; g < m_groups.size(); ++g) {
+		for (Handle p : m_groups[g].passes) {
+			for (const Access& access : m_passes[p].accesses) {
+				Handle r = access.resource;
+				touches[r].push_back({ g, &access });
+				m_last_uses[r] = access.use;
+				if (m_resources[r].imported || !m_resources[r].image)
+					continue;
+				if (transient_of[r] == NONE) {
+					transient_of[r] = static_cast<uint32_t>(m_transients.size());
+					m_transients.push_back({ r, g, g, 0, false });
+				}
+				Transient& transient = m_transients[transient_of[r]];
+				transient.last_group = g;
+				transient.uses |= bit(access.use);
+			}
+		}
+	}
+	m_first_syncs.assign(m_transients.size(), { NONE, 0, false });
+
+	// stored when a later group needs what's there, or it's imported and
+	// nothing later in the frame touches it
+	auto store = [&](Handle r, uint32_t g) {
+		for (const Touch& touch : touches[r])
+			if (touch.group > g)
+				return reads(*touch.access);
+		return m_resources[r].imported;
+	};
+
+	// Where each resource was left, and the render pass attachment it was
+	// last, if it was one
+	struct State {
+		Use use;
+		bool contents;
+		uint32_t group;
+		uint32_t attachment;
+		uint32_t subpass;
+	};
+	std::vector<State> states(m_resources.size());
+	for (Handle r = 0; r < m_resources.size(); ++r)
+		states[r] = { m_resources[r].initial, m_resources[r].imported, NONE, 0, 0 };
+
+	for (uint32_t g = 0; g < m_groups.size(); ++g) {
+		Group& group = m_groups[g];
+		for (uint32_t s = 0; s < group.passes.size(); ++s) {
+			const Pass& pass = m_passes[group.passes[s]];
+			if (group.type == RASTER) {
+				group.subpasses.emplace_back();
+				group.subpasses.back().pass = group.passes[s];
+			}
+
+			for (const Access& access : pass.accesses) {
+				Handle r = access.resource;
+				State& state = states[r];
+				uint32_t t = transient_of[r];
+				// the first use of a transient waits on its last one, from
+				// the frame before
+				bool first = t != NONE && state.use == UNDEFINED && !state.contents;
+				uint32_t wait = state.use == UNDEFINED ? 0 : bit(state.use);
+				if (first)
+					wait |= bit(m_last_uses[r]);
+
+				if (access.role == OTHER) {
+					if (state.group != NONE) {
+						// the render pass it was last an attachment of leaves
+						// it ready
+						Group& before = m_groups[state.group];
+						before.attachments[state.attachment].final = access.use;
+						add_dependency(before, state.subpass, EXTERNAL, bit(state.use), bit(access.use));
+					} else if (state.use == access.use && !is_write(access.use)) {
+						// read the same way as last time
+					} else if (wait != 0 || m_resources[r].image) {
+						group.barriers.push_back({ r, state.contents ? state.use : UNDEFINED, access.use, wait });
+						if (first)
+							m_first_syncs[t] = { g, static_cast<uint32_t>(group.barriers.size() - 1), true };
+					}
+					state = { access.use, state.contents || is_write(access.use), NONE, 0, 0 };
+					continue;
+				}
+
+				Subpass& subpass = group.subpasses[s];
+				uint32_t index;
+				if (state.group == g) {
+					index = state.attachment;
+					if (state.subpass != s)
+						add_dependency(group, state.subpass, s, bit(state.use), bit(access.use));
+				} else {
+					index = static_cast<uint32_t>(group.attachments.size());
+					bool load = reads(access) && state.contents;
+					Load op = access.role == RESOLVE ? DONT_CARE : access.clear ? CLEAR : load ? LOAD : DONT_CARE;
+					group.attachments.push_back({ r, op, store(r, g), load ? state.use : UNDEFINED, access.use });
+					if (wait != 0) {
+						uint32_t dependency = add_dependency(group, EXTERNAL, s, wait, bit(access.use));
+						if (first)
+							m_first_syncs[t] = { g, dependency, false };
+					}
+				}
+
+				if (access.role == COLOR) {
+					subpass.colors.push_back(index);
+					subpass.resolves.push_back(EXTERNAL);
+				} else if (access.role == RESOLVE) {
+					subpass.resolves.back() = index;
+				} else {
+					subpass.depth = index;
+					subpass.depth_use = access.use;
+				}
+				group.attachments[index].final = access.use;
+				state = { access.use, state.contents || is_write(access.use), g, index, s };
+			}
+		}
+	}
+
+	// imported resources end the frame how they were asked to
+	for (Handle r = 0; r < m_resources.size(); ++r) {
+		const Resource& resource = m_resources[r];
+		const State& state = states[r];
+		if (!resource.imported || resource.final == UNDEFINED || resource.final == state.use)
+			continue;
+		if (state.group != NONE) {
+			Group& before = m_groups[state.group];
+			before.attachments[state.attachment].final = resource.final;
+			add_dependency(before, state.subpass, EXTERNAL, bit(state.use), bit(resource.final));
+		} else {
+			m_final_barriers.push_back({ r, state.use, resource.final, state.use == UNDEFINED ? 0 : bit(state.use) });
+		}
+	}
+
+	// Never loaded or stored and only ever an attachment of one render pass.
+	// Render passes hold a resource as attachments everywhere or nowhere, so
+	// being one of its attachments is enough.
+	for (Transient& transient : m_transients) {
+		if (transient.first_group != transient.last_group)
+			continue;
+		const Group& group = m_groups[transient.first_group];
+		if (group.type != RASTER)
+			continue;
+		for (const Attachment& attachment : group.attachments)
+			if (attachment.resource == transient.resource)
+				transient.memoryless = attachment.load != LOAD && !attachment.store;
+	}
+}
+
+void RenderGraph::compile()
+{
+	for (Pass& pass : m_passes) {
+		pass.group = NONE;
+		pass.subpass = 0;
+	}
+	m_groups.clear();
+	m_final_barriers.clear();
+	m_transients.clear();
+	m_first_syncs.clear();
+
+	std::vector<Handle> alive;
+	cull(alive);
+	form_groups(alive);
+	synchronize();
+}
+
+uint64_t RenderGraph::alias(const std::vector<MemoryRequirement>& requirements, bool include_memoryless)
+{
+	if (requirements.size() != m_transients.size())
+		throw std::runtime_error("render graph needs a memory requirement for every transient");
+
+	std::vector<uint32_t> order;
+	for (uint32_t t = 0; t < m_transients.size(); ++t)
+		if (include_memoryless || !m_transients[t].memoryless)
+			order.push_back(t);
+	// biggest first packs tighter
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return requirements[a].size > requirements[b].size;
+	});
+
+	auto concurrent = [&](uint32_t a, uint32_t b) {
+		return m_transients[a].first_group <= m_transients[b].last_group
+			&& m_transients[b].first_group <= m_transients[a].last_group;
+	};
+	auto overlapping = [&](uint32_t a, uint32_t b) {
+		return m_transients[a].offset < m_transients[b].offset + requirements[b].size
+			&& m_transients[b].offset < m_transients[a].offset + requirements[a].size;
+	};
+
+	uint64_t size = 0;
+	std::vector<uint32_t> placed;
+	for (uint32_t t : order) {
+		const MemoryRequirement& requirement = requirements[t];
+		uint64_t alignment = std::max<uint64_t>(requirement.alignment, 1);
+		Transient& transient = m_transients[t];
+
+		// lowest offset clear of everything alive at the same time, moving
+		// past whatever's in the way until nothing is
+		transient.offset = 0;
+		for (bool moved = true; moved;) {
+			moved = false;
+			for (uint32_t other : placed) {
+				if (!concurrent(t, other) || !overlapping(t, other))
+					continue;
+				uint64_t end = m_transients[other].offset + requirements[other].size;
+				transient.offset = (end + alignment - 1) / alignment * alignment;
+				moved = true;
+			}
+		}
+		placed.push_back(t);
+		size = std::max(size, transient.offset + requirement.size);
+	}
+
+	// Taking over memory waits for the last use of whatever had it, whether
+	// that was earlier in the frame or is later in the one before
+	for (uint32_t t : placed) {
+		const FirstSync& sync = m_first_syncs[t];
+		if (sync.group == NONE)
+			continue;
+		uint32_t wait = 0;
+		for (uint32_t other : placed)
+			if (other != t && !concurrent(t, other) && overlapping(t, other))
+				wait |= bit(m_last_uses[m_transients[other].resource]);
+		Group& group = m_groups[sync.group];
+		if (sync.barrier)
+			group.barriers[sync.index].wait |= wait;
+		else
+			group.dependencies[sync.index].src_uses |= wait;
+	}
+	return size;
+}
+
+}
@@ -0,0 +1,744 @@
+#include "render_graph_executor.hpp"
+#include "context.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace chch {
+
+using Graph = RenderGraph;
+
+static bool is_depth_format(VkFormat format)
+{
+	return format == VK_FORMAT_D16_UNORM
+		|| format == VK_FORMAT_X8_D24_UNORM_PACK32
+		|| format == VK_FORMAT_D32_SFLOAT
+		|| format == VK_FORMAT_D16_UNORM_S8_UINT
+		|| format == VK_FORMAT_D24_UNORM_S8_UINT
+		|| format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+static VkImageLayout layout_of(Graph::Use use, bool depth)
+{
+	switch (use) {
+	case Graph::COLOR_ATTACHMENT:
+		return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	case Graph::DEPTH_ATTACHMENT:
+		return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	case Graph::DEPTH_READ:
+		return VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	case Graph::SHADER_READ:
+	case Graph::COMPUTE_READ:
+		return depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	case Graph::COMPUTE_WRITE:
+		return VK_IMAGE_LAYOUT_GENERAL;
+	case Graph::TRANSFER_READ:
+		return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	case Graph::TRANSFER_WRITE:
+		return VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	case Graph::PRESENT:
+		return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	default:
+		return VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+}
+
+// src is the side being waited on
+static VkPipelineStageFlags stages_of(uint32_t uses, bool src)
+{
+	VkPipelineStageFlags stages = 0;
+	for (uint32_t use = 0; use < Graph::USE_COUNT; ++use) {
+		if (!(uses & (1u << use)))
+			continue;
+		switch (static_cast<Graph::Use>(use)) {
+		case Graph::COLOR_ATTACHMENT:
+			stages |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			break;
+		case Graph::DEPTH_ATTACHMENT:
+		case Graph::DEPTH_READ:
+			stages |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			break;
+		case Graph::SHADER_READ:
+			stages |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			break;
+		case Graph::COMPUTE_READ:
+		case Graph::COMPUTE_WRITE:
+			stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			break;
+		case Graph::INDIRECT_READ:
+			stages |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+			break;
+		case Graph::TRANSFER_READ:
+		case Graph::TRANSFER_WRITE:
+			stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			break;
+		case Graph::PRESENT:
+			// frames wait on the acquire semaphore at color output, so
+			// leaving present from there chains onto it
+			stages |= src ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			break;
+		default:
+			break;
+		}
+	}
+	if (stages == 0)
+		stages = src ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	return stages;
+}
+
+// only writes have anything to make available on the src side
+static VkAccessFlags access_of(uint32_t uses, bool src)
+{
+	VkAccessFlags access = 0;
+	for (uint32_t use = 0; use < Graph::USE_COUNT; ++use) {
+		if (!(uses & (1u << use)))
+			continue;
+		switch (static_cast<Graph::Use>(use)) {
+		case Graph::COLOR_ATTACHMENT:
+			access |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			if (!src)
+				access |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+			break;
+		case Graph::DEPTH_ATTACHMENT:
+			access |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			if (!src)
+				access |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+			break;
+		case Graph::DEPTH_READ:
+			if (!src)
+				access |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+			break;
+		case Graph::SHADER_READ:
+		case Graph::COMPUTE_READ:
+			if (!src)
+				access |= VK_ACCESS_SHADER_READ_BIT;
+			break;
+		case Graph::COMPUTE_WRITE:
+			access |= VK_ACCESS_SHADER_WRITE_BIT;
+			if (!src)
+				access |= VK_ACCESS_SHADER_READ_BIT;
+			break;
+		case Graph::INDIRECT_READ:
+			if (!src)
+				access |= VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			break;
+		case Graph::TRANSFER_READ:
+			if (!src)
+				access |= VK_ACCESS_TRANSFER_READ_BIT;
+			break;
+		case Graph::TRANSFER_WRITE:
+			access |= VK_ACCESS_TRANSFER_WRITE_BIT;
+			break;
+		default:
+			break;
+		}
+	}
+	return access;
+}
+
+static VkAttachmentLoadOp load_op(Graph::Load load)
+{
+	switch (load) {
+	case Graph::LOAD:
+		return VK_ATTACHMENT_LOAD_OP_LOAD;
+	case Graph::CLEAR:
+		return VK_ATTACHMENT_LOAD_OP_CLEAR;
+	default:
+		return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	}
+}
+
+static VkImageUsageFlags usage_of(uint32_t uses)
+{
+	VkImageUsageFlags usage = 0;
+	if (uses & Graph::bit(Graph::COLOR_ATTACHMENT))
+		usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	if (uses & (Graph::bit(Graph::DEPTH_ATTACHMENT) | Graph::bit(Graph::DEPTH_READ)))
+		usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	if (uses & (Graph::bit(Graph::SHADER_READ) | Graph::bit(Graph::COMPUTE_READ)))
+		usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (uses & Graph::bit(Graph::COMPUTE_WRITE))
+		usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+	if (uses & Graph::bit(Graph::TRANSFER_READ))
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	if (uses & Graph::bit(Graph::TRANSFER_WRITE))
+		usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	return usage;
+}
+
+void RenderGraphExecutor::init(const Context* context)
+{
+	m_context = context;
+}
+
+void RenderGraphExecutor::deinit()
+{
+	if (!m_context)
+		return;
+	release(nullptr, 0);
+	for (auto& cached : m_render_pass_cache)
+		vkDestroyRenderPass(m_context->device, cached.render_pass, m_context->allocation_callbacks);
+	m_render_pass_cache.clear();
+	m_graph = nullptr;
+	m_context = nullptr;
+}
+
+void RenderGraphExecutor::release(DeletionQueue* retired, uint64_t frame)
+{
+	std::vector<VkFramebuffer> framebuffers;
+	for (auto& f : m_framebuffers)
+		framebuffers.push_back(f.framebuffer);
+	std::vector<Image> images;
+	for (Graph::Handle handle : m_transients)
+		images.push_back(m_images[handle]);
+
+	auto destroy = [context = m_context, framebuffers, images, aliased = m_aliased]() {
+		for (auto framebuffer : framebuffers)
+			vkDestroyFramebuffer(context->device, framebuffer, context->allocation_callbacks);
+		for (const auto& image : images) {
+			vkDestroyImageView(context->device, image.image_view, context->allocation_callbacks);
+			vkDestroyImage(context->device, image.image, context->allocation_callbacks);
+			if (image.allocation != VK_NULL_HANDLE)
+				vmaFreeMemory(context->allocator, image.allocation);
+		}
+		if (aliased != VK_NULL_HANDLE)
+			vmaFreeMemory(context->allocator, aliased);
+	};
+	if (retired)
+		retired->push(frame, std::move(destroy));
+	else
+		destroy();
+
+	m_framebuffers.clear();
+	m_render_passes.clear();
+	m_clear_values.clear();
+	m_begin_barriers.clear();
+	m_end_barriers.clear();
+	m_transients.clear();
+	m_aliased = VK_NULL_HANDLE;
+	m_aliased_size = 0;
+
+	m_images.clear();
+	m_aspects.clear();
+	m_buffers.clear();
+}
+
+void RenderGraphExecutor::build(RenderGraph& graph, DeletionQueue* retired, uint64_t frame)
+{
+	release(retired, frame);
+	m_graph = &graph;
+	if (dynamic_rendering)
+		graph.merge_subpasses = false;
+	graph.compile();
+
+	size_t count = graph.resource_count();
+	m_images.assign(count, Image { VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE });
+	m_aspects.assign(count, 0);
+	m_buffers.assign(count, VK_NULL_HANDLE);
+	for (Graph::Handle r = 0; r < count; ++r) {
+		if (!graph.is_image(r))
+			continue;
+		auto format = static_cast<VkFormat>(graph.image_info(r).format);
+		m_aspects[r] = VK_IMAGE_ASPECT_COLOR_BIT;
+		if (is_depth_format(format)) {
+			m_aspects[r] = VK_IMAGE_ASPECT_DEPTH_BIT;
+			if (has_stencil_component(format))
+				m_aspects[r] |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+	}
+
+	init_transients();
+	init_render_passes(retired, frame);
+	if (dynamic_rendering)
+		init_rendering_barriers();
+}
+
+void RenderGraphExecutor::init_transients()
+{
+	const auto& transients = m_graph->transients();
+
+	// tiled GPUs keep attachments that never leave the render pass on chip,
+	// desktop ones have no such memory and alias them with the rest
+	bool lazy = false;
+	for (uint32_t i = 0; i < m_context->memory_properties.memoryTypeCount; ++i)
+		if (m_context->memory_properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+			lazy = true;
+
+	std::vector<Graph::MemoryRequirement> requirements(transients.size());
+	uint32_t type_bits = UINT32_MAX;
+	VkDeviceSize alignment = 1;
+	for (size_t t = 0; t < transients.size(); ++t) {
+		const auto& transient = transients[t];
+		const auto& info = m_graph->image_info(transient.resource);
+		bool memoryless = transient.memoryless && lazy;
+
+		VkImageCreateInfo image_info {};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.extent = { info.width, info.height, 1 };
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.format = static_cast<VkFormat>(info.format);
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		image_info.usage = usage_of(transient.uses);
+		if (memoryless)
+			image_info.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		image_info.samples = static_cast<VkSampleCountFlagBits>(info.samples);
+
+		Image& image = m_images[transient.resource];
+		auto result = vkCreateImage(m_context->device, &image_info, m_context->allocation_callbacks, &image.image);
+		vk_check(result, "Failed to create render graph image");
+		m_transients.push_back(transient.resource);
+
+		VkMemoryRequirements memory;
+		vkGetImageMemoryRequirements(m_context->device, image.image, &memory);
+		requirements[t] = { memory.size, memory.alignment };
+		if (!memoryless) {
+			type_bits &= memory.memoryTypeBits;
+			alignment = std::max(alignment, memory.alignment);
+		}
+	}
+
+	// one block for everything that isn't lazily allocated, unless the images
+	// can't agree on a memory type
+	VkDeviceSize size = m_graph->alias(requirements, !lazy);
+	bool shared = size > 0 && type_bits != 0;
+	if (shared) {
+		VkMemoryRequirements block { size, alignment, type_bits };
+		VmaAllocationCreateInfo alloc_info {};
+		alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		auto result = vmaAllocateMemory(m_context->allocator, &block, &alloc_info, &m_aliased, nullptr);
+		vk_check(result, "Failed to allocate render graph memory");
+		m_aliased_size = size;
+	}
+
+	for (const auto& transient : transients) {
+		Image& image = m_images[transient.resource];
+		bool memoryless = transient.memoryless && lazy;
+		VkResult result;
+		if (shared && !memoryless) {
+			result = vmaBindImageMemory2(m_context->allocator, m_aliased, transient.offset, image.image, nullptr);
+		} else {
+			VmaAllocationCreateInfo alloc_info {};
+			alloc_info.usage = memoryless ? VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED : VMA_MEMORY_USAGE_GPU_ONLY;
+			result = vmaAllocateMemoryForImage(m_context->allocator, image.image, &alloc_info, &image.allocation, nullptr);
+			vk_check(result, "Failed to allocate render graph image");
+			result = vmaBindImageMemory(m_context->allocator, image.allocation, image.image);
+		}
+		vk_check(result, "Failed to bind render graph image");
+
+		// depth is viewed without stencil so it can be sampled
+		VkImageViewCreateInfo view_info {};
+		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_info.image = image.image;
+		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_info.format = static_cast<VkFormat>(m_graph->image_info(transient.resource).format);
+		view_info.subresourceRange.aspectMask = m_aspects[transient.resource] & ~VK_IMAGE_ASPECT_STENCIL_BIT;
+		view_info.subresourceRange.baseMipLevel = 0;
+		view_info.subresourceRange.levelCount = 1;
+		view_info.subresourceRange.baseArrayLayer = 0;
+		view_info.subresourceRange.layerCount = 1;
+
+		result = vkCreateImageView(m_context->device, &view_info, m_context->allocation_callbacks, &image.image_view);
+		vk_check(result, "Failed to create render graph image view");
+	}
+}
+
+// Everything that goes into a group's render pass, sizes aside
+static std::vector<uint32_t> render_pass_key(const Graph& graph, const Graph::Group& group)
+{
+	std::vector<uint32_t> key;
+	key.push_back(static_cast<uint32_t>(group.attachments.size()));
+	for (const auto& a : group.attachments) {
+		const auto& info = graph.image_info(a.resource);
+		key.insert(key.end(), { info.format, info.samples, a.load, a.store, a.initial, a.final });
+	}
+	key.push_back(static_cast<uint32_t>(group.subpasses.size()));
+	for (const auto& subpass : group.subpasses) {
+		key.push_back(static_cast<uint32_t>(subpass.colors.size()));
+		key.insert(key.end(), subpass.colors.begin(), subpass.colors.end());
+		key.insert(key.end(), subpass.resolves.begin(), subpass.resolves.end());
+		key.insert(key.end(), { subpass.depth, subpass.depth_use });
+	}
+	for (const auto& d : group.dependencies)
+		key.insert(key.end(), { d.src_subpass, d.dst_subpass, d.src_uses, d.dst_uses });
+	return key;
+}
+
+void RenderGraphExecutor::init_render_passes(DeletionQueue* retired, uint64_t frame)
+{
+	const auto& groups = m_graph->groups();
+	m_render_passes.assign(groups.size(), VK_NULL_HANDLE);
+	m_clear_values.assign(groups.size(), {});
+	auto cache = std::move(m_render_pass_cache);
+	m_render_pass_cache.clear();
+
+	for (size_t g = 0; g < groups.size(); ++g) {
+		const auto& group = groups[g];
+		if (group.type != Graph::RASTER)
+			continue;
+
+		auto key = render_pass_key(*m_graph, group);
+		auto cached = std::find_if(cache.begin(), cache.end(), [&](const CachedRenderPass& c) { return c.key == key; });
+		bool reused = !dynamic_rendering && cached != cache.end();
+		if (reused) {
+			m_render_passes[g] = cached->render_pass;
+			m_render_pass_cache.push_back(std::move(*cached));
+			cache.erase(cached);
+		}
+
+		std::vector<VkAttachmentDescription> attachments;
+		for (const auto& a : group.attachments) {
+			const auto& info = m_graph->image_info(a.resource);
+			auto format = static_cast<VkFormat>(info.format);
+			bool depth = is_depth_format(format);
+
+			VkAttachmentDescription attachment {};
+			attachment.format = format;
+			attachment.samples = static_cast<VkSampleCountFlagBits>(info.samples);
+			attachment.loadOp = load_op(a.load);
+			attachment.storeOp = a.store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = layout_of(a.initial, depth);
+			attachment.finalLayout = layout_of(a.final, depth);
+			attachments.push_back(attachment);
+
+			VkClearValue clear {};
+			if (depth)
+				clear.depthStencil = { info.clear.depth_stencil.depth, info.clear.depth_stencil.stencil };
+			else
+				memcpy(clear.color.float32, info.clear.color, sizeof(clear.color.float32));
+			m_clear_values[g].push_back(clear);
+		}
+		// dynamic rendering only needs the clear values
+		if (reused || dynamic_rendering)
+			continue;
+
+		// the references have to live until the render pass is made
+		size_t subpass_count = group.subpasses.size();
+		std::vector<std::vector<VkAttachmentReference>> colors(subpass_count);
+		std::vector<std::vector<VkAttachmentReference>> resolves(subpass_count);
+		std::vector<VkAttachmentReference> depths(subpass_count);
+		std::vector<VkSubpassDescription> subpasses(subpass_count);
+		for (size_t s = 0; s < subpass_count; ++s) {
+			const auto& subpass = group.subpasses[s];
+			bool resolved = false;
+			for (size_t c = 0; c < subpass.colors.size(); ++c) {
+				colors[s].push_back({ subpass.colors[c], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+				uint32_t resolve = subpass.resolves[c];
+				resolves[s].push_back({
+					resolve == Graph::EXTERNAL ? VK_ATTACHMENT_UNUSED : resolve,
+					VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+				resolved |= resolve != Graph::EXTERNAL;
+			}
+
+			VkSubpassDescription& description = subpasses[s];
+			description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			description.colorAttachmentCount = static_cast<uint32_t>(colors[s].size());
+			description.pColorAttachments = colors[s].data();
+			description.pResolveAttachments = resolved ? resolves[s].data() : nullptr;
+			if (subpass.depth != Graph::EXTERNAL) {
+				depths[s] = { subpass.depth, layout_of(subpass.depth_use, true) };
+				description.pDepthStencilAttachment = &depths[s];
+			}
+		}
+
+		std::vector<VkSubpassDependency> dependencies;
+		for (const auto& d : group.dependencies) {
+			VkSubpassDependency dependency {};
+			dependency.srcSubpass = d.src_subpass == Graph::EXTERNAL ? VK_SUBPASS_EXTERNAL : d.src_subpass;
+			dependency.dstSubpass = d.dst_subpass == Graph::EXTERNAL ? VK_SUBPASS_EXTERNAL : d.dst_subpass;
+			dependency.srcStageMask = stages_of(d.src_uses, true);
+			dependency.dstStageMask = stages_of(d.dst_uses, false);
+			dependency.srcAccessMask = access_of(d.src_uses, true);
+			dependency.dstAccessMask = access_of(d.dst_uses, false);
+			// between subpasses a pixel only ever needs itself
+			if (d.src_subpass != Graph::EXTERNAL && d.dst_subpass != Graph::EXTERNAL)
+				dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+			dependencies.push_back(dependency);
+		}
+
+		VkRenderPassCreateInfo create_info {};
+		create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		create_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+		create_info.pAttachments = attachments.data();
+		create_info.subpassCount = static_cast<uint32_t>(subpasses.size());
+		create_info.pSubpasses = subpasses.data();
+		create_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		create_info.pDependencies = dependencies.data();
+
+		auto result = vkCreateRenderPass(m_context->device, &create_info, m_context->allocation_callbacks, &m_render_passes[g]);
+		vk_check(result, "Failed to create render graph render pass");
+		m_render_pass_cache.push_back({ std::move(key), m_render_passes[g] });
+	}
+
+	for (auto& stale : cache) {
+		auto destroy = [context = m_context, render_pass = stale.render_pass]() {
+			vkDestroyRenderPass(context->device, render_pass, context->allocation_callbacks);
+		};
+		if (retired)
+			retired->push(frame, destroy);
+		else
+			destroy();
+	}
+}
+
+// Render passes move attachments between layouts themselves and wait on the
+// group's external dependencies, without them that's done with barriers
+void RenderGraphExecutor::init_rendering_barriers()
+{
+	const auto& groups = m_graph->groups();
+	m_begin_barriers.assign(groups.size(), {});
+	m_end_barriers.assign(groups.size(), {});
+
+	for (size_t g = 0; g < groups.size(); ++g) {
+		const auto& group = groups[g];
+		m_begin_barriers[g] = group.barriers;
+		if (group.type != Graph::RASTER)
+			continue;
+
+		// merging is off, so there's the one subpass
+		uint32_t wait = 0;
+		for (const auto& d : group.dependencies)
+			if (d.src_subpass == Graph::EXTERNAL)
+				wait |= d.src_uses;
+
+		const auto& subpass = group.subpasses[0];
+		std::vector<Graph::Use> uses(group.attachments.size(), Graph::COLOR_ATTACHMENT);
+		if (subpass.depth != Graph::EXTERNAL)
+			uses[subpass.depth] = subpass.depth_use;
+
+		for (size_t a = 0; a < group.attachments.size(); ++a) {
+			const auto& attachment = group.attachments[a];
+			if (attachment.initial != uses[a] || wait != 0)
+				m_begin_barriers[g].push_back({ attachment.resource, attachment.initial, uses[a], wait });
+			if (attachment.final != uses[a])
+				m_end_barriers[g].push_back({ attachment.resource, uses[a], attachment.final, Graph::bit(uses[a]) });
+		}
+	}
+}
+
+void RenderGraphExecutor::set_image(RenderGraph::Handle image, VkImage vk_image, VkImageView view)
+{
+	m_images[image].image = vk_image;
+	m_images[image].image_view = view;
+}
+
+void RenderGraphExecutor::set_buffer(RenderGraph::Handle buffer, VkBuffer vk_buffer)
+{
+	m_buffers[buffer] = vk_buffer;
+}
+
+VkRenderPass RenderGraphExecutor::render_pass(RenderGraph::Handle pass) const
+{
+	uint32_t group = m_graph->group_of(pass);
+	return group == Graph::NONE ? VK_NULL_HANDLE : m_render_passes[group];
+}
+
+RenderTarget RenderGraphExecutor::render_target(RenderGraph::Handle pass) const
+{
+	RenderTarget target;
+	target.render_pass = render_pass(pass);
+	target.subpass = subpass(pass);
+	uint32_t g = m_graph->group_of(pass);
+	if (g == Graph::NONE || m_graph->groups()[g].type != Graph::RASTER)
+		return target;
+
+	const auto& group = m_graph->groups()[g];
+	const auto& subpass = group.subpasses[target.subpass];
+	auto format = [&](uint32_t attachment) {
+		return static_cast<VkFormat>(m_graph->image_info(group.attachments[attachment].resource).format);
+	};
+	for (uint32_t color : subpass.colors)
+		target.color_formats.push_back(format(color));
+	if (subpass.depth != Graph::EXTERNAL)
+		target.depth_format = format(subpass.depth);
+	return target;
+}
+
+VkFramebuffer RenderGraphExecutor::framebuffer(uint32_t group)
+{
+	const auto& g = m_graph->groups()[group];
+	std::vector<VkImageView> views;
+	for (const auto& attachment : g.attachments)
+		views.push_back(m_images[attachment.resource].image_view);
+
+	for (const auto& f : m_framebuffers)
+		if (f.group == group && f.views == views)
+			return f.framebuffer;
+
+	VkFramebufferCreateInfo framebuffer_info {};
+	framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebuffer_info.renderPass = m_render_passes[group];
+	framebuffer_info.attachmentCount = static_cast<uint32_t>(views.size());
+	framebuffer_info.pAttachments = views.data();
+	framebuffer_info.width = g.width;
+	framebuffer_info.height = g.height;
+	framebuffer_info.layers = 1;
+
+	VkFramebuffer framebuffer;
+	auto result = vkCreateFramebuffer(m_context->device, &framebuffer_info, m_context->allocation_callbacks, &framebuffer);
+	vk_check(result, "Failed to create render graph framebuffer");
+	m_framebuffers.push_back({ group, std::move(views), framebuffer });
+	return framebuffer;
+}
+
+void RenderGraphExecutor::record_barriers(VkCommandBuffer command_buffer, const std::vector<RenderGraph::Barrier>& barriers)
+{
+	if (barriers.empty())
+		return;
+
+	VkPipelineStageFlags src_stages = 0;
+	VkPipelineStageFlags dst_stages = 0;
+	std::vector<VkImageMemoryBarrier> image_barriers;
+	std::vector<VkBufferMemoryBarrier> buffer_barriers;
+	for (const auto& b : barriers) {
+		uint32_t after = Graph::bit(b.after);
+		src_stages |= stages_of(b.wait, true);
+		dst_stages |= stages_of(after, false);
+
+		if (!m_graph->is_image(b.resource)) {
+			VkBufferMemoryBarrier barrier {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = access_of(b.wait, true);
+			barrier.dstAccessMask = access_of(after, false);
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = m_buffers[b.resource];
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			buffer_barriers.push_back(barrier);
+			continue;
+		}
+
+		bool depth = (m_aspects[b.resource] & VK_IMAGE_ASPECT_DEPTH_BIT) != 0;
+		VkImageMemoryBarrier barrier {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = access_of(b.wait, true);
+		barrier.dstAccessMask = access_of(after, false);
+		barrier.oldLayout = layout_of(b.before, depth);
+		barrier.newLayout = layout_of(b.after, depth);
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = m_images[b.resource].image;
+		barrier.subresourceRange.aspectMask = m_aspects[b.resource];
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		image_barriers.push_back(barrier);
+	}
+
+	vkCmdPipelineBarrier(
+		command_buffer,
+		src_stages,
+		dst_stages,
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+		static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+}
+
+bool RenderGraphExecutor::begin_pass(VkCommandBuffer command_buffer, RenderGraph::Handle pass)
+{
+	uint32_t g = m_graph->group_of(pass);
+	if (g == Graph::NONE)
+		return false;
+	const auto& group = m_graph->groups()[g];
+	if (m_graph->subpass_of(pass) > 0) {
+		vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+		return true;
+	}
+
+	record_barriers(command_buffer, dynamic_rendering ? m_begin_barriers[g] : group.barriers);
+	if (group.type != Graph::RASTER)
+		return true;
+	if (dynamic_rendering) {
+		begin_rendering(command_buffer, g);
+		return true;
+	}
+
+	VkRenderPassBeginInfo render_pass_info {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_info.renderPass = m_render_passes[g];
+	render_pass_info.framebuffer = framebuffer(g);
+	render_pass_info.renderArea.offset = { 0, 0 };
+	render_pass_info.renderArea.extent = { group.width, group.height };
+	render_pass_info.clearValueCount = static_cast<uint32_t>(m_clear_values[g].size());
+	render_pass_info.pClearValues = m_clear_values[g].data();
+	vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+	return true;
+}
+
+void RenderGraphExecutor::begin_rendering(VkCommandBuffer command_buffer, uint32_t group)
+{
+	const auto& g = m_graph->groups()[group];
+	const auto& subpass = g.subpasses[0];
+	auto attachment_info = [&](uint32_t attachment, VkImageLayout layout) {
+		const auto& a = g.attachments[attachment];
+		VkRenderingAttachmentInfo info {};
+		info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+		info.imageView = m_images[a.resource].image_view;
+		info.imageLayout = layout;
+		info.resolveMode = VK_RESOLVE_MODE_NONE;
+		info.loadOp = load_op(a.load);
+		info.storeOp = a.store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		info.clearValue = m_clear_values[group][attachment];
+		return info;
+	};
+
+	std::vector<VkRenderingAttachmentInfo> colors;
+	for (size_t c = 0; c < subpass.colors.size(); ++c) {
+		auto info = attachment_info(subpass.colors[c], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		uint32_t resolve = subpass.resolves[c];
+		if (resolve != Graph::EXTERNAL) {
+			info.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+			info.resolveImageView = m_images[g.attachments[resolve].resource].image_view;
+			info.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
+		colors.push_back(info);
+	}
+
+	VkRenderingInfo rendering_info {};
+	rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+	rendering_info.renderArea.offset = { 0, 0 };
+	rendering_info.renderArea.extent = { g.width, g.height };
+	rendering_info.layerCount = 1;
+	rendering_info.colorAttachmentCount = static_cast<uint32_t>(colors.size());
+	rendering_info.pColorAttachments = colors.data();
+
+	VkRenderingAttachmentInfo depth {};
+	if (subpass.depth != Graph::EXTERNAL) {
+		depth = attachment_info(subpass.depth, layout_of(subpass.depth_use, true));
+		rendering_info.pDepthAttachment = &depth;
+	}
+	vkCmdBeginRendering(command_buffer, &rendering_info);
+}
+
+void RenderGraphExecutor::end_pass(VkCommandBuffer command_buffer, RenderGraph::Handle pass)
+{
+	uint32_t g = m_graph->group_of(pass);
+	if (g == Graph::NONE)
+		return;
+	const auto& group = m_graph->groups()[g];
+	if (group.type != Graph::RASTER || m_graph->subpass_of(pass) + 1 != group.subpasses.size())
+		return;
+	if (dynamic_rendering) {
+		vkCmdEndRendering(command_buffer);
+		record_barriers(command_buffer, m_end_barriers[g]);
+	} else {
+		vkCmdEndRenderPass(command_buffer);
+	}
+}
+
+void RenderGraphExecutor::finish(VkCommandBuffer command_buffer)
+{
+	record_barriers(command_buffer, m_graph->final_barriers());
+}
+
+}
@@ -108,7 +108,10 @@ RenderPassBuilder RenderPassBuilder::add_color_attachment(uint32_t attachment_in
 	return *this;
 }
 
-RenderPassBuilder RenderPassBuilder::add_color_resolve_attachment(uint32_t attachment_index, VkFormat format)
+RenderPassBuilder RenderPassBuilder::add_color_resolve_attachment(
+		uint32_t attachment_index,
+		VkFormat format,
+		VkImageLayout final_layout)
 {
 	VkAttachmentDescription attachment {};
 	attachment.format = format;
@@ -118,7 +121,7 @@ RenderPassBuilder RenderPassBuilder::add_color_resolve_attachment(uint32_t attac
 	attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	attachment.finalLayout = final_layout;
 
 	m_attachments[attachment_index] = attachment;
 	return *this;
@@ -131,11 +134,7 @@ RenderPassBuilder RenderPassBuilder::add_depth_attachment(
 		VkImageLayout final_layout)
 {
 	VkAttachmentDescription attachment {};
-	attachment.format = find_supported_format(
-		m_context,
-		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+	attachment.format = find_depth_format(m_context);
 	attachment.samples = samples;
 	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	attachment.storeOp = store_op;
@@ -148,6 +147,14 @@ RenderPassBuilder RenderPassBuilder::add_depth_attachment(
 	return *this;
 }
 
+RenderPassBuilder RenderPassBuilder::load_attachment(uint32_t attachment_index, VkImageLayout initial_layout)
+{
+	auto& attachment = m_attachments.at(attachment_index);
+	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachment.initialLayout = initial_layout;
+	return *this;
+}
+
 // TODO: Implement when I need these
 // RenderPassBuilder RenderPassBuilder::add_input_attachment(uint32_t attachment_index)
 //{
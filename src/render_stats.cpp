@@ -0,0 +1,75 @@
+#include "render_stats.hpp"
+
+#include <fstream>
+#include <sstream>
+
+namespace chch {
+
+double RenderStats::overdraw(uint32_t width, uint32_t height) const
+{
+	if (!gpu_valid || width == 0 || height == 0)
+		return 0.0;
+	return static_cast<double>(fragment_invocations) / (static_cast<double>(width) * height);
+}
+
+std::string render_stats_csv_header()
+{
+	return "frame,draws,instances,triangles,pipeline_binds,descriptor_binds,vertex_buffer_binds,"
+		"frustum_culled,occlusion_culled,deferred,"
+		"input_vertices,input_primitives,vertex_invocations,clipping_invocations,clipping_primitives,"
+		"fragment_invocations";
+}
+
+std::string render_stats_csv_row(const RenderStats& stats)
+{
+	std::ostringstream out;
+	out << stats.frame << ','
+		<< stats.draws << ','
+		<< stats.instances << ','
+		<< stats.triangles << ','
+		<< stats.pipeline_binds << ','
+		<< stats.descriptor_binds << ','
+		<< stats.vertex_buffer_binds << ','
+		<< stats.frustum_culled << ','
+		<< stats.occlusion_culled << ','
+		<< stats.deferred;
+	if (stats.gpu_valid) {
+		out << ',' << stats.input_vertices
+			<< ',' << stats.input_primitives
+			<< ',' << stats.vertex_invocations
+			<< ',' << stats.clipping_invocations
+			<< ',' << stats.clipping_primitives
+			<< ',' << stats.fragment_invocations;
+	} else {
+		out << ",,,,,,";
+	}
+	return out.str();
+}
+
+void RenderStatsLog::add(const RenderStats& stats)
+{
+	if (capacity == 0)
+		return;
+	m_frames.push_back(stats);
+	while (m_frames.size() > capacity)
+		m_frames.pop_front();
+}
+
+std::string RenderStatsLog::to_csv() const
+{
+	std::string csv = render_stats_csv_header() + '\n';
+	for (const auto& stats : m_frames)
+		csv += render_stats_csv_row(stats) + '\n';
+	return csv;
+}
+
+bool RenderStatsLog::write_csv(const std::filesystem::path& path) const
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file)
+		return false;
+	file << to_csv();
+	return static_cast<bool>(file);
+}
+
+}
@@ -1,6 +1,7 @@
 #include "renderer.hpp"
 #include "buffer.hpp"
 #include "camera.hpp"
+#include "cpu_profiler.hpp"
 #include "material.hpp"
 #include "mesh.hpp"
 #include "texture.hpp"
@@ -8,10 +9,13 @@
 #include "vertex.hpp"
 
 #include "descriptor_builder.hpp"
-#include "render_pass_builder.hpp"
+#include "pipeline_builder.hpp"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <thread>
 #include <vulkan/vulkan_core.h>
 
 namespace chch {
@@ -19,36 +23,92 @@ namespace chch {
 void Renderer::init(Context* p_context, SceneGlobals scene_globals, Camera* p_camera)
 {
 	context = p_context;
+	if (readback && !context->headless
+		&& !(context->surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+		std::cerr << "swap chain images can't be copied from, frame readback disabled" << std::endl;
+		readback = false;
+	}
+	readback_depth = readback_depth && readback;
+	if (readback_depth && context->msaa_samples != VK_SAMPLE_COUNT_1_BIT) {
+		std::cerr << "multisampled depth can't be copied, depth readback disabled" << std::endl;
+		readback_depth = false;
+	}
 	init_swap_chain();
 
 	init_image_views();
-	init_render_pass();
-	init_images();
-	init_framebuffers();
+	if (occlusion_culling && !OcclusionCuller::is_supported(context)) {
+		std::cerr << "depth buffer can't be sampled, occlusion culling disabled" << std::endl;
+		occlusion_culling = false;
+	}
+	if (dynamic_rendering && !context->dynamic_rendering) {
+		std::cerr << "device has no dynamic rendering, using render passes" << std::endl;
+		dynamic_rendering = false;
+	}
+	graph_executor.init(context);
+	graph_executor.dynamic_rendering = dynamic_rendering;
+	init_render_graph();
+	if (occlusion_culling)
+		occlusion_culler.init(context, graph_executor.image(m_depth_image), max_scene_objects);
+	if (readback)
+		frame_readback.init(
+			context,
+			context->surface_capabilities.currentExtent,
+			context->surface_format.format,
+			readback_depth ? m_depth_format : VK_FORMAT_UNDEFINED);
 
 	scene_uniform.init(context, scene_globals);
 	init_base_descriptor();
+	init_fallback_pipeline();
 
 	camera = p_camera;
 	frames.init(context);
+	gpu_scene.init(context, max_scene_objects);
+	draw_uniforms.init(context, draw_uniform_capacity);
+
+	// the recording thread takes a share of every parallel_for
+	thread_pool.init(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	culler.thread_pool = &thread_pool;
+	occlusion_rasterizer.init();
+	occlusion_rasterizer.thread_pool = &thread_pool;
+	if (gpu_profiling)
+		gpu_profiler.init(context);
+	if (pipeline_statistics)
+		pipeline_stats.init(context);
 }
 
 void Renderer::deinit()
 {
+	// frames still in flight go to their callbacks, after those of the
+	// readbacks a resize retired
+	vkDeviceWaitIdle(context->device);
+	m_retired.flush_all();
+	if (readback) {
+		frame_readback.complete_all();
+		frame_readback.deinit(context);
+	}
+	thread_pool.deinit();
+	gpu_profiler.deinit(context);
+	pipeline_stats.deinit(context);
+	occlusion_culler.deinit(context);
+	gpu_scene.deinit(context);
+	scene_bvh.clear();
+	m_scene_entities.clear();
+	m_scene_proxies.clear();
+	draw_uniforms.deinit(context);
 	frames.deinit(context);
-	depth_image.deinit(context);
-	msaa_image.deinit(context);
-
-	for (auto framebuffer : framebuffers)
-		vkDestroyFramebuffer(context->device, framebuffer, context->allocation_callbacks);
-
-	vkDestroyRenderPass(context->device, render_pass, context->allocation_callbacks);
+	graph_executor.deinit();
+	render_graph.clear();
+	render_target = RenderTarget {};
 
+	context->pipelines.release(m_fallback_pipeline);
 	scene_uniform.deinit(context);
-	vkDestroyDescriptorPool(context->device, descriptor_pool, context->allocation_callbacks);
-	for (auto& layout : descriptor_set_layout)
-		vkDestroyDescriptorSetLayout(context->device, layout, context->allocation_callbacks);
 
+	if (context->headless) {
+		for (auto& image : m_offscreen_images)
+			image.deinit(context);
+		m_offscreen_images.clear();
+		return;
+	}
 	for (auto view : swap_chain_image_views)
 		vkDestroyImageView(context->device, view, context->allocation_callbacks);
 	vkDestroySwapchainKHR(context->device, swap_chain, context->allocation_callbacks);
@@ -56,6 +116,11 @@ void Renderer::deinit()
 
 void Renderer::init_swap_chain()
 {
+	if (context->headless) {
+		init_offscreen_images();
+		return;
+	}
+
 	uint32_t image_count = context->surface_capabilities.minImageCount + 1;
 	if (context->surface_capabilities.maxImageCount > 0)
 		image_count = std::min(image_count, context->surface_capabilities.maxImageCount);
@@ -69,6 +134,8 @@ void Renderer::init_swap_chain()
 	create_info.imageExtent = context->surface_capabilities.currentExtent;
 	create_info.imageArrayLayers = 1;
 	create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	if (readback)
+		create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
 	if (context->unique_queue_indices.size() > 1) {
 		create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
@@ -84,7 +151,8 @@ void Renderer::init_swap_chain()
 	create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	create_info.presentMode = context->present_mode;
 	create_info.clipped = VK_TRUE;
-	create_info.oldSwapchain = VK_NULL_HANDLE;
+	// images the old one already handed out stay presentable meanwhile
+	create_info.oldSwapchain = swap_chain;
 
 	if (vkCreateSwapchainKHR(context->device, &create_info, context->allocation_callbacks, &swap_chain) != VK_SUCCESS)
 		throw std::runtime_error("failed to create swap chain");
@@ -94,8 +162,39 @@ void Renderer::init_swap_chain()
 	vkGetSwapchainImagesKHR(context->device, swap_chain, &image_count, swap_chain_images.data());
 }
 
+void Renderer::init_offscreen_images()
+{
+	// copied out after drawing instead of presented
+	m_offscreen_images.resize(context->surface_capabilities.minImageCount);
+	swap_chain_images.clear();
+	for (auto& image : m_offscreen_images) {
+		image.init(
+			context,
+			context->surface_capabilities.currentExtent.width,
+			context->surface_capabilities.currentExtent.height,
+			1,
+			VK_SAMPLE_COUNT_1_BIT,
+			context->surface_format.format,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY);
+		swap_chain_images.push_back(image.image);
+	}
+	image_index = 0;
+}
+
 void Renderer::init_image_views()
 {
+	// the offscreen images come with their own
+	if (context->headless) {
+		swap_chain_image_views.clear();
+		for (auto& image : m_offscreen_images)
+			swap_chain_image_views.push_back(image.image_view);
+		return;
+	}
+
 	swap_chain_image_views.resize(swap_chain_images.size());
 	for (size_t i = 0; i < swap_chain_images.size(); ++i) {
 		VkImageViewCreateInfo create_info {};
@@ -125,182 +224,154 @@ void Renderer::init_image_views()
 	}
 }
 
-void Renderer::init_images()
+void Renderer::init_render_graph()
 {
-	VkFormat depth_format = find_supported_format(
+	using Graph = RenderGraph;
+	// the depth pyramid is built by sampling the depth buffer
+	m_depth_format = find_depth_format(
 		context,
-		{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
-
-	depth_image.init(
-		context,
-		context->surface_capabilities.currentExtent.width,
-		context->surface_capabilities.currentExtent.height,
-		1,
-		context->msaa_samples,
-		depth_format,
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_ASPECT_DEPTH_BIT,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		VMA_MEMORY_USAGE_GPU_ONLY);
-
-	msaa_image.init(
-		context,
-		context->surface_capabilities.currentExtent.width,
-		context->surface_capabilities.currentExtent.height,
-		1,
-		context->msaa_samples,
-		context->surface_format.format,
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_ASPECT_COLOR_BIT,
-		VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		VMA_MEMORY_USAGE_GPU_ONLY);
-
-	shadow_map_image.init(
-		context,
-		2048,
-		2048,
-		1,
-		VK_SAMPLE_COUNT_1_BIT,
-		depth_format,
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_ASPECT_DEPTH_BIT,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		VMA_MEMORY_USAGE_GPU_ONLY);
-}
-
-void Renderer::init_render_pass()
-{
-	auto r = RenderPassBuilder::begin(context)
-				 .add_color_attachment(0, context->surface_format.format)
-				 .add_color_resolve_attachment(1, context->surface_format.format)
-				 .add_depth_attachment(2,
-					 context->msaa_samples,
-					 VK_ATTACHMENT_STORE_OP_DONT_CARE,
-					 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
-				 .begin_subpass(0)
-				 .add_color_ref(0, 1)
-				 .add_depth_ref(2)
-				 .end_subpass()
-				 .add_dependency(
-					 VK_SUBPASS_EXTERNAL,
-					 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-					 0,
-					 0,
-					 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-					 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)
-				 .build(&render_pass);
-	vk_check(r, "Failed to create render pass");
-
-	r = RenderPassBuilder::begin(context)
-			.add_depth_attachment(0,
-				VK_SAMPLE_COUNT_1_BIT,
-				VK_ATTACHMENT_STORE_OP_STORE,
-				VK_IMAGE_LAYOUT_STENCIL_READ_ONLY_OPTIMAL)
-			.begin_subpass(0)
-			.add_depth_ref(0)
-			.end_subpass()
-			.add_dependency(
-				VK_SUBPASS_EXTERNAL,
-				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-				VK_ACCESS_SHADER_READ_BIT,
-				0,
-				VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)
-			.add_dependency(
-				0,
-				VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-				VK_SUBPASS_EXTERNAL,
-				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-				VK_ACCESS_SHADER_READ_BIT)
-			.build(&shadow_mapping_render_pass);
-	vk_check(r, "Failed to create shadow mapping render pass");
-}
-
-void Renderer::init_framebuffers()
-{
-	framebuffers.resize(swap_chain_image_views.size());
-
-	for (size_t i = 0; i < swap_chain_image_views.size(); i++) {
-		std::array<VkImageView, 3> attachments = {
-			msaa_image.image_view,
-			swap_chain_image_views[i],
-			depth_image.image_view
-		};
+		occlusion_culling ? VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT : 0);
+	auto extent = context->surface_capabilities.currentExtent;
+
+	auto color_format = static_cast<uint32_t>(context->surface_format.format);
+	auto samples = static_cast<uint32_t>(context->msaa_samples);
+	Graph::ImageInfo swap_info { extent.width, extent.height, color_format, VK_SAMPLE_COUNT_1_BIT };
+	Graph::ImageInfo color_info { extent.width, extent.height, color_format, samples };
+	color_info.clear.color[3] = 1.0f;
+	Graph::ImageInfo depth_info { extent.width, extent.height, static_cast<uint32_t>(m_depth_format), samples };
+	depth_info.clear.depth_stencil = { 1.0f, 0 };
+
+	// offscreen images are copied out of instead of presented
+	Graph::Use presented = context->headless ? Graph::TRANSFER_READ : Graph::PRESENT;
+
+	render_graph.clear();
+	m_swap_image = render_graph.import_image("swap chain", swap_info, presented, presented);
+	m_msaa_image = render_graph.create_image("color", color_info);
+	m_depth_image = render_graph.create_image("depth", depth_info);
+
+	m_main_pass = render_graph.add_pass("main pass", Graph::RASTER);
+	render_graph.color(m_main_pass, m_msaa_image, m_swap_image, true);
+	render_graph.depth(m_main_pass, m_depth_image, false, true);
+
+	// the depth pyramid is built from the main pass's depth, then whatever
+	// shows up against it is drawn on top
+	m_indirect_buffer = m_cull_pass = m_deferred_pass = Graph::NONE;
+	if (occlusion_culling) {
+		m_indirect_buffer = render_graph.import_buffer("indirect draws");
+		m_cull_pass = render_graph.add_pass("occlusion cull", Graph::COMPUTE);
+		render_graph.read(m_cull_pass, m_depth_image, Graph::COMPUTE_READ);
+		render_graph.write(m_cull_pass, m_indirect_buffer, Graph::COMPUTE_WRITE);
+
+		m_deferred_pass = render_graph.add_pass("deferred pass", Graph::RASTER);
+		render_graph.color(m_deferred_pass, m_msaa_image, m_swap_image);
+		render_graph.depth(m_deferred_pass, m_depth_image);
+		render_graph.read(m_deferred_pass, m_indirect_buffer, Graph::INDIRECT_READ);
+	}
 
-		VkFramebufferCreateInfo framebuffer_info {};
-		framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebuffer_info.renderPass = render_pass;
-		framebuffer_info.attachmentCount = static_cast<uint32_t>(attachments.size());
-		framebuffer_info.pAttachments = attachments.data();
-		framebuffer_info.width = context->surface_capabilities.currentExtent.width;
-		framebuffer_info.height = context->surface_capabilities.currentExtent.height;
-		framebuffer_info.layers = 1;
-
-		if (vkCreateFramebuffer(context->device, &framebuffer_info, context->allocation_callbacks, &framebuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create framebuffer");
-		}
+	// its copies leave through the readback buffers, which the graph can't see
+	m_readback_pass = Graph::NONE;
+	if (readback) {
+		m_readback_pass = render_graph.add_pass("readback", Graph::TRANSFER);
+		render_graph.read(m_readback_pass, m_swap_image, Graph::TRANSFER_READ);
+		if (readback_depth)
+			render_graph.read(m_readback_pass, m_depth_image, Graph::TRANSFER_READ);
+		render_graph.keep(m_readback_pass);
 	}
+
+	graph_executor.build(render_graph, &m_retired, frame_number);
+	render_target = graph_executor.render_target(m_main_pass);
 }
 
 void Renderer::init_base_descriptor()
 {
-	descriptor_pool = make_descriptor_pool(context->device, 0, 1);
-
 	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-		DescriptorBuilder::begin(context, descriptor_pool)
+		DescriptorBuilder::begin(context)
 			.bind_uniform(0, &scene_uniform.buffer[i])
-			.build(&descriptor_set_layout[i], &descriptor_set[i]);
+			.build(&descriptor_set_layout, &descriptor_set[i]);
 	}
 }
 
+void Renderer::init_fallback_pipeline()
+{
+	auto result = PipelineBuilder::begin(context)
+					  .add_shader("shader_vert.spv", VK_SHADER_STAGE_VERTEX_BIT)
+					  .add_shader("fallback_frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT)
+					  .set_render_target(render_target)
+					  .add_layout(0, descriptor_set_layout)
+					  .add_push_constant(0, sizeof(glm::mat4), VK_SHADER_STAGE_VERTEX_BIT)
+					  .set_rasterizer(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE)
+					  .build(&m_fallback_layout, &m_fallback_pipeline);
+	vk_check(result, "Failed to create fallback pipeline");
+}
+
 void Renderer::record_command_buffer(
 	VkCommandBuffer& command_buffer,
-	const Transform& transform,
+	const glm::mat4& model_matrix,
 	const Mesh& mesh,
-	const Material& material)
+	const Material& material,
+	uint32_t params_offset,
+	VkBuffer indirect_buffer,
+	VkDeviceSize indirect_offset)
 {
+	// the real pipeline is swapped in as soon as its build finishes
+	bool ready = material.ready();
+	VkPipelineLayout pipeline_layout = ready ? material.pipeline_layout : m_fallback_layout;
+
 	// really only need to bind this once
 	vkCmdBindDescriptorSets(
 		command_buffer,
 		VK_PIPELINE_BIND_POINT_GRAPHICS,
-		material.pipeline_layout,
+		pipeline_layout,
 		0,
 		1,
 		&descriptor_set[frames.index],
 		0,
 		nullptr);
 
-	vkCmdBindDescriptorSets(
-		command_buffer,
-		VK_PIPELINE_BIND_POINT_GRAPHICS,
-		material.pipeline_layout,
-		1,
-		1,
-		&material.descriptor_set[frames.index],
-		0,
-		nullptr);
+	if (ready) {
+		vkCmdBindDescriptorSets(
+			command_buffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipeline_layout,
+			1,
+			1,
+			&material.descriptor_set[frames.index],
+			0,
+			nullptr);
+
+		VkDescriptorSet draw_set = draw_uniforms.descriptor_set();
+		vkCmdBindDescriptorSets(
+			command_buffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipeline_layout,
+			2,
+			1,
+			&draw_set,
+			1,
+			&params_offset);
+	}
 
-	glm::mat4 matrix = correction_matrix * camera->matrix() * transform.matrix();
+	glm::mat4 matrix = view_projection * model_matrix;
 	vkCmdPushConstants(
 		command_buffer,
-		material.pipeline_layout,
+		pipeline_layout,
 		VK_SHADER_STAGE_VERTEX_BIT,
 		0,
 		sizeof(glm::mat4),
 		&matrix);
 
-	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
+	vkCmdBindPipeline(
+		command_buffer,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		ready ? material.pipeline : m_fallback_pipeline);
+	++stats.pipeline_binds;
+	stats.descriptor_binds += ready ? 3 : 1;
 
 	VkBuffer vertex_buffers[] = { mesh.vertex_buffer.buffer };
 	VkDeviceSize offsets[] = { 0 };
 	vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
 	vkCmdBindIndexBuffer(command_buffer, mesh.index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+	++stats.vertex_buffer_binds;
 
 	VkViewport viewport {};
 	viewport.x = 0.0f;
@@ -316,62 +387,134 @@ void Renderer::record_command_buffer(
 	scissor.extent = context->surface_capabilities.currentExtent;
 	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
-	vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(mesh.indices.size()), 1, 0, 0, 0);
+	if (indirect_buffer != VK_NULL_HANDLE)
+		vkCmdDrawIndexedIndirect(
+			command_buffer,
+			indirect_buffer,
+			indirect_offset,
+			1,
+			sizeof(VkDrawIndexedIndirectCommand));
+	else
+		vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(mesh.indices.size()), 1, 0, 0, 0);
+	++stats.draws;
+	++stats.instances;
+	stats.triangles += mesh.indices.size() / 3;
 }
 
-void Renderer::recreate_swap_chain()
+bool Renderer::recreate_swap_chain()
 {
-	int width = 0, height = 0;
-	glfwGetFramebufferSize(context->window, &width, &height);
-	while (width == 0 || height == 0) {
-		glfwGetFramebufferSize(context->window, &width, &height);
-		glfwWaitEvents();
-	}
-
-	vkDeviceWaitIdle(context->device);
-	camera->width = width;
-	camera->height = height;
+	PROFILE_ZONE("Renderer::recreate_swap_chain");
+	m_swap_chain_stale = !context->update_surface_extent();
+	if (m_swap_chain_stale)
+		return false;
+
+	auto extent = context->surface_capabilities.currentExtent;
+	camera->width = extent.width;
+	camera->height = extent.height;
 	camera->cache_good = false;
 
-	// Need to cleanup old stuff first
-	depth_image.deinit(context);
-	msaa_image.deinit(context);
-	for (auto& framebuffer : framebuffers)
-		vkDestroyFramebuffer(context->device, framebuffer, context->allocation_callbacks);
-	for (auto& iv : swap_chain_image_views)
-		vkDestroyImageView(context->device, iv, context->allocation_callbacks);
-	vkDestroySwapchainKHR(context->device, swap_chain, context->allocation_callbacks);
+	// frames in flight keep drawing into the old images, so everything sized
+	// to them goes once those frames are done rather than after an idle
+	const Context* ctx = context;
+	m_retired.push(frame_number, [ctx, old_swap_chain = swap_chain, old_views = swap_chain_image_views]() {
+		for (auto view : old_views)
+			vkDestroyImageView(ctx->device, view, ctx->allocation_callbacks);
+		vkDestroySwapchainKHR(ctx->device, old_swap_chain, ctx->allocation_callbacks);
+	});
+	if (readback) {
+		// its readbacks still in flight go to their callbacks at the same time
+		m_retired.push(frame_number, [ctx, old = frame_readback]() mutable {
+			old.complete_all();
+			old.deinit(ctx);
+		});
+		frame_readback = FrameReadback {};
+	}
 
 	init_swap_chain();
 	init_image_views();
-	init_images();
-	init_framebuffers();
+	init_render_graph();
+	if (occlusion_culling)
+		occlusion_culler.resize(graph_executor.image(m_depth_image), m_retired, frame_number);
+	if (readback)
+		frame_readback.init(
+			context,
+			extent,
+			context->surface_format.format,
+			readback_depth ? m_depth_format : VK_FORMAT_UNDEFINED);
+	return true;
 }
 
 void Renderer::setup_draw()
 {
-	auto frame = frames.current_frame();
-	vkWaitForFences(context->device, 1, &frame.in_flight_fence, VK_TRUE, UINT64_MAX);
+	PROFILE_ZONE("Renderer::setup_draw");
+	// planes come from the matrix the vertex shader actually sees, the
+	// correction matrix changes clip w so camera->matrix() alone would be wrong
+	view_projection = correction_matrix * camera->matrix();
+	frustum = Frustum::from_matrix(view_projection);
+	m_deferred_draws.clear();
+	m_draw_count = 0;
+	m_readback_callback = nullptr;
+	m_frame_skipped = false;
+	stats = {};
+	stats.frame = frame_number;
+	if (software_occlusion)
+		occlusion_rasterizer.begin(view_projection);
 
-	auto result = vkAcquireNextImageKHR(
-		context->device,
-		swap_chain,
-		UINT64_MAX,
-		frame.image_available_semaphore,
-		VK_NULL_HANDLE,
-		&image_index);
+	auto frame = frames.current_frame();
+	{
+		PROFILE_ZONE("wait for frame fence");
+		vkWaitForFences(context->device, 1, &frame.in_flight_fence, VK_TRUE, UINT64_MAX);
+	}
+	// this slot's last frame is done, and every one before it
+	if (frame_number + 1 >= MAX_FRAMES_IN_FLIGHT)
+		m_retired.flush(frame_number + 1 - MAX_FRAMES_IN_FLIGHT);
+	frames.current_frame().descriptors.reset();
+	if (m_stats_pending[frames.index]) {
+		pipeline_stats.collect(frames.index, m_submitted_stats[frames.index]);
+		m_completed_stats = m_submitted_stats[frames.index];
+		stats_log.add(m_completed_stats);
+		m_stats_pending[frames.index] = false;
+	}
+	if (readback)
+		frame_readback.complete(frames.index);
+	if (occlusion_culling)
+		occlusion_culler.begin_frame(frames.index);
+	draw_uniforms.begin_frame(frames.index);
+	const glm::vec4 blank[4] {};
+	m_blank_params = draw_uniforms.push(blank);
+
+	// offscreen images are handed out in turn by present_draw
+	if (!context->headless) {
+		PROFILE_ZONE("acquire image");
+		auto acquire = [&]() {
+			return vkAcquireNextImageKHR(
+				context->device,
+				swap_chain,
+				UINT64_MAX,
+				frame.image_available_semaphore,
+				VK_NULL_HANDLE,
+				&image_index);
+		};
+		// an out of date swap chain is replaced on the spot, the frame only
+		// goes when there's no window to make one for
+		auto result = m_swap_chain_stale ? VK_ERROR_OUT_OF_DATE_KHR : acquire();
+		while (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			if (!recreate_swap_chain()) {
+				m_frame_skipped = true;
+				return;
+			}
+			result = acquire();
+		}
 
-	switch (result) {
-	case VK_ERROR_OUT_OF_DATE_KHR:
-		recreate_swap_chain();
-		return;
-	case VK_SUBOPTIMAL_KHR:
-		break;
-	case VK_SUCCESS:
-		break;
-	default:
-		throw std::runtime_error("failed to acquire swap chain images");
-		break;
+		switch (result) {
+		case VK_SUBOPTIMAL_KHR:
+			break;
+		case VK_SUCCESS:
+			break;
+		default:
+			throw std::runtime_error("failed to acquire swap chain images");
+			break;
+		}
 	}
 
 	vkResetFences(context->device, 1, &frame.in_flight_fence);
@@ -385,38 +528,266 @@ void Renderer::setup_draw()
 	if (vkBeginCommandBuffer(frame.command_buffer, &begin_info) != VK_SUCCESS)
 		throw std::runtime_error("failed to begin recording command buffer");
 
-	VkRenderPassBeginInfo render_pass_info {};
-	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	render_pass_info.renderPass = render_pass;
-	render_pass_info.framebuffer = framebuffers[image_index];
-	render_pass_info.renderArea.offset = { 0, 0 };
-	render_pass_info.renderArea.extent = context->surface_capabilities.currentExtent;
+	gpu_profiler.begin_frame(frame.command_buffer, frames.index);
+	m_frame_region = gpu_profiler.begin(frame.command_buffer, "frame");
+	{
+		auto scope = gpu_profiler.scope(frame.command_buffer, "scene upload");
+		gpu_scene.upload(frame.command_buffer, frames.index);
+	}
+	pipeline_stats.begin(frame.command_buffer, frames.index);
+
+	graph_executor.set_image(m_swap_image, swap_chain_images[image_index], swap_chain_image_views[image_index]);
+	if (occlusion_culling)
+		graph_executor.set_buffer(m_indirect_buffer, occlusion_culler.indirect_buffer(frames.index));
+	m_main_pass_region = gpu_profiler.begin(frame.command_buffer, "main pass");
+	graph_executor.begin_pass(frame.command_buffer, m_main_pass);
+}
+
+void Renderer::draw(const Transform& transform, const Mesh& mesh, const Material& material)
+{
+	draw(transform.matrix(), mesh, material);
+}
+
+void Renderer::draw(
+	const glm::mat4& model_matrix,
+	const Mesh& mesh,
+	const Material& material,
+	const void* params,
+	uint32_t params_size,
+	uint32_t object_id)
+{
+	if (m_frame_skipped)
+		return;
+	auto sphere = mesh.bounds.sphere.transform(model_matrix);
+	bool visible = !frustum_culling || culler.is_visible(frustum, sphere);
+	if (!visible)
+		++stats.frustum_culled;
+
+	if (visible && software_occlusion) {
+		if (m_occluders_pending) {
+			occlusion_rasterizer.rasterize();
+			m_occluders_pending = false;
+		}
+		visible = occlusion_rasterizer.is_visible(mesh.bounds.box.transform(model_matrix));
+		if (!visible)
+			++stats.occlusion_culled;
+	}
 
-	std::array<VkClearValue, 3> clear_values {};
-	clear_values[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-	clear_values[1].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-	clear_values[2].depthStencil = { 1.0f, 0 };
+	// hidden draws skip the copy, unless the occlusion test may still bring them back
+	uint32_t params_offset = m_blank_params;
+	bool deferred = occlusion_culling
+		&& object_id < max_scene_objects
+		&& m_draw_count < OcclusionCuller::MAX_OBJECTS;
+	if (params && (visible || deferred))
+		params_offset = draw_uniforms.push(params, params_size);
+
+	if (!deferred) {
+		if (visible)
+			record_command_buffer(frames.current_frame().command_buffer, model_matrix, mesh, material, params_offset);
+		return;
+	}
 
-	render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
-	render_pass_info.pClearValues = clear_values.data();
+	uint32_t index = m_draw_count++;
+	auto index_count = static_cast<uint32_t>(mesh.indices.size());
+	if (!visible) {
+		occlusion_culler.set_object(frames.index, index, object_id, sphere, OcclusionCuller::CULLED, index_count);
+	} else if (occlusion_culler.was_visible(frames.index, object_id)) {
+		occlusion_culler.set_object(frames.index, index, object_id, sphere, 0, index_count);
+		record_command_buffer(frames.current_frame().command_buffer, model_matrix, mesh, material, params_offset);
+	} else {
+		occlusion_culler.set_object(frames.index, index, object_id, sphere, OcclusionCuller::DEFERRED, index_count);
+		++stats.deferred;
+		m_deferred_draws.push_back({ model_matrix, &mesh, &material, params_offset, index });
+	}
+}
 
-	vkCmdBeginRenderPass(frame.command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+void Renderer::draw(World& world, const TransformHierarchy& transforms)
+{
+	PROFILE_ZONE("Renderer::draw");
+	if (m_frame_skipped)
+		return;
+	// chunk order shifts as entities come and go, the scene record doesn't,
+	// so it keys the occlusion results
+	if (frustum_culling) {
+		// the boxes carry scene_bvh's margin, draw still tests the exact sphere
+		m_visible_records.clear();
+		scene_bvh.query(frustum, m_visible_records);
+		stats.frustum_culled += static_cast<uint32_t>(scene_bvh.size() - m_visible_records.size());
+		for (uint32_t index : m_visible_records) {
+			Entity entity = m_scene_entities[index];
+			const SceneNode* node = world.get<SceneNode>(entity);
+			const Renderable* renderable = world.get<Renderable>(entity);
+			draw(
+				transforms.world(node->handle),
+				*renderable->mesh,
+				*renderable->material,
+				renderable->params,
+				renderable->params_size,
+				index);
+		}
+	} else {
+		world.each_chunk<SceneNode, Renderable, SceneRecord>([&](size_t count, const Entity*, SceneNode* nodes, Renderable* renderables, SceneRecord* records) {
+			for (size_t i = 0; i < count; ++i)
+				draw(
+					transforms.world(nodes[i].handle),
+					*renderables[i].mesh,
+					*renderables[i].material,
+					renderables[i].params,
+					renderables[i].params_size,
+					records[i].index);
+		});
+	}
+	world.each_chunk<SceneNode, Renderable>([&](size_t count, const Entity* entities, SceneNode* nodes, Renderable* renderables) {
+		// every entity in a chunk shares the archetype, those were drawn above
+		if (world.has<SceneRecord>(entities[0]))
+			return;
+		for (size_t i = 0; i < count; ++i)
+			draw(
+				transforms.world(nodes[i].handle),
+				*renderables[i].mesh,
+				*renderables[i].material,
+				renderables[i].params,
+				renderables[i].params_size);
+	});
 }
 
-void Renderer::draw(const Transform& transform, const Mesh& mesh, const Material& material)
+void Renderer::update_scene(World& world, const TransformHierarchy& transforms)
 {
-	record_command_buffer(
-		frames.current_frame().command_buffer,
-		transform,
-		mesh,
-		material);
+	world.each<SceneNode, Renderable, SceneRecord>([&](Entity entity, SceneNode& node, Renderable& renderable, SceneRecord& record) {
+		bool added = record.index == SceneRecord::NONE;
+		if (!added && !transforms.changed(node.handle))
+			return;
+
+		const glm::mat4& model_matrix = transforms.world(node.handle);
+		auto object = GpuObject::make(
+			model_matrix,
+			renderable.mesh->bounds,
+			record.material,
+			static_cast<uint32_t>(renderable.mesh->indices.size()));
+		AABB box = renderable.mesh->bounds.box.transform(model_matrix);
+		if (!added) {
+			gpu_scene.set(record.index, object);
+			scene_bvh.move(m_scene_proxies[record.index], box);
+			return;
+		}
+
+		record.index = gpu_scene.add(object);
+		if (record.index >= m_scene_entities.size()) {
+			m_scene_entities.resize(record.index + 1);
+			m_scene_proxies.resize(record.index + 1, int32_t(Bvh::NULL_NODE));
+		}
+		m_scene_entities[record.index] = entity;
+		m_scene_proxies[record.index] = scene_bvh.insert(box, record.index);
+	});
+}
+
+void Renderer::remove_from_scene(SceneRecord& record)
+{
+	if (record.index == SceneRecord::NONE)
+		return;
+
+	gpu_scene.remove(record.index);
+	scene_bvh.remove(m_scene_proxies[record.index]);
+	m_scene_proxies[record.index] = Bvh::NULL_NODE;
+	m_scene_entities[record.index] = Entity {};
+	record.index = SceneRecord::NONE;
+}
+
+void Renderer::add_occluder(const Transform& transform, const Mesh& mesh)
+{
+	add_occluder(transform.matrix(), mesh);
+}
+
+void Renderer::add_occluder(const glm::mat4& model_matrix, const Mesh& mesh)
+{
+	if (!software_occlusion)
+		return;
+
+	OccluderGeometry geometry {
+		reinterpret_cast<const uint8_t*>(mesh.vertices.data()) + offsetof(Vertex, position),
+		sizeof(Vertex),
+		mesh.vertices.size(),
+		mesh.indices.data(),
+		mesh.indices.size()
+	};
+	occlusion_rasterizer.add_occluder(geometry, model_matrix);
+	m_occluders_pending = true;
+}
+
+size_t Renderer::cull(const BoundingSpheres& spheres, std::vector<uint8_t>& visibility) const
+{
+	return culler.cull(frustum, spheres, visibility);
+}
+
+void Renderer::read_back(FrameReadback::Callback callback)
+{
+	if (!readback)
+		throw std::runtime_error("frame readback has to be turned on before init");
+	m_readback_callback = std::move(callback);
+}
+
+Ray Renderer::pick_ray(glm::vec2 cursor) const
+{
+	glm::vec2 ndc = cursor / glm::vec2(camera->width, camera->height) * 2.0f - 1.0f;
+	return Ray::from_screen(glm::inverse(correction_matrix * camera->matrix()), ndc);
 }
 
 void Renderer::present_draw()
 {
+	PROFILE_ZONE("Renderer::present_draw");
+	if (m_frame_skipped)
+		return;
 	auto frame = frames.current_frame();
 
-	vkCmdEndRenderPass(frame.command_buffer);
+	graph_executor.end_pass(frame.command_buffer, m_main_pass);
+	gpu_profiler.end(frame.command_buffer, m_main_pass_region);
+
+	// second phase, test what wasn't drawn against this frame's depth so far
+	if (occlusion_culling) {
+		{
+			auto scope = gpu_profiler.scope(frame.command_buffer, "occlusion cull");
+			graph_executor.begin_pass(frame.command_buffer, m_cull_pass);
+			if (m_draw_count > 0)
+				occlusion_culler.record(
+					frame.command_buffer,
+					frames.index,
+					m_draw_count,
+					view_projection);
+			graph_executor.end_pass(frame.command_buffer, m_cull_pass);
+		}
+
+		PROFILE_ZONE("record deferred draws");
+		auto scope = gpu_profiler.scope(frame.command_buffer, "deferred pass");
+		graph_executor.begin_pass(frame.command_buffer, m_deferred_pass);
+		for (const auto& d : m_deferred_draws)
+			record_command_buffer(
+				frame.command_buffer,
+				d.model_matrix,
+				*d.mesh,
+				*d.material,
+				d.params_offset,
+				occlusion_culler.indirect_buffer(frames.index),
+				d.object_index * sizeof(VkDrawIndexedIndirectCommand));
+		graph_executor.end_pass(frame.command_buffer, m_deferred_pass);
+	}
+	pipeline_stats.end(frame.command_buffer);
+
+	if (readback) {
+		auto scope = gpu_profiler.scope(frame.command_buffer, "readback");
+		graph_executor.begin_pass(frame.command_buffer, m_readback_pass);
+		if (m_readback_callback)
+			frame_readback.record(
+				frame.command_buffer,
+				frames.index,
+				frame_number,
+				swap_chain_images[image_index],
+				graph_executor.image(m_depth_image).image,
+				std::move(m_readback_callback));
+		m_readback_callback = nullptr;
+		graph_executor.end_pass(frame.command_buffer, m_readback_pass);
+	}
+	graph_executor.finish(frame.command_buffer);
+	gpu_profiler.end(frame.command_buffer, m_frame_region);
 
 	if (vkEndCommandBuffer(frame.command_buffer) != VK_SUCCESS)
 		throw std::runtime_error("failed to record command buffer");
@@ -424,25 +795,40 @@ void Renderer::present_draw()
 	VkSubmitInfo submit_info {};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+	// nothing to wait on or signal without a swap chain
+	uint32_t semaphore_count = context->headless ? 0 : 1;
 	VkSemaphore wait_semaphores[] = { frame.image_available_semaphore };
 	VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submit_info.waitSemaphoreCount = 1;
+	submit_info.waitSemaphoreCount = semaphore_count;
 	submit_info.pWaitSemaphores = wait_semaphores;
 	submit_info.pWaitDstStageMask = wait_stages;
 	submit_info.commandBufferCount = 1;
 	submit_info.pCommandBuffers = &frame.command_buffer;
 
 	VkSemaphore signal_semaphores[] = { frame.render_finished_semaphore };
-	submit_info.signalSemaphoreCount = 1;
+	submit_info.signalSemaphoreCount = semaphore_count;
 	submit_info.pSignalSemaphores = signal_semaphores;
 
-	if (vkQueueSubmit(
-			context->graphics_queue.queue,
-			1,
-			&submit_info,
-			frame.in_flight_fence)
-		!= VK_SUCCESS)
-		throw std::runtime_error("failed to submit draw command buffer");
+	{
+		PROFILE_ZONE("queue submit");
+		if (vkQueueSubmit(
+				context->graphics_queue.queue,
+				1,
+				&submit_info,
+				frame.in_flight_fence)
+			!= VK_SUCCESS)
+			throw std::runtime_error("failed to submit draw command buffer");
+	}
+	gpu_profiler.submitted(CpuProfiler::now());
+	m_submitted_stats[frames.index] = stats;
+	m_stats_pending[frames.index] = true;
+	++frame_number;
+
+	if (context->headless) {
+		image_index = (image_index + 1) % static_cast<uint32_t>(swap_chain_images.size());
+		frames.next();
+		return;
+	}
 
 	VkPresentInfoKHR present_info;
 	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -458,7 +844,11 @@ void Renderer::present_draw()
 	// need to figure out why setting pNext got vkQueuePresentKHR to work
 	present_info.pNext = nullptr;
 
-	auto result = vkQueuePresentKHR(context->present_queue.queue, &present_info);
+	VkResult result;
+	{
+		PROFILE_ZONE("queue present");
+		result = vkQueuePresentKHR(context->present_queue.queue, &present_info);
+	}
 
 	switch (result) {
 	case VK_SUCCESS:
@@ -0,0 +1,245 @@
+#include "replay_log.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace chch {
+
+static_assert(sizeof(Transform) == 10 * sizeof(float), "Transform is written to logs as is");
+
+// Frames are a size followed by that many bytes:
+//   time, delta, camera, flags,
+//   load count, then kind, name length and name for each,
+//   transform count, then object and transform for each,
+//   draw count and draws, only when the DRAWS flag is set.
+enum ChunkFlags : uint8_t {
+	PICK = 1 << 0,
+	DRAWS = 1 << 1
+};
+
+struct FileHeader {
+	uint32_t magic;
+	uint32_t version;
+	ReplayHeader header;
+};
+
+template <typename T>
+static void put(std::vector<uint8_t>& out, const T& value)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "only plain data goes into logs");
+	size_t at = out.size();
+	out.resize(at + sizeof(T));
+	memcpy(out.data() + at, &value, sizeof(T));
+}
+
+// Reads out of a chunk, throwing rather than running off its end
+struct ChunkReader {
+	const std::vector<uint8_t>& chunk;
+	size_t at = 0;
+
+	template <typename T>
+	T get()
+	{
+		T value;
+		read(&value, sizeof(T));
+		return value;
+	}
+
+	// A count of elements that follow, checked against what's left so a
+	// damaged count can't ask for gigabytes
+	uint32_t count(size_t element_size)
+	{
+		uint32_t n = get<uint32_t>();
+		if (n > (chunk.size() - at) / element_size)
+			throw std::runtime_error("replay log frame is damaged");
+		return n;
+	}
+
+	void read(void* out, size_t size)
+	{
+		if (size > chunk.size() - at)
+			throw std::runtime_error("replay log frame is damaged");
+		memcpy(out, chunk.data() + at, size);
+		at += size;
+	}
+};
+
+void ReplayFrame::clear()
+{
+	pick = false;
+	loads.clear();
+	transforms.clear();
+	draws.clear();
+}
+
+void ReplayWriter::open(const std::filesystem::path& path, const ReplayHeader& header)
+{
+	close();
+	m_file.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_file.is_open())
+		throw std::runtime_error("failed to open replay log " + path.string());
+
+	m_frames_written = 0;
+	m_transforms.clear();
+	m_written.clear();
+	m_draws.clear();
+
+	FileHeader file_header { MAGIC, VERSION, header };
+	m_file.write(reinterpret_cast<const char*>(&file_header), sizeof(file_header));
+	if (!m_file)
+		throw std::runtime_error("failed to write replay log header");
+}
+
+void ReplayWriter::write(const ReplayFrame& frame)
+{
+	if (!m_file.is_open())
+		throw std::runtime_error("replay log isn't open");
+
+	uint8_t flags = frame.pick ? PICK : 0;
+	// the first frame always has a draw list, empty or not
+	bool draws_changed = m_frames_written == 0 || frame.draws != m_draws;
+	if (draws_changed) {
+		flags |= DRAWS;
+		m_draws = frame.draws;
+	}
+
+	m_chunk.clear();
+	put(m_chunk, frame.time);
+	put(m_chunk, frame.delta);
+	put(m_chunk, frame.camera);
+	put(m_chunk, flags);
+
+	put(m_chunk, static_cast<uint32_t>(frame.loads.size()));
+	for (const auto& load : frame.loads) {
+		put(m_chunk, load.kind);
+		put(m_chunk, static_cast<uint32_t>(load.name.size()));
+		m_chunk.insert(m_chunk.end(), load.name.begin(), load.name.end());
+	}
+
+	// the count goes in once it's known which transforms made it
+	size_t count_at = m_chunk.size();
+	uint32_t count = 0;
+	put(m_chunk, count);
+	for (const auto& transform : frame.transforms) {
+		if (transform.object >= m_transforms.size()) {
+			m_transforms.resize(transform.object + 1);
+			m_written.resize(transform.object + 1, false);
+		}
+		if (m_written[transform.object]
+			&& memcmp(&m_transforms[transform.object], &transform.local, sizeof(Transform)) == 0)
+			continue;
+		m_transforms[transform.object] = transform.local;
+		m_written[transform.object] = true;
+		put(m_chunk, transform.object);
+		put(m_chunk, transform.local);
+		++count;
+	}
+	memcpy(m_chunk.data() + count_at, &count, sizeof(count));
+
+	if (draws_changed) {
+		put(m_chunk, static_cast<uint32_t>(frame.draws.size()));
+		for (const auto& draw : frame.draws)
+			put(m_chunk, draw);
+	}
+
+	uint32_t size = static_cast<uint32_t>(m_chunk.size());
+	m_file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	m_file.write(reinterpret_cast<const char*>(m_chunk.data()), m_chunk.size());
+	if (!m_file)
+		throw std::runtime_error("failed to write replay frame");
+	++m_frames_written;
+}
+
+void ReplayWriter::close()
+{
+	if (m_file.is_open())
+		m_file.close();
+}
+
+void ReplayReader::open(const std::filesystem::path& path)
+{
+	close();
+	m_file.open(path, std::ios::binary | std::ios::ate);
+	if (!m_file.is_open())
+		throw std::runtime_error("failed to open replay log " + path.string());
+	m_remaining = static_cast<uint64_t>(m_file.tellg());
+	m_file.seekg(0);
+
+	FileHeader file_header;
+	m_file.read(reinterpret_cast<char*>(&file_header), sizeof(file_header));
+	if (!m_file || file_header.magic != ReplayWriter::MAGIC)
+		throw std::runtime_error(path.string() + " isn't a replay log");
+	if (file_header.version != ReplayWriter::VERSION)
+		throw std::runtime_error(path.string() + " was written by another version of the engine");
+
+	m_header = file_header.header;
+	m_remaining -= sizeof(file_header);
+	m_frames_read = 0;
+	m_draws.clear();
+}
+
+bool ReplayReader::next(ReplayFrame& frame)
+{
+	if (!m_file.is_open())
+		throw std::runtime_error("replay log isn't open");
+
+	uint32_t size;
+	m_file.read(reinterpret_cast<char*>(&size), sizeof(size));
+	if (m_file.gcount() == 0 && m_file.eof())
+		return false;
+	if (!m_file || size > m_remaining - sizeof(size))
+		throw std::runtime_error("replay log frame is damaged");
+	m_remaining -= sizeof(size) + size;
+
+	m_chunk.resize(size);
+	m_file.read(reinterpret_cast<char*>(m_chunk.data()), size);
+	if (!m_file)
+		throw std::runtime_error("replay log frame is damaged");
+
+	ChunkReader chunk { m_chunk };
+	frame.clear();
+	frame.time = chunk.get<float>();
+	frame.delta = chunk.get<float>();
+	frame.camera = chunk.get<Transform>();
+	uint8_t flags = chunk.get<uint8_t>();
+	frame.pick = (flags & PICK) != 0;
+
+	uint32_t loads = chunk.count(sizeof(uint8_t) + sizeof(uint32_t));
+	for (uint32_t i = 0; i < loads; ++i) {
+		ReplayLoad load;
+		load.kind = chunk.get<ReplayLoad::Kind>();
+		load.name.resize(chunk.count(1));
+		chunk.read(load.name.data(), load.name.size());
+		frame.loads.push_back(std::move(load));
+	}
+
+	uint32_t transforms = chunk.count(sizeof(uint32_t) + sizeof(Transform));
+	for (uint32_t i = 0; i < transforms; ++i) {
+		ReplayTransform transform;
+		transform.object = chunk.get<uint32_t>();
+		transform.local = chunk.get<Transform>();
+		frame.transforms.push_back(transform);
+	}
+
+	if (flags & DRAWS) {
+		m_draws.resize(chunk.count(sizeof(ReplayDraw)));
+		for (auto& draw : m_draws)
+			draw = chunk.get<ReplayDraw>();
+	}
+	frame.draws = m_draws;
+
+	if (chunk.at != m_chunk.size())
+		throw std::runtime_error("replay log frame is damaged");
+	++m_frames_read;
+	return true;
+}
+
+void ReplayReader::close()
+{
+	if (m_file.is_open())
+		m_file.close();
+}
+
+}
@@ -0,0 +1,103 @@
+#include "scene_records.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace chch {
+
+GpuObject GpuObject::make(
+	const glm::mat4& model,
+	const Bounds& object_bounds,
+	uint32_t material,
+	uint32_t index_count,
+	uint32_t first_index,
+	int32_t vertex_offset)
+{
+	auto sphere = object_bounds.sphere.transform(model);
+	auto box = object_bounds.box.transform(model);
+
+	GpuObject object;
+	object.model = model;
+	object.sphere = glm::vec4(sphere.center, sphere.radius);
+	object.box_min = glm::vec4(box.min, 0.0f);
+	object.box_max = glm::vec4(box.max, 0.0f);
+	object.material = material;
+	object.first_index = first_index;
+	object.index_count = index_count;
+	object.vertex_offset = vertex_offset;
+	return object;
+}
+
+void SceneRecords::init(uint32_t capacity)
+{
+	m_objects.assign(capacity, GpuObject {});
+	m_dirty.assign(capacity, 0);
+	m_dirty_list.clear();
+	m_free.clear();
+	m_extent = 0;
+}
+
+void SceneRecords::clear()
+{
+	// the cleared slots still have to reach the GPU
+	for (uint32_t i = 0; i < m_extent; ++i) {
+		m_objects[i] = GpuObject {};
+		mark(i);
+	}
+	m_free.clear();
+	m_extent = 0;
+}
+
+uint32_t SceneRecords::add(const GpuObject& object)
+{
+	uint32_t index;
+	if (!m_free.empty()) {
+		index = m_free.back();
+		m_free.pop_back();
+	} else if (m_extent < m_objects.size()) {
+		index = m_extent++;
+	} else {
+		throw std::runtime_error("scene buffer is full");
+	}
+
+	set(index, object);
+	return index;
+}
+
+void SceneRecords::remove(uint32_t index)
+{
+	set(index, GpuObject {});
+	m_free.push_back(index);
+}
+
+void SceneRecords::set(uint32_t index, const GpuObject& object)
+{
+	m_objects[index] = object;
+	mark(index);
+}
+
+size_t SceneRecords::collect(uint32_t* indices, GpuObject* records)
+{
+	// sorted so neighbours can share a copy region
+	std::sort(m_dirty_list.begin(), m_dirty_list.end());
+	for (size_t i = 0; i < m_dirty_list.size(); ++i) {
+		uint32_t index = m_dirty_list[i];
+		indices[i] = index;
+		records[i] = m_objects[index];
+		m_dirty[index] = 0;
+	}
+
+	size_t count = m_dirty_list.size();
+	m_dirty_list.clear();
+	return count;
+}
+
+void SceneRecords::mark(uint32_t index)
+{
+	if (m_dirty[index])
+		return;
+	m_dirty[index] = 1;
+	m_dirty_list.push_back(index);
+}
+
+}
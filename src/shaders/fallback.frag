@@ -0,0 +1,23 @@
+#version 450
+
+// Drawn while a material's own pipeline is still compiling, so only the
+// scene data is bound
+
+layout(set = 0, binding = 0) uniform SceneData {
+	vec3 sun_color;
+	vec3 sun_dir;
+	float intensity;
+	vec3 ambient_color;
+} scene;
+
+layout(location = 0) in vec3 normal;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec3 frag_position;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+	float cos_theta = clamp(dot(normalize(normal), scene.sun_dir), 0, 1);
+	vec3 light = scene.ambient_color + scene.sun_color * scene.intensity * cos_theta;
+	out_color = vec4(vec3(0.5) * light, 1.0);
+}
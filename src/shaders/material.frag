@@ -0,0 +1,56 @@
+#version 450
+
+// Every feature a material can pick, see ShaderFeatures. Each is a
+// specialization constant, so a pipeline only contains the paths it uses.
+layout(constant_id = 0) const bool TEXTURED = false;
+layout(constant_id = 1) const bool LIT = false;
+layout(constant_id = 2) const bool SPECULAR = false;
+layout(constant_id = 3) const bool SHADOWS = false;
+layout(constant_id = 4) const bool ALPHA_TEST = false;
+
+layout(set = 0, binding = 0) uniform SceneData {
+	vec3 sun_color;
+	vec3 sun_dir;
+	float intensity;
+	vec3 ambient_color;
+} scene;
+
+layout(set = 1, binding = 1) uniform sampler2D tex_sampler;
+
+// MaterialParams in material.hpp
+layout(set = 2, binding = 0) uniform MaterialParams {
+	vec4 color;
+	vec3 camera_pos;
+	float alpha_cutoff;
+} params;
+
+layout(location = 0) in vec3 normal;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec3 frag_position;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+	vec4 base = params.color;
+	if (TEXTURED)
+		base *= texture(tex_sampler, uv);
+
+	if (ALPHA_TEST && base.a < params.alpha_cutoff)
+		discard;
+
+	vec3 light = vec3(1.0);
+	if (LIT) {
+		float intensity = 0.5;
+		float cos_theta = clamp(dot(normal, scene.sun_dir), 0, 1);
+		light = scene.ambient_color + scene.sun_color * intensity * cos_theta;
+
+		if (SPECULAR) {
+			vec3 view_dir = normalize(params.camera_pos - frag_position);
+			vec3 reflection = reflect(-scene.sun_dir, normal);
+			float cos_alpha = max(dot(view_dir, reflection), 0);
+			light += scene.sun_color * 2 * pow(cos_alpha, 32);
+		}
+	}
+
+	out_color = vec4(base.rgb * light, base.a);
+}
@@ -0,0 +1,104 @@
+#include "stress_scene.hpp"
+
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace chch {
+
+StressScene generate_stress_scene(const StressSceneInfo& info)
+{
+	StressScene scene;
+	uint32_t mesh_count = std::max(1u, info.meshes);
+	uint32_t material_count = std::max(1u, info.materials);
+
+	scene.meshes.reserve(mesh_count);
+	for (uint32_t i = 0; i < mesh_count; ++i) {
+		uint32_t rings = 6 + 4 * (i % 16);
+		scene.meshes.push_back(make_sphere_mesh(rings, rings * 2));
+	}
+
+	std::mt19937 rng(info.seed);
+	std::uniform_real_distribution<float> position(-info.extent * 0.5f, info.extent * 0.5f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+
+	scene.objects.resize(info.objects);
+	for (uint32_t i = 0; i < info.objects; ++i) {
+		StressObject& object = scene.objects[i];
+		object.transform.position = { position(rng), position(rng), position(rng) };
+		object.transform.rotation = glm::angleAxis(unit(rng) * glm::two_pi<float>(), glm::vec3(0.0f, 1.0f, 0.0f));
+		object.transform.scale = glm::vec3(0.5f + unit(rng) * 1.5f);
+		object.mesh = i % mesh_count;
+		object.material = (i / mesh_count) % material_count;
+		object.dynamic = unit(rng) < info.dynamic_fraction;
+		if (object.dynamic) {
+			glm::vec3 a(axis(rng), axis(rng), axis(rng));
+			object.spin_axis = glm::length(a) > 1e-3f ? glm::normalize(a) : glm::vec3(0.0f, 1.0f, 0.0f);
+			object.spin_speed = 0.5f + unit(rng) * 2.0f;
+		}
+	}
+	return scene;
+}
+
+StressMesh make_sphere_mesh(uint32_t rings, uint32_t segments)
+{
+	rings = std::max(2u, rings);
+	segments = std::max(3u, segments);
+
+	// the seam column is doubled up so the uvs can wrap
+	StressMesh mesh;
+	for (uint32_t r = 0; r <= rings; ++r) {
+		float v = static_cast<float>(r) / rings;
+		float phi = v * glm::pi<float>();
+		for (uint32_t s = 0; s <= segments; ++s) {
+			float u = static_cast<float>(s) / segments;
+			float theta = u * glm::two_pi<float>();
+			glm::vec3 n(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+			mesh.positions.push_back(n);
+			mesh.normals.push_back(n);
+			mesh.uvs.push_back({ u, v });
+		}
+	}
+
+	// counter clockwise seen from outside
+	uint32_t row = segments + 1;
+	for (uint32_t r = 0; r < rings; ++r) {
+		for (uint32_t s = 0; s < segments; ++s) {
+			uint32_t a = r * row + s;
+			uint32_t b = a + row;
+			mesh.indices.insert(mesh.indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+		}
+	}
+	return mesh;
+}
+
+Transform animate(const StressObject& object, float seconds)
+{
+	Transform t = object.transform;
+	if (object.dynamic)
+		t.rotation = glm::angleAxis(object.spin_speed * seconds, object.spin_axis) * t.rotation;
+	return t;
+}
+
+Transform camera_path(uint32_t frame, uint32_t frame_count, float radius)
+{
+	float angle = glm::two_pi<float>() * frame / std::max(1u, frame_count);
+	glm::vec3 eye(
+		radius * std::cos(angle),
+		radius * (0.2f + 0.15f * std::sin(2.0f * angle)),
+		radius * std::sin(angle));
+
+	// Transform::matrix translates by -position, and the camera's view is
+	// the inverse of its matrix
+	glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Transform t;
+	t.position = -eye;
+	t.rotation = glm::inverse(glm::quat_cast(view));
+	return t;
+}
+
+}
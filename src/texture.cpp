@@ -1,4 +1,5 @@
 #include "util.hpp"
+#include "cpu_profiler.hpp"
 #include <cmath>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -69,6 +70,7 @@ void Image::deinit(const Context* context)
 
 void Texture::init(const Context* context, std::string filename)
 {
+	PROFILE_ZONE("Texture::init");
 	init_texture(context, filename);
 	init_sampler(context);
 }
@@ -0,0 +1,99 @@
+#include "thread_pool.hpp"
+#include "cpu_profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace chch {
+
+void ThreadPool::init(uint32_t thread_count)
+{
+	m_stop = false;
+	m_threads.reserve(thread_count);
+	for (uint32_t i = 0; i < thread_count; ++i)
+		m_threads.emplace_back([this]() { worker(); });
+}
+
+void ThreadPool::deinit()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_condition.notify_all();
+
+	for (auto& thread : m_threads)
+		thread.join();
+	m_threads.clear();
+	m_jobs.clear();
+}
+
+void ThreadPool::worker()
+{
+	PROFILE_THREAD("worker");
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+			if (m_stop && m_jobs.empty())
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		PROFILE_ZONE("job");
+		job();
+	}
+}
+
+void ThreadPool::parallel_for(
+		size_t count,
+		size_t grain,
+		const std::function<void(size_t begin, size_t end)>& body)
+{
+	if (count == 0)
+		return;
+
+	grain = std::max<size_t>(grain, 1);
+	size_t chunk_count = std::min<size_t>((count + grain - 1) / grain, m_threads.size() + 1);
+	if (chunk_count <= 1) {
+		body(0, count);
+		return;
+	}
+
+	// Chunks are handed out from a counter rather than queued one per job, so
+	// the caller only ever runs its own chunks and never picks up something
+	// long-running like a pipeline build while it waits. A helper job that
+	// gets to the queue late finds nothing left and leaves, which is why the
+	// counters outlive this call.
+	struct Chunks {
+		std::atomic<size_t> next { 0 };
+		std::atomic<size_t> done { 0 };
+	};
+	auto chunks = std::make_shared<Chunks>();
+	size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+	auto run = [chunks, body = &body, chunk_count, chunk_size, count]() {
+		size_t i;
+		while ((i = chunks->next.fetch_add(1, std::memory_order_relaxed)) < chunk_count) {
+			size_t begin = i * chunk_size;
+			size_t end = std::min(begin + chunk_size, count);
+			if (begin < end)
+				(*body)(begin, end);
+			chunks->done.fetch_add(1, std::memory_order_release);
+		}
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (size_t i = 1; i < chunk_count; ++i)
+			m_jobs.emplace_back(run);
+	}
+	m_condition.notify_all();
+
+	run();
+	while (chunks->done.load(std::memory_order_acquire) != chunk_count)
+		std::this_thread::yield();
+}
+
+}
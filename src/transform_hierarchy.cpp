@@ -0,0 +1,308 @@
+#include "transform_hierarchy.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace chch {
+
+void TransformHierarchy::Locals::resize(size_t count)
+{
+	position_x.resize(count);
+	position_y.resize(count);
+	position_z.resize(count);
+	rotation_x.resize(count);
+	rotation_y.resize(count);
+	rotation_z.resize(count);
+	rotation_w.resize(count, 1.0f);
+	scale_x.resize(count);
+	scale_y.resize(count);
+	scale_z.resize(count);
+}
+
+TransformHierarchy::Handle TransformHierarchy::add(const Transform& local, Handle parent)
+{
+	if (parent != NONE && !alive(parent))
+		throw std::runtime_error("parent transform doesn't exist");
+
+	Handle node;
+	if (m_free.empty()) {
+		node = static_cast<Handle>(m_slot.size());
+		m_slot.push_back(NONE);
+		m_parent.push_back(NONE);
+		m_world.emplace_back(1.0f);
+		m_changed.push_back(0);
+	} else {
+		node = m_free.back();
+		m_free.pop_back();
+	}
+
+	m_slot[node] = push_slot(node, local);
+	m_parent[node] = parent;
+	m_slot_parent[m_slot[node]] = parent;
+	++m_count;
+	m_topology_dirty = true;
+	return node;
+}
+
+void TransformHierarchy::remove(Handle node)
+{
+	if (!alive(node))
+		throw std::runtime_error("transform doesn't exist");
+
+	for (Handle child = 0; child < m_parent.size(); ++child) {
+		if (m_parent[child] == node && alive(child)) {
+			m_parent[child] = NONE;
+			m_slot_parent[m_slot[child]] = NONE;
+			m_dirty[m_slot[child]] = 1;
+		}
+	}
+
+	m_slot_node[m_slot[node]] = NONE;
+	m_slot[node] = NONE;
+	m_parent[node] = NONE;
+	m_free.push_back(node);
+	--m_count;
+	m_topology_dirty = true;
+}
+
+void TransformHierarchy::set_parent(Handle node, Handle parent)
+{
+	if (!alive(node) || (parent != NONE && !alive(parent)))
+		throw std::runtime_error("transform doesn't exist");
+	for (Handle ancestor = parent; ancestor != NONE; ancestor = m_parent[ancestor]) {
+		if (ancestor == node)
+			throw std::runtime_error("transform can't be parented to its own descendant");
+	}
+
+	m_parent[node] = parent;
+	m_slot_parent[m_slot[node]] = parent;
+	m_dirty[m_slot[node]] = 1;
+	m_topology_dirty = true;
+}
+
+void TransformHierarchy::clear()
+{
+	m_locals.resize(0);
+	m_slot_node.clear();
+	m_slot_parent.clear();
+	m_dirty.clear();
+	m_levels.clear();
+	m_slot.clear();
+	m_parent.clear();
+	m_world.clear();
+	m_changed.clear();
+	m_free.clear();
+	m_updated.clear();
+	m_count = 0;
+	m_topology_dirty = false;
+}
+
+void TransformHierarchy::set_local(Handle node, const Transform& local)
+{
+	uint32_t slot = m_slot[node];
+	set_slot(slot, local);
+	m_dirty[slot] = 1;
+}
+
+Transform TransformHierarchy::local(Handle node) const
+{
+	uint32_t s = m_slot[node];
+	Transform t;
+	t.position = { m_locals.position_x[s], m_locals.position_y[s], m_locals.position_z[s] };
+	t.rotation.x = m_locals.rotation_x[s];
+	t.rotation.y = m_locals.rotation_y[s];
+	t.rotation.z = m_locals.rotation_z[s];
+	t.rotation.w = m_locals.rotation_w[s];
+	t.scale = { m_locals.scale_x[s], m_locals.scale_y[s], m_locals.scale_z[s] };
+	return t;
+}
+
+uint32_t TransformHierarchy::push_slot(Handle node, const Transform& local)
+{
+	auto slot = static_cast<uint32_t>(m_slot_node.size());
+	m_slot_node.push_back(node);
+	m_slot_parent.push_back(NONE);
+	m_dirty.push_back(1);
+	m_locals.resize(m_slot_node.size() + simd::WIDTH);
+	set_slot(slot, local);
+	return slot;
+}
+
+void TransformHierarchy::set_slot(uint32_t slot, const Transform& local)
+{
+	m_locals.position_x[slot] = local.position.x;
+	m_locals.position_y[slot] = local.position.y;
+	m_locals.position_z[slot] = local.position.z;
+	m_locals.rotation_x[slot] = local.rotation.x;
+	m_locals.rotation_y[slot] = local.rotation.y;
+	m_locals.rotation_z[slot] = local.rotation.z;
+	m_locals.rotation_w[slot] = local.rotation.w;
+	m_locals.scale_x[slot] = local.scale.x;
+	m_locals.scale_y[slot] = local.scale.y;
+	m_locals.scale_z[slot] = local.scale.z;
+}
+
+void TransformHierarchy::rebuild()
+{
+	// depth of every live node, walking up until a known depth is found
+	std::vector<uint32_t> depth(m_slot.size(), NONE);
+	std::vector<Handle> chain;
+	uint32_t max_depth = 0;
+	for (Handle node = 0; node < m_slot.size(); ++node) {
+		if (!alive(node))
+			continue;
+		Handle walk = node;
+		while (walk != NONE && depth[walk] == NONE) {
+			chain.push_back(walk);
+			walk = m_parent[walk];
+		}
+		uint32_t d = walk == NONE ? 0 : depth[walk] + 1;
+		for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+			depth[*it] = d++;
+		chain.clear();
+		max_depth = std::max(max_depth, depth[node]);
+	}
+
+	// counting sort by depth, old slot order is kept within a level
+	m_levels.assign(max_depth + 2, 0);
+	for (Handle node : m_slot_node) {
+		if (node != NONE)
+			++m_levels[depth[node] + 1];
+	}
+	for (size_t i = 1; i < m_levels.size(); ++i)
+		m_levels[i] += m_levels[i - 1];
+
+	Locals locals;
+	locals.resize(m_count + simd::WIDTH);
+	std::vector<Handle> slot_node(m_count);
+	std::vector<Handle> slot_parent(m_count);
+	std::vector<uint8_t> dirty(m_count);
+	std::vector<uint32_t> next(m_levels.begin(), m_levels.end() - 1);
+	for (uint32_t old = 0; old < m_slot_node.size(); ++old) {
+		Handle node = m_slot_node[old];
+		if (node == NONE)
+			continue;
+		uint32_t slot = next[depth[node]]++;
+		locals.position_x[slot] = m_locals.position_x[old];
+		locals.position_y[slot] = m_locals.position_y[old];
+		locals.position_z[slot] = m_locals.position_z[old];
+		locals.rotation_x[slot] = m_locals.rotation_x[old];
+		locals.rotation_y[slot] = m_locals.rotation_y[old];
+		locals.rotation_z[slot] = m_locals.rotation_z[old];
+		locals.rotation_w[slot] = m_locals.rotation_w[old];
+		locals.scale_x[slot] = m_locals.scale_x[old];
+		locals.scale_y[slot] = m_locals.scale_y[old];
+		locals.scale_z[slot] = m_locals.scale_z[old];
+		slot_node[slot] = node;
+		slot_parent[slot] = m_parent[node];
+		dirty[slot] = m_dirty[old];
+		m_slot[node] = slot;
+	}
+
+	m_locals = std::move(locals);
+	m_slot_node = std::move(slot_node);
+	m_slot_parent = std::move(slot_parent);
+	m_dirty = std::move(dirty);
+	m_topology_dirty = false;
+}
+
+void TransformHierarchy::update()
+{
+	if (m_topology_dirty)
+		rebuild();
+
+	for (Handle node : m_updated)
+		m_changed[node] = 0;
+	m_updated.clear();
+
+	for (size_t level = 0; level + 1 < m_levels.size(); ++level) {
+		for (uint32_t begin = m_levels[level]; begin < m_levels[level + 1]; begin += simd::WIDTH) {
+			auto count = std::min<uint32_t>(simd::WIDTH, m_levels[level + 1] - begin);
+			update_block(begin, count, level == 0);
+		}
+	}
+}
+
+void TransformHierarchy::update_block(uint32_t begin, uint32_t count, bool root)
+{
+	using simd::Float;
+
+	// static nodes stop here, a byte or two per node
+	uint32_t lanes = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t slot = begin + i;
+		bool changed = m_dirty[slot] || (!root && m_changed[m_slot_parent[slot]]);
+		lanes |= uint32_t(changed) << i;
+	}
+	if (!lanes)
+		return;
+
+	// local matrix columns, same as translate(-position) * mat4_cast(rotation) * scale
+	const auto& l = m_locals;
+	Float x = simd::load(&l.rotation_x[begin]), y = simd::load(&l.rotation_y[begin]);
+	Float z = simd::load(&l.rotation_z[begin]), w = simd::load(&l.rotation_w[begin]);
+	Float two = simd::splat(2.0f), one = simd::splat(1.0f);
+	Float xx = simd::mul(x, x), yy = simd::mul(y, y), zz = simd::mul(z, z);
+	Float xy = simd::mul(x, y), xz = simd::mul(x, z), yz = simd::mul(y, z);
+	Float wx = simd::mul(w, x), wy = simd::mul(w, y), wz = simd::mul(w, z);
+	Float sx = simd::load(&l.scale_x[begin]), sy = simd::load(&l.scale_y[begin]), sz = simd::load(&l.scale_z[begin]);
+
+	// column major 3x4, m[column * 3 + row]
+	Float m[12] = {
+		simd::mul(simd::sub(one, simd::mul(two, simd::add(yy, zz))), sx),
+		simd::mul(simd::mul(two, simd::add(xy, wz)), sx),
+		simd::mul(simd::mul(two, simd::sub(xz, wy)), sx),
+		simd::mul(simd::mul(two, simd::sub(xy, wz)), sy),
+		simd::mul(simd::sub(one, simd::mul(two, simd::add(xx, zz))), sy),
+		simd::mul(simd::mul(two, simd::add(yz, wx)), sy),
+		simd::mul(simd::mul(two, simd::add(xz, wy)), sz),
+		simd::mul(simd::mul(two, simd::sub(yz, wx)), sz),
+		simd::mul(simd::sub(one, simd::mul(two, simd::add(xx, yy))), sz),
+		simd::sub(simd::splat(0.0f), simd::load(&l.position_x[begin])),
+		simd::sub(simd::splat(0.0f), simd::load(&l.position_y[begin])),
+		simd::sub(simd::splat(0.0f), simd::load(&l.position_z[begin])),
+	};
+
+	alignas(32) float out[12][simd::WIDTH];
+	if (root) {
+		for (int i = 0; i < 12; ++i)
+			simd::store(out[i], m[i]);
+	} else {
+		// parents are one level up and already final
+		alignas(32) float parent[12][simd::WIDTH];
+		for (uint32_t lane = 0; lane < simd::WIDTH; ++lane) {
+			const glm::mat4* p = lane < count ? &m_world[m_slot_parent[begin + lane]] : nullptr;
+			for (int c = 0; c < 4; ++c) {
+				for (int r = 0; r < 3; ++r)
+					parent[c * 3 + r][lane] = p ? (*p)[c][r] : 0.0f;
+			}
+		}
+		Float pm[12];
+		for (int i = 0; i < 12; ++i)
+			pm[i] = simd::load(parent[i]);
+
+		for (int c = 0; c < 4; ++c) {
+			for (int r = 0; r < 3; ++r) {
+				Float v = simd::mul_add(pm[r], m[c * 3], simd::mul_add(pm[3 + r], m[c * 3 + 1], simd::mul(pm[6 + r], m[c * 3 + 2])));
+				if (c == 3)
+					v = simd::add(v, pm[9 + r]);
+				simd::store(out[c * 3 + r], v);
+			}
+		}
+	}
+
+	for (; lanes; lanes &= lanes - 1) {
+		uint32_t lane = __builtin_ctz(lanes);
+		uint32_t slot = begin + lane;
+		Handle node = m_slot_node[slot];
+		glm::mat4& world = m_world[node];
+		for (int c = 0; c < 4; ++c)
+			world[c] = glm::vec4(out[c * 3][lane], out[c * 3 + 1][lane], out[c * 3 + 2][lane], c == 3 ? 1.0f : 0.0f);
+		m_dirty[slot] = 0;
+		m_changed[node] = 1;
+		m_updated.push_back(node);
+	}
+}
+
+}
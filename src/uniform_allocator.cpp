@@ -0,0 +1,72 @@
+#include "uniform_allocator.hpp"
+#include "context.hpp"
+#include "util.hpp"
+
+#include "descriptor_builder.hpp"
+
+#include <algorithm>
+#include <vulkan/vulkan_core.h>
+
+namespace chch {
+
+void UniformAllocator::init(const Context* context, VkDeviceSize capacity, uint32_t max_range)
+{
+	m_capacity = capacity;
+	m_max_range = std::min(max_range, context->device_properties.limits.maxUniformBufferRange);
+	m_alignment = context->device_properties.limits.minUniformBufferOffsetAlignment;
+	if (capacity <= m_max_range)
+		throw std::runtime_error("uniform allocator has to hold more than one range");
+
+	for (auto& f : m_frames) {
+		// coherent, so a push is visible to the GPU without a flush
+		f.buffer.init(
+			context,
+			capacity,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU);
+		vmaMapMemory(context->allocator, f.buffer.allocation, &f.data);
+
+		auto result = DescriptorBuilder::begin(context)
+					 .bind_buffer(
+						 0,
+						 VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+						 { f.buffer.buffer, 0, m_max_range },
+						 VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+					 .build(&m_set_layout, &f.descriptor_set);
+		vk_check(result, "Failed to create uniform allocator descriptor");
+	}
+
+	begin_frame(0);
+}
+
+void UniformAllocator::deinit(const Context* context)
+{
+	if (m_set_layout == VK_NULL_HANDLE)
+		return;
+	m_set_layout = VK_NULL_HANDLE;
+
+	for (auto& f : m_frames) {
+		vmaUnmapMemory(context->allocator, f.buffer.allocation);
+		f.buffer.deinit(context);
+	}
+}
+
+void UniformAllocator::begin_frame(uint32_t frame)
+{
+	m_frame = frame;
+	// a shader may read max_range bytes from any offset, keep that inside the buffer
+	m_allocator.init(
+		m_frames[frame].data,
+		m_capacity - m_max_range,
+		m_alignment);
+}
+
+uint32_t UniformAllocator::push(const void* data, size_t size)
+{
+	if (size > m_max_range)
+		throw std::runtime_error("uniform data is larger than the descriptor range");
+	return static_cast<uint32_t>(m_allocator.push(data, size));
+}
+
+}
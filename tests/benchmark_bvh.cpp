@@ -0,0 +1,133 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "bvh.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <random>
+
+using namespace chch;
+
+// A large open world's worth of objects, most of them outside the frustum
+TEST_CASE("BVH 100k objects", "[benchmark]")
+{
+	const size_t count = 100000;
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> height(0.0f, 50.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+	std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+
+	std::vector<AABB> boxes;
+	for (size_t i = 0; i < count; ++i) {
+		glm::vec3 center(position(rng), height(rng), position(rng));
+		glm::vec3 half(size(rng));
+		boxes.push_back({ center - half, center + half });
+	}
+
+	auto frustum = Frustum::from_matrix(
+		glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f)
+		* glm::lookAt(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(1.0f, 10.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+	std::vector<Ray> rays;
+	for (int i = 0; i < 1000; ++i)
+		rays.push_back({ { position(rng), height(rng), position(rng) }, glm::normalize(glm::vec3(step(rng), step(rng), step(rng))) });
+
+	Bvh bvh;
+	std::vector<int32_t> proxies;
+
+	BENCHMARK("insert")
+	{
+		bvh.clear();
+		proxies.clear();
+		for (size_t i = 0; i < count; ++i)
+			proxies.push_back(bvh.insert(boxes[i], static_cast<uint32_t>(i)));
+		return bvh.height();
+	};
+
+	BENCHMARK("SAH build")
+	{
+		bvh.build();
+		return bvh.height();
+	};
+
+	bvh.flatten();
+	BENCHMARK("flatten")
+	{
+		bvh.set_box(proxies[0], boxes[0]);
+		bvh.flatten();
+		return bvh.size();
+	};
+
+	// a tenth of the scene moves a little every frame
+	BENCHMARK("move 10k")
+	{
+		size_t reinserted = 0;
+		for (size_t i = 0; i < count; i += 10) {
+			glm::vec3 offset(step(rng), step(rng), step(rng));
+			boxes[i].min += offset;
+			boxes[i].max += offset;
+			reinserted += bvh.move(proxies[i], boxes[i]);
+		}
+		return reinserted;
+	};
+
+	BENCHMARK("refit 100k")
+	{
+		for (size_t i = 0; i < count; ++i)
+			bvh.set_box(proxies[i], boxes[i]);
+		bvh.refit();
+		return bvh.height();
+	};
+
+	bvh.build();
+	bvh.flatten();
+	std::vector<uint32_t> result;
+	BENCHMARK("frustum query")
+	{
+		result.clear();
+		bvh.query(frustum, result);
+		return result.size();
+	};
+
+	BENCHMARK("frustum, brute force")
+	{
+		size_t visible = 0;
+		for (const auto& box : boxes)
+			visible += frustum.contains(box);
+		return visible;
+	};
+
+	BENCHMARK("1k box queries")
+	{
+		size_t found = 0;
+		for (const auto& ray : rays) {
+			result.clear();
+			bvh.query(AABB { ray.origin - glm::vec3(20.0f), ray.origin + glm::vec3(20.0f) }, result);
+			found += result.size();
+		}
+		return found;
+	};
+
+	BENCHMARK("1k sphere queries")
+	{
+		size_t found = 0;
+		for (const auto& ray : rays) {
+			result.clear();
+			bvh.query(Sphere { ray.origin, 20.0f }, result);
+			found += result.size();
+		}
+		return found;
+	};
+
+	BENCHMARK("1k ray casts")
+	{
+		size_t hits = 0;
+		uint32_t id;
+		float t;
+		for (const auto& ray : rays)
+			hits += bvh.ray_cast(ray, 500.0f, id, t);
+		return hits;
+	};
+}
@@ -0,0 +1,31 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "camera.hpp"
+
+using namespace chch;
+
+// Renderer::setup_draw asks for the matrix once a frame, the projection is
+// only rebuilt after a resize
+TEST_CASE("Camera matrices", "[benchmark]")
+{
+	Camera camera {};
+	camera.width = 1920.0f;
+	camera.height = 1080.0f;
+	camera.fov = 55.0f;
+	camera.depth_min = 0.1f;
+	camera.depth_max = 100.0f;
+	camera.type = Camera::PERSPECTIVE;
+	camera.transform.position = glm::vec3(0.0f, 0.0f, -10.0f);
+
+	BENCHMARK("Camera::matrix, cached projection")
+	{
+		return camera.matrix();
+	};
+
+	BENCHMARK("Camera::matrix, after a resize")
+	{
+		camera.cache_good = false;
+		return camera.matrix();
+	};
+}
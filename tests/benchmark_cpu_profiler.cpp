@@ -0,0 +1,42 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "cpu_profiler.hpp"
+
+#include <chrono>
+
+using namespace chch;
+
+template <typename F>
+static double ns_per_call(int count, F&& f)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; ++i)
+		f();
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / count;
+}
+
+// Zones go around every stage of a frame. What the profiler adds on top of
+// reading the clock twice has to stay under 20 ns. The clock itself is the
+// hardware's, a virtualized TSC can take 20 ns a read on its own.
+TEST_CASE("CPU profiler zone overhead", "[benchmark]")
+{
+	BENCHMARK("clock read")
+	{
+		return CpuProfiler::now();
+	};
+	BENCHMARK("zone")
+	{
+		ProfileZone zone("benchmark zone");
+	};
+
+	const int count = 1000000;
+	volatile uint64_t sink = 0;
+	double clock = ns_per_call(count, [&]() { sink = sink + CpuProfiler::now(); });
+	double zone = ns_per_call(count, []() { ProfileZone zone("benchmark zone"); });
+	INFO(zone << " ns per zone, " << clock << " ns per clock read");
+	CHECK(zone - 2 * clock < 20.0);
+	WARN(zone << " ns per zone, " << clock << " ns per clock read");
+	CpuProfiler::clear();
+}
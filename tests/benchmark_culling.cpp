@@ -0,0 +1,84 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "culling.hpp"
+#include "thread_pool.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <random>
+#include <thread>
+
+using namespace chch;
+
+// Target is 1M sphere tests per millisecond, so every case below should stay under 1 ms
+TEST_CASE("Frustum culling 1M spheres", "[benchmark]")
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> radius(0.1f, 5.0f);
+
+	BoundingSpheres spheres;
+	for (size_t i = 0; i < 1000000; ++i)
+		spheres.push_back({ { position(rng), position(rng), position(rng) }, radius(rng) });
+
+	glm::mat4 view_projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f)
+		* glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.2f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	auto frustum = Frustum::from_matrix(view_projection);
+
+	FrustumCuller culler;
+	std::vector<uint8_t> visibility(spheres.size());
+
+	BENCHMARK("scalar")
+	{
+		return culler.cull_scalar(frustum, spheres, visibility);
+	};
+
+	BENCHMARK("simd")
+	{
+		return culler.cull(frustum, spheres, visibility);
+	};
+
+	culler.min_screen_size = 0.005f;
+	BENCHMARK("simd + screen size")
+	{
+		return culler.cull(frustum, spheres, visibility);
+	};
+
+	ThreadPool pool;
+	pool.init(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	culler.thread_pool = &pool;
+	BENCHMARK("simd + screen size, threaded")
+	{
+		return culler.cull(frustum, spheres, visibility);
+	};
+	pool.deinit();
+}
+
+// What Renderer::draw pays per draw, and setup_draw once a frame
+TEST_CASE("Frustum tests one at a time", "[benchmark]")
+{
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+	std::vector<Sphere> spheres;
+	for (size_t i = 0; i < 1024; ++i)
+		spheres.push_back({ { position(rng), position(rng), position(rng) }, 1.0f });
+
+	glm::mat4 view_projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f)
+		* glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.2f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	BENCHMARK("frustum from matrix")
+	{
+		return Frustum::from_matrix(view_projection);
+	};
+
+	auto frustum = Frustum::from_matrix(view_projection);
+	FrustumCuller culler;
+	BENCHMARK("1024 single sphere tests")
+	{
+		size_t visible = 0;
+		for (const auto& sphere : spheres)
+			visible += culler.is_visible(frustum, sphere);
+		return visible;
+	};
+}
@@ -0,0 +1,110 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "ecs.hpp"
+
+#include <thread>
+
+using namespace chch;
+
+struct Position {
+	float x, y, z;
+};
+
+struct Velocity {
+	float x, y, z;
+};
+
+struct Model {
+	float matrix[16];
+};
+
+struct Bounds {
+	float center[3];
+	float radius;
+};
+
+// What the scene used to look like, everything about an object in one struct
+struct GameObject {
+	Position position;
+	Velocity velocity;
+	Model model;
+	Bounds bounds;
+	const void* mesh;
+	const void* material;
+};
+
+// Moves 100k entities, the update only touches position and velocity
+TEST_CASE("ECS iteration 100k entities", "[benchmark]")
+{
+	const size_t count = 100000;
+	const float dt = 1.0f / 60.0f;
+
+	std::vector<GameObject> objects(count);
+	World world;
+	for (size_t i = 0; i < count; ++i) {
+		Position p { float(i), 0.0f, 0.0f };
+		Velocity v { 1.0f, float(i % 7), -1.0f };
+		objects[i].position = p;
+		objects[i].velocity = v;
+		world.create(p, v, Model {}, Bounds {});
+	}
+
+	BENCHMARK("array of structs")
+	{
+		for (auto& object : objects) {
+			object.position.x += object.velocity.x * dt;
+			object.position.y += object.velocity.y * dt;
+			object.position.z += object.velocity.z * dt;
+		}
+		return objects[0].position.x;
+	};
+
+	BENCHMARK("each_chunk")
+	{
+		world.each_chunk<Position, Velocity>([dt](size_t n, const Entity*, Position* p, Velocity* v) {
+			for (size_t i = 0; i < n; ++i) {
+				p[i].x += v[i].x * dt;
+				p[i].y += v[i].y * dt;
+				p[i].z += v[i].z * dt;
+			}
+		});
+		return world.size();
+	};
+
+	BENCHMARK("each")
+	{
+		world.each<Position, Velocity>([dt](Entity, Position& p, Velocity& v) {
+			p.x += v.x * dt;
+			p.y += v.y * dt;
+			p.z += v.z * dt;
+		});
+		return world.size();
+	};
+
+	ThreadPool pool;
+	pool.init(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	world.thread_pool = &pool;
+	BENCHMARK("parallel_each_chunk")
+	{
+		world.parallel_each_chunk<Position, Velocity>([dt](size_t n, const Entity*, Position* p, Velocity* v) {
+			for (size_t i = 0; i < n; ++i) {
+				p[i].x += v[i].x * dt;
+				p[i].y += v[i].y * dt;
+				p[i].z += v[i].z * dt;
+			}
+		});
+		return world.size();
+	};
+	pool.deinit();
+
+	BENCHMARK("create and destroy 10k")
+	{
+		std::vector<Entity> created;
+		for (size_t i = 0; i < 10000; ++i)
+			created.push_back(world.create(Position {}, Velocity {}));
+		for (auto entity : created)
+			world.destroy(entity);
+		return world.size();
+	};
+}
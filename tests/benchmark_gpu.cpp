@@ -0,0 +1,215 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "buffer.hpp"
+#include "camera.hpp"
+#include "context.hpp"
+#include "descriptor_builder.hpp"
+#include "material.hpp"
+#include "mesh.hpp"
+#include "pipeline_builder.hpp"
+#include "renderer.hpp"
+#include "uniform.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+using namespace chch;
+
+// A headless context and renderer with one untextured material, on whatever
+// device the loader picks. make bench points the loader at lavapipe when it's
+// installed, so these run the same on machines without a GPU. ready stays
+// false when there's no device at all.
+struct GpuFixture {
+	Context context;
+	Camera camera {};
+	Renderer renderer;
+	Mesh mesh;
+	Material material;
+	bool ready = false;
+
+	GpuFixture()
+	{
+		ContextCreateInfo cc_info {};
+		cc_info.app_name = "benchmark";
+		cc_info.app_version = VK_MAKE_VERSION(0, 1, 0);
+		cc_info.window_size = { 1280, 720 };
+		cc_info.enable_validation_layers = false;
+		cc_info.headless = true;
+		try {
+			context.init(cc_info);
+		} catch (const std::runtime_error& e) {
+			WARN("no Vulkan device, skipping: " << e.what());
+			return;
+		}
+
+		camera.width = static_cast<float>(cc_info.window_size.width);
+		camera.height = static_cast<float>(cc_info.window_size.height);
+		camera.fov = 55.0f;
+		camera.depth_min = 0.1f;
+		camera.depth_max = 100.0f;
+		camera.type = Camera::PERSPECTIVE;
+		camera.transform.position = glm::vec3(0.0f, 0.0f, -10.0f);
+
+		SceneGlobals globals {};
+		globals.sun_color = glm::vec3(1.0f);
+		globals.sun_dir = glm::normalize(glm::vec3(1.0f));
+		globals.intensity = 0.5f;
+		renderer.init(&context, globals, &camera);
+
+		mesh.init(&context, "cube.obj");
+		material.init(&context,
+			renderer.render_target, renderer.descriptor_set_layout, renderer.draw_uniforms.layout(),
+			{ },
+			{ },
+			"shader_vert.spv", "material_frag.spv", 0,
+			VK_CULL_MODE_BACK_BIT, VK_TRUE);
+		ready = true;
+	}
+
+	~GpuFixture()
+	{
+		if (!ready)
+			return;
+		vkDeviceWaitIdle(context.device);
+		material.deinit(&context);
+		mesh.deinit(&context);
+		renderer.deinit();
+		context.deinit();
+	}
+};
+
+TEST_CASE("Descriptor and pipeline builders", "[benchmark][gpu]")
+{
+	GpuFixture gpu;
+	if (!gpu.ready)
+		return;
+	const Context* context = &gpu.context;
+
+	UniformBuffer uniform;
+	uniform.init(context, 256);
+	DescriptorAllocator allocator;
+	allocator.init(context);
+
+	// the layout comes out of the cache after the first build
+	BENCHMARK_ADVANCED("DescriptorBuilder, one uniform")(Catch::Benchmark::Chronometer meter)
+	{
+		VkDescriptorSetLayout layout;
+		VkDescriptorSet set;
+		meter.measure([&] {
+			return DescriptorBuilder::begin(context, &allocator)
+				.bind_uniform(0, &uniform)
+				.build(&layout, &set);
+		});
+		allocator.reset();
+	};
+
+	// the same state as the fixture's material, so the registry hands its
+	// pipeline back
+	BENCHMARK_ADVANCED("PipelineBuilder, registry hit")(Catch::Benchmark::Chronometer meter)
+	{
+		std::vector<VkPipeline> pipelines(meter.runs(), VK_NULL_HANDLE);
+		meter.measure([&](int i) {
+			VkPipelineLayout layout;
+			return PipelineBuilder::begin(context)
+				.add_shader("shader_vert.spv", VK_SHADER_STAGE_VERTEX_BIT, 0)
+				.add_shader("material_frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT, 0)
+				.set_render_target(gpu.renderer.render_target)
+				.add_layout(0, gpu.renderer.descriptor_set_layout)
+				.add_layout(1, gpu.material.descriptor_set_layout)
+				.add_layout(2, gpu.renderer.draw_uniforms.layout())
+				.add_push_constant(0, sizeof(glm::mat4), VK_SHADER_STAGE_VERTEX_BIT)
+				.set_depth_stencil(VK_TRUE, VK_TRUE)
+				.set_rasterizer(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE)
+				.build(&layout, &pipelines[i]);
+		});
+		for (VkPipeline pipeline : pipelines) {
+			if (pipeline != VK_NULL_HANDLE)
+				context->pipelines.release(pipeline);
+		}
+	};
+
+	allocator.deinit();
+	uniform.deinit(context);
+}
+
+TEST_CASE("Staging upload", "[benchmark][gpu]")
+{
+	GpuFixture gpu;
+	if (!gpu.ready)
+		return;
+	const Context* context = &gpu.context;
+
+	const VkDeviceSize size = 16 * 1024 * 1024;
+	Buffer staging {}, target {};
+	staging.init(context,
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		VMA_MEMORY_USAGE_CPU_ONLY);
+	target.init(context,
+		size,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY);
+	std::vector<uint8_t> data(size, 0x5a);
+
+	// the way Mesh::init_buffers and Texture::init get data onto the GPU
+	auto upload = [&]() {
+		void* mapped;
+		vmaMapMemory(context->allocator, staging.allocation, &mapped);
+		memcpy(mapped, data.data(), size);
+		vmaUnmapMemory(context->allocator, staging.allocation);
+
+		context->record_transfer_command([&](VkCommandBuffer command_buffer) {
+			VkBufferCopy region {};
+			region.size = size;
+			vkCmdCopyBuffer(command_buffer, staging.buffer, target.buffer, 1, &region);
+		});
+	};
+
+	BENCHMARK("upload 16 MB")
+	{
+		upload();
+	};
+
+	// the report only has times, so throughput is worked out once more here
+	const int uploads = 8;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < uploads; ++i)
+		upload();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	WARN("staging upload " << uploads * (size / (1024.0 * 1024.0)) / elapsed.count() << " MB/s");
+
+	target.deinit(context);
+	staging.deinit(context);
+}
+
+TEST_CASE("Command recording", "[benchmark][gpu]")
+{
+	GpuFixture gpu;
+	if (!gpu.ready)
+		return;
+
+	// a grid in front of the camera, with culling off every one is recorded
+	std::vector<glm::mat4> matrices;
+	for (int i = 0; i < 10000; ++i) {
+		glm::vec3 position((i % 100) * 0.2f - 10.0f, (i / 100) * 0.2f - 10.0f, 10.0f);
+		matrices.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.05f)));
+	}
+	gpu.renderer.frustum_culling = false;
+
+	BENCHMARK_ADVANCED("record 10k draws")(Catch::Benchmark::Chronometer meter)
+	{
+		gpu.renderer.setup_draw();
+		meter.measure([&] {
+			for (const auto& matrix : matrices)
+				gpu.renderer.draw(matrix, gpu.mesh, gpu.material);
+			return gpu.renderer.stats.draws;
+		});
+		gpu.renderer.present_draw();
+	};
+}
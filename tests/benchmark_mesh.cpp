@@ -0,0 +1,36 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "mesh.hpp"
+
+#include <vector>
+
+using namespace chch;
+
+// The CPU half of Mesh::init on the biggest model in resources/
+TEST_CASE("Mesh loading", "[benchmark]")
+{
+	Mesh reference;
+	reference.load_model("viking_room.obj");
+
+	BENCHMARK("load viking_room.obj")
+	{
+		Mesh mesh;
+		mesh.load_model("viking_room.obj");
+		return mesh.indices.size();
+	};
+
+	// the corners as they come out of the OBJ file
+	std::vector<Vertex> corners;
+	corners.reserve(reference.indices.size());
+	for (uint32_t index : reference.indices)
+		corners.push_back(reference.vertices[index]);
+
+	BENCHMARK("deduplicate viking_room.obj vertices")
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		deduplicate_vertices(corners, vertices, indices);
+		return vertices.size();
+	};
+}
@@ -0,0 +1,100 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "mesh_bvh.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace chch;
+
+// Rays per second over the whole batch, one warm pass first
+template <typename F>
+static double mrays_per_second(size_t ray_count, F&& cast)
+{
+	cast();
+	auto start = std::chrono::steady_clock::now();
+	int passes = 0;
+	std::chrono::duration<double> elapsed(0.0);
+	do {
+		cast();
+		++passes;
+		elapsed = std::chrono::steady_clock::now() - start;
+	} while (elapsed.count() < 0.5);
+	return ray_count * passes / elapsed.count() / 1e6;
+}
+
+// A rolling terrain of about a million triangles, rays from a camera above it
+TEST_CASE("Mesh BVH 1M triangles", "[benchmark]")
+{
+	const uint32_t side = 708;
+	std::vector<glm::vec3> positions;
+	for (uint32_t z = 0; z <= side; ++z) {
+		for (uint32_t x = 0; x <= side; ++x) {
+			float fx = x * 0.5f, fz = z * 0.5f;
+			positions.push_back({ fx, 3.0f * std::sin(fx * 0.1f) * std::cos(fz * 0.13f) + std::sin(fx * 0.7f + fz), fz });
+		}
+	}
+	std::vector<uint32_t> indices;
+	for (uint32_t z = 0; z < side; ++z) {
+		for (uint32_t x = 0; x < side; ++x) {
+			uint32_t i = z * (side + 1) + x;
+			indices.insert(indices.end(), { i, i + 1, i + side + 1, i + 1, i + side + 2, i + side + 1 });
+		}
+	}
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> spread(-1.0f, 1.0f);
+	// scanline order like a camera would shoot them
+	std::vector<Ray> rays;
+	glm::vec3 eye(side * 0.25f, 40.0f, -20.0f);
+	for (int y = 0; y < 250; ++y) {
+		for (int x = 0; x < 400; ++x)
+			rays.push_back({ eye, glm::normalize(glm::vec3((x / 200.0f - 1.0f) * 0.6f, -0.35f + (y / 125.0f - 1.0f) * 0.25f, 1.0f)) });
+	}
+
+	// scattered short rays, like line of sight checks between agents
+	std::vector<Ray> sight;
+	std::uniform_real_distribution<float> ground(0.0f, side * 0.5f);
+	for (int i = 0; i < 100000; ++i) {
+		glm::vec3 from(ground(rng), 2.5f, ground(rng));
+		glm::vec3 to(ground(rng), 2.5f, ground(rng));
+		sight.push_back({ from, to - from });
+	}
+
+	MeshBvh bvh;
+	BENCHMARK("build")
+	{
+		bvh.build(positions.data(), sizeof(glm::vec3), positions.size(), indices.data(), indices.size());
+		return bvh.node_count();
+	};
+	REQUIRE(bvh.triangle_count() == 2 * side * side);
+
+	size_t hits = 0;
+	auto closest = [&]() {
+		hits = 0;
+		RayHit hit;
+		for (const auto& ray : rays)
+			hits += bvh.intersect(ray, 1000.0f, hit);
+	};
+	auto any = [&]() {
+		hits = 0;
+		for (const auto& ray : sight)
+			hits += bvh.occluded(ray, 1.0f);
+	};
+
+	BENCHMARK("100k closest hit rays")
+	{
+		closest();
+		return hits;
+	};
+	BENCHMARK("100k line of sight rays")
+	{
+		any();
+		return hits;
+	};
+
+	WARN("closest hit: " << mrays_per_second(rays.size(), closest) << " Mrays/s, " << hits << " hits");
+	WARN("line of sight: " << mrays_per_second(sight.size(), any) << " Mrays/s, " << hits << " blocked");
+}
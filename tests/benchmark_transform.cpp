@@ -0,0 +1,36 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "transform.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <random>
+#include <vector>
+
+using namespace chch;
+
+// Every draw that isn't in the hierarchy builds its matrix from a Transform
+TEST_CASE("Transform matrices", "[benchmark]")
+{
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+	std::vector<Transform> transforms(10000);
+	for (auto& t : transforms) {
+		t.position = { value(rng), value(rng), value(rng) };
+		t.rotation = glm::angleAxis(value(rng), glm::normalize(glm::vec3(value(rng), value(rng), 1.0f)));
+		t.scale = glm::vec3(1.0f + value(rng) * 0.01f);
+	}
+
+	BENCHMARK("Transform::matrix")
+	{
+		return transforms[0].matrix();
+	};
+
+	std::vector<glm::mat4> matrices(transforms.size());
+	BENCHMARK("Transform::matrix x10k")
+	{
+		for (size_t i = 0; i < transforms.size(); ++i)
+			matrices[i] = transforms[i].matrix();
+		return matrices.back();
+	};
+}
@@ -0,0 +1,68 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "transform_hierarchy.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <random>
+
+using namespace chch;
+
+// 100k nodes, 10k roots carrying three levels of children
+TEST_CASE("Transform hierarchy 100k nodes", "[benchmark]")
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	auto random_transform = [&]() {
+		Transform t;
+		t.position = { position(rng), position(rng), position(rng) };
+		t.rotation = glm::angleAxis(position(rng), glm::vec3(0.0f, 1.0f, 0.0f));
+		return t;
+	};
+
+	const size_t count = 100000;
+	TransformHierarchy hierarchy;
+	std::vector<Transform> locals;
+	std::vector<uint32_t> parents;
+	for (size_t i = 0; i < count; ++i) {
+		uint32_t parent = i < count / 10 ? TransformHierarchy::NONE : static_cast<uint32_t>(i / 3);
+		locals.push_back(random_transform());
+		parents.push_back(parent);
+		hierarchy.add(locals.back(), parent);
+	}
+	hierarchy.update();
+
+	// what every draw used to do, rebuild the whole chain from the locals
+	std::vector<glm::mat4> world(count);
+	BENCHMARK("Transform::matrix every node")
+	{
+		for (size_t i = 0; i < count; ++i) {
+			world[i] = locals[i].matrix();
+			if (parents[i] != TransformHierarchy::NONE)
+				world[i] = world[parents[i]] * world[i];
+		}
+		return world[count - 1][3][0];
+	};
+
+	BENCHMARK("update, nothing moved")
+	{
+		hierarchy.update();
+		return hierarchy.updated().size();
+	};
+
+	BENCHMARK("update, 1% of roots moved")
+	{
+		for (uint32_t i = 0; i < count / 10; i += 100)
+			hierarchy.set_local(i, locals[i]);
+		hierarchy.update();
+		return hierarchy.updated().size();
+	};
+
+	BENCHMARK("update, everything moved")
+	{
+		for (uint32_t i = 0; i < count; ++i)
+			hierarchy.set_local(i, locals[i]);
+		hierarchy.update();
+		return hierarchy.updated().size();
+	};
+}
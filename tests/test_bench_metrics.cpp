@@ -0,0 +1,94 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "bench_metrics.hpp"
+
+#include <filesystem>
+
+using namespace chch;
+
+TEST_CASE("Bench metrics round trip through JSON")
+{
+	BenchMetrics metrics;
+	metrics.set("frame_ms_mean", 4.25);
+	metrics.set("frame_ms_p99", 7.0 / 3.0);
+	metrics.set("gpu_memory_mb", 0.0);
+	metrics.set("frame_ms_mean", 4.5);
+	REQUIRE(metrics.values.size() == 3);
+	REQUIRE(*metrics.find("frame_ms_mean") == 4.5);
+	REQUIRE(metrics.find("missing") == nullptr);
+
+	BenchMetrics parsed;
+	REQUIRE(BenchMetrics::parse_json(metrics.to_json(), parsed));
+	REQUIRE(parsed.values == metrics.values);
+
+	REQUIRE(BenchMetrics::parse_json("{}", parsed));
+	REQUIRE(parsed.values.empty());
+	REQUIRE(BenchMetrics::parse_json(" { \"a\" : 1e3 , \"b\\\"c\": -2 } ", parsed));
+	REQUIRE(*parsed.find("a") == 1000.0);
+	REQUIRE(*parsed.find("b\"c") == -2.0);
+}
+
+TEST_CASE("Bench metrics reject anything but a flat object of numbers")
+{
+	BenchMetrics parsed;
+	parsed.set("kept", 1.0);
+	for (const char* json : {
+			 "",
+			 "[]",
+			 "{\"a\":}",
+			 "{\"a\":\"slow\"}",
+			 "{\"a\":{\"b\":1}}",
+			 "{\"a\":1,}",
+			 "{\"a\":1",
+			 "{\"a\" 1}",
+			 "{\"a\":1} trailing" }) {
+		INFO(json);
+		REQUIRE_FALSE(BenchMetrics::parse_json(json, parsed));
+	}
+	REQUIRE(parsed.values.size() == 1);
+}
+
+TEST_CASE("Bench metrics flag regressions past the threshold")
+{
+	BenchMetrics baseline, current;
+	baseline.set("frame_ms_mean", 10.0);
+	baseline.set("frame_ms_p99", 20.0);
+	baseline.set("gpu_memory_mb", 0.0);
+	baseline.set("dropped", 1.0);
+
+	current.set("frame_ms_mean", 10.9);
+	current.set("frame_ms_p99", 25.0);
+	current.set("gpu_memory_mb", 0.05);
+	current.set("new_metric", 1000.0);
+
+	auto regressions = find_regressions(current, baseline, 0.1);
+	REQUIRE(regressions.size() == 1);
+	REQUIRE(regressions[0].name == "frame_ms_p99");
+	REQUIRE(regressions[0].baseline == 20.0);
+	REQUIRE(regressions[0].current == 25.0);
+	REQUIRE(regressions[0].change == Approx(0.25));
+
+	REQUIRE(find_regressions(current, baseline, 0.3).empty());
+	REQUIRE(find_regressions(current, baseline, 0.01).size() == 3);
+
+	// getting faster is never a regression
+	current.set("frame_ms_p99", 1.0);
+	REQUIRE(find_regressions(current, baseline, 0.0).size() == 2);
+}
+
+TEST_CASE("Bench metrics save and load baselines")
+{
+	BenchMetrics metrics;
+	metrics.set("frame_ms_p95", 3.5);
+	auto path = std::filesystem::temp_directory_path() / "chch_bench_metrics_test.json";
+	REQUIRE(metrics.save(path));
+
+	BenchMetrics loaded;
+	REQUIRE(loaded.load(path));
+	REQUIRE(loaded.values == metrics.values);
+	std::filesystem::remove(path);
+
+	REQUIRE_FALSE(loaded.load(path));
+	REQUIRE(loaded.values == metrics.values);
+}
@@ -0,0 +1,297 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "bvh.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <random>
+
+using namespace chch;
+
+static glm::mat4 test_view_projection()
+{
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 80.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.3f, 0.1f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return projection * view;
+}
+
+static AABB random_box(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 4.0f);
+	glm::vec3 center(position(rng), position(rng), position(rng));
+	glm::vec3 half(size(rng), size(rng), size(rng));
+	return { center - half, center + half };
+}
+
+static std::vector<uint32_t> sorted(std::vector<uint32_t> ids)
+{
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+// Fills the tree with proxies whose user data is their index in boxes
+static std::vector<int32_t> fill(Bvh& bvh, std::vector<AABB>& boxes, size_t count, uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::vector<int32_t> proxies;
+	for (size_t i = 0; i < count; ++i) {
+		boxes.push_back(random_box(rng));
+		proxies.push_back(bvh.insert(boxes.back(), static_cast<uint32_t>(i)));
+	}
+	return proxies;
+}
+
+TEST_CASE("BVH insert and remove keep the tree valid")
+{
+	Bvh bvh;
+	REQUIRE(bvh.validate());
+
+	std::vector<AABB> boxes;
+	auto proxies = fill(bvh, boxes, 500, 1);
+	REQUIRE(bvh.size() == 500);
+	REQUIRE(bvh.validate());
+	// rotations keep insertion from producing a list
+	REQUIRE(bvh.height() < 40);
+
+	for (size_t i = 0; i < proxies.size(); i += 2)
+		bvh.remove(proxies[i]);
+	REQUIRE(bvh.size() == 250);
+	REQUIRE(bvh.validate());
+
+	// freed nodes are reused
+	std::mt19937 rng(2);
+	for (int i = 0; i < 250; ++i)
+		bvh.insert(random_box(rng), 0);
+	REQUIRE(bvh.validate());
+
+	bvh.clear();
+	REQUIRE(bvh.size() == 0);
+	REQUIRE(bvh.height() == 0);
+	REQUIRE(bvh.validate());
+}
+
+TEST_CASE("BVH box and sphere queries match brute force")
+{
+	Bvh bvh;
+	std::vector<AABB> boxes;
+	fill(bvh, boxes, 2000, 3);
+	bool rebuilt = GENERATE(false, true);
+	if (rebuilt)
+		bvh.build();
+	REQUIRE(bvh.validate());
+
+	std::mt19937 rng(4);
+	std::uniform_real_distribution<float> radius(1.0f, 30.0f);
+	for (int i = 0; i < 50; ++i) {
+		AABB query = random_box(rng);
+		query.max += glm::vec3(radius(rng));
+
+		std::vector<uint32_t> expected, result;
+		for (uint32_t k = 0; k < boxes.size(); ++k) {
+			if (boxes[k].overlaps(query))
+				expected.push_back(k);
+		}
+		bvh.query(query, result);
+		REQUIRE(sorted(result) == expected);
+
+		// fused multiply-add may round differently for boxes grazing the sphere
+		Sphere sphere { query.center(), radius(rng) };
+		Sphere grown { sphere.center, sphere.radius + 1e-3f };
+		Sphere shrunk { sphere.center, sphere.radius - 1e-3f };
+		result.clear();
+		bvh.query(sphere, result);
+		result = sorted(result);
+		for (uint32_t k = 0; k < boxes.size(); ++k) {
+			bool found = std::binary_search(result.begin(), result.end(), k);
+			if (shrunk.overlaps(boxes[k]))
+				REQUIRE(found);
+			else if (!grown.overlaps(boxes[k]))
+				REQUIRE_FALSE(found);
+		}
+	}
+}
+
+TEST_CASE("BVH frustum query matches brute force")
+{
+	Bvh bvh;
+	std::vector<AABB> boxes;
+	fill(bvh, boxes, 5000, 5);
+	if (GENERATE(false, true))
+		bvh.build();
+
+	auto frustum = Frustum::from_matrix(test_view_projection());
+	std::vector<uint32_t> result;
+	bvh.query(frustum, result);
+	result = sorted(result);
+	REQUIRE(std::adjacent_find(result.begin(), result.end()) == result.end());
+
+	size_t visible = 0;
+	for (uint32_t k = 0; k < boxes.size(); ++k) {
+		AABB grown { boxes[k].min - glm::vec3(1e-3f), boxes[k].max + glm::vec3(1e-3f) };
+		AABB shrunk { boxes[k].min + glm::vec3(1e-3f), boxes[k].max - glm::vec3(1e-3f) };
+		bool found = std::binary_search(result.begin(), result.end(), k);
+		if (frustum.contains(shrunk)) {
+			REQUIRE(found);
+			++visible;
+		} else if (!frustum.contains(grown)) {
+			REQUIRE_FALSE(found);
+		}
+	}
+	// the test is only worth something if the frustum splits the scene
+	REQUIRE(visible > 50);
+	REQUIRE(visible < boxes.size() / 2);
+}
+
+TEST_CASE("BVH ray cast finds the closest box")
+{
+	Bvh bvh;
+	std::vector<AABB> boxes;
+	fill(bvh, boxes, 3000, 6);
+	if (GENERATE(false, true))
+		bvh.build();
+
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	size_t hits = 0;
+	for (int i = 0; i < 200; ++i) {
+		Ray ray { { position(rng), position(rng), position(rng) }, { position(rng), position(rng), position(rng) } };
+		float t_max = 10.0f;
+
+		// nearest and second nearest entry
+		float first = t_max, second = t_max;
+		uint32_t nearest = 0;
+		bool expected = false;
+		for (uint32_t k = 0; k < boxes.size(); ++k) {
+			float t;
+			if (!ray.intersect(boxes[k], t_max, t))
+				continue;
+			if (t < first) {
+				second = first;
+				first = t;
+				nearest = k;
+				expected = true;
+			} else {
+				second = std::min(second, t);
+			}
+		}
+
+		uint32_t id = 0;
+		float t = 0.0f;
+		bool hit = bvh.ray_cast(ray, t_max, id, t);
+		REQUIRE(hit == expected);
+		if (!hit)
+			continue;
+		++hits;
+		REQUIRE(t == Approx(first).margin(1e-4));
+		if (second - first > 1e-4f)
+			REQUIRE(id == nearest);
+	}
+	REQUIRE(hits > 20);
+}
+
+TEST_CASE("BVH ray cast callback refines hits")
+{
+	Bvh bvh;
+	std::vector<AABB> boxes = {
+		{ { -1.0f, -1.0f, -6.0f }, { 1.0f, 1.0f, -4.0f } },
+		{ { -1.0f, -1.0f, -11.0f }, { 1.0f, 1.0f, -9.0f } },
+		{ { -1.0f, -1.0f, -16.0f }, { 1.0f, 1.0f, -14.0f } },
+	};
+	for (uint32_t i = 0; i < boxes.size(); ++i)
+		bvh.insert(boxes[i], i);
+
+	Ray ray { glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+	uint32_t id = 0;
+	float t = 0.0f;
+	REQUIRE(bvh.ray_cast(ray, 100.0f, id, t));
+	REQUIRE(id == 0);
+	REQUIRE(t == Approx(4.0f));
+
+	// the nearest object turns out to be hollow, the middle one is hit at its center
+	auto callback = [](uint32_t user_data, const Ray&, float) {
+		return user_data == 0 ? -1.0f : user_data * 5.0f + 5.0f;
+	};
+	REQUIRE(bvh.ray_cast(ray, 100.0f, id, t, callback));
+	REQUIRE(id == 1);
+	REQUIRE(t == Approx(10.0f));
+
+	REQUIRE_FALSE(bvh.ray_cast(ray, 3.0f, id, t));
+	REQUIRE_FALSE(bvh.ray_cast({ glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f) }, 100.0f, id, t));
+}
+
+TEST_CASE("BVH follows moving proxies")
+{
+	Bvh bvh;
+	bvh.margin = 0.5f;
+	std::vector<AABB> boxes;
+	auto proxies = fill(bvh, boxes, 1000, 8);
+	bool use_refit = GENERATE(false, true);
+
+	std::mt19937 rng(9);
+	std::uniform_real_distribution<float> step(-3.0f, 3.0f);
+	for (int frame = 0; frame < 10; ++frame) {
+		size_t reinserted = 0;
+		for (size_t i = 0; i < boxes.size(); i += 3) {
+			glm::vec3 offset(step(rng), step(rng), step(rng));
+			boxes[i].min += offset;
+			boxes[i].max += offset;
+			if (use_refit)
+				bvh.set_box(proxies[i], boxes[i]);
+			else
+				reinserted += bvh.move(proxies[i], boxes[i]);
+		}
+		if (use_refit)
+			bvh.refit();
+		else
+			REQUIRE(reinserted > 0);
+		REQUIRE(bvh.validate());
+
+		// stored boxes always hold the real ones
+		for (size_t i = 0; i < boxes.size(); ++i)
+			REQUIRE(bvh.box(proxies[i]).contains(boxes[i]));
+
+		AABB query { glm::vec3(-50.0f), glm::vec3(50.0f) };
+		std::vector<uint32_t> result;
+		bvh.query(query, result);
+		result = sorted(result);
+		for (uint32_t k = 0; k < boxes.size(); ++k) {
+			if (boxes[k].overlaps(query))
+				REQUIRE(std::binary_search(result.begin(), result.end(), k));
+		}
+	}
+
+	// a small nudge after a real move stays inside the margin
+	if (!use_refit) {
+		AABB moved { boxes[1].min + glm::vec3(20.0f), boxes[1].max + glm::vec3(20.0f) };
+		REQUIRE(bvh.move(proxies[1], moved));
+		AABB nudged { moved.min + glm::vec3(0.1f), moved.max + glm::vec3(0.1f) };
+		REQUIRE_FALSE(bvh.move(proxies[1], nudged));
+	}
+}
+
+TEST_CASE("BVH rotations and rebuilds lower the cost")
+{
+	Bvh bvh;
+	std::vector<AABB> boxes;
+	auto proxies = fill(bvh, boxes, 4000, 10);
+	float inserted = bvh.cost();
+
+	// scramble the boxes under a fixed topology, the stale tree gets expensive
+	std::mt19937 rng(11);
+	std::shuffle(boxes.begin(), boxes.end(), rng);
+	for (size_t i = 0; i < boxes.size(); ++i)
+		bvh.set_box(proxies[i], boxes[i]);
+	bvh.refit();
+	REQUIRE(bvh.validate());
+	float refit = bvh.cost();
+
+	bvh.build();
+	REQUIRE(bvh.validate());
+	float rebuilt = bvh.cost();
+
+	REQUIRE(rebuilt < refit);
+	REQUIRE(rebuilt < inserted * 1.5f);
+}
@@ -0,0 +1,95 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "cpu_profiler.hpp"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+using namespace chch;
+
+static std::vector<TraceEvent> named(const std::vector<TraceEvent>& events, const std::string& name)
+{
+	std::vector<TraceEvent> out;
+	std::copy_if(events.begin(), events.end(), std::back_inserter(out), [&](const TraceEvent& e) {
+		return e.name == name;
+	});
+	return out;
+}
+
+TEST_CASE("CPU zones are collected per thread")
+{
+	CpuProfiler::clear();
+	{
+		ProfileZone outer("outer");
+		ProfileZone inner("inner");
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	std::thread([]() {
+		CpuProfiler::set_thread_name("other");
+		ProfileZone zone("other thread");
+	}).join();
+
+	auto events = CpuProfiler::collect();
+	auto outer = named(events, "outer");
+	auto inner = named(events, "inner");
+	auto other = named(events, "other thread");
+	REQUIRE(outer.size() == 1);
+	REQUIRE(inner.size() == 1);
+	REQUIRE(other.size() == 1);
+
+	REQUIRE(inner[0].duration_us >= 900.0);
+	REQUIRE(outer[0].start_us <= inner[0].start_us);
+	REQUIRE(outer[0].start_us + outer[0].duration_us >= inner[0].start_us + inner[0].duration_us);
+	REQUIRE(outer[0].thread == inner[0].thread);
+	REQUIRE(other[0].thread != outer[0].thread);
+}
+
+TEST_CASE("CPU zone rings keep the newest zones")
+{
+	CpuProfiler::clear();
+	for (size_t i = 0; i < CpuProfiler::RING_SIZE + 10; ++i)
+		CpuProfiler::record(i < 10 ? "old" : "new", i, i + 1);
+
+	auto events = CpuProfiler::collect();
+	REQUIRE(named(events, "old").empty());
+	// the oldest slot is the one a zone in progress would be overwriting
+	REQUIRE(named(events, "new").size() == CpuProfiler::RING_SIZE - 1);
+	CpuProfiler::clear();
+	REQUIRE(CpuProfiler::collect().empty());
+}
+
+TEST_CASE("Chrome traces name threads and carry extra events")
+{
+	CpuProfiler::clear();
+	CpuProfiler::set_thread_name("main");
+	{
+		ProfileZone zone("frame");
+	}
+
+	std::vector<TraceEvent> gpu { { "main pass", 10.0, 2.5, 0 } };
+	auto json = CpuProfiler::chrome_trace(gpu, "GPU");
+	REQUIRE(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0) == 0);
+	REQUIRE(json.find("\"args\":{\"name\":\"main\"}") != std::string::npos);
+	REQUIRE(json.find("\"args\":{\"name\":\"GPU\"}") != std::string::npos);
+	REQUIRE(json.find("{\"name\":\"frame\",\"ph\":\"X\"") != std::string::npos);
+	REQUIRE(json.find("\"ts\":10.000,\"dur\":2.500}") != std::string::npos);
+	REQUIRE(json.substr(json.size() - 2) == "]}");
+
+	// without extra events there's no extra thread
+	REQUIRE(CpuProfiler::chrome_trace().find("\"GPU\"") == std::string::npos);
+	CpuProfiler::clear();
+}
+
+TEST_CASE("Profile macros compile away without PROFILE")
+{
+	CpuProfiler::clear();
+	PROFILE_ZONE("compiled out");
+	PROFILE_THREAD("compiled out");
+#ifdef PROFILE
+	REQUIRE(true);
+#else
+	REQUIRE(named(CpuProfiler::collect(), "compiled out").empty());
+#endif
+}
@@ -0,0 +1,111 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "culling.hpp"
+#include "thread_pool.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <random>
+
+using namespace chch;
+
+static glm::mat4 test_view_projection()
+{
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return projection * view;
+}
+
+static BoundingSpheres random_spheres(size_t count, uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+	std::uniform_real_distribution<float> radius(0.01f, 4.0f);
+
+	BoundingSpheres spheres;
+	for (size_t i = 0; i < count; ++i)
+		spheres.push_back({ { position(rng), position(rng), position(rng) }, radius(rng) });
+	return spheres;
+}
+
+TEST_CASE("Frustum planes")
+{
+	auto frustum = Frustum::from_matrix(test_view_projection());
+
+	REQUIRE(frustum.contains(Sphere { { 0.0f, 0.0f, -10.0f }, 1.0f }));
+	REQUIRE_FALSE(frustum.contains(Sphere { { 0.0f, 0.0f, 10.0f }, 1.0f }));
+	REQUIRE_FALSE(frustum.contains(Sphere { { 50.0f, 0.0f, -10.0f }, 1.0f }));
+	REQUIRE_FALSE(frustum.contains(Sphere { { 0.0f, 0.0f, -200.0f }, 1.0f }));
+	// straddles the near plane
+	REQUIRE(frustum.contains(Sphere { { 0.0f, 0.0f, 0.5f }, 1.0f }));
+
+	REQUIRE(frustum.contains(AABB { { -1.0f, -1.0f, -11.0f }, { 1.0f, 1.0f, -9.0f } }));
+	REQUIRE_FALSE(frustum.contains(AABB { { -1.0f, -1.0f, 9.0f }, { 1.0f, 1.0f, 11.0f } }));
+}
+
+TEST_CASE("Screen size threshold")
+{
+	FrustumCuller culler;
+	culler.min_screen_size = 0.01f;
+	auto frustum = Frustum::from_matrix(test_view_projection());
+
+	Sphere pebble { { 0.0f, 0.0f, -90.0f }, 0.05f };
+	REQUIRE_FALSE(culler.is_visible(frustum, pebble));
+
+	pebble.center.z = -2.0f;
+	REQUIRE(culler.is_visible(frustum, pebble));
+
+	culler.min_screen_size = 0.0f;
+	pebble.center.z = -90.0f;
+	REQUIRE(culler.is_visible(frustum, pebble));
+}
+
+TEST_CASE("SIMD culling matches scalar")
+{
+	FrustumCuller culler;
+	culler.min_screen_size = GENERATE(0.0f, 0.02f);
+	auto frustum = Frustum::from_matrix(test_view_projection());
+	// odd count so the scalar tail runs too
+	auto spheres = random_spheres(100003, 7);
+
+	std::vector<uint8_t> simd_result, scalar_result;
+	culler.cull(frustum, spheres, simd_result);
+	culler.cull_scalar(frustum, spheres, scalar_result);
+	REQUIRE(simd_result.size() == spheres.size());
+
+	// fused multiply-add may round differently right on a plane
+	FrustumCuller loose = culler, tight = culler;
+	size_t mismatches = 0;
+	for (size_t i = 0; i < spheres.size(); ++i) {
+		if (simd_result[i] == scalar_result[i])
+			continue;
+		Sphere s = spheres.get(i);
+		Sphere grown = s, shrunk = s;
+		grown.radius += 1e-3f;
+		shrunk.radius -= 1e-3f;
+		bool ambiguous = loose.is_visible(frustum, grown) != tight.is_visible(frustum, shrunk);
+		mismatches += !ambiguous;
+	}
+	REQUIRE(mismatches == 0);
+}
+
+TEST_CASE("Threaded culling matches single threaded")
+{
+	ThreadPool pool;
+	pool.init(3);
+
+	FrustumCuller culler;
+	culler.batch_size = 1000;
+	auto frustum = Frustum::from_matrix(test_view_projection());
+	auto spheres = random_spheres(54321, 11);
+
+	std::vector<uint8_t> single, threaded;
+	size_t single_count = culler.cull(frustum, spheres, single);
+	culler.thread_pool = &pool;
+	size_t threaded_count = culler.cull(frustum, spheres, threaded);
+
+	REQUIRE(single_count == threaded_count);
+	REQUIRE(single == threaded);
+	pool.deinit();
+}
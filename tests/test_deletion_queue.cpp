@@ -0,0 +1,61 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "deletion_queue.hpp"
+
+#include <vector>
+
+using namespace chch;
+
+TEST_CASE("Deletion queue waits for enough frames to complete")
+{
+	DeletionQueue queue;
+	std::vector<int> deleted;
+	queue.push(3, [&] { deleted.push_back(1); });
+	queue.push(3, [&] { deleted.push_back(2); });
+	queue.push(5, [&] { deleted.push_back(3); });
+
+	queue.flush(2);
+	REQUIRE(deleted.empty());
+	REQUIRE(queue.size() == 3);
+
+	queue.flush(4);
+	REQUIRE(deleted == std::vector<int> { 1, 2 });
+	REQUIRE(queue.size() == 1);
+
+	// nothing runs twice
+	queue.flush(4);
+	REQUIRE(deleted.size() == 2);
+
+	queue.flush_all();
+	REQUIRE(deleted == std::vector<int> { 1, 2, 3 });
+	REQUIRE(queue.empty());
+}
+
+TEST_CASE("Deletion queue keeps later entries pushed out of order")
+{
+	DeletionQueue queue;
+	std::vector<int> deleted;
+	queue.push(8, [&] { deleted.push_back(8); });
+	queue.push(2, [&] { deleted.push_back(2); });
+
+	queue.flush(2);
+	REQUIRE(deleted == std::vector<int> { 2 });
+	REQUIRE(queue.size() == 1);
+}
+
+TEST_CASE("Deletion queue entries can push more")
+{
+	DeletionQueue queue;
+	int deleted = 0;
+	queue.push(1, [&] {
+		++deleted;
+		queue.push(4, [&] { ++deleted; });
+	});
+
+	queue.flush(1);
+	REQUIRE(deleted == 1);
+	REQUIRE(queue.size() == 1);
+	queue.flush(4);
+	REQUIRE(deleted == 2);
+}
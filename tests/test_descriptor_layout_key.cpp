@@ -0,0 +1,63 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "descriptor_layout_key.hpp"
+
+#include <unordered_map>
+
+using namespace chch;
+
+// raw values of VK_DESCRIPTOR_TYPE_* and VK_SHADER_STAGE_*
+const uint32_t SAMPLER = 1, UNIFORM = 6, STORAGE = 7;
+const uint32_t VERTEX = 0x1, FRAGMENT = 0x10;
+
+TEST_CASE("Descriptor layout keys ignore declaration order")
+{
+	DescriptorLayoutKey a;
+	a.add(0, UNIFORM, 1, VERTEX);
+	a.add(1, SAMPLER, 1, FRAGMENT);
+	a.add(2, STORAGE, 1, FRAGMENT);
+
+	DescriptorLayoutKey b;
+	b.add(2, STORAGE, 1, FRAGMENT);
+	b.add(0, UNIFORM, 1, VERTEX);
+	b.add(1, SAMPLER, 1, FRAGMENT);
+
+	REQUIRE(a == b);
+	REQUIRE(a.hash() == b.hash());
+	REQUIRE(b.bindings[0].binding == 0);
+	REQUIRE(b.bindings[2].binding == 2);
+}
+
+TEST_CASE("Descriptor layout keys tell apart every field")
+{
+	DescriptorLayoutKey base;
+	base.add(0, UNIFORM, 1, VERTEX);
+
+	DescriptorLayoutKey binding, type, count, stages, longer;
+	binding.add(1, UNIFORM, 1, VERTEX);
+	type.add(0, STORAGE, 1, VERTEX);
+	count.add(0, UNIFORM, 2, VERTEX);
+	stages.add(0, UNIFORM, 1, VERTEX | FRAGMENT);
+	longer.add(0, UNIFORM, 1, VERTEX);
+	longer.add(1, UNIFORM, 1, VERTEX);
+
+	for (auto* other : { &binding, &type, &count, &stages, &longer }) {
+		REQUIRE_FALSE(base == *other);
+		REQUIRE(base.hash() != other->hash());
+	}
+}
+
+TEST_CASE("Descriptor layout keys share one map entry per binding list")
+{
+	std::unordered_map<DescriptorLayoutKey, int, DescriptorLayoutKey::Hash> layouts;
+	for (int material = 0; material < 100; ++material) {
+		DescriptorLayoutKey key;
+		key.add(1, SAMPLER, 1, FRAGMENT);
+		key.add(0, UNIFORM, 1, VERTEX | FRAGMENT);
+		layouts.emplace(key, material);
+	}
+
+	REQUIRE(layouts.size() == 1);
+	REQUIRE(layouts.begin()->second == 0);
+}
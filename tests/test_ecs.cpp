@@ -0,0 +1,182 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "ecs.hpp"
+
+#include <atomic>
+#include <thread>
+
+using namespace chch;
+
+struct Position {
+	float x, y, z;
+};
+
+struct Velocity {
+	float x, y, z;
+};
+
+struct Health {
+	int value;
+};
+
+struct alignas(32) Wide {
+	float lanes[8];
+};
+
+TEST_CASE("ECS entities are created, destroyed and recycled")
+{
+	World world;
+	Entity a = world.create(Position { 1.0f, 2.0f, 3.0f });
+	Entity b = world.create(Position { 4.0f, 5.0f, 6.0f }, Health { 10 });
+	REQUIRE(world.size() == 2);
+	REQUIRE(world.alive(a));
+	REQUIRE(world.get<Position>(b)->y == 5.0f);
+	REQUIRE(world.get<Health>(b)->value == 10);
+	REQUIRE(world.get<Health>(a) == nullptr);
+	REQUIRE(world.archetype_count() == 2);
+
+	world.destroy(a);
+	REQUIRE_FALSE(world.alive(a));
+	REQUIRE(world.size() == 1);
+	REQUIRE_THROWS(world.get<Position>(a));
+	REQUIRE_THROWS(world.destroy(a));
+
+	// same slot, new generation, the old handle stays dead
+	Entity c = world.create(Position { 7.0f, 8.0f, 9.0f });
+	REQUIRE(c.index == a.index);
+	REQUIRE(c != a);
+	REQUIRE_FALSE(world.alive(a));
+	REQUIRE(world.get<Position>(c)->x == 7.0f);
+
+	world.clear();
+	REQUIRE(world.size() == 0);
+	REQUIRE_FALSE(world.alive(c));
+}
+
+TEST_CASE("ECS destroying keeps the other entities' data")
+{
+	World world;
+	std::vector<Entity> entities;
+	for (int i = 0; i < 2000; ++i)
+		entities.push_back(world.create(Position { float(i), 0.0f, 0.0f }, Health { i }));
+	REQUIRE(world.chunk_count() > 1);
+
+	for (int i = 0; i < 2000; i += 3)
+		world.destroy(entities[i]);
+	for (int i = 0; i < 2000; ++i) {
+		REQUIRE(world.alive(entities[i]) == (i % 3 != 0));
+		if (i % 3 != 0) {
+			REQUIRE(world.get<Position>(entities[i])->x == float(i));
+			REQUIRE(world.get<Health>(entities[i])->value == i);
+		}
+	}
+
+	size_t rows = 0;
+	world.each_chunk<Health>([&rows](size_t count, const Entity*, Health*) { rows += count; });
+	REQUIRE(rows == world.size());
+}
+
+TEST_CASE("ECS adding and removing components moves entities between archetypes")
+{
+	World world;
+	Entity a = world.create(Position { 1.0f, 2.0f, 3.0f });
+	Entity b = world.create(Position { 4.0f, 5.0f, 6.0f });
+
+	world.add(a, Velocity { 0.5f, 0.0f, 0.0f });
+	REQUIRE(world.has<Velocity>(a));
+	REQUIRE_FALSE(world.has<Velocity>(b));
+	REQUIRE(world.get<Position>(a)->z == 3.0f);
+	REQUIRE(world.get<Velocity>(a)->x == 0.5f);
+	REQUIRE(world.get<Position>(b)->z == 6.0f);
+
+	// already there, just overwritten
+	world.add(a, Velocity { 2.0f, 0.0f, 0.0f });
+	REQUIRE(world.get<Velocity>(a)->x == 2.0f);
+
+	world.remove<Position>(a);
+	REQUIRE_FALSE(world.has<Position>(a));
+	REQUIRE(world.get<Velocity>(a)->x == 2.0f);
+	world.remove<Health>(a);
+	REQUIRE(world.alive(a));
+	REQUIRE(world.size() == 2);
+}
+
+TEST_CASE("ECS queries visit every matching entity once")
+{
+	World world;
+	for (int i = 0; i < 1000; ++i) {
+		if (i % 2)
+			world.create(Position { float(i), 0.0f, 0.0f }, Velocity { 1.0f, 0.0f, 0.0f });
+		else if (i % 3)
+			world.create(Position { float(i), 0.0f, 0.0f }, Velocity { 1.0f, 0.0f, 0.0f }, Health { i });
+		else
+			world.create(Position { float(i), 0.0f, 0.0f });
+	}
+
+	world.each<Position, Velocity>([](Entity, Position& p, Velocity& v) { p.x += v.x; });
+
+	size_t moving = 0, still = 0;
+	double sum = 0.0;
+	world.each<Position>([&](Entity entity, Position& p) {
+		sum += p.x;
+		if (world.has<Velocity>(entity))
+			++moving;
+		else
+			++still;
+	});
+	REQUIRE(moving == 500 + 333);
+	REQUIRE(still == 167);
+	REQUIRE(sum == Approx(999.0 * 1000.0 / 2.0 + moving));
+
+	size_t healthy = 0;
+	world.each<Health, Position>([&healthy](Entity, Health&, Position&) { ++healthy; });
+	REQUIRE(healthy == 333);
+}
+
+TEST_CASE("ECS chunks hold as many rows as fit in 16 KB")
+{
+	World world;
+	size_t capacity = world.chunk_capacity<Position, Velocity>();
+	REQUIRE(capacity == World::CHUNK_SIZE / (sizeof(Entity) + sizeof(Position) + sizeof(Velocity)));
+
+	// alignment padding can cost a row
+	size_t wide = world.chunk_capacity<Health, Wide>();
+	REQUIRE(wide * (sizeof(Entity) + sizeof(Health) + sizeof(Wide)) <= World::CHUNK_SIZE);
+	REQUIRE(wide >= World::CHUNK_SIZE / (sizeof(Entity) + sizeof(Health) + sizeof(Wide)) - 1);
+
+	for (int i = 0; i < 100; ++i)
+		world.create(Health { i }, Wide {});
+	world.each_chunk<Wide, Health>([](size_t count, const Entity* entities, Wide* w, Health* h) {
+		REQUIRE(count > 0);
+		REQUIRE(reinterpret_cast<uintptr_t>(w) % alignof(Wide) == 0);
+		REQUIRE(reinterpret_cast<uintptr_t>(h) % alignof(Health) == 0);
+		REQUIRE(reinterpret_cast<uintptr_t>(entities) % alignof(Entity) == 0);
+	});
+}
+
+TEST_CASE("ECS parallel chunk queries match serial ones")
+{
+	World world;
+	for (int i = 0; i < 20000; ++i)
+		world.create(Position { float(i), 0.0f, 0.0f }, Velocity { 1.0f, 2.0f, 3.0f });
+
+	ThreadPool pool;
+	pool.init(3);
+	world.thread_pool = &pool;
+
+	std::atomic<size_t> rows { 0 };
+	world.parallel_each_chunk<Position, Velocity>([&rows](size_t count, const Entity*, Position* p, Velocity* v) {
+		for (size_t i = 0; i < count; ++i) {
+			p[i].y += v[i].y;
+			p[i].z += v[i].z;
+		}
+		rows += count;
+	});
+	pool.deinit();
+
+	REQUIRE(rows == world.size());
+	size_t wrong = 0;
+	world.each<Position>([&wrong](Entity, Position& p) { wrong += p.y != 2.0f || p.z != 3.0f; });
+	REQUIRE(wrong == 0);
+}
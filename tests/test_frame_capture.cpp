@@ -0,0 +1,106 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "frame_capture.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace chch;
+
+static std::vector<uint8_t> solid(uint32_t width, uint32_t height, uint8_t r, uint8_t g, uint8_t b)
+{
+	std::vector<uint8_t> pixels(width * height * 4);
+	for (size_t i = 0; i < pixels.size(); i += 4) {
+		pixels[i + 0] = r;
+		pixels[i + 1] = g;
+		pixels[i + 2] = b;
+		pixels[i + 3] = 255;
+	}
+	return pixels;
+}
+
+static std::string read_all(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+TEST_CASE("RGBA converts to studio range YUV")
+{
+	std::vector<uint8_t> planes(yuv420_size(4, 2));
+	REQUIRE(planes.size() == 8 + 2 * 2);
+
+	auto black = solid(4, 2, 0, 0, 0);
+	rgba_to_yuv420(black.data(), 4, 2, false, planes.data());
+	REQUIRE(planes[0] == 16);
+	REQUIRE(planes[8] == 128);
+	REQUIRE(planes[10] == 128);
+
+	auto white = solid(4, 2, 255, 255, 255);
+	rgba_to_yuv420(white.data(), 4, 2, false, planes.data());
+	REQUIRE(planes[7] == 235);
+	REQUIRE(planes[9] == 128);
+	REQUIRE(planes[11] == 128);
+
+	// red pushes V up, blue pushes U up, whichever order the channels come in
+	auto red = solid(4, 2, 255, 0, 0);
+	rgba_to_yuv420(red.data(), 4, 2, false, planes.data());
+	REQUIRE(planes[8] < 128);
+	REQUIRE(planes[10] > 200);
+	rgba_to_yuv420(red.data(), 4, 2, true, planes.data());
+	REQUIRE(planes[8] > 200);
+	REQUIRE(planes[10] < 128);
+}
+
+TEST_CASE("Odd sized frames get rounded up chroma planes")
+{
+	REQUIRE(yuv420_size(3, 3) == 9 + 2 * 4);
+
+	auto gray = solid(3, 3, 128, 128, 128);
+	std::vector<uint8_t> planes(yuv420_size(3, 3), 0);
+	rgba_to_yuv420(gray.data(), 3, 3, false, planes.data());
+	for (size_t i = 9; i < planes.size(); ++i)
+		REQUIRE(planes[i] == 128);
+}
+
+TEST_CASE("Y4M captures carry a header and a marker per frame")
+{
+	auto path = std::filesystem::temp_directory_path() / "chch_test_capture.y4m";
+	REQUIRE(FrameCapture::format_for(path) == FrameCapture::Y4M);
+	REQUIRE(FrameCapture::format_for("frames.rgba") == FrameCapture::RAW);
+
+	auto pixels = solid(6, 4, 10, 20, 30);
+	FrameCapture capture;
+	capture.open(path, FrameCapture::Y4M, 6, 4, 30);
+	capture.write(pixels.data());
+	capture.write(pixels.data());
+	REQUIRE(capture.frames_written() == 2);
+	capture.close();
+
+	std::string header = "YUV4MPEG2 W6 H4 F30:1 Ip A1:1 C420jpeg\n";
+	auto file = read_all(path);
+	REQUIRE(file.compare(0, header.size(), header) == 0);
+	REQUIRE(file.size() == header.size() + 2 * (6 + yuv420_size(6, 4)));
+	REQUIRE(file.compare(header.size(), 6, "FRAME\n") == 0);
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("Raw captures come out as RGBA")
+{
+	auto path = std::filesystem::temp_directory_path() / "chch_test_capture.rgba";
+	const uint8_t bgra[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+	FrameCapture capture;
+	capture.open(path, FrameCapture::RAW, 2, 1, 60, true);
+	capture.write(bgra);
+	capture.close();
+	REQUIRE_THROWS(capture.write(bgra));
+
+	REQUIRE(read_all(path) == std::string { 3, 2, 1, 4, 7, 6, 5, 8 });
+	std::filesystem::remove(path);
+
+	REQUIRE_THROWS(capture.open("/nonexistent/dir/capture.rgba", FrameCapture::RAW, 2, 1));
+}
@@ -0,0 +1,94 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "image_compare.hpp"
+
+#include <cmath>
+#include <filesystem>
+
+using namespace chch;
+
+static Rgba8Image gradient(uint32_t width, uint32_t height)
+{
+	Rgba8Image image;
+	image.resize(width, height);
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			uint8_t* p = &image.pixels[(y * width + x) * 4];
+			p[0] = static_cast<uint8_t>(x * 255 / width);
+			p[1] = static_cast<uint8_t>(y * 255 / height);
+			p[2] = static_cast<uint8_t>((x + y) % 256);
+			p[3] = 255;
+		}
+	}
+	return image;
+}
+
+TEST_CASE("Identical images compare clean")
+{
+	auto a = gradient(64, 32);
+	auto diff = compare_images(a, a);
+	REQUIRE(diff.identical());
+	REQUIRE(diff.mismatched == 0);
+	REQUIRE(diff.mse == 0.0);
+	REQUIRE(std::isinf(diff.psnr()));
+}
+
+TEST_CASE("Image differences are counted against the tolerance")
+{
+	auto a = gradient(64, 32);
+	auto b = a;
+	b.pixels[0] += 3;
+	b.pixels[(10 * 64 + 10) * 4 + 1] ^= 0x80;
+	// alpha doesn't count
+	b.pixels[(20 * 64 + 20) * 4 + 3] = 0;
+
+	auto diff = compare_images(a, b);
+	REQUIRE(diff.mismatched == 2);
+	REQUIRE(diff.max_difference == 128);
+	REQUIRE(diff.mse > 0.0);
+
+	diff = compare_images(a, b, 3);
+	REQUIRE(diff.mismatched == 1);
+
+	Rgba8Image marked;
+	compare_images(a, b, 3, &marked);
+	REQUIRE(marked.width == a.width);
+	REQUIRE(marked.pixels[(10 * 64 + 10) * 4 + 0] == 255);
+	REQUIRE(marked.pixels[(10 * 64 + 10) * 4 + 1] == 0);
+	REQUIRE(marked.pixels[0] == a.pixels[0] / 4);
+
+	Rgba8Image small;
+	small.resize(8, 8);
+	REQUIRE_THROWS(compare_images(a, small));
+}
+
+TEST_CASE("BGRA frames are swizzled to RGBA")
+{
+	const uint8_t bgra[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	auto image = make_rgba8_image(bgra, 2, 1, true);
+	REQUIRE(image.pixels == std::vector<uint8_t> { 3, 2, 1, 4, 7, 6, 5, 8 });
+	image = make_rgba8_image(bgra, 2, 1);
+	REQUIRE(image.pixels == std::vector<uint8_t> { 1, 2, 3, 4, 5, 6, 7, 8 });
+}
+
+TEST_CASE("Golden images round trip through PPM")
+{
+	auto path = std::filesystem::temp_directory_path() / "chch_test_golden.ppm";
+	auto a = gradient(37, 19);
+	a.pixels[3] = 7;
+	REQUIRE(save_ppm(path, a));
+
+	Rgba8Image b;
+	REQUIRE(load_ppm(path, b));
+	REQUIRE(b.width == 37);
+	REQUIRE(b.height == 19);
+	REQUIRE(b.pixels[3] == 255);
+	REQUIRE(compare_images(a, b).identical());
+
+	// cut short
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 10);
+	REQUIRE_FALSE(load_ppm(path, b));
+	std::filesystem::remove(path);
+	REQUIRE_FALSE(load_ppm(path, b));
+}
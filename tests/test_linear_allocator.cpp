@@ -0,0 +1,51 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "linear_allocator.hpp"
+
+#include <vector>
+
+using namespace chch;
+
+TEST_CASE("Linear allocator hands out aligned slices in order")
+{
+	std::vector<uint8_t> memory(1024);
+	LinearAllocator allocator;
+	allocator.init(memory.data(), memory.size(), 256);
+
+	REQUIRE(allocator.allocate(16) == 0);
+	REQUIRE(allocator.allocate(300) == 256);
+	REQUIRE(allocator.used() == 556);
+	REQUIRE(allocator.allocate(1) == 768);
+	// 1024 would end past the memory
+	REQUIRE_THROWS(allocator.allocate(1));
+
+	allocator.reset();
+	REQUIRE(allocator.used() == 0);
+	REQUIRE(allocator.allocate(1024) == 0);
+}
+
+TEST_CASE("Linear allocator copies pushed data")
+{
+	std::vector<uint8_t> memory(256);
+	LinearAllocator allocator;
+	allocator.init(memory.data(), memory.size(), 16);
+
+	float a[3] = { 1.0f, 2.0f, 3.0f };
+	int b = 42;
+	size_t first = allocator.push(a, sizeof(a));
+	size_t second = allocator.push(&b, sizeof(b));
+	REQUIRE(second == 16);
+	REQUIRE(static_cast<float*>(allocator.data(first))[2] == 3.0f);
+	REQUIRE(*static_cast<int*>(allocator.data(second)) == 42);
+	REQUIRE(allocator.data(second) == memory.data() + 16);
+}
+
+TEST_CASE("Linear allocator rejects alignments that aren't powers of two")
+{
+	uint8_t memory[64];
+	LinearAllocator allocator;
+	REQUIRE_THROWS(allocator.init(memory, sizeof(memory), 0));
+	REQUIRE_THROWS(allocator.init(memory, sizeof(memory), 48));
+	REQUIRE_NOTHROW(allocator.init(memory, sizeof(memory), 1));
+}
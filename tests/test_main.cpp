@@ -2,5 +2,12 @@
 #define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "catch.hpp"
 
+#include "root.hpp"
+
+// the tests run from the repo root, the build directory has the shaders and
+// a link to the resources
+static const std::filesystem::path root_path = std::filesystem::current_path() / "build";
+const std::filesystem::path& chch::Root::path(root_path);
+
 // Put tests in different files to minimize recompiling catch
 
@@ -0,0 +1,266 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "mesh_bvh.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <cmath>
+#include <random>
+
+using namespace chch;
+
+// position sits behind other attributes like it does in Vertex
+struct TestVertex {
+	glm::vec2 uv;
+	glm::vec3 position;
+	float pad;
+};
+
+struct TestMesh {
+	std::vector<TestVertex> vertices;
+	std::vector<uint32_t> indices;
+
+	void build(MeshBvh& bvh) const
+	{
+		bvh.build(&vertices[0].position, sizeof(TestVertex), vertices.size(), indices.data(), indices.size());
+	}
+
+	glm::vec3 corner(size_t triangle, int k) const
+	{
+		return vertices[indices[3 * triangle + k]].position;
+	}
+};
+
+static TestMesh random_triangles(size_t count, uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> center(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+
+	TestMesh mesh;
+	for (size_t i = 0; i < count; ++i) {
+		glm::vec3 c(center(rng), center(rng), center(rng));
+		for (int k = 0; k < 3; ++k) {
+			mesh.indices.push_back(static_cast<uint32_t>(mesh.vertices.size()));
+			mesh.vertices.push_back({ glm::vec2(0.0f), c + glm::vec3(offset(rng), offset(rng), offset(rng)), 0.0f });
+		}
+	}
+	return mesh;
+}
+
+static Ray random_ray(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> position(-25.0f, 25.0f);
+	glm::vec3 origin(position(rng), position(rng), position(rng));
+	glm::vec3 target(position(rng) * 0.5f, position(rng) * 0.5f, position(rng) * 0.5f);
+	return { origin, target - origin };
+}
+
+struct Reference {
+	bool hit = false;
+	// a hit within a hair of an edge, or two hits at almost the same distance
+	bool ambiguous = false;
+	double t = 0.0;
+	uint32_t triangle = 0;
+	double u = 0.0, v = 0.0;
+};
+
+// Every triangle in double precision
+static Reference brute_force(const TestMesh& mesh, const Ray& ray, double t_max)
+{
+	Reference result;
+	double second = t_max;
+	glm::dvec3 o(ray.origin), d(ray.direction);
+	for (size_t i = 0; i < mesh.indices.size() / 3; ++i) {
+		glm::dvec3 v0(mesh.corner(i, 0));
+		glm::dvec3 e1 = glm::dvec3(mesh.corner(i, 1)) - v0;
+		glm::dvec3 e2 = glm::dvec3(mesh.corner(i, 2)) - v0;
+		glm::dvec3 p = glm::cross(d, e2);
+		double det = glm::dot(e1, p);
+		if (std::abs(det) < 1e-12)
+			continue;
+		glm::dvec3 s = o - v0;
+		double u = glm::dot(s, p) / det;
+		glm::dvec3 q = glm::cross(s, e1);
+		double v = glm::dot(d, q) / det;
+		double t = glm::dot(e2, q) / det;
+
+		const double edge = 1e-4;
+		bool near_edge = std::abs(u) < edge || std::abs(v) < edge || std::abs(1.0 - u - v) < edge
+			|| std::abs(t) < edge || std::abs(t - t_max) < edge;
+		bool inside = u >= 0.0 && v >= 0.0 && u + v <= 1.0 && t >= 0.0 && t <= t_max;
+		if (near_edge && (inside || !result.hit || t < result.t))
+			result.ambiguous = true;
+		if (!inside)
+			continue;
+
+		if (!result.hit || t < result.t) {
+			second = result.hit ? result.t : second;
+			result.hit = true;
+			result.t = t;
+			result.triangle = static_cast<uint32_t>(i);
+			result.u = u;
+			result.v = v;
+		} else {
+			second = std::min(second, t);
+		}
+	}
+	if (result.hit && second - result.t < 1e-4)
+		result.ambiguous = true;
+	return result;
+}
+
+TEST_CASE("Mesh BVH closest hit matches brute force")
+{
+	auto mesh = random_triangles(GENERATE(5, 3000), 1);
+	MeshBvh bvh;
+	mesh.build(bvh);
+	REQUIRE(bvh.triangle_count() == mesh.indices.size() / 3);
+	REQUIRE(bvh.bounds().is_valid());
+
+	std::mt19937 rng(2);
+	size_t checked = 0, hits = 0;
+	for (int i = 0; i < 500; ++i) {
+		Ray ray = random_ray(rng);
+		auto expected = brute_force(mesh, ray, 2.0);
+		if (expected.ambiguous)
+			continue;
+		++checked;
+
+		RayHit hit;
+		REQUIRE(bvh.intersect(ray, 2.0f, hit) == expected.hit);
+		REQUIRE(bvh.occluded(ray, 2.0f) == expected.hit);
+		if (!expected.hit)
+			continue;
+		++hits;
+		REQUIRE(hit.triangle == expected.triangle);
+		REQUIRE(hit.t == Approx(expected.t).margin(1e-4));
+		REQUIRE(hit.barycentrics.x == Approx(expected.u).margin(1e-4));
+		REQUIRE(hit.barycentrics.y == Approx(expected.v).margin(1e-4));
+	}
+	REQUIRE(checked > 350);
+	if (mesh.indices.size() > 100)
+		REQUIRE(hits > 50);
+}
+
+TEST_CASE("Mesh BVH hits a quad from both sides")
+{
+	TestMesh quad;
+	for (auto p : { glm::vec3(-1, -1, 0), glm::vec3(1, -1, 0), glm::vec3(1, 1, 0), glm::vec3(-1, 1, 0) })
+		quad.vertices.push_back({ glm::vec2(0.0f), p, 0.0f });
+	quad.indices = { 0, 1, 2, 0, 2, 3 };
+	MeshBvh bvh;
+	quad.build(bvh);
+
+	RayHit hit;
+	REQUIRE(bvh.intersect({ { 0.5f, -0.5f, 5.0f }, { 0.0f, 0.0f, -1.0f } }, 100.0f, hit));
+	REQUIRE(hit.t == Approx(5.0f));
+	REQUIRE(hit.triangle == 0);
+	// p = v0 + u * e1 + v * e2 with v0 = (-1, -1), e1 = (2, 0), e2 = (2, 2)
+	REQUIRE(hit.barycentrics.x == Approx(0.5f));
+	REQUIRE(hit.barycentrics.y == Approx(0.25f));
+
+	REQUIRE(bvh.intersect({ { -0.5f, 0.5f, -5.0f }, { 0.0f, 0.0f, 2.0f } }, 100.0f, hit));
+	REQUIRE(hit.t == Approx(2.5f));
+	REQUIRE(hit.triangle == 1);
+
+	REQUIRE_FALSE(bvh.intersect({ { 0.5f, -0.5f, 5.0f }, { 0.0f, 0.0f, -1.0f } }, 4.0f, hit));
+	REQUIRE_FALSE(bvh.occluded({ { 2.5f, 0.0f, 5.0f }, { 0.0f, 0.0f, -1.0f } }, 100.0f));
+	REQUIRE_FALSE(bvh.occluded({ { 0.0f, 0.0f, 5.0f }, { 0.0f, 0.0f, 1.0f } }, 100.0f));
+
+	MeshBvh empty;
+	empty.build(nullptr, sizeof(glm::vec3), 0, nullptr, 0);
+	REQUIRE_FALSE(empty.intersect({ glm::vec3(0.0f), glm::vec3(1.0f) }, 100.0f, hit));
+}
+
+TEST_CASE("Mesh BVH rejects out of range indices")
+{
+	TestMesh mesh = random_triangles(3, 3);
+	mesh.indices[4] = 100;
+	MeshBvh bvh;
+	REQUIRE_THROWS(mesh.build(bvh));
+}
+
+TEST_CASE("Mesh scene instances match brute force in world space")
+{
+	auto mesh = random_triangles(800, 4);
+	MeshBvh bvh;
+	mesh.build(bvh);
+
+	std::vector<glm::mat4> transforms;
+	for (int i = 0; i < 6; ++i) {
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(i * 15.0f - 40.0f, 0.0f, 0.0f));
+		transform = glm::rotate(transform, i * 0.7f, glm::normalize(glm::vec3(1.0f, 2.0f, 0.5f)));
+		transforms.push_back(glm::scale(transform, glm::vec3(0.5f + i * 0.2f)));
+	}
+
+	MeshScene scene;
+	for (const auto& transform : transforms)
+		scene.add(&bvh, transform);
+	REQUIRE(scene.size() == transforms.size());
+
+	// the middle instance walks away, another one leaves for good
+	transforms[2] = glm::translate(transforms[2], glm::vec3(0.0f, 30.0f, 0.0f));
+	scene.set_transform(2, transforms[2]);
+	scene.remove(4);
+
+	// world space copy of everything still in the scene
+	TestMesh world;
+	std::vector<uint32_t> owner;
+	for (uint32_t i = 0; i < transforms.size(); ++i) {
+		if (i == 4)
+			continue;
+		for (size_t t = 0; t < mesh.indices.size() / 3; ++t) {
+			for (int k = 0; k < 3; ++k) {
+				world.indices.push_back(static_cast<uint32_t>(world.vertices.size()));
+				world.vertices.push_back({ glm::vec2(0.0f), glm::vec3(transforms[i] * glm::vec4(mesh.corner(t, k), 1.0f)), 0.0f });
+			}
+			owner.push_back(i);
+		}
+	}
+
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	size_t checked = 0, hits = 0;
+	for (int i = 0; i < 300; ++i) {
+		Ray ray { { position(rng), position(rng), 40.0f }, { position(rng) * 0.01f, position(rng) * 0.01f, -1.0f } };
+		auto expected = brute_force(world, ray, 100.0);
+		if (expected.ambiguous)
+			continue;
+		++checked;
+
+		RayHit hit;
+		REQUIRE(scene.intersect(ray, 100.0f, hit) == expected.hit);
+		REQUIRE(scene.occluded(ray, 100.0f) == expected.hit);
+		if (!expected.hit)
+			continue;
+		++hits;
+		REQUIRE(hit.instance == owner[expected.triangle]);
+		REQUIRE(hit.triangle == expected.triangle % (mesh.indices.size() / 3));
+		REQUIRE(hit.t == Approx(expected.t).epsilon(1e-4));
+	}
+	REQUIRE(checked > 250);
+	REQUIRE(hits > 30);
+}
+
+TEST_CASE("Screen rays go through the pixel they were made for")
+{
+	glm::mat4 view_projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f)
+		* glm::lookAt(glm::vec3(3.0f, 2.0f, 1.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 inverse = glm::inverse(view_projection);
+
+	for (glm::vec2 ndc : { glm::vec2(0.0f), glm::vec2(-0.9f, 0.3f), glm::vec2(0.5f, -0.75f) }) {
+		Ray ray = Ray::from_screen(inverse, ndc);
+		REQUIRE(glm::length(ray.direction) == Approx(1.0f));
+		for (float t : { 1.0f, 10.0f, 50.0f }) {
+			glm::vec4 clip = view_projection * glm::vec4(ray.at(t), 1.0f);
+			REQUIRE(clip.x / clip.w == Approx(ndc.x).margin(1e-4));
+			REQUIRE(clip.y / clip.w == Approx(ndc.y).margin(1e-4));
+			REQUIRE(clip.w > 0.0f);
+		}
+	}
+	// starts on the near plane
+	Ray center = Ray::from_screen(inverse, glm::vec2(0.0f));
+	REQUIRE(glm::length(center.origin - glm::vec3(3.0f, 2.0f, 1.0f)) == Approx(0.1f).epsilon(1e-3));
+}
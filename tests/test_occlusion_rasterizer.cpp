@@ -0,0 +1,269 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "occlusion_rasterizer.hpp"
+#include "thread_pool.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <cmath>
+#include <random>
+
+using namespace chch;
+
+static const uint32_t WIDTH = 256;
+static const uint32_t HEIGHT = 128;
+
+static glm::mat4 test_view_projection()
+{
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return projection * view;
+}
+
+struct TestMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+
+	OccluderGeometry geometry() const
+	{
+		return { positions.data(), sizeof(glm::vec3), positions.size(), indices.data(), indices.size() };
+	}
+
+	void add_quad(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d)
+	{
+		auto base = static_cast<uint32_t>(positions.size());
+		positions.insert(positions.end(), { a, b, c, d });
+		indices.insert(indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+	}
+};
+
+static TestMesh random_triangles(size_t count, uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> center_xy(-20.0f, 20.0f);
+	std::uniform_real_distribution<float> center_z(-60.0f, -2.0f);
+	std::uniform_real_distribution<float> offset(-6.0f, 6.0f);
+
+	TestMesh mesh;
+	for (size_t i = 0; i < count; ++i) {
+		glm::vec3 center(center_xy(rng), center_xy(rng), center_z(rng));
+		for (int k = 0; k < 3; ++k) {
+			mesh.indices.push_back(static_cast<uint32_t>(mesh.positions.size()));
+			mesh.positions.push_back(center + glm::vec3(offset(rng), offset(rng), offset(rng)));
+		}
+	}
+	return mesh;
+}
+
+// Every pixel center against every triangle in double precision. Pixels that
+// sit within a hair of some triangle edge could go either way and are flagged.
+static void brute_force_depth(
+	const TestMesh& mesh,
+	const glm::mat4& view_projection,
+	std::vector<double>& depth,
+	std::vector<bool>& ambiguous)
+{
+	depth.assign(WIDTH * HEIGHT, 1.0);
+	ambiguous.assign(WIDTH * HEIGHT, false);
+	glm::dmat4 vp(view_projection);
+
+	for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+		glm::dvec3 v[3];
+		bool behind = false;
+		for (int k = 0; k < 3; ++k) {
+			glm::dvec4 clip = vp * glm::dvec4(glm::dvec3(mesh.positions[mesh.indices[i + k]]), 1.0);
+			if (clip.w < 1e-5)
+				behind = true;
+			v[k] = glm::dvec3(
+				(clip.x / clip.w * 0.5 + 0.5) * WIDTH,
+				(clip.y / clip.w * 0.5 + 0.5) * HEIGHT,
+				clip.z / clip.w);
+		}
+		if (behind)
+			continue;
+
+		double area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+		if (std::abs(area) < 1e-8)
+			continue;
+
+		for (uint32_t y = 0; y < HEIGHT; ++y) {
+			for (uint32_t x = 0; x < WIDTH; ++x) {
+				glm::dvec2 p(x + 0.5, y + 0.5);
+				double w[3];
+				bool near_edge = false;
+				for (int k = 0; k < 3; ++k) {
+					const auto& a = v[(k + 1) % 3];
+					const auto& b = v[(k + 2) % 3];
+					double edge = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+					double length = glm::length(glm::dvec2(b - a));
+					near_edge |= std::abs(edge) / length < 1e-3;
+					w[k] = edge / area;
+				}
+				if (w[0] < 0.0 || w[1] < 0.0 || w[2] < 0.0) {
+					if (near_edge)
+						ambiguous[y * WIDTH + x] = true;
+					continue;
+				}
+				if (near_edge)
+					ambiguous[y * WIDTH + x] = true;
+
+				double z = w[0] * v[0].z + w[1] * v[1].z + w[2] * v[2].z;
+				depth[y * WIDTH + x] = std::min(depth[y * WIDTH + x], z);
+			}
+		}
+	}
+}
+
+TEST_CASE("Occlusion rasterizer matches brute force")
+{
+	auto seed = GENERATE(1u, 2u, 3u);
+	auto mesh = random_triangles(40, seed);
+	auto view_projection = test_view_projection();
+
+	OcclusionRasterizer rasterizer;
+	rasterizer.init(WIDTH, HEIGHT);
+	rasterizer.begin(view_projection);
+	rasterizer.add_occluder(mesh.geometry(), glm::mat4(1.0f));
+	rasterizer.rasterize();
+
+	std::vector<double> reference;
+	std::vector<bool> ambiguous;
+	brute_force_depth(mesh, view_projection, reference, ambiguous);
+
+	size_t checked = 0, mismatched = 0;
+	for (size_t i = 0; i < reference.size(); ++i) {
+		if (ambiguous[i])
+			continue;
+		++checked;
+		if (std::abs(rasterizer.depth()[i] - reference[i]) > 1e-4)
+			++mismatched;
+	}
+
+	REQUIRE(checked > reference.size() * 9 / 10);
+	REQUIRE(mismatched == 0);
+}
+
+TEST_CASE("Occlusion rasterizer threaded matches single threaded")
+{
+	auto mesh = random_triangles(200, 11);
+	auto view_projection = test_view_projection();
+
+	OcclusionRasterizer single;
+	single.init(WIDTH, HEIGHT);
+	single.begin(view_projection);
+	single.add_occluder(mesh.geometry(), glm::mat4(1.0f));
+	single.rasterize();
+
+	ThreadPool pool;
+	pool.init(3);
+	OcclusionRasterizer threaded;
+	threaded.thread_pool = &pool;
+	threaded.band_height = 8;
+	threaded.init(WIDTH, HEIGHT);
+	threaded.begin(view_projection);
+	threaded.add_occluder(mesh.geometry(), glm::mat4(1.0f));
+	threaded.rasterize();
+	pool.deinit();
+
+	REQUIRE(single.depth() == threaded.depth());
+}
+
+TEST_CASE("Occludees behind a wall")
+{
+	TestMesh wall;
+	wall.add_quad(
+		{ -5.0f, -5.0f, 0.0f },
+		{ 5.0f, -5.0f, 0.0f },
+		{ 5.0f, 5.0f, 0.0f },
+		{ -5.0f, 5.0f, 0.0f });
+
+	OcclusionRasterizer rasterizer;
+	rasterizer.init(WIDTH, HEIGHT);
+	rasterizer.begin(test_view_projection());
+	rasterizer.add_occluder(wall.geometry(), glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -10.0f)));
+	rasterizer.rasterize();
+	REQUIRE(rasterizer.triangle_count() == 2);
+
+	// straight behind
+	REQUIRE_FALSE(rasterizer.is_visible({ { -1.0f, -1.0f, -21.0f }, { 1.0f, 1.0f, -19.0f } }));
+	// in front
+	REQUIRE(rasterizer.is_visible({ { -1.0f, -1.0f, -6.0f }, { 1.0f, 1.0f, -4.0f } }));
+	// behind but poking out past the edge
+	REQUIRE(rasterizer.is_visible({ { 3.0f, -1.0f, -21.0f }, { 14.0f, 1.0f, -19.0f } }));
+	// off to the side
+	REQUIRE(rasterizer.is_visible({ { 12.0f, -1.0f, -21.0f }, { 14.0f, 1.0f, -19.0f } }));
+	// around the camera
+	REQUIRE(rasterizer.is_visible({ { -1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f } }));
+	// behind the camera can't be projected, that is left to frustum culling
+	REQUIRE(rasterizer.is_visible({ { -1.0f, -1.0f, 4.0f }, { 1.0f, 1.0f, 6.0f } }));
+}
+
+TEST_CASE("Occludee test matches brute force")
+{
+	auto mesh = random_triangles(120, 7);
+	auto view_projection = test_view_projection();
+
+	OcclusionRasterizer rasterizer;
+	rasterizer.init(WIDTH, HEIGHT);
+	rasterizer.begin(view_projection);
+	rasterizer.add_occluder(mesh.geometry(), glm::mat4(1.0f));
+	rasterizer.rasterize();
+
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> center_xy(-25.0f, 25.0f);
+	std::uniform_real_distribution<float> center_z(-80.0f, -5.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 3.0f);
+	glm::dmat4 vp(view_projection);
+
+	size_t checked = 0;
+	for (int i = 0; i < 2000; ++i) {
+		glm::vec3 center(center_xy(rng), center_xy(rng), center_z(rng));
+		glm::vec3 half(extent(rng), extent(rng), extent(rng));
+		AABB box { center - half, center + half };
+
+		// every pixel the projected rect touches, in double precision
+		double x_min = 1e9, x_max = -1e9, y_min = 1e9, y_max = -1e9, nearest = 1.0;
+		for (int c = 0; c < 8; ++c) {
+			glm::dvec3 corner(
+				(c & 1) ? box.max.x : box.min.x,
+				(c & 2) ? box.max.y : box.min.y,
+				(c & 4) ? box.max.z : box.min.z);
+			glm::dvec4 clip = vp * glm::dvec4(corner, 1.0);
+			double x = (clip.x / clip.w * 0.5 + 0.5) * WIDTH;
+			double y = (clip.y / clip.w * 0.5 + 0.5) * HEIGHT;
+			x_min = std::min(x_min, x);
+			x_max = std::max(x_max, x);
+			y_min = std::min(y_min, y);
+			y_max = std::max(y_max, y);
+			nearest = std::min(nearest, clip.z / clip.w);
+		}
+
+		// skip rects whose edges land right on a pixel boundary
+		auto on_boundary = [](double v) { return std::abs(v - std::round(v)) < 1e-3; };
+		if (on_boundary(x_min) || on_boundary(x_max) || on_boundary(y_min) || on_boundary(y_max))
+			continue;
+
+		int px_min = std::max(0, static_cast<int>(std::floor(x_min)));
+		int px_max = std::min<int>(WIDTH - 1, static_cast<int>(std::floor(x_max)));
+		int py_min = std::max(0, static_cast<int>(std::floor(y_min)));
+		int py_max = std::min<int>(HEIGHT - 1, static_cast<int>(std::floor(y_max)));
+
+		bool surely_visible = false, surely_hidden = true;
+		for (int y = py_min; y <= py_max; ++y) {
+			for (int x = px_min; x <= px_max; ++x) {
+				double d = rasterizer.depth()[y * WIDTH + x];
+				surely_visible |= d > nearest + 1e-5;
+				surely_hidden &= d < nearest - 1e-5;
+			}
+		}
+		if (px_min > px_max || py_min > py_max)
+			surely_visible = false;
+		if (surely_visible == surely_hidden)
+			continue;
+
+		++checked;
+		REQUIRE(rasterizer.is_visible(box) == surely_visible);
+	}
+	REQUIRE(checked > 1000);
+}
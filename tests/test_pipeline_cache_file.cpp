@@ -0,0 +1,108 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "pipeline_cache_file.hpp"
+
+#include <cstring>
+#include <fstream>
+
+using namespace chch;
+
+static PipelineCacheDevice test_device()
+{
+	PipelineCacheDevice device { 0x10de, 0x2484, {} };
+	for (size_t i = 0; i < device.uuid.size(); ++i)
+		device.uuid[i] = static_cast<uint8_t>(i * 7);
+	return device;
+}
+
+// What a driver would hand back from vkGetPipelineCacheData
+static std::vector<char> driver_data(const PipelineCacheDevice& device, size_t payload)
+{
+	PipelineCacheHeader header { sizeof(PipelineCacheHeader), 1, device.vendor_id, device.device_id, {} };
+	memcpy(header.uuid, device.uuid.data(), device.uuid.size());
+
+	std::vector<char> data(sizeof(PipelineCacheHeader) + payload);
+	memcpy(data.data(), &header, sizeof(header));
+	for (size_t i = 0; i < payload; ++i)
+		data[sizeof(header) + i] = static_cast<char>(i * 31);
+	return data;
+}
+
+TEST_CASE("Pipeline cache files round trip")
+{
+	auto device = test_device();
+	auto data = driver_data(device, 1000);
+
+	std::vector<char> out;
+	REQUIRE(PipelineCacheFile::unpack(PipelineCacheFile::pack(data), device, out));
+	REQUIRE(out == data);
+}
+
+TEST_CASE("Pipeline cache files from another device or driver are dropped")
+{
+	auto device = test_device();
+	auto file = PipelineCacheFile::pack(driver_data(device, 100));
+	std::vector<char> out;
+
+	auto other = device;
+	other.device_id += 1;
+	REQUIRE_FALSE(PipelineCacheFile::unpack(file, other, out));
+
+	other = device;
+	other.vendor_id += 1;
+	REQUIRE_FALSE(PipelineCacheFile::unpack(file, other, out));
+
+	// a driver update changes the uuid
+	other = device;
+	other.uuid[15] ^= 1;
+	REQUIRE_FALSE(PipelineCacheFile::unpack(file, other, out));
+	REQUIRE(out.empty());
+}
+
+TEST_CASE("Damaged pipeline cache files are dropped")
+{
+	auto device = test_device();
+	auto file = PipelineCacheFile::pack(driver_data(device, 100));
+	std::vector<char> out;
+
+	auto flipped = file;
+	flipped[flipped.size() - 3] ^= 0x40;
+	REQUIRE_FALSE(PipelineCacheFile::unpack(flipped, device, out));
+
+	auto truncated = file;
+	truncated.resize(file.size() - 1);
+	REQUIRE_FALSE(PipelineCacheFile::unpack(truncated, device, out));
+
+	REQUIRE_FALSE(PipelineCacheFile::unpack({}, device, out));
+	REQUIRE_FALSE(PipelineCacheFile::unpack(std::vector<char>(200, 'x'), device, out));
+}
+
+TEST_CASE("Pipeline cache files are saved and loaded")
+{
+	auto device = test_device();
+	auto data = driver_data(device, 4096);
+	auto path = std::filesystem::temp_directory_path() / "chch_test_pipeline_cache.bin";
+	std::filesystem::remove(path);
+
+	REQUIRE(PipelineCacheFile::load(path, device).empty());
+
+	REQUIRE(PipelineCacheFile::save(path, data));
+	REQUIRE(PipelineCacheFile::load(path, device) == data);
+	REQUIRE_FALSE(std::filesystem::exists(path.string() + ".tmp"));
+
+	// replacing an existing cache
+	auto smaller = driver_data(device, 16);
+	REQUIRE(PipelineCacheFile::save(path, smaller));
+	REQUIRE(PipelineCacheFile::load(path, device) == smaller);
+
+	// what a crash halfway through an unsafe write would leave
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		auto packed = PipelineCacheFile::pack(data);
+		file.write(packed.data(), packed.size() / 2);
+	}
+	REQUIRE(PipelineCacheFile::load(path, device).empty());
+
+	std::filesystem::remove(path);
+}
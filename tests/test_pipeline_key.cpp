@@ -0,0 +1,53 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "pipeline_key.hpp"
+
+#include <unordered_map>
+
+using namespace chch;
+
+static PipelineKey material_key(const std::string& fragment, uint32_t cull_mode)
+{
+	PipelineKey key;
+	key.add('G')
+		.add(std::string("shader_vert.spv"))
+		.add(uint32_t(0x1))
+		.add(fragment)
+		.add(uint32_t(0x10))
+		.add(cull_mode)
+		.add(1.0f);
+	return key;
+}
+
+TEST_CASE("Pipeline keys with the same state match")
+{
+	auto a = material_key("shader_frag.spv", 2);
+	auto b = material_key("shader_frag.spv", 2);
+	REQUIRE(a == b);
+	REQUIRE(a.hash() == b.hash());
+
+	REQUIRE_FALSE(a == material_key("skybox_frag.spv", 2));
+	REQUIRE_FALSE(a == material_key("shader_frag.spv", 1));
+}
+
+TEST_CASE("Pipeline keys keep strings apart")
+{
+	PipelineKey a, b;
+	a.add(std::string("ab")).add(std::string("c"));
+	b.add(std::string("a")).add(std::string("bc"));
+	REQUIRE_FALSE(a == b);
+}
+
+TEST_CASE("Pipeline keys deduplicate in a map")
+{
+	std::unordered_map<PipelineKey, int, PipelineKey::Hash> pipelines;
+	// the demo's sphere, cube, floor and skybox
+	pipelines.emplace(material_key("shader_frag.spv", 2), 0);
+	pipelines.emplace(material_key("shader_frag.spv", 2), 1);
+	pipelines.emplace(material_key("white_out_frag.spv", 0), 2);
+	pipelines.emplace(material_key("skybox_frag.spv", 1), 3);
+
+	REQUIRE(pipelines.size() == 3);
+	REQUIRE(pipelines.at(material_key("shader_frag.spv", 2)) == 0);
+}
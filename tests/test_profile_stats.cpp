@@ -0,0 +1,63 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "profile_stats.hpp"
+
+using namespace chch;
+
+TEST_CASE("Rolling stats only keep the window")
+{
+	RollingStats stats(4);
+	REQUIRE(stats.count() == 0);
+	REQUIRE(stats.average() == 0.0);
+	REQUIRE(stats.percentile(0.5) == 0.0);
+
+	for (double v : { 100.0, 1.0, 2.0, 3.0, 4.0 })
+		stats.add(v);
+	REQUIRE(stats.count() == 4);
+	REQUIRE(stats.last() == 4.0);
+	REQUIRE(stats.average() == Approx(2.5));
+	REQUIRE(stats.min() == 1.0);
+	REQUIRE(stats.max() == 4.0);
+}
+
+TEST_CASE("Rolling stats percentiles use the nearest rank")
+{
+	RollingStats stats(100);
+	for (int i = 100; i >= 1; --i)
+		stats.add(i);
+	REQUIRE(stats.percentile(0.0) == 1.0);
+	REQUIRE(stats.percentile(0.5) == 50.0);
+	REQUIRE(stats.percentile(0.95) == 95.0);
+	REQUIRE(stats.percentile(0.99) == 99.0);
+	REQUIRE(stats.percentile(1.0) == 100.0);
+}
+
+TEST_CASE("Profile stats keep regions in order and export JSON")
+{
+	ProfileStats stats(8);
+	stats.add("main pass", 2.0);
+	stats.add("upload", 0.5);
+	stats.add("main pass", 4.0);
+
+	REQUIRE(stats.size() == 2);
+	REQUIRE(stats.name(0) == "main pass");
+	REQUIRE(stats.find("main pass")->average() == Approx(3.0));
+	REQUIRE(stats.find("upload")->count() == 1);
+	REQUIRE(stats.find("missing") == nullptr);
+
+	auto json = stats.to_json();
+	REQUIRE(json.rfind("{\"regions\":[{\"name\":\"main pass\",\"count\":2,", 0) == 0);
+	REQUIRE(json.find("\"p95_ms\":4") != std::string::npos);
+	REQUIRE(json.find("{\"name\":\"upload\",\"count\":1,\"last_ms\":0.5") != std::string::npos);
+
+	stats.clear();
+	REQUIRE(stats.to_json() == "{\"regions\":[]}");
+}
+
+TEST_CASE("JSON strings are escaped")
+{
+	REQUIRE(json_string("plain") == "\"plain\"");
+	REQUIRE(json_string("a \"b\"\\c\n") == "\"a \\\"b\\\"\\\\c\\n\"");
+	REQUIRE(json_string(std::string(1, '\x01')) == "\"\\u0001\"");
+}
@@ -0,0 +1,299 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "render_graph.hpp"
+
+using namespace chch;
+
+using Graph = RenderGraph;
+
+static Graph::ImageInfo sized(uint32_t width, uint32_t height)
+{
+	Graph::ImageInfo info;
+	info.width = width;
+	info.height = height;
+	return info;
+}
+
+static const Graph::Attachment& attachment(const Graph& graph, uint32_t group, Graph::Handle resource)
+{
+	for (const auto& attachment : graph.groups()[group].attachments)
+		if (attachment.resource == resource)
+			return attachment;
+	FAIL("no attachment for " << graph.resource_name(resource));
+	throw;
+}
+
+static bool has_barrier(const Graph& graph, uint32_t group, Graph::Handle resource)
+{
+	for (const auto& barrier : graph.groups()[group].barriers)
+		if (barrier.resource == resource)
+			return true;
+	return false;
+}
+
+TEST_CASE("Render graphs cull passes nobody reads")
+{
+	Graph graph;
+	auto swap = graph.import_image("swap", sized(64, 64), Graph::UNDEFINED, Graph::PRESENT);
+	auto scene = graph.create_image("scene", sized(64, 64));
+	auto unused = graph.create_image("unused", sized(64, 64));
+	auto stats = graph.import_buffer("stats");
+
+	auto draw = graph.add_pass("draw", Graph::RASTER);
+	graph.color(draw, scene, Graph::NONE, true);
+	auto debug = graph.add_pass("debug", Graph::RASTER);
+	graph.color(debug, unused, Graph::NONE, true);
+	auto blit = graph.add_pass("blit", Graph::TRANSFER);
+	graph.read(blit, scene, Graph::TRANSFER_READ);
+	graph.write(blit, swap, Graph::TRANSFER_WRITE);
+	auto count = graph.add_pass("count", Graph::COMPUTE);
+	graph.read(count, stats, Graph::COMPUTE_READ);
+
+	SECTION("unread results go")
+	{
+		graph.compile();
+		REQUIRE_FALSE(graph.culled(draw));
+		REQUIRE(graph.culled(debug));
+		REQUIRE_FALSE(graph.culled(blit));
+		REQUIRE(graph.culled(count));
+		REQUIRE(graph.groups().size() == 2);
+		// nothing's left using it
+		REQUIRE(graph.transients().size() == 1);
+	}
+	SECTION("kept passes stay")
+	{
+		graph.keep(count);
+		graph.compile();
+		REQUIRE_FALSE(graph.culled(count));
+		REQUIRE(graph.groups().size() == 3);
+	}
+}
+
+TEST_CASE("Render graphs only synchronize what changes")
+{
+	Graph graph;
+	auto depth = graph.create_image("depth", sized(64, 64));
+	auto swap = graph.import_image("swap", sized(64, 64), Graph::PRESENT, Graph::PRESENT);
+	auto commands = graph.import_buffer("commands");
+
+	auto main = graph.add_pass("main", Graph::RASTER);
+	graph.color(main, swap, Graph::NONE, true);
+	graph.depth(main, depth, false, true);
+	auto cull = graph.add_pass("cull", Graph::COMPUTE);
+	graph.read(cull, depth, Graph::COMPUTE_READ);
+	graph.write(cull, commands, Graph::COMPUTE_WRITE);
+	auto first = graph.add_pass("first", Graph::RASTER);
+	graph.color(first, swap);
+	graph.read(first, commands, Graph::INDIRECT_READ);
+	auto second = graph.add_pass("second", Graph::RASTER);
+	graph.color(second, swap);
+	graph.read(second, commands, Graph::INDIRECT_READ);
+	graph.compile();
+
+	REQUIRE(graph.groups().size() == 3);
+	REQUIRE(graph.group_of(first) == graph.group_of(second));
+
+	SECTION("attachments read afterwards leave their render pass ready")
+	{
+		const auto& main_depth = attachment(graph, 0, depth);
+		REQUIRE(main_depth.load == Graph::CLEAR);
+		REQUIRE(main_depth.store);
+		REQUIRE(main_depth.initial == Graph::UNDEFINED);
+		REQUIRE(main_depth.final == Graph::COMPUTE_READ);
+		REQUIRE_FALSE(has_barrier(graph, 1, depth));
+
+		bool found = false;
+		for (const auto& dependency : graph.groups()[0].dependencies)
+			if (dependency.dst_subpass == Graph::EXTERNAL) {
+				REQUIRE((dependency.src_uses & Graph::bit(Graph::DEPTH_ATTACHMENT)));
+				REQUIRE((dependency.dst_uses & Graph::bit(Graph::COMPUTE_READ)));
+				found = true;
+			}
+		REQUIRE(found);
+	}
+	SECTION("reading the same way twice needs one barrier")
+	{
+		const auto& barriers = graph.groups()[2].barriers;
+		REQUIRE(barriers.size() == 1);
+		REQUIRE(barriers[0].resource == commands);
+		REQUIRE(barriers[0].after == Graph::INDIRECT_READ);
+		REQUIRE(barriers[0].wait == Graph::bit(Graph::COMPUTE_WRITE));
+	}
+	SECTION("imported images carry on from where they were")
+	{
+		const auto& main_swap = attachment(graph, 0, swap);
+		REQUIRE(main_swap.load == Graph::CLEAR);
+		REQUIRE(main_swap.store);
+		const auto& later_swap = attachment(graph, 2, swap);
+		REQUIRE(later_swap.load == Graph::LOAD);
+		REQUIRE(later_swap.initial == Graph::COLOR_ATTACHMENT);
+		REQUIRE(later_swap.final == Graph::PRESENT);
+		REQUIRE(graph.final_barriers().empty());
+	}
+}
+
+TEST_CASE("Render graphs merge raster passes into subpasses")
+{
+	Graph graph;
+	auto swap = graph.import_image("swap", sized(64, 64), Graph::UNDEFINED, Graph::PRESENT);
+	auto gbuffer = graph.create_image("gbuffer", sized(64, 64));
+	auto small = graph.create_image("small", sized(32, 32));
+
+	auto geometry = graph.add_pass("geometry", Graph::RASTER);
+	graph.color(geometry, gbuffer, Graph::NONE, true);
+
+	SECTION("same size passes share a render pass")
+	{
+		auto lighting = graph.add_pass("lighting", Graph::RASTER);
+		graph.color(lighting, gbuffer);
+		graph.color(lighting, swap, Graph::NONE, true);
+		graph.compile();
+
+		REQUIRE(graph.groups().size() == 1);
+		const auto& group = graph.groups()[0];
+		REQUIRE(group.subpasses.size() == 2);
+		REQUIRE(graph.subpass_of(lighting) == 1);
+		REQUIRE(group.subpasses[1].colors.size() == 2);
+
+		bool between = false;
+		for (const auto& dependency : group.dependencies)
+			between |= dependency.src_subpass == 0 && dependency.dst_subpass == 1;
+		REQUIRE(between);
+
+		// never leaves the render pass
+		REQUIRE(graph.transients().size() == 1);
+		REQUIRE(graph.transients()[0].memoryless);
+		REQUIRE_FALSE(attachment(graph, 0, gbuffer).store);
+	}
+	SECTION("unless merging is off")
+	{
+		auto lighting = graph.add_pass("lighting", Graph::RASTER);
+		graph.color(lighting, gbuffer);
+		graph.color(lighting, swap, Graph::NONE, true);
+		graph.merge_subpasses = false;
+		graph.compile();
+
+		REQUIRE(graph.groups().size() == 2);
+		REQUIRE(graph.subpass_of(lighting) == 0);
+		// carried over in its layout, and no longer memoryless
+		REQUIRE(attachment(graph, 0, gbuffer).store);
+		REQUIRE(attachment(graph, 1, gbuffer).load == Graph::LOAD);
+		REQUIRE(attachment(graph, 1, gbuffer).initial == Graph::COLOR_ATTACHMENT);
+		REQUIRE_FALSE(graph.transients()[0].memoryless);
+	}
+	SECTION("sampling what was an attachment splits them")
+	{
+		auto lighting = graph.add_pass("lighting", Graph::RASTER);
+		graph.read(lighting, gbuffer, Graph::SHADER_READ);
+		graph.color(lighting, swap, Graph::NONE, true);
+		graph.compile();
+
+		REQUIRE(graph.groups().size() == 2);
+		REQUIRE(attachment(graph, 0, gbuffer).store);
+		REQUIRE(attachment(graph, 0, gbuffer).final == Graph::SHADER_READ);
+		REQUIRE_FALSE(graph.transients()[0].memoryless);
+	}
+	SECTION("different sizes split them")
+	{
+		auto downsample = graph.add_pass("downsample", Graph::RASTER);
+		graph.color(downsample, small, Graph::NONE, true);
+		graph.keep(geometry);
+		graph.keep(downsample);
+		graph.compile();
+		REQUIRE(graph.groups().size() == 2);
+		REQUIRE(graph.groups()[1].width == 32);
+	}
+	SECTION("a pass can't mix sizes")
+	{
+		auto downsample = graph.add_pass("downsample", Graph::RASTER);
+		graph.color(downsample, small, Graph::NONE, true);
+		graph.color(downsample, swap);
+		REQUIRE_THROWS(graph.compile());
+	}
+}
+
+TEST_CASE("Render graph load and store ops")
+{
+	Graph graph;
+	auto info = sized(64, 64);
+	info.samples = 4;
+	auto swap = graph.import_image("swap", sized(64, 64), Graph::PRESENT, Graph::PRESENT);
+	auto msaa = graph.create_image("msaa", info);
+	auto depth = graph.create_image("depth", info);
+
+	auto main = graph.add_pass("main", Graph::RASTER);
+	graph.color(main, msaa, swap, true);
+	graph.depth(main, depth, false, true);
+	graph.compile();
+
+	const auto& group = graph.groups()[0];
+	REQUIRE(group.attachments.size() == 3);
+	REQUIRE(group.subpasses[0].resolves[0] != Graph::EXTERNAL);
+	REQUIRE(group.subpasses[0].depth_use == Graph::DEPTH_ATTACHMENT);
+
+	REQUIRE(attachment(graph, 0, msaa).load == Graph::CLEAR);
+	REQUIRE_FALSE(attachment(graph, 0, msaa).store);
+	REQUIRE_FALSE(attachment(graph, 0, depth).store);
+	// resolving overwrites all of it
+	const auto& resolved = attachment(graph, 0, swap);
+	REQUIRE(resolved.load == Graph::DONT_CARE);
+	REQUIRE(resolved.initial == Graph::UNDEFINED);
+	REQUIRE(resolved.store);
+	REQUIRE(resolved.final == Graph::PRESENT);
+
+	REQUIRE(graph.transients().size() == 2);
+	for (const auto& transient : graph.transients())
+		REQUIRE(transient.memoryless);
+}
+
+TEST_CASE("Render graphs alias transients that aren't alive together")
+{
+	Graph graph;
+	auto a = graph.create_image("a", sized(64, 64));
+	auto b = graph.create_image("b", sized(64, 64));
+	auto c = graph.create_image("c", sized(64, 64));
+	auto out = graph.import_buffer("out");
+
+	auto make_a = graph.add_pass("make a", Graph::COMPUTE);
+	graph.write(make_a, a, Graph::COMPUTE_WRITE);
+	auto copy = graph.add_pass("copy", Graph::TRANSFER);
+	graph.read(copy, a, Graph::TRANSFER_READ);
+	graph.write(copy, b, Graph::TRANSFER_WRITE);
+	auto make_c = graph.add_pass("make c", Graph::COMPUTE);
+	graph.read(make_c, b, Graph::COMPUTE_READ);
+	graph.write(make_c, c, Graph::COMPUTE_WRITE);
+	auto use_c = graph.add_pass("use c", Graph::COMPUTE);
+	graph.read(use_c, c, Graph::COMPUTE_READ);
+	graph.write(use_c, out, Graph::COMPUTE_WRITE);
+	graph.compile();
+
+	const auto& transients = graph.transients();
+	REQUIRE(transients.size() == 3);
+	REQUIRE_FALSE(transients[0].memoryless);
+	REQUIRE(transients[1].first_group == 1);
+	REQUIRE(transients[1].last_group == 2);
+
+	uint64_t size = graph.alias({ { 1000, 256 }, { 1000, 256 }, { 1000, 256 } });
+	REQUIRE(transients[0].offset == 0);
+	REQUIRE(transients[1].offset == 1024);
+	REQUIRE(transients[2].offset == 0);
+	REQUIRE(size == 2024);
+
+	// c takes over a's memory, after the copy out of it
+	for (const auto& barrier : graph.groups()[2].barriers) {
+		if (barrier.resource != c)
+			continue;
+		REQUIRE(barrier.before == Graph::UNDEFINED);
+		REQUIRE((barrier.wait & Graph::bit(Graph::TRANSFER_READ)));
+	}
+	REQUIRE(has_barrier(graph, 2, c));
+	// and a waits on c from the frame before
+	for (const auto& barrier : graph.groups()[0].barriers)
+		if (barrier.resource == a)
+			REQUIRE((barrier.wait & Graph::bit(Graph::COMPUTE_READ)));
+	// b shares with nothing
+	for (const auto& barrier : graph.groups()[1].barriers)
+		if (barrier.resource == b)
+			REQUIRE(barrier.wait == Graph::bit(Graph::COMPUTE_READ));
+}
@@ -0,0 +1,105 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "render_stats.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace chch;
+
+namespace {
+
+RenderStats sample_stats(uint64_t frame)
+{
+	RenderStats stats;
+	stats.frame = frame;
+	stats.draws = 12;
+	stats.instances = 12;
+	stats.triangles = 3400;
+	stats.pipeline_binds = 12;
+	stats.descriptor_binds = 34;
+	stats.vertex_buffer_binds = 12;
+	stats.frustum_culled = 5;
+	stats.occlusion_culled = 2;
+	stats.deferred = 1;
+	return stats;
+}
+
+}
+
+TEST_CASE("Render stats leave the GPU columns empty without them")
+{
+	auto stats = sample_stats(7);
+	REQUIRE(render_stats_csv_row(stats) == "7,12,12,3400,12,34,12,5,2,1,,,,,,");
+	REQUIRE(stats.overdraw(4, 4) == 0.0);
+
+	stats.gpu_valid = true;
+	stats.input_vertices = 10200;
+	stats.input_primitives = 3400;
+	stats.vertex_invocations = 9000;
+	stats.clipping_invocations = 3400;
+	stats.clipping_primitives = 1800;
+	stats.fragment_invocations = 40;
+	REQUIRE(render_stats_csv_row(stats) == "7,12,12,3400,12,34,12,5,2,1,10200,3400,9000,3400,1800,40");
+	REQUIRE(stats.overdraw(4, 4) == Approx(2.5));
+	REQUIRE(stats.overdraw(0, 4) == 0.0);
+}
+
+TEST_CASE("Render stats rows line up with the header")
+{
+	auto columns = [](const std::string& line) {
+		size_t count = 1;
+		for (char c : line)
+			count += c == ',';
+		return count;
+	};
+	auto stats = sample_stats(0);
+	REQUIRE(columns(render_stats_csv_header()) == columns(render_stats_csv_row(stats)));
+	stats.gpu_valid = true;
+	REQUIRE(columns(render_stats_csv_header()) == columns(render_stats_csv_row(stats)));
+	REQUIRE(render_stats_csv_header().rfind("frame,draws,", 0) == 0);
+}
+
+TEST_CASE("Render stats log keeps the newest frames")
+{
+	RenderStatsLog log;
+	log.add(sample_stats(0));
+	REQUIRE(log.size() == 0);
+
+	log.capacity = 3;
+	for (uint64_t frame = 0; frame < 5; ++frame)
+		log.add(sample_stats(frame));
+	REQUIRE(log.size() == 3);
+	REQUIRE(log[0].frame == 2);
+	REQUIRE(log[2].frame == 4);
+
+	std::istringstream csv(log.to_csv());
+	std::string line;
+	std::getline(csv, line);
+	REQUIRE(line == render_stats_csv_header());
+	std::getline(csv, line);
+	REQUIRE(line == render_stats_csv_row(log[0]));
+
+	log.clear();
+	REQUIRE(log.size() == 0);
+}
+
+TEST_CASE("Render stats log writes CSV files")
+{
+	RenderStatsLog log;
+	log.capacity = 4;
+	log.add(sample_stats(1));
+	log.add(sample_stats(2));
+
+	auto path = std::filesystem::temp_directory_path() / "chch_render_stats_test.csv";
+	REQUIRE(log.write_csv(path));
+	std::ifstream file(path);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	REQUIRE(contents.str() == log.to_csv());
+	std::filesystem::remove(path);
+
+	REQUIRE_FALSE(log.write_csv(std::filesystem::temp_directory_path() / "missing_dir" / "stats.csv"));
+}
@@ -0,0 +1,151 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "replay_log.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace chch;
+
+static Transform moved(float x)
+{
+	Transform transform;
+	transform.position = glm::vec3(x, 2.0f, -3.0f);
+	transform.rotation = glm::angleAxis(x, glm::vec3(0.0f, 1.0f, 0.0f));
+	return transform;
+}
+
+static bool same(const Transform& a, const Transform& b)
+{
+	return memcmp(&a, &b, sizeof(Transform)) == 0;
+}
+
+TEST_CASE("Replay logs round trip")
+{
+	auto path = std::filesystem::temp_directory_path() / "chch_test_replay.bin";
+
+	ReplayHeader header { 640, 480, 1.0f / 60.0f };
+	ReplayWriter writer;
+	writer.open(path, header);
+
+	ReplayFrame frame;
+	frame.time = 0.0f;
+	frame.delta = 1.0f / 60.0f;
+	frame.camera = moved(1.0f);
+	frame.loads = { { ReplayLoad::MESH, "cube.obj" }, { ReplayLoad::MATERIAL, "cube" } };
+	frame.transforms = { { 0, moved(2.0f) }, { 3, moved(5.0f) } };
+	frame.draws = { { ReplayDraw::NO_OBJECT, 0, 1 }, { 0, 0, 1 }, { 3, 0, 1 } };
+	writer.write(frame);
+
+	frame.clear();
+	frame.time = 1.0f / 60.0f;
+	frame.camera = moved(1.5f);
+	frame.pick = true;
+	frame.transforms = { { 3, moved(6.0f) } };
+	frame.draws = { { 3, 0, 1 } };
+	writer.write(frame);
+	writer.close();
+	REQUIRE(writer.frames_written() == 2);
+
+	ReplayReader reader;
+	reader.open(path);
+	REQUIRE(reader.header().width == 640);
+	REQUIRE(reader.header().height == 480);
+	REQUIRE(reader.header().timestep == header.timestep);
+
+	ReplayFrame read;
+	REQUIRE(reader.next(read));
+	REQUIRE(read.time == 0.0f);
+	REQUIRE(read.delta == 1.0f / 60.0f);
+	REQUIRE(same(read.camera, moved(1.0f)));
+	REQUIRE_FALSE(read.pick);
+	REQUIRE(read.loads.size() == 2);
+	REQUIRE(read.loads[1] == ReplayLoad { ReplayLoad::MATERIAL, "cube" });
+	REQUIRE(read.transforms.size() == 2);
+	REQUIRE(read.transforms[1].object == 3);
+	REQUIRE(same(read.transforms[1].local, moved(5.0f)));
+	REQUIRE(read.draws.size() == 3);
+	REQUIRE(read.draws[0].object == ReplayDraw::NO_OBJECT);
+
+	REQUIRE(reader.next(read));
+	REQUIRE(read.pick);
+	REQUIRE(read.loads.empty());
+	REQUIRE(read.transforms.size() == 1);
+	REQUIRE(same(read.transforms[0].local, moved(6.0f)));
+	REQUIRE(read.draws == std::vector<ReplayDraw> { { 3, 0, 1 } });
+
+	REQUIRE_FALSE(reader.next(read));
+	REQUIRE(reader.frames_read() == 2);
+	reader.close();
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("Replay logs leave out what didn't change")
+{
+	auto path = std::filesystem::temp_directory_path() / "chch_test_replay_unchanged.bin";
+
+	ReplayFrame frame;
+	frame.transforms = { { 0, moved(1.0f) }, { 1, moved(2.0f) } };
+	frame.draws = { { 0, 0, 0 }, { 1, 0, 0 } };
+	auto log_size = [&](int frames) {
+		ReplayWriter writer;
+		writer.open(path, {});
+		for (int i = 0; i < frames; ++i)
+			writer.write(frame);
+		writer.close();
+		return std::filesystem::file_size(path);
+	};
+	auto header = log_size(0);
+	auto first = log_size(1) - header;
+	// same transforms, same draws
+	auto second = log_size(2) - header - first;
+	REQUIRE(second < first / 2);
+
+	ReplayReader reader;
+	reader.open(path);
+	ReplayFrame read;
+	REQUIRE(reader.next(read));
+	REQUIRE(read.transforms.size() == 2);
+	// the draw list carries over from the frame before
+	REQUIRE(reader.next(read));
+	REQUIRE(read.transforms.empty());
+	REQUIRE(read.draws == frame.draws);
+	reader.close();
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("Damaged replay logs throw")
+{
+	auto path = std::filesystem::temp_directory_path() / "chch_test_replay_damaged.bin";
+
+	ReplayWriter writer;
+	writer.open(path, {});
+	ReplayFrame frame;
+	frame.loads = { { ReplayLoad::TEXTURE, "skybox.png" } };
+	frame.draws = { { 0, 0, 0 } };
+	writer.write(frame);
+	writer.close();
+
+	ReplayReader reader;
+	SECTION("cut short")
+	{
+		std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+		reader.open(path);
+		ReplayFrame read;
+		REQUIRE_THROWS(reader.next(read));
+	}
+	SECTION("not a log")
+	{
+		std::ofstream(path, std::ios::binary | std::ios::trunc) << "not a replay log at all";
+		REQUIRE_THROWS(reader.open(path));
+	}
+	SECTION("missing")
+	{
+		std::filesystem::remove(path);
+		REQUIRE_THROWS(reader.open(path));
+	}
+	reader.close();
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,82 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "scene_records.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+using namespace chch;
+
+static GpuObject object(float x, uint32_t material)
+{
+	Bounds bounds { { glm::vec3(-1.0f), glm::vec3(1.0f) }, { glm::vec3(0.0f), 1.0f } };
+	return GpuObject::make(glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, 0.0f)), bounds, material, 36);
+}
+
+struct Collected {
+	std::vector<uint32_t> indices;
+	std::vector<GpuObject> records;
+
+	size_t collect(SceneRecords& scene)
+	{
+		indices.resize(scene.dirty_count());
+		records.resize(scene.dirty_count());
+		return scene.collect(indices.data(), records.data());
+	}
+};
+
+TEST_CASE("Scene records fill in world space bounds")
+{
+	auto o = object(5.0f, 3);
+	REQUIRE(o.sphere == glm::vec4(5.0f, 0.0f, 0.0f, 1.0f));
+	REQUIRE(glm::vec3(o.box_min) == glm::vec3(4.0f, -1.0f, -1.0f));
+	REQUIRE(glm::vec3(o.box_max) == glm::vec3(6.0f, 1.0f, 1.0f));
+	REQUIRE(o.material == 3);
+	REQUIRE(o.index_count == 36);
+	REQUIRE(o.first_index == 0);
+}
+
+TEST_CASE("Scene records only hand out what changed")
+{
+	SceneRecords scene;
+	scene.init(100);
+	Collected out;
+
+	for (uint32_t i = 0; i < 10; ++i)
+		REQUIRE(scene.add(object(float(i), i)) == i);
+	REQUIRE(scene.size() == 10);
+	REQUIRE(out.collect(scene) == 10);
+	REQUIRE(out.collect(scene) == 0);
+
+	// set twice, sent once, in index order
+	scene.set(7, object(70.0f, 7));
+	scene.set(2, object(20.0f, 2));
+	scene.set(7, object(71.0f, 7));
+	REQUIRE(out.collect(scene) == 2);
+	REQUIRE(out.indices == std::vector<uint32_t> { 2, 7 });
+	REQUIRE(out.records[1].model[3][0] == 71.0f);
+	REQUIRE(scene.get(7).model[3][0] == 71.0f);
+
+	// removed slots are sent cleared and reused
+	scene.remove(4);
+	REQUIRE(out.collect(scene) == 1);
+	REQUIRE(out.indices[0] == 4);
+	REQUIRE(out.records[0].index_count == 0);
+	REQUIRE(scene.size() == 9);
+	REQUIRE(scene.add(object(40.0f, 4)) == 4);
+	REQUIRE(scene.extent() == 10);
+
+	scene.clear();
+	REQUIRE(scene.size() == 0);
+	REQUIRE(out.collect(scene) == 10);
+}
+
+TEST_CASE("Scene records throw when full")
+{
+	SceneRecords scene;
+	scene.init(3);
+	for (int i = 0; i < 3; ++i)
+		scene.add(object(0.0f, 0));
+	REQUIRE_THROWS(scene.add(object(0.0f, 0)));
+	scene.remove(1);
+	REQUIRE(scene.add(object(0.0f, 0)) == 1);
+}
@@ -0,0 +1,32 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "shader_features.hpp"
+
+using namespace chch;
+
+TEST_CASE("Shader features map to one constant each")
+{
+	auto constants = ShaderFeatures::constants(ShaderFeatures::TEXTURED | ShaderFeatures::SPECULAR);
+	REQUIRE(constants[0] == 1);
+	REQUIRE(constants[1] == 0);
+	REQUIRE(constants[2] == 1);
+	REQUIRE(constants[3] == 0);
+	REQUIRE(constants[4] == 0);
+
+	for (auto c : ShaderFeatures::constants(0))
+		REQUIRE(c == 0);
+}
+
+TEST_CASE("Shader features drop bits that do nothing alone")
+{
+	using F = ShaderFeatures;
+	REQUIRE(F::normalize(F::SPECULAR) == 0);
+	REQUIRE(F::normalize(F::TEXTURED | F::SHADOWS) == F::TEXTURED);
+	REQUIRE(F::normalize(F::LIT | F::SPECULAR | F::SHADOWS) == (F::LIT | F::SPECULAR | F::SHADOWS));
+	REQUIRE(F::normalize(F::ALPHA_TEST | 0x80000000u) == F::ALPHA_TEST);
+
+	// every combination lands on a fixed point
+	for (uint32_t bits = 0; bits < (1u << F::COUNT); ++bits)
+		REQUIRE(F::normalize(F::normalize(bits)) == F::normalize(bits));
+}
@@ -0,0 +1,111 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "stress_scene.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+using namespace chch;
+
+TEST_CASE("Stress scenes come out the same for the same seed")
+{
+	StressSceneInfo info;
+	info.objects = 500;
+	info.meshes = 3;
+	info.materials = 4;
+	info.dynamic_fraction = 0.5f;
+
+	auto a = generate_stress_scene(info);
+	auto b = generate_stress_scene(info);
+	REQUIRE(a.meshes.size() == 3);
+	REQUIRE(a.objects.size() == 500);
+
+	size_t dynamic = 0;
+	std::vector<bool> meshes_used(3), materials_used(4);
+	for (size_t i = 0; i < a.objects.size(); ++i) {
+		REQUIRE(a.objects[i].transform.position == b.objects[i].transform.position);
+		REQUIRE(a.objects[i].dynamic == b.objects[i].dynamic);
+		REQUIRE(a.objects[i].mesh < 3);
+		REQUIRE(a.objects[i].material < 4);
+		REQUIRE(glm::all(glm::lessThanEqual(glm::abs(a.objects[i].transform.position), glm::vec3(info.extent * 0.5f))));
+		meshes_used[a.objects[i].mesh] = true;
+		materials_used[a.objects[i].material] = true;
+		dynamic += a.objects[i].dynamic;
+	}
+	REQUIRE(dynamic > 200);
+	REQUIRE(dynamic < 300);
+	for (bool used : meshes_used)
+		REQUIRE(used);
+	for (bool used : materials_used)
+		REQUIRE(used);
+
+	info.seed = 2;
+	auto c = generate_stress_scene(info);
+	REQUIRE(c.objects[0].transform.position != a.objects[0].transform.position);
+
+	// finer meshes further down the list
+	REQUIRE(a.meshes[1].indices.size() > a.meshes[0].indices.size());
+	REQUIRE(a.meshes[2].indices.size() > a.meshes[1].indices.size());
+}
+
+TEST_CASE("Stress scene spheres are closed and face outwards")
+{
+	auto mesh = make_sphere_mesh(8, 16);
+	REQUIRE(mesh.positions.size() == 9 * 17);
+	REQUIRE(mesh.normals.size() == mesh.positions.size());
+	REQUIRE(mesh.uvs.size() == mesh.positions.size());
+	REQUIRE(mesh.indices.size() == 8 * 16 * 6);
+
+	size_t facing_out = 0;
+	for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+		for (size_t j = 0; j < 3; ++j)
+			REQUIRE(mesh.indices[i + j] < mesh.positions.size());
+		glm::vec3 a = mesh.positions[mesh.indices[i]];
+		glm::vec3 b = mesh.positions[mesh.indices[i + 1]];
+		glm::vec3 c = mesh.positions[mesh.indices[i + 2]];
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		// the triangles touching the poles have a side of zero length
+		if (glm::length(normal) < 1e-6f)
+			continue;
+		REQUIRE(glm::dot(normal, a + b + c) > 0.0f);
+		++facing_out;
+	}
+	REQUIRE(facing_out >= 8 * 16 * 2 - 2 * 16);
+
+	for (const auto& p : mesh.positions)
+		REQUIRE(glm::length(p) == Approx(1.0f));
+
+	auto clamped = make_sphere_mesh(0, 0);
+	REQUIRE(clamped.indices.size() == 2 * 3 * 6);
+}
+
+TEST_CASE("Stress scene objects only move when dynamic")
+{
+	StressObject object;
+	object.transform.position = glm::vec3(1.0f, 2.0f, 3.0f);
+	object.spin_speed = 1.0f;
+
+	REQUIRE(animate(object, 5.0f).matrix() == object.transform.matrix());
+
+	object.dynamic = true;
+	REQUIRE(animate(object, 0.0f).matrix() == object.transform.matrix());
+	auto moved = animate(object, 1.0f);
+	REQUIRE(moved.position == object.transform.position);
+	REQUIRE(moved.matrix() != object.transform.matrix());
+}
+
+TEST_CASE("The camera path keeps the origin in view")
+{
+	const uint32_t frames = 60;
+	const float radius = 80.0f;
+	for (uint32_t frame = 0; frame < frames; frame += 7) {
+		Transform t = camera_path(frame, frames, radius);
+		// what Camera::matrix multiplies the projection by
+		glm::mat4 view = glm::inverse(t.matrix());
+		glm::vec4 origin = view * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		REQUIRE(origin.x == Approx(0.0f).margin(1e-3));
+		REQUIRE(origin.y == Approx(0.0f).margin(1e-3));
+		REQUIRE(-origin.z == Approx(glm::length(t.position)).epsilon(1e-4));
+		REQUIRE(glm::length(t.position) > radius * 0.99f);
+	}
+	REQUIRE(camera_path(0, frames, radius).position != camera_path(frames / 2, frames, radius).position);
+}
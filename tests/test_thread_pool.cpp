@@ -0,0 +1,40 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace chch;
+
+TEST_CASE("parallel_for only runs its own chunks while it waits")
+{
+	ThreadPool pool;
+	pool.init(1);
+
+	// keep the one worker busy so the caller has to do every chunk itself
+	std::promise<void> started, release;
+	auto blocker = pool.submit([&started, gate = release.get_future().share()]() {
+		started.set_value();
+		gate.wait();
+	});
+	started.get_future().wait();
+	auto other = pool.submit([]() { return std::this_thread::get_id(); });
+
+	std::vector<uint32_t> hits(1000, 0);
+	pool.parallel_for(hits.size(), 10, [&hits](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			hits[i] += 1;
+	});
+	REQUIRE(std::all_of(hits.begin(), hits.end(), [](uint32_t hit) { return hit == 1; }));
+	CHECK(other.wait_for(std::chrono::seconds(0)) == std::future_status::timeout);
+
+	release.set_value();
+	CHECK(other.get() != std::this_thread::get_id());
+	blocker.wait();
+	pool.deinit();
+}
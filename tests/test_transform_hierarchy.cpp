@@ -0,0 +1,154 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch.hpp"
+
+#include "transform_hierarchy.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <random>
+
+using namespace chch;
+
+static Transform random_transform(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+	Transform t;
+	t.position = { position(rng), position(rng), position(rng) };
+	t.rotation = glm::angleAxis(angle(rng), glm::normalize(glm::vec3(position(rng), position(rng), position(rng) + 0.1f)));
+	t.scale = { scale(rng), scale(rng), scale(rng) };
+	return t;
+}
+
+static bool close(const glm::mat4& a, const glm::mat4& b)
+{
+	for (int c = 0; c < 4; ++c) {
+		for (int r = 0; r < 4; ++r) {
+			if (std::abs(a[c][r] - b[c][r]) > 1e-3f * std::max(1.0f, std::abs(b[c][r])))
+				return false;
+		}
+	}
+	return true;
+}
+
+// The slow way, straight from the locals
+struct Reference {
+	std::vector<Transform> locals;
+	std::vector<TransformHierarchy::Handle> parents;
+
+	glm::mat4 world(TransformHierarchy::Handle node) const
+	{
+		glm::mat4 m = locals[node].matrix();
+		for (auto p = parents[node]; p != TransformHierarchy::NONE; p = parents[p])
+			m = locals[p].matrix() * m;
+		return m;
+	}
+};
+
+TEST_CASE("Transform hierarchy roots match Transform::matrix")
+{
+	std::mt19937 rng(1);
+	TransformHierarchy hierarchy;
+	std::vector<Transform> locals;
+	for (int i = 0; i < 37; ++i) {
+		locals.push_back(random_transform(rng));
+		hierarchy.add(locals.back());
+	}
+	locals.push_back(Transform {});
+	hierarchy.add(locals.back());
+
+	hierarchy.update();
+	REQUIRE(hierarchy.updated().size() == locals.size());
+	for (uint32_t i = 0; i < locals.size(); ++i)
+		REQUIRE(close(hierarchy.world(i), locals[i].matrix()));
+}
+
+TEST_CASE("Transform hierarchy composes and propagates changes down")
+{
+	std::mt19937 rng(2);
+	TransformHierarchy hierarchy;
+	Reference reference;
+
+	// a forest, every node's parent was added before it
+	for (uint32_t i = 0; i < 500; ++i) {
+		auto parent = i < 5 ? TransformHierarchy::NONE : static_cast<uint32_t>(rng() % i);
+		reference.locals.push_back(random_transform(rng));
+		reference.parents.push_back(parent);
+		REQUIRE(hierarchy.add(reference.locals.back(), parent) == i);
+	}
+	hierarchy.update();
+	for (uint32_t i = 0; i < 500; ++i)
+		REQUIRE(close(hierarchy.world(i), reference.world(i)));
+
+	// nothing changed, nothing recomputed
+	hierarchy.update();
+	REQUIRE(hierarchy.updated().empty());
+
+	// one node moves, it and everything under it updates
+	uint32_t moved = 7;
+	reference.locals[moved] = random_transform(rng);
+	hierarchy.set_local(moved, reference.locals[moved]);
+	hierarchy.update();
+
+	size_t expected = 0;
+	for (uint32_t i = 0; i < 500; ++i) {
+		bool below = false;
+		for (auto p = i; p != TransformHierarchy::NONE; p = reference.parents[p])
+			below |= p == moved;
+		expected += below;
+		REQUIRE(close(hierarchy.world(i), reference.world(i)));
+	}
+	REQUIRE(hierarchy.updated().size() == expected);
+	REQUIRE(expected > 1);
+}
+
+TEST_CASE("Transform hierarchy reparenting and removal")
+{
+	std::mt19937 rng(3);
+	TransformHierarchy hierarchy;
+	Reference reference;
+	auto add = [&](TransformHierarchy::Handle parent) {
+		reference.locals.push_back(random_transform(rng));
+		reference.parents.push_back(parent);
+		return hierarchy.add(reference.locals.back(), parent);
+	};
+
+	auto a = add(TransformHierarchy::NONE);
+	auto b = add(a);
+	auto c = add(b);
+	auto d = add(TransformHierarchy::NONE);
+	hierarchy.update();
+
+	REQUIRE_THROWS(hierarchy.set_parent(a, c));
+	REQUIRE_THROWS(hierarchy.set_parent(a, a));
+
+	// c moves to the other root, a goes under the deepest node there is
+	hierarchy.set_parent(c, d);
+	reference.parents[c] = d;
+	hierarchy.set_parent(a, c);
+	reference.parents[a] = c;
+	REQUIRE(hierarchy.parent(a) == c);
+	hierarchy.update();
+	for (auto node : { a, b, c, d })
+		REQUIRE(close(hierarchy.world(node), reference.world(node)));
+
+	// b's child is a root now, the handle is reused
+	hierarchy.remove(a);
+	reference.parents[b] = TransformHierarchy::NONE;
+	REQUIRE_FALSE(hierarchy.alive(a));
+	REQUIRE(hierarchy.parent(b) == TransformHierarchy::NONE);
+	REQUIRE(hierarchy.size() == 3);
+	auto e = add(b);
+	REQUIRE(e == a);
+	reference.parents[e] = b;
+	reference.locals[e] = reference.locals.back();
+	hierarchy.update();
+	for (auto node : { b, c, d, e })
+		REQUIRE(close(hierarchy.world(node), reference.world(node)));
+	REQUIRE(hierarchy.local(c).position == reference.locals[c].position);
+
+	REQUIRE_THROWS(hierarchy.remove(100));
+	hierarchy.clear();
+	REQUIRE(hierarchy.size() == 0);
+}
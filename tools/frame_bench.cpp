@@ -0,0 +1,315 @@
+#include "bench_metrics.hpp"
+#include "camera.hpp"
+#include "context.hpp"
+#include "cpu_profiler.hpp"
+#include "material.hpp"
+#include "mesh.hpp"
+#include "profile_stats.hpp"
+#include "renderer.hpp"
+#include "stress_scene.hpp"
+#include "transform_hierarchy.hpp"
+#include "util.hpp"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+static std::filesystem::path root_path;
+const std::filesystem::path& chch::Root::path(root_path);
+
+using namespace chch;
+
+namespace {
+
+// Renders a generated scene headless along a scripted camera path and
+// reports frame times and memory. With a baseline it exits with 1 when any
+// metric got worse by more than the threshold, so a software device run can
+// gate changes to the renderer.
+const char* USAGE =
+	"frame_bench [options]\n"
+	"  --objects n         objects in the scene (2000)\n"
+	"  --meshes n          unique meshes (8)\n"
+	"  --materials n       unique materials (8)\n"
+	"  --dynamic f         share of objects moving every frame (0.25)\n"
+	"  --seed n            scene generator seed (1)\n"
+	"  --frames n          frames measured (300)\n"
+	"  --warmup n          frames rendered before measuring (30)\n"
+	"  --width n --height n  render size (1280x720)\n"
+	"  --out file.json     writes the metrics\n"
+	"  --baseline file.json  compares the metrics against a previous run\n"
+	"  --threshold f       allowed growth over the baseline (0.1 for 10%)\n";
+
+struct Options {
+	StressSceneInfo scene;
+	uint32_t frames = 300;
+	uint32_t warmup = 30;
+	VkExtent2D extent = { 1280, 720 };
+	std::filesystem::path out_path;
+	std::filesystem::path baseline_path;
+	double threshold = 0.1;
+};
+
+bool parse_options(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		auto arg = [&](const char* name) { return strcmp(argv[i], name) == 0 && i + 1 < argc; };
+		if (arg("--objects"))
+			options.scene.objects = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg("--meshes"))
+			options.scene.meshes = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg("--materials"))
+			options.scene.materials = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg("--dynamic"))
+			options.scene.dynamic_fraction = std::stof(argv[++i]);
+		else if (arg("--seed"))
+			options.scene.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg("--frames"))
+			options.frames = static_cast<uint32_t>(std::max(1ul, std::stoul(argv[++i])));
+		else if (arg("--warmup"))
+			options.warmup = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg("--width"))
+			options.extent.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg("--height"))
+			options.extent.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (arg("--out"))
+			options.out_path = argv[++i];
+		else if (arg("--baseline"))
+			options.baseline_path = argv[++i];
+		else if (arg("--threshold"))
+			options.threshold = std::stod(argv[++i]);
+		else
+			return false;
+	}
+	return true;
+}
+
+// untextured so nothing has to be loaded, the variants give distinct pipelines
+const uint32_t MATERIAL_FEATURES[] = {
+	ShaderFeatures::LIT,
+	ShaderFeatures::LIT | ShaderFeatures::SPECULAR,
+	0,
+	ShaderFeatures::LIT | ShaderFeatures::ALPHA_TEST,
+	ShaderFeatures::LIT | ShaderFeatures::SPECULAR | ShaderFeatures::ALPHA_TEST,
+	ShaderFeatures::ALPHA_TEST,
+};
+const uint32_t FEATURE_VARIANTS = sizeof(MATERIAL_FEATURES) / sizeof(MATERIAL_FEATURES[0]);
+
+std::vector<Vertex> make_vertices(const StressMesh& mesh)
+{
+	std::vector<Vertex> vertices(mesh.positions.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+		vertices[i] = { mesh.positions[i], mesh.normals[i], mesh.uvs[i] };
+	return vertices;
+}
+
+// which StressObject a moving entity was made from
+struct Dynamic {
+	uint32_t object;
+};
+
+void add_percentiles(BenchMetrics& metrics, const std::string& name, const RollingStats& stats)
+{
+	metrics.set(name + "_mean", stats.average());
+	metrics.set(name + "_p50", stats.percentile(0.5));
+	metrics.set(name + "_p95", stats.percentile(0.95));
+	metrics.set(name + "_p99", stats.percentile(0.99));
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	root_path = std::filesystem::absolute(argv[0]).parent_path();
+
+	Options options;
+	if (!parse_options(argc, argv, options)) {
+		std::cerr << USAGE;
+		return 2;
+	}
+
+	ContextCreateInfo cc_info {};
+	cc_info.app_name = "frame_bench";
+	cc_info.app_version = VK_MAKE_VERSION(0, 1, 0);
+	cc_info.window_size = options.extent;
+	cc_info.enable_validation_layers = false;
+	cc_info.preferred_extensions = {
+		VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+	};
+	cc_info.headless = true;
+
+	Context context;
+	Renderer renderer;
+	Camera camera {};
+	World world;
+	TransformHierarchy transforms;
+	BenchMetrics metrics;
+
+	try {
+		context.init(cc_info);
+		std::cout << "device: " << context.device_properties.deviceName << std::endl;
+
+		auto scene = generate_stress_scene(options.scene);
+		renderer.gpu_profiling = true;
+		// the frame region of every measured frame, a handful of regions each
+		renderer.gpu_profiler.trace_capacity = (options.warmup + options.frames) * 8;
+		renderer.max_scene_objects = std::max(renderer.max_scene_objects, options.scene.objects);
+
+		SceneGlobals globals {};
+		globals.sun_color = glm::vec3(1.0f);
+		globals.sun_dir = glm::normalize(glm::vec3(60, 60, 60));
+		globals.intensity = 0.5f;
+		globals.ambient_color = glm::vec3(0.05f);
+		renderer.init(&context, globals, &camera);
+
+		camera.width = static_cast<float>(options.extent.width);
+		camera.height = static_cast<float>(options.extent.height);
+		camera.fov = 55.0f;
+		camera.depth_min = 0.1f;
+		camera.depth_max = options.scene.extent * 2.0f;
+		camera.type = Camera::PERSPECTIVE;
+
+		// sized up front, materials can't be moved
+		std::vector<Mesh> meshes(scene.meshes.size());
+		for (size_t i = 0; i < meshes.size(); ++i) {
+			auto& m = scene.meshes[i];
+			meshes[i].init(&context, make_vertices(m), m.indices);
+		}
+
+		uint32_t material_count = std::max(1u, options.scene.materials);
+		std::vector<Material> materials(material_count);
+		std::vector<MaterialParams> params(material_count);
+		std::vector<std::shared_future<VkResult>> builds;
+		for (uint32_t i = 0; i < material_count; ++i) {
+			params[i].color = glm::vec4(
+				0.3f + 0.7f * ((i * 37) % 11) / 10.0f,
+				0.3f + 0.7f * ((i * 53) % 7) / 6.0f,
+				0.3f + 0.7f * ((i * 71) % 5) / 4.0f,
+				1.0f);
+			bool cull_back = (i / FEATURE_VARIANTS) % 2 == 0;
+			builds.push_back(materials[i].init_async(renderer.thread_pool, &context,
+				renderer.render_target, renderer.descriptor_set_layout, renderer.draw_uniforms.layout(),
+				{ },
+				{ },
+				"shader_vert.spv", "material_frag.spv", MATERIAL_FEATURES[i % FEATURE_VARIANTS],
+				cull_back ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE, VK_TRUE));
+		}
+		for (auto& build : builds)
+			vk_check(build.get(), "Failed to create material pipeline");
+
+		for (uint32_t i = 0; i < scene.objects.size(); ++i) {
+			const auto& object = scene.objects[i];
+			SceneNode node { transforms.add(object.transform) };
+			Renderable renderable {
+				&meshes[object.mesh],
+				&materials[object.material],
+				&params[object.material],
+				sizeof(MaterialParams) };
+			SceneRecord record { SceneRecord::NONE, object.material };
+			if (object.dynamic)
+				world.create(node, renderable, record, Dynamic { i });
+			else
+				world.create(node, renderable, record);
+		}
+
+		using clock = std::chrono::steady_clock;
+		using ms = std::chrono::duration<double, std::milli>;
+		RollingStats frame_ms(options.frames), record_ms(options.frames);
+		uint64_t measure_start_ticks = 0;
+		const float frame_seconds = 1.0f / 60.0f;
+
+		uint32_t total_frames = options.warmup + options.frames;
+		for (uint32_t frame = 0; frame < total_frames; ++frame) {
+			if (frame == options.warmup)
+				measure_start_ticks = CpuProfiler::now();
+
+			// a fixed step, so every run renders the same frames
+			auto frame_start = clock::now();
+			float seconds = frame * frame_seconds;
+			camera.transform = camera_path(frame, total_frames, options.scene.extent);
+			world.each<SceneNode, Dynamic>([&](Entity, SceneNode& node, Dynamic& dynamic) {
+				transforms.set_local(node.handle, animate(scene.objects[dynamic.object], seconds));
+			});
+			transforms.update();
+			renderer.update_scene(world, transforms);
+
+			renderer.setup_draw();
+			auto record_start = clock::now();
+			renderer.draw(world, transforms);
+			renderer.present_draw();
+			auto frame_end = clock::now();
+
+			if (frame >= options.warmup) {
+				frame_ms.add(ms(frame_end - frame_start).count());
+				record_ms.add(ms(frame_end - record_start).count());
+			}
+		}
+		vkDeviceWaitIdle(context.device);
+
+		add_percentiles(metrics, "frame_ms", frame_ms);
+		add_percentiles(metrics, "record_ms", record_ms);
+
+		// frames still in flight at the end never get read back
+		if (renderer.gpu_profiler.timestamps_supported()) {
+			double measure_start_us = CpuProfiler::to_us(measure_start_ticks);
+			RollingStats gpu_ms(options.frames);
+			for (const auto& event : renderer.gpu_profiler.trace()) {
+				if (event.name == "frame" && event.start_us >= measure_start_us)
+					gpu_ms.add(event.duration_us / 1000.0);
+			}
+			if (gpu_ms.count() > 0)
+				add_percentiles(metrics, "gpu_ms", gpu_ms);
+		}
+
+		rusage usage {};
+		getrusage(RUSAGE_SELF, &usage);
+		metrics.set("cpu_peak_rss_mb", usage.ru_maxrss / 1024.0);
+		std::vector<VmaBudget> budgets(context.memory_properties.memoryHeapCount);
+		vmaGetHeapBudgets(context.allocator, budgets.data());
+		VkDeviceSize gpu_bytes = 0;
+		for (const auto& budget : budgets)
+			gpu_bytes += budget.usage;
+		metrics.set("gpu_memory_mb", gpu_bytes / (1024.0 * 1024.0));
+
+		world.clear();
+		for (auto& material : materials)
+			material.deinit(&context);
+		for (auto& mesh : meshes)
+			mesh.deinit(&context);
+		renderer.deinit();
+		context.deinit();
+
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+
+	for (const auto& [name, value] : metrics.values)
+		std::cout << name << " " << value << std::endl;
+	if (!options.out_path.empty() && !metrics.save(options.out_path)) {
+		std::cerr << "failed to write " << options.out_path << std::endl;
+		return 2;
+	}
+
+	if (options.baseline_path.empty())
+		return 0;
+	BenchMetrics baseline;
+	if (!baseline.load(options.baseline_path)) {
+		std::cerr << "failed to read baseline " << options.baseline_path << std::endl;
+		return 2;
+	}
+	auto regressions = find_regressions(metrics, baseline, options.threshold);
+	for (const auto& r : regressions)
+		std::cerr << "regression: " << r.name << " " << r.baseline << " -> " << r.current
+				  << " (+" << r.change * 100.0 << "%)" << std::endl;
+	if (!regressions.empty())
+		return 1;
+	std::cout << "within " << options.threshold * 100.0 << "% of " << options.baseline_path << std::endl;
+	return 0;
+}